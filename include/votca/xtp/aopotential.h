@@ -69,6 +69,13 @@ class AOMultipole : public AOPotential<double> {
       const AOBasis& aobasis,
       const std::vector<std::unique_ptr<StaticSite>>& externalsites);
 
+  // potential of the electrons described by dmat at all points, the
+  // integrals are contracted with dmat shell pair by shell pair and pairs
+  // without density or overlap are skipped
+  Eigen::VectorXd ElectronicPotential(
+      const AOBasis& aobasis, const Eigen::MatrixXd& dmat,
+      const std::vector<Eigen::Vector3d>& points) const;
+
  protected:
   void FillBlock(Eigen::Block<Eigen::MatrixXd>& matrix,
                  const AOShell& shell_row,
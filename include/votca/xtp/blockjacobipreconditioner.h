@@ -0,0 +1,109 @@
+/*
+ * Copyright 2009-2020 The VOTCA Development Team (http://www.votca.org)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#pragma once
+#ifndef VOTCA_XTP_BLOCKJACOBIPRECONDITIONER_H
+#define VOTCA_XTP_BLOCKJACOBIPRECONDITIONER_H
+
+// Standard includes
+#include <vector>
+
+// Local VOTCA includes
+#include "eeinteractor.h"
+#include "eigen.h"
+
+namespace votca {
+namespace xtp {
+
+/**
+ * \brief Block-Jacobi preconditioner for the induced dipole equations
+ *
+ * Keeps the Cholesky factors of the intra-segment blocks of the
+ * DipoleDipoleInteraction matrix, so solve() gives the exact induced dipoles
+ * of isolated segments. Follows the preconditioner interface of
+ * Eigen::ConjugateGradient, the blocks have to be set up before compute is
+ * called.
+ */
+class BlockJacobiPreconditioner {
+ public:
+  BlockJacobiPreconditioner() = default;
+
+  template <typename MatType>
+  explicit BlockJacobiPreconditioner(const MatType&) {}
+
+  void setup(const eeInteractor& interactor,
+             const std::vector<PolarSegment>& segs) {
+    blocks_ = std::vector<Eigen::LLT<Eigen::MatrixXd>>(segs.size());
+    offsets_.resize(segs.size());
+    size_ = 0;
+    for (Index i = 0; i < Index(segs.size()); i++) {
+      offsets_[i] = size_;
+      size_ += 3 * segs[i].size();
+    }
+    bool success = true;
+#pragma omp parallel for schedule(dynamic) reduction(&& : success)
+    for (Index i = 0; i < Index(segs.size()); i++) {
+      blocks_[i].compute(interactor.IntraSegmentMatrix(segs[i]));
+      success = success && (blocks_[i].info() == Eigen::Success);
+    }
+    info_ = success ? Eigen::Success : Eigen::NumericalIssue;
+  }
+
+  template <typename MatType>
+  BlockJacobiPreconditioner& analyzePattern(const MatType&) {
+    return *this;
+  }
+
+  template <typename MatType>
+  BlockJacobiPreconditioner& factorize(const MatType& mat) {
+    assert(mat.rows() == size_ &&
+           "preconditioner was set up for a different matrix");
+    EIGEN_ONLY_USED_FOR_DEBUG(mat);
+    return *this;
+  }
+
+  template <typename MatType>
+  BlockJacobiPreconditioner& compute(const MatType& mat) {
+    return factorize(mat);
+  }
+
+  template <typename Rhs>
+  Eigen::VectorXd solve(const Rhs& b) const {
+    assert(b.size() == size_ && "input vector has the wrong size");
+    Eigen::VectorXd x = Eigen::VectorXd(size_);
+#pragma omp parallel for schedule(dynamic)
+    for (Index i = 0; i < Index(blocks_.size()); i++) {
+      Index blocksize = blocks_[i].rows();
+      x.segment(offsets_[i], blocksize) =
+          blocks_[i].solve(b.segment(offsets_[i], blocksize));
+    }
+    return x;
+  }
+
+  Eigen::ComputationInfo info() const { return info_; }
+
+ private:
+  std::vector<Eigen::LLT<Eigen::MatrixXd>> blocks_;
+  std::vector<Index> offsets_;
+  Index size_ = 0;
+  Eigen::ComputationInfo info_ = Eigen::Success;
+};
+
+}  // namespace xtp
+}  // namespace votca
+
+#endif  // VOTCA_XTP_BLOCKJACOBIPRECONDITIONER_H
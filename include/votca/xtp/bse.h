@@ -21,6 +21,9 @@
 #ifndef VOTCA_XTP_BSE_H
 #define VOTCA_XTP_BSE_H
 
+// Standard includes
+#include <array>
+
 // Local VOTCA includes
 #include "logger.h"
 #include "orbitals.h"
@@ -36,6 +39,8 @@ typedef BSE_OPERATOR<1, 2, 1, 0> SingletOperator_TDA;
 typedef BSE_OPERATOR<1, 0, 1, 0> TripletOperator_TDA;
 template <class T>
 class QMFragment;
+class RPA;
+class DavidsonSolver;
 
 class BSE {
 
@@ -58,10 +63,21 @@ class BSE {
     std::string davidson_tolerance;
     std::string davidson_update;
     Index davidson_maxiter;
+    bool davidson_warmstart;  // start from BSE eigenvectors in the orbitals
+    Index dense_max_memory;   // bytes the explicit hamiltonian may use
     double min_print_weight;  // minimium contribution for state to print it
     bool use_Hqp_offdiag;
     Index max_dyn_iter;
     double dyn_tolerance;
+    double dyn_mesh;  // spacing of the frequency mesh for dynamical screening
+    // in TDA only levels with transitions up to truncation_window above the
+    // requested roots are kept, 0 keeps the full product space
+    double truncation_window;
+    double truncation_coupling;  // keeps strongly coupled levels outside
+    Index haydock_steps;  // Lanczos steps for the absorption spectrum
+    // Mmn is streamed in single precision, the converged states are refined
+    // with the double precision Mmn
+    bool mixed_precision;
   };
 
   void configure(const options& opt, const Eigen::VectorXd& RPAEnergies,
@@ -69,6 +85,9 @@ class BSE {
 
   void Solve_singlets(Orbitals& orb) const;
   void Solve_triplets(Orbitals& orb) const;
+  // same as Solve_triplets and Solve_singlets, but in TDA both Davidson
+  // solvers share the application of the direct interaction
+  void Solve_singlets_and_triplets(Orbitals& orb) const;
 
   Eigen::MatrixXd getHqp() const { return Hqp_; };
 
@@ -82,6 +101,13 @@ class BSE {
 
   void Perturbative_DynamicalScreening(const QMStateType& type, Orbitals& orb);
 
+  // Lorentzian broadened oscillator strength density f(omega) and
+  // omega*f(omega) of the singlets on a frequency grid, from a Lanczos
+  // recursion started at the transition dipoles instead of eigenvectors
+  Eigen::MatrixXd AbsorptionSpectrum(const Orbitals& orb,
+                                     const Eigen::VectorXd& frequencies,
+                                     double fwhm) const;
+
  private:
   options opt_;
 
@@ -111,27 +137,63 @@ class BSE {
   TCMatrix_gwbse& Mmn_;
   Eigen::MatrixXd Hqp_;
 
-  tools::EigenSystem Solve_singlets_TDA() const;
-  tools::EigenSystem Solve_singlets_BTDA() const;
+  tools::EigenSystem Solve_singlets_TDA(const Eigen::MatrixXd& guess) const;
+  tools::EigenSystem Solve_singlets_BTDA(const Eigen::MatrixXd& guess) const;
 
-  tools::EigenSystem Solve_triplets_TDA() const;
-  tools::EigenSystem Solve_triplets_BTDA() const;
+  tools::EigenSystem Solve_triplets_TDA(const Eigen::MatrixXd& guess) const;
+  tools::EigenSystem Solve_triplets_BTDA(const Eigen::MatrixXd& guess) const;
+
+  Eigen::MatrixXd InitialGuess(const tools::EigenSystem& previous) const;
 
   void PrintWeights(const Eigen::VectorXd& weights) const;
 
   template <typename BSE_OPERATOR>
   void configureBSEOperator(BSE_OPERATOR& H) const;
 
+  // decides if nblocks size x size matrices fit into dense_max_memory
+  bool StoreHamiltonian(Index nblocks, Index size) const;
+  bool UseDenseSolver(Index size) const;
+
   template <typename BSE_OPERATOR>
-  tools::EigenSystem solve_hermitian(BSE_OPERATOR& h) const;
+  tools::EigenSystem solve_hermitian(BSE_OPERATOR& h,
+                                     const Eigen::MatrixXd& guess) const;
 
-  template <typename BSE_OPERATOR_ApB, typename BSE_OPERATOR_AmB>
-  tools::EigenSystem Solve_nonhermitian(BSE_OPERATOR_ApB& apb,
-                                        BSE_OPERATOR_AmB&) const;
+  void configureDavidson(DavidsonSolver& DS,
+                         const Eigen::MatrixXd& guess) const;
 
+  // Rayleigh-Ritz step with the double precision Mmn in the space of the
+  // states from the single precision kernels
+  template <typename BSE_OPERATOR>
+  void RefineHermitian(BSE_OPERATOR& h, tools::EigenSystem& result) const;
   template <typename BSE_OPERATOR_A, typename BSE_OPERATOR_B>
-  tools::EigenSystem Solve_nonhermitian_Davidson(BSE_OPERATOR_A& Aop,
-                                                 BSE_OPERATOR_B& Bop) const;
+  void RefineNonHermitian(BSE_OPERATOR_A& Aop, BSE_OPERATOR_B& Bop,
+                          tools::EigenSystem& result) const;
+
+  // lowest occupied and highest virtual level kept by the truncation
+  std::array<Index, 2> TruncatedWindow() const;
+
+  // solves in the truncated product space and adds a second order
+  // correction for the discarded transitions
+  template <typename BSE_OPERATOR>
+  tools::EigenSystem solve_hermitian_truncated(
+      BSE_OPERATOR& h, const Eigen::MatrixXd& guess) const;
+
+  template <typename MatrixReplacement>
+  tools::EigenSystem Solve_hermitian_Davidson(
+      MatrixReplacement& h, const Eigen::MatrixXd& guess) const;
+
+  template <typename BSE_OPERATOR_A, typename BSE_OPERATOR_B>
+  tools::EigenSystem solve_nonhermitian(BSE_OPERATOR_A& Aop,
+                                        BSE_OPERATOR_B& Bop,
+                                        const Eigen::MatrixXd& guess) const;
+
+  tools::EigenSystem Solve_nonhermitian_dense(const Eigen::MatrixXd& A,
+                                              const Eigen::MatrixXd& B) const;
+
+  template <typename BSE_OPERATOR_A, typename BSE_OPERATOR_B>
+  tools::EigenSystem Solve_nonhermitian_Davidson(
+      BSE_OPERATOR_A& Aop, BSE_OPERATOR_B& Bop,
+      const Eigen::MatrixXd& guess) const;
 
   void printFragInfo(const std::vector<QMFragment<BSE_Population> >& frags,
                      Index state) const;
@@ -139,6 +201,15 @@ class BSE {
   void SetupDirectInteractionOperator(const Eigen::VectorXd& DFTenergies,
                                       double energy);
 
+  // upper triangle of <state|Hd+Hd2|state> as a function of epsilon^-1 in the
+  // current auxbasis, one column per state
+  Eigen::MatrixXd DirectInteractionDensities(const QMStateType& type,
+                                             const Orbitals& orb) const;
+  // nonpositive counts the eigenvalues of epsilon <= 0, it changes where
+  // epsilon^-1 has a pole
+  Eigen::VectorXd InverseScreening(const RPA& rpa, double frequency,
+                                   Index& nonpositive) const;
+
   Eigen::MatrixXd AdjustHqpSize(const Eigen::MatrixXd& Hqp_in,
                                 const Eigen::VectorXd& RPAInputEnergies);
 
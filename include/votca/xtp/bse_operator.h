@@ -21,6 +21,9 @@
 #ifndef VOTCA_XTP_BSE_OPERATOR_H
 #define VOTCA_XTP_BSE_OPERATOR_H
 
+// Standard includes
+#include <utility>
+
 // Local VOTCA includes
 #include "eigen.h"
 #include "matrixfreeoperator.h"
@@ -61,6 +64,10 @@ class BSE_OPERATOR final : public MatrixFreeOperator {
    */
   Eigen::MatrixXd matmul(const Eigen::MatrixXd& input) const;
 
+  // Builds the operator explicitly, the Mmn contractions become a few large
+  // matrix products. Needs bse_size^2 doubles.
+  Eigen::MatrixXd get_full_matrix() const;
+
  private:
   Eigen::VectorXd Hqp_row(Index v1, Index c1) const;
 
@@ -86,6 +93,34 @@ typedef BSE_OPERATOR<0, 1, 0, 0> HxOperator;
 typedef BSE_OPERATOR<0, 0, 1, 0> HdOperator;
 typedef BSE_OPERATOR<0, 0, 0, 1> Hd2Operator;
 
+/*
+ * Applies the TDA singlet and the triplet hamiltonian to their own sets of
+ * vectors at once. The triplet hamiltonian Hqp+Hd is applied to both sets
+ * together, so the Mmn blocks of the direct interaction are read only once,
+ * and the singlet vectors additionally get 2*Hx. Interface as needed by
+ * DavidsonSolver::solve_lockstep, the singlets are the first problem.
+ */
+class SingletTripletOperator_TDA {
+ public:
+  SingletTripletOperator_TDA(const TripletOperator_TDA& Ht,
+                             const HxOperator& Hx)
+      : Ht_(Ht), Hx_(Hx){};
+
+  Index rows() const { return Ht_.rows(); }
+
+  Eigen::VectorXd diagonal1() const {
+    return Ht_.diagonal() + 2 * Hx_.diagonal();
+  }
+  Eigen::VectorXd diagonal2() const { return Ht_.diagonal(); }
+
+  std::pair<Eigen::MatrixXd, Eigen::MatrixXd> matmul(
+      const Eigen::MatrixXd& singlets, const Eigen::MatrixXd& triplets) const;
+
+ private:
+  const TripletOperator_TDA& Ht_;
+  const HxOperator& Hx_;
+};
+
 }  // namespace xtp
 }  // namespace votca
 
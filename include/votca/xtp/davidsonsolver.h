@@ -20,9 +20,11 @@
 #define VOTCA_XTP_DAVIDSONSOLVER_H
 
 // Standard includes
+#include <algorithm>
 #include <chrono>
 #include <iostream>
 #include <stdexcept>
+#include <utility>
 
 // Third party includes
 #include <boost/format.hpp>
@@ -55,6 +57,11 @@ class DavidsonSolver {
   void set_correction(std::string method);
   void set_size_update(std::string update_size);
   void set_matrix_type(std::string mt);
+  // vectors used to build the initial search space instead of unit vectors,
+  // e.g. eigenvectors of a previous, similar problem
+  void set_initial_guess(const Eigen::MatrixXd &guess) {
+    this->initial_guess_ = guess;
+  }
 
   Eigen::ComputationInfo info() const { return info_; }
   Eigen::VectorXd eigenvalues() const { return this->eigenvalues_; }
@@ -65,60 +72,75 @@ class DavidsonSolver {
   void solve(const MatrixReplacement &A, Index neigen,
              Index size_initial_guess = 0) {
 
-    if (max_search_space_ < neigen) {
-      max_search_space_ = neigen * 5;
-    }
     std::chrono::time_point<std::chrono::system_clock> start =
         std::chrono::system_clock::now();
-    Index op_size = A.rows();
-
-    checkOptions(op_size);
-    printOptions(op_size);
-
-    // initial guess size
-    if (size_initial_guess == 0) {
-      size_initial_guess = 2 * neigen;
-    }
-
-    restart_size_ = size_initial_guess;
 
-    // get the diagonal of the operator
-    this->Adiag_ = A.diagonal();
-
-    // target the lowest diagonal element
-    ProjectedSpace proj = initProjectedSpace(neigen, size_initial_guess);
+    ProjectedSpace proj =
+        startSolve(A.rows(), A.diagonal(), neigen, size_initial_guess);
     RitzEigenPair rep;
-    XTP_LOG(Log::error, log_)
-        << TimeStamp() << " iter\tSearch Space\tNorm" << std::flush;
 
     for (i_iter_ = 0; i_iter_ < iter_max_; i_iter_++) {
-
       updateProjection(A, proj);
+      if (iterate(rep, proj, neigen)) {
+        break;
+      }
+    }
 
-      rep = getRitzEigenPairs(proj);
-
-      bool converged = checkConvergence(rep, proj, neigen);
-
-      printIterationData(rep, proj, neigen);
+    printTiming(start);
+  }
 
-      bool last_iter = i_iter_ == (iter_max_ - 1);
+  /*
+   * Solves two symmetric problems of the same size in lockstep, the second
+   * one with the options of other. Each iteration applies both operators
+   * with one call A.matmul(V1, V2), which returns the pair (A1*V1, A2*V2),
+   * so that work the two operators share is only done once. A also has to
+   * provide rows(), diagonal1() and diagonal2().
+   */
+  template <typename PairOperator>
+  void solve_lockstep(const PairOperator &A, Index neigen,
+                      DavidsonSolver &other, Index neigen_other) {
+
+    if (matrix_type_ != MATRIX_TYPE::SYMM ||
+        other.matrix_type_ != MATRIX_TYPE::SYMM) {
+      throw std::runtime_error(
+          "Davidson lockstep solve only works for symmetric matrices");
+    }
+    std::chrono::time_point<std::chrono::system_clock> start =
+        std::chrono::system_clock::now();
 
-      if (converged) {
-        storeConvergedData(rep, neigen);
-        break;
-      } else if (last_iter) {
-        storeNotConvergedData(rep, proj.root_converged, neigen);
-        break;
+    ProjectedSpace proj = startSolve(A.rows(), A.diagonal1(), neigen, 0);
+    ProjectedSpace proj_other =
+        other.startSolve(A.rows(), A.diagonal2(), neigen_other, 0);
+    RitzEigenPair rep;
+    RitzEigenPair rep_other;
+
+    i_iter_ = 0;
+    other.i_iter_ = 0;
+    bool finished = (iter_max_ <= 0);
+    bool finished_other = (other.iter_max_ <= 0);
+    while (!finished || !finished_other) {
+      // a finished problem passes an empty block
+      Eigen::MatrixXd V = newVectors(proj, finished);
+      Eigen::MatrixXd V_other = other.newVectors(proj_other, finished_other);
+      std::pair<Eigen::MatrixXd, Eigen::MatrixXd> AV = A.matmul(V, V_other);
+      if (!finished) {
+        appendProjection(proj, AV.first);
+        finished = iterate(rep, proj, neigen);
+        if (!finished) {
+          i_iter_++;
+        }
       }
-      Index extension_size = extendProjection(rep, proj);
-      bool do_restart = (proj.search_space() > max_search_space_);
-
-      if (do_restart) {
-        restart(rep, proj, extension_size);
+      if (!finished_other) {
+        other.appendProjection(proj_other, AV.second);
+        finished_other = other.iterate(rep_other, proj_other, neigen_other);
+        if (!finished_other) {
+          other.i_iter_++;
+        }
       }
     }
 
     printTiming(start);
+    other.printTiming(start);
   }
 
  private:
@@ -129,6 +151,7 @@ class DavidsonSolver {
   double tol_ = 1E-4;
   Index max_search_space_ = 0;
   Eigen::VectorXd Adiag_;
+  Eigen::MatrixXd initial_guess_;
   Index restart_size_ = 0;
   enum CORR { DPR, OLSEN };
   CORR davidson_correction_ = CORR::DPR;
@@ -148,6 +171,9 @@ class DavidsonSolver {
     Eigen::MatrixXd q;       // Ritz (or harmonic Ritz) eigenvectors
     Eigen::MatrixXd U;       // eigenvectors of the small subspace
     Eigen::MatrixXd res;     // residues of the pairs
+    // all eigenpairs of the small subspace, only kept in the symmetric case
+    Eigen::VectorXd lambda_all;
+    Eigen::MatrixXd U_all;
     Eigen::ArrayXd res_norm() const {
       return res.colwise().norm();
     }  // norm of the residues
@@ -166,20 +192,24 @@ class DavidsonSolver {
     // These are only used for harmonic ritz in the non-hermitian case
     Eigen::MatrixXd AAV;  // A*A*V
     Eigen::MatrixXd B;    // V.T *A*A*V
+
+    // converged roots removed from the search space (only symmetric case)
+    Eigen::MatrixXd locked_vectors;
+    Eigen::VectorXd locked_values;
+    Index nlocked() const { return locked_values.size(); }
   };
 
   template <typename MatrixReplacement>
   void updateProjection(const MatrixReplacement &A,
                         ProjectedSpace &proj) const {
 
-    if (i_iter_ == 0) {
+    if (matrix_type_ == MATRIX_TYPE::SYMM) {
+      appendProjection(proj, A * newVectors(proj, false));
+    } else if (i_iter_ == 0) {
       proj.AV = A * proj.V;
       proj.T = proj.V.transpose() * proj.AV;
-      if (matrix_type_ == MATRIX_TYPE::HAM) {
-        proj.AAV = A * proj.AV;
-        proj.B = proj.V.transpose() * proj.AAV;
-      }
-
+      proj.AAV = A * proj.AV;
+      proj.B = proj.V.transpose() * proj.AAV;
     } else {
       /* if we use a Gram Schmid(GS) orthogonalisation we do not have to
       recompute the entire projection as GS doesn't change the original
@@ -192,24 +222,29 @@ class DavidsonSolver {
 
       proj.T.conservativeResize(new_dim, new_dim);
       proj.T.rightCols(nvec) = proj.V.transpose() * proj.AV.rightCols(nvec);
+      proj.T.bottomLeftCorner(nvec, old_dim) =
+          proj.V.rightCols(nvec).transpose() * proj.AV.leftCols(old_dim);
+
+      proj.AAV.conservativeResize(Eigen::NoChange, new_dim);
+      proj.AAV.rightCols(nvec) = A * proj.AV.rightCols(nvec);
+      proj.B.conservativeResize(new_dim, new_dim);
+      proj.B.rightCols(nvec) = proj.V.transpose() * proj.AAV.rightCols(nvec);
+      proj.B.bottomLeftCorner(nvec, old_dim) =
+          proj.V.rightCols(nvec).transpose() * proj.AAV.leftCols(old_dim);
+    }
+  }
 
-      if (matrix_type_ == MATRIX_TYPE::SYMM) {
-        proj.T.bottomLeftCorner(nvec, old_dim) =
-            proj.T.topRightCorner(old_dim, nvec).transpose();
+  // vectors of the search space whose product with A is not known yet
+  Eigen::MatrixXd newVectors(const ProjectedSpace &proj, bool none) const;
+  // adds A*V for the new vectors to the symmetric projection
+  void appendProjection(ProjectedSpace &proj, const Eigen::MatrixXd &AV) const;
 
-      } else {
-        proj.T.bottomLeftCorner(nvec, old_dim) =
-            proj.V.rightCols(nvec).transpose() * proj.AV.leftCols(old_dim);
+  ProjectedSpace startSolve(Index op_size, const Eigen::VectorXd &Adiag,
+                            Index neigen, Index size_initial_guess);
+  // everything of one iteration after the projection is updated, returns
+  // true once the solver is done
+  bool iterate(RitzEigenPair &rep, ProjectedSpace &proj, Index neigen);
 
-        proj.AAV.conservativeResize(Eigen::NoChange, new_dim);
-        proj.AAV.rightCols(nvec) = A * proj.AV.rightCols(nvec);
-        proj.B.conservativeResize(new_dim, new_dim);
-        proj.B.rightCols(nvec) = proj.V.transpose() * proj.AAV.rightCols(nvec);
-        proj.B.bottomLeftCorner(nvec, old_dim) =
-            proj.V.rightCols(nvec).transpose() * proj.AAV.leftCols(old_dim);
-      }
-    }
-  }
   RitzEigenPair getRitzEigenPairs(const ProjectedSpace &proj) const;
 
   Eigen::MatrixXd qr(const Eigen::MatrixXd &A) const;
@@ -238,6 +273,11 @@ class DavidsonSolver {
 
   void orthogonalize(Eigen::MatrixXd &V, Index nupdate) const;
   void gramschmidt(Eigen::MatrixXd &A, Index nstart) const;
+  bool choleskyqr(Eigen::MatrixXd &Q, Index nstart,
+                  const Eigen::VectorXd &norms) const;
+  void columnwise_gramschmidt(Eigen::MatrixXd &Q, Index nstart,
+                              const Eigen::VectorXd &norms,
+                              bool check_dependence) const;
 
   Eigen::VectorXd computeCorrectionVector(const Eigen::VectorXd &qj,
                                           double lambdaj,
@@ -254,15 +294,20 @@ class DavidsonSolver {
   bool checkConvergence(const RitzEigenPair &rep, ProjectedSpace &proj,
                         Index neigen) const;
 
+  void lockConvergedRoots(RitzEigenPair &rep, ProjectedSpace &proj,
+                          Index neigen) const;
+
   void restart(const RitzEigenPair &rep, ProjectedSpace &proj,
                Index newtestvectors) const;
 
-  void storeConvergedData(const RitzEigenPair &rep, Index neigen);
+  void storeConvergedData(const RitzEigenPair &rep, const ProjectedSpace &proj,
+                          Index neigen);
 
   void storeNotConvergedData(const RitzEigenPair &rep,
-                             const ArrayXb &root_converged, Index neigen);
+                             const ProjectedSpace &proj, Index neigen);
 
-  void storeEigenPairs(const RitzEigenPair &rep, Index neigen);
+  ArrayXb storeEigenPairs(const RitzEigenPair &rep, const ProjectedSpace &proj,
+                          Index neigen);
 };
 
 }  // namespace xtp
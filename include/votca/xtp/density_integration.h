@@ -44,6 +44,19 @@ class DensityIntegration {
   double IntegrateDensity(const Eigen::MatrixXd& density_matrix);
   double IntegratePotential(const Eigen::Vector3d& rvector) const;
   Eigen::Vector3d IntegrateField(const Eigen::Vector3d& rvector) const;
+
+  // sorts the density of IntegrateDensity into cubes of boxsize and
+  // calculates their multipole expansions up to quadrupoles
+  void SetupMultipoleBoxes(double boxsize);
+  // like IntegrateField, but cubes with radius/distance below accuracy act
+  // through their expansion
+  Eigen::Vector3d IntegrateField_Multipoles(const Eigen::Vector3d& rvector,
+                                            double accuracy) const;
+  // like IntegratePotential, a cube acts through its expansion if that
+  // changes the result by less than accuracy/(number of cubes), so the
+  // deviation from IntegratePotential is below accuracy
+  double IntegratePotential_Multipoles(const Eigen::Vector3d& rvector,
+                                       double accuracy) const;
   Eigen::MatrixXd IntegratePotential(const AOBasis& externalbasis) const;
 
   Gyrationtensor IntegrateGyrationTensor(const Eigen::MatrixXd& density_matrix);
@@ -53,10 +66,22 @@ class DensityIntegration {
   }
 
  private:
+  struct MultipoleBox {
+    std::vector<Eigen::Vector3d> points;
+    std::vector<double> densities;
+    Eigen::Vector3d center = Eigen::Vector3d::Zero();
+    double radius = 0.0;
+    double charge = 0.0;
+    double abs_charge = 0.0;
+    Eigen::Vector3d dipole = Eigen::Vector3d::Zero();
+    Eigen::Matrix3d quadrupole = Eigen::Matrix3d::Zero();
+  };
+
   void SetupDensityContainer();
   const Grid grid_;
 
   std::vector<std::vector<double> > densities_;
+  std::vector<MultipoleBox> multipole_boxes_;
 };
 
 }  // namespace xtp
@@ -22,6 +22,7 @@
 // Local VOTCA includes
 #include "eeinteractor.h"
 #include "eigen.h"
+#include "ewaldsum.h"
 
 namespace votca {
 namespace xtp {
@@ -56,16 +57,19 @@ class DipoleDipoleInteraction
   DipoleDipoleInteraction(const eeInteractor& interactor,
                           const std::vector<PolarSegment>& segs)
       : interactor_(interactor) {
-    size_ = 0;
-    for (const PolarSegment& seg : segs) {
-      size_ += 3 * seg.size();
-    }
-    sites_.reserve(size_ / 3);
-    for (const PolarSegment& seg : segs) {
-      for (const PolarSite& site : seg) {
-        sites_.push_back(&site);
-      }
-    }
+    CollectSites(segs);
+    own_packed_ = PolarSiteBlock(sites_);
+  }
+
+  // uses the block of a region, which packs its sites once for all
+  // operators and CG iterations, the block has to outlive the operator
+  DipoleDipoleInteraction(const eeInteractor& interactor,
+                          const std::vector<PolarSegment>& segs,
+                          const PolarSiteBlock& packed)
+      : interactor_(interactor), packed_(&packed) {
+    CollectSites(segs);
+    assert(packed.size() == Index(sites_.size()) &&
+           "block belongs to a different set of sites");
   }
 
   class InnerIterator {
@@ -103,7 +107,7 @@ class DipoleDipoleInteraction
                           Eigen::AliasFreeProduct>(*this, x.derived());
   }
 
-  // this is not a fast method
+  // this is not a fast method, it does not include the periodic images
   double operator()(const Index i, const Index j) const {
     Index seg1id = Index(i / 3);
     Index xyz1 = Index(i % 3);
@@ -119,28 +123,205 @@ class DipoleDipoleInteraction
     }
   };
 
+  /**
+   * \brief Thole tensors of all site pairs i<j closer than a cutoff
+   *
+   * Stored row wise, the blocks of site i are
+   * block[row_start[i]] ... block[row_start[i+1]-1] with the partner sites in
+   * col. They only depend on the geometry and the polarisabilities and can be
+   * kept over many solves.
+   */
+  struct NearFieldBlocks {
+    std::vector<Index> row_start;
+    std::vector<Index> col;
+    std::vector<Eigen::Matrix3d> block;
+    Index nsites() const { return Index(row_start.size()) - 1; }
+  };
+
+  // pairs are added site by site until max_memory (in bytes) is reached, the
+  // remaining pairs are computed on the fly
+  NearFieldBlocks CalcNearFieldBlocks(double cutoff, double max_memory) const {
+    const Index nsites = Index(sites_.size());
+    const double cutoff2 = cutoff * cutoff;
+    std::vector<Index> count(nsites, 0);
+#pragma omp parallel for schedule(dynamic)
+    for (Index i = 0; i < nsites; i++) {
+      const Eigen::Vector3d& pos1 = sites_[i]->getPos();
+      for (Index j = i + 1; j < nsites; j++) {
+        if ((sites_[j]->getPos() - pos1).squaredNorm() < cutoff2) {
+          count[i]++;
+        }
+      }
+    }
+
+    const Index max_blocks =
+        Index(max_memory / double(sizeof(Eigen::Matrix3d) + sizeof(Index)));
+    NearFieldBlocks near;
+    near.row_start.resize(nsites + 1);
+    near.row_start[0] = 0;
+    bool full = false;
+    for (Index i = 0; i < nsites; i++) {
+      full = full || (near.row_start[i] + count[i] > max_blocks);
+      if (full) {
+        count[i] = 0;
+      }
+      near.row_start[i + 1] = near.row_start[i] + count[i];
+    }
+    near.col.resize(near.row_start.back());
+    near.block.resize(near.row_start.back());
+
+#pragma omp parallel for schedule(dynamic)
+    for (Index i = 0; i < nsites; i++) {
+      if (count[i] == 0) {
+        continue;
+      }
+      const PolarSite& site1 = *sites_[i];
+      Index k = near.row_start[i];
+      for (Index j = i + 1; j < nsites; j++) {
+        const PolarSite& site2 = *sites_[j];
+        if ((site2.getPos() - site1.getPos()).squaredNorm() < cutoff2) {
+          near.col[k] = j;
+          near.block[k] = interactor_.FillTholeInteraction(site1, site2);
+          k++;
+        }
+      }
+    }
+    return near;
+  }
+
+  // the blocks are not copied and have to outlive the operator
+  void setNearFieldBlocks(const NearFieldBlocks& near) {
+    assert(near.nsites() == Index(sites_.size()) &&
+           "near field blocks belong to a different set of sites");
+    near_ = &near;
+  }
+
+  // Thole corrections of the closest image of all pairs i<j within the
+  // damping range, including pairs in the same cell, stored like the near
+  // field blocks. Only valid if the damping range is below half the smallest
+  // cell height, then no pair has a second damped image.
+  NearFieldBlocks CalcLatticeDampingBlocks(const EwaldSum& lattice) const {
+    const Index nsites = Index(sites_.size());
+    std::vector<std::vector<Index>> cols(nsites);
+    std::vector<std::vector<Eigen::Matrix3d>> blocks(nsites);
+#pragma omp parallel for schedule(dynamic)
+    for (Index i = 0; i < nsites; i++) {
+      const PolarSite& site1 = *sites_[i];
+      for (Index j = i + 1; j < nsites; j++) {
+        const PolarSite& site2 = *sites_[j];
+        const Eigen::Vector3d dr = site2.getPos() - site1.getPos();
+        const Eigen::Matrix3d correction = interactor_.TholeCorrection(
+            site1, site2, lattice.ShortestImage(dr) - dr);
+        if (!correction.isZero(0.0)) {
+          cols[i].push_back(j);
+          blocks[i].push_back(correction);
+        }
+      }
+    }
+    NearFieldBlocks damping;
+    damping.row_start.resize(nsites + 1);
+    damping.row_start[0] = 0;
+    for (Index i = 0; i < nsites; i++) {
+      damping.row_start[i + 1] = damping.row_start[i] + Index(cols[i].size());
+      damping.col.insert(damping.col.end(), cols[i].begin(), cols[i].end());
+      damping.block.insert(damping.block.end(), blocks[i].begin(),
+                           blocks[i].end());
+    }
+    return damping;
+  }
+
+  // replaces the direct sum over all pairs by the Ewald sum of the dipoles
+  // and all their periodic images plus the Thole corrections of
+  // CalcLatticeDampingBlocks. The sum has to be set up from the sites of the
+  // operator in the same order, both have to outlive the operator.
+  void setLattice(const EwaldSum& lattice, const NearFieldBlocks& damping) {
+    assert(lattice.NumberOfSites() == Index(sites_.size()) &&
+           damping.nsites() == Index(sites_.size()) &&
+           "lattice belongs to a different set of sites");
+    lattice_ = &lattice;
+    damping_ = &damping;
+  }
+
   Eigen::VectorXd multiply(const Eigen::VectorXd& v) const {
     assert(v.size() == size_ &&
            "input vector has the wrong size for multiply with operator");
     const Index segment_size = Index(sites_.size());
-    Eigen::VectorXd result = Eigen::VectorXd::Zero(size_);
-#pragma omp parallel for schedule(dynamic) reduction(+ : result)
+    using RowMatrix =
+        Eigen::Matrix<double, Eigen::Dynamic, 3, Eigen::RowMajor>;
+    // structure-of-arrays layout for the array kernel
+    const Eigen::MatrixXd dipoles =
+        Eigen::Map<const RowMatrix>(v.data(), segment_size, 3);
+    Eigen::VectorXd result = Eigen::VectorXd(size_);
+    if (lattice_ != nullptr) {
+      Eigen::Map<RowMatrix>(result.data(), segment_size, 3) =
+          LatticeFields(dipoles);
+      return result;
+    }
+    const PolarSiteBlock& packed =
+        (packed_ != nullptr) ? *packed_ : own_packed_;
+    Eigen::MatrixXd fields = Eigen::MatrixXd::Zero(segment_size, 3);
+#pragma omp parallel for schedule(dynamic) reduction(+ : fields)
     for (Index i = 0; i < segment_size; i++) {
-      const PolarSite& site1 = *sites_[i];
-      result.segment<3>(3 * i) += site1.getPInv() * v.segment<3>(3 * i);
-      for (Index j = i + 1; j < segment_size; j++) {
-        const PolarSite& site2 = *sites_[j];
-        Eigen::Matrix3d block = interactor_.FillTholeInteraction(site1, site2);
-        result.segment<3>(3 * i) += block * v.segment<3>(3 * j);
-        result.segment<3>(3 * j) += block.transpose() * v.segment<3>(3 * i);
+      fields.row(i) += dipoles.row(i) * sites_[i]->getPInv().transpose();
+      // stored near field pairs split the row into ranges computed on the fly
+      Index first = i + 1;
+      if (near_ != nullptr) {
+        for (Index k = near_->row_start[i]; k < near_->row_start[i + 1];
+             k++) {
+          const Index j = near_->col[k];
+          interactor_.TholeField_Block(packed, i, first, j - first, dipoles,
+                                       fields);
+          const Eigen::Matrix3d& block = near_->block[k];
+          fields.row(i) += dipoles.row(j) * block.transpose();
+          fields.row(j) += dipoles.row(i) * block;
+          first = j + 1;
+        }
       }
+      interactor_.TholeField_Block(packed, i, first, segment_size - first,
+                                   dipoles, fields);
     }
-
+    Eigen::Map<RowMatrix>(result.data(), segment_size, 3) = fields;
     return result;
   }
 
  private:
+  void CollectSites(const std::vector<PolarSegment>& segs) {
+    size_ = 0;
+    for (const PolarSegment& seg : segs) {
+      size_ += 3 * seg.size();
+    }
+    sites_.reserve(size_ / 3);
+    for (const PolarSegment& seg : segs) {
+      for (const PolarSite& site : seg) {
+        sites_.push_back(&site);
+      }
+    }
+  }
+
+  Eigen::MatrixXd LatticeFields(const Eigen::MatrixXd& dipoles) const {
+    const Index segment_size = Index(sites_.size());
+    Eigen::MatrixXd fields = Eigen::MatrixXd::Zero(segment_size, 3);
+#pragma omp parallel for schedule(dynamic) reduction(+ : fields)
+    for (Index i = 0; i < segment_size; i++) {
+      fields.row(i) += dipoles.row(i) * sites_[i]->getPInv().transpose();
+      for (Index k = damping_->row_start[i]; k < damping_->row_start[i + 1];
+           k++) {
+        const Index j = damping_->col[k];
+        const Eigen::Matrix3d& block = damping_->block[k];
+        fields.row(i) += dipoles.row(j) * block.transpose();
+        fields.row(j) += dipoles.row(i) * block;
+      }
+    }
+    return fields + lattice_->DipoleField(dipoles);
+  }
+
   const eeInteractor& interactor_;
+  const NearFieldBlocks* near_ = nullptr;
+  const EwaldSum* lattice_ = nullptr;
+  const NearFieldBlocks* damping_ = nullptr;
+  const PolarSiteBlock* packed_ = nullptr;
+  // only built if no block of the region is passed in
+  PolarSiteBlock own_packed_;
   std::vector<const PolarSite*> sites_;
   Index size_;
 };
@@ -0,0 +1,90 @@
+/*
+ *            Copyright 2009-2020 The VOTCA Development Team
+ *                       (http://www.votca.org)
+ *
+ *      Licensed under the Apache License, Version 2.0 (the "License")
+ *
+ * You may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *              http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#pragma once
+#ifndef VOTCA_XTP_DIPOLEHISTORY_H
+#define VOTCA_XTP_DIPOLEHISTORY_H
+
+// Standard includes
+#include <vector>
+
+// Local VOTCA includes
+#include "eigen.h"
+
+/**
+ * \brief Stores the external fields b_i and induced dipoles x_i of the last
+ * solutions of A*x=b for a fixed interaction matrix A and extrapolates the
+ * initial guess for a new field from them
+ *
+ *
+ */
+
+namespace votca {
+namespace xtp {
+
+class DipoleHistory {
+ public:
+  // 0 switches the history off
+  void setMaxSize(Index maxsize) { maxsize_ = maxsize; }
+
+  Index size() const { return Index(b_.size()); }
+  bool empty() const { return b_.empty(); }
+
+  void clear() {
+    b_.clear();
+    x_.clear();
+  }
+
+  // the oldest solution is dropped if the history is full
+  void push_back(const Eigen::VectorXd& b, const Eigen::VectorXd& x) {
+    if (maxsize_ < 1) {
+      return;
+    }
+    if (size() == maxsize_) {
+      b_.erase(b_.begin());
+      x_.erase(x_.begin());
+    }
+    b_.push_back(b);
+    x_.push_back(x);
+  }
+
+  // every stored solution satisfies A*x_i=b_i, so the combination of the x_i
+  // whose b_i best reproduce b is the guess with the smallest residual in the
+  // subspace of earlier solutions
+  Eigen::VectorXd Extrapolate(const Eigen::VectorXd& b) const {
+    Eigen::MatrixXd B(b.size(), size());
+    Eigen::MatrixXd X(b.size(), size());
+    for (Index i = 0; i < size(); i++) {
+      B.col(i) = b_[i];
+      X.col(i) = x_[i];
+    }
+    Eigen::VectorXd coeffs = B.colPivHouseholderQr().solve(b);
+    return X * coeffs;
+  }
+
+ private:
+  Index maxsize_ = 6;
+  std::vector<Eigen::VectorXd> b_;
+  std::vector<Eigen::VectorXd> x_;
+};
+
+}  // namespace xtp
+}  // namespace votca
+
+#endif  // VOTCA_XTP_DIPOLEHISTORY_H
@@ -21,9 +21,14 @@
 #ifndef VOTCA_XTP_EEINTERACTOR_H
 #define VOTCA_XTP_EEINTERACTOR_H
 
+// Standard includes
+#include <cmath>
+
 // Local VOTCA includes
 #include "classicalsegment.h"
 #include "eigen.h"
+#include "polarsiteblock.h"
+#include "staticsiteblock.h"
 
 namespace votca {
 namespace xtp {
@@ -44,6 +49,40 @@ class eeInteractor {
   Eigen::Matrix3d FillTholeInteraction(const PolarSite& site1,
                                        const PolarSite& site2) const;
 
+  // Thole tensor minus the bare dipole tensor for site2 moved by shift, zero
+  // where the damping has decayed, it turns an undamped lattice sum into a
+  // damped one
+  Eigen::Matrix3d TholeCorrection(const PolarSite& site1,
+                                  const PolarSite& site2,
+                                  const Eigen::Vector3d& shift) const;
+
+  // distance beyond which the Thole damping of two sites is switched off
+  double TholeRange(const PolarSite& site1, const PolarSite& site2) const {
+    return std::cbrt(40.0 / (expdamping_ * site1.getSqrtInvEigenDamp() *
+                             site2.getSqrtInvEigenDamp()));
+  }
+
+  // Thole interaction of site i with the sites first ... first+n-1 of the
+  // block, dipoles and fields are nsites x 3 matrices
+  // adds T_ij*dipole_j to field_i and T_ij*dipole_i to field_j
+  void TholeField_Block(const PolarSiteBlock& sites, Index i, Index first,
+                        Index n, const Eigen::MatrixXd& dipoles,
+                        Eigen::MatrixXd& fields) const;
+
+  // field at site i of the dipoles of the sites first ... first+n-1 only, for
+  // energies where each pair is visited once
+  Eigen::Vector3d TholeField_Block(const PolarSiteBlock& sites, Index i,
+                                   Index first, Index n,
+                                   const Eigen::MatrixXd& dipoles) const;
+
+  // potential and field of the charges and dipoles first ... first+n-1 of
+  // the block at pos, same components as VSiteA<4>
+  Eigen::Vector4d StaticField_Block(const StaticSiteBlock& sources, Index first,
+                                    Index n, const Eigen::Vector3d& pos) const;
+
+  // lower triangle of the dipole-dipole interaction matrix of one segment
+  Eigen::MatrixXd IntraSegmentMatrix(const PolarSegment& seg) const;
+
   Eigen::VectorXd Cholesky_IntraSegment(const PolarSegment& seg) const;
 
   template <class T, enum Estatic>
@@ -88,6 +127,19 @@ class eeInteractor {
 
   double CalcPolarEnergy_IntraSegment(const PolarSegment& seg) const;
 
+  // the same energies for the disjoint ranges first1 ... first1+n1-1 and
+  // first2 ... first2+n2-1 of the blocks of a whole region, a range can span
+  // several segments. dipoles holds the induced dipoles of all sites of the
+  // region as nsites x 3 matrix.
+  E_terms CalcPolarEnergy_Block(const PolarSiteBlock& sites,
+                                const StaticSiteBlock& statics,
+                                const Eigen::MatrixXd& dipoles, Index first1,
+                                Index n1, Index first2, Index n2) const;
+
+  double CalcPolarEnergy_IntraSegment(const PolarSiteBlock& sites,
+                                      const Eigen::MatrixXd& dipoles,
+                                      Index first, Index n) const;
+
   double CalcStaticEnergy_site(const StaticSite& site1,
                                const StaticSite& site2) const;
 
@@ -109,6 +161,37 @@ class eeInteractor {
   E_terms CalcPolarEnergy_site(const PolarSite& site1,
                                const PolarSite& site2) const;
 
+  // distances and Thole factors of site i with the sites first ...
+  // first+n-1, the unit vectors point from i to the other sites
+  void TholeFactors_Block(const PolarSiteBlock& sites, Index i, Index first,
+                          Index n, Eigen::ArrayXd& ax, Eigen::ArrayXd& ay,
+                          Eigen::ArrayXd& az, Eigen::ArrayXd& lambda3,
+                          Eigen::ArrayXd& lambda5) const;
+
+  // energy of the induced dipoles of targets in the field of sources
+  double CalcPolar_stat_Energy_Block(const PolarSegment& targets,
+                                     const StaticSiteBlock& sources) const;
+
+  // energy of the induced dipoles of the targets first ... first+n-1 in the
+  // field of the source s, as arrays over the targets
+  double StaticFieldEnergy_Block(const StaticSiteBlock& sources, Index s,
+                                 const PolarSiteBlock& targets,
+                                 const Eigen::MatrixXd& dipoles, Index first,
+                                 Index n) const;
+
+  double CalcPolar_stat_Energy_Block(const PolarSiteBlock& targets,
+                                     const Eigen::MatrixXd& dipoles,
+                                     Index first, Index n,
+                                     const StaticSiteBlock& sources,
+                                     Index first_source,
+                                     Index nsources) const;
+
+  E_terms CalcPolarEnergy_Block(const PolarSegment& segment1,
+                                const StaticSegment& segment2) const;
+
+  E_terms CalcPolarEnergy_Block(const PolarSegment& segment1,
+                                const PolarSegment& segment2) const;
+
   double expdamping_ = 0.39;  // dimensionless
 };
 
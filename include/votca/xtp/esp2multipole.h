@@ -60,6 +60,8 @@ class Esp2multipole {
   QMState state_;
   std::string method_;
   std::string gridsize_;
+  std::string esp_method_;
+  double esp_accuracy_;
   bool use_mulliken_;
   bool use_lowdin_;
   bool use_CHELPG_;
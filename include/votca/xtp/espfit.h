@@ -32,6 +32,7 @@
 
 namespace votca {
 namespace xtp {
+class AOBasis;
 class Orbitals;
 class Grid;
 class QMState;
@@ -57,6 +58,14 @@ class Espfit {
     regionconstraint_ = regionconstraint;
   }
 
+  // numeric: integration grid, analytic: potential integrals over the density
+  // matrix, multipole: integration grid where distant cubes act through their
+  // multipoles, accuracy bounds the resulting error of the potential
+  void setESPMethod(std::string method, double accuracy) {
+    esp_method_ = method;
+    esp_accuracy_ = accuracy;
+  }
+
   StaticSegment Fit2Density(const Orbitals& orbitals, const QMState& state,
                             std::string gridsize);
 
@@ -64,6 +73,8 @@ class Espfit {
   Logger& log_;
   bool do_svd_ = true;
   double conditionnumber_ = 1e-8;
+  std::string esp_method_ = "numeric";
+  double esp_accuracy_ = 1e-6;
 
   std::vector<std::pair<Index, Index> > pairconstraint_;  //  pairconstraint[i]
                                                           //  is all the
@@ -75,6 +86,12 @@ class Espfit {
 
   void EvalNuclearPotential(const QMMolecule& atoms, Grid& grid);
 
+  // electronic potential at the CHELPG points from the integration grid,
+  // returns the number of electrons on the integration grid
+  double EvalNumericalPotential(const Eigen::MatrixXd& dmat,
+                                const AOBasis& basis, const QMMolecule& atoms,
+                                const std::string& gridsize, Grid& grid);
+
   // Fits partial charges to Potential on a grid, constrains net charge
   StaticSegment FitPartialCharges(const Orbitals& orbitals, const Grid& grid,
                                   double netcharge);
@@ -0,0 +1,168 @@
+/*
+ * Copyright 2009-2020 The VOTCA Development Team (http://www.votca.org)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#pragma once
+#ifndef VOTCA_XTP_EWALDSUM_H
+#define VOTCA_XTP_EWALDSUM_H
+
+// Standard includes
+#include <array>
+#include <complex>
+#include <memory>
+#include <vector>
+
+// Local VOTCA includes
+#include "eigen.h"
+#include "staticsite.h"
+
+namespace votca {
+namespace xtp {
+
+/**
+ * \brief Ewald lattice sum of the permanent multipoles (up to quadrupoles)
+ * of a periodic cell
+ *
+ * Gives potential, gradient and second derivatives of the infinite lattice at
+ * arbitrary points, with conducting (tinfoil) boundary conditions and a
+ * neutralising background for charged cells. Sites marked as explicit are left
+ * out in their central copy, all their periodic images still contribute. So
+ * the field at a site of an explicit region is the one of everything it does
+ * not interact with directly. The splitting parameter is chosen such that real
+ * and reciprocal space work are balanced for the given number of target
+ * points, the real space cutoff never exceeds half the smallest cell height.
+ *
+ * DipoleField sums a lattice of point dipoles on the same sites instead, which
+ * is how the periodic images of induced dipoles enter the polarisation.
+ *
+ * The sources, real space cells and structure factors do not depend on which
+ * copies are explicit. A sum for other explicit copies shares them with an
+ * existing one, so a frame is set up once for all its jobs.
+ */
+class EwaldSum {
+ public:
+  // box holds the cell vectors as columns
+  EwaldSum(const Eigen::Matrix3d& box, double tolerance,
+           const std::vector<const StaticSite*>& sites,
+           const std::vector<bool>& is_explicit, Index ntargets);
+
+  // shares the lattice of sum, only the copies of the sites explicit_sites at
+  // explicit_pos are left out, they may be any image of the sites
+  EwaldSum(const EwaldSum& sum, const std::vector<Index>& explicit_sites,
+           const std::vector<Eigen::Vector3d>& explicit_pos);
+
+  // potential and gradient, for N=9 also the second derivatives, same
+  // components as eeInteractor::VSiteA<N>
+  template <int N>
+  Eigen::Matrix<double, N, 1> Field(const Eigen::Vector3d& pos) const;
+
+  // gradient of the potential of point dipoles (one row per site) at all
+  // sites and all their images, on every site without its own central copy.
+  // The multipoles and explicit flags of the sites are not used. Linear and
+  // symmetric in the dipoles, so it can be part of a CG operator.
+  Eigen::MatrixXd DipoleField(const Eigen::MatrixXd& dipoles) const;
+
+  // image of dr closest to the origin, only unique if it is shorter than half
+  // the smallest cell height
+  Eigen::Vector3d ShortestImage(const Eigen::Vector3d& dr) const {
+    return dr - box_ * (inv_box_ * dr).array().round().matrix();
+  }
+
+  const Eigen::Matrix3d& Box() const { return box_; }
+  double MinCellHeight() const {
+    return 1.0 / inv_box_.rowwise().norm().maxCoeff();
+  }
+  double Alpha() const { return alpha_; }
+  double RealSpaceCutoff() const { return rcut_; }
+  Index NumberOfKvectors() const { return Index(lattice_->kvectors.size()); }
+  Index NumberOfSites() const { return Index(lattice_->sources.size()); }
+  Index NumberOfExplicitSites() const { return Index(explicit_.size()); }
+
+ private:
+  struct Source {
+    Eigen::Vector3d pos;
+    Eigen::Vector3d frac;    // fractional coordinates wrapped into [0,1)
+    Eigen::Vector3d origin;  // cell of the central copy, frac+origin is pos
+    double q;
+    Eigen::Vector3d d;
+    Eigen::Matrix3d theta;
+  };
+
+  struct Kvector {
+    Eigen::Vector3d k;
+    std::array<Index, 3> m;  // k in units of the reciprocal vectors
+    double prefactor;        // 4pi/V exp(-k^2/4alpha^2)/k^2
+    std::complex<double> S;  // structure factor of all sites
+  };
+
+  struct Lattice {
+    std::vector<Source> sources;
+    std::vector<std::vector<Index>> cells;
+    std::vector<Kvector> kvectors;
+  };
+
+  // (-1/R d/dR)^l erfc(alpha R)/R and (-1/R d/dR)^l erf(alpha R)/R
+  std::array<double, 5> ErfcKernels(double R) const;
+  std::array<double, 5> ErfKernels(double R) const;
+
+  static Eigen::Vector4d MultipoleField(const Source& s,
+                                        const Eigen::Vector3d& R,
+                                        const std::array<double, 5>& B);
+  static Eigen::Matrix3d MultipoleHessian(const Source& s,
+                                          const Eigen::Vector3d& R,
+                                          const std::array<double, 5>& B);
+
+  // calls f(j, R, image) for every copy of source j within the real space
+  // cutoff of pos, R points from the copy to pos, image is the cell vector in
+  // fractional coordinates from source j to the copy
+  template <class F>
+  void LoopRealSpace(const Eigen::Vector3d& pos, F&& f) const;
+
+  // exp(-i 2pi m frac_a) for -mmax_a <= m <= mmax_a, stored at m+mmax_a, the
+  // products give the phases of all k-vectors without trigonometric calls
+  std::array<Eigen::ArrayXcd, 3> PhaseTables(const Eigen::Vector3d& frac) const;
+
+  std::array<Index, 3> FracToCell(const Eigen::Vector3d& frac) const;
+
+  Index CellIndex(const std::array<Index, 3>& cell) const {
+    return (cell[0] * ncells_[1] + cell[1]) * ncells_[2] + cell[2];
+  }
+
+  void SetupRealSpaceCells(Lattice& lattice);
+  void SetupKvectors(Lattice& lattice, double kcut);
+  void SetExplicitCopies(const std::vector<Index>& explicit_sites,
+                         const std::vector<Eigen::Vector3d>& explicit_pos);
+
+  Eigen::Matrix3d box_;
+  Eigen::Matrix3d inv_box_;
+  double volume_;
+  double alpha_;
+  double rcut_;
+  double background_;
+  std::array<Index, 3> ncells_;
+  std::array<Index, 3> mmax_;
+  std::shared_ptr<const Lattice> lattice_;
+  // sources whose copy at explicit_image_ is left out, explicit_slot_ holds
+  // the position in explicit_ for every source and -1 for the others
+  std::vector<Index> explicit_;
+  std::vector<Eigen::Vector3d> explicit_image_;
+  std::vector<Index> explicit_slot_;
+};
+
+}  // namespace xtp
+}  // namespace votca
+
+#endif  // VOTCA_XTP_EWALDSUM_H
@@ -0,0 +1,77 @@
+/*
+ *            Copyright 2009-2020 The VOTCA Development Team
+ *                       (http://www.votca.org)
+ *
+ *      Licensed under the Apache License, Version 2.0 (the "License")
+ *
+ * You may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *              http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#pragma once
+#ifndef VOTCA_XTP_FROZEN_NATURAL_ORBITALS_H
+#define VOTCA_XTP_FROZEN_NATURAL_ORBITALS_H
+
+// Local VOTCA includes
+#include "eigen.h"
+
+namespace votca {
+namespace xtp {
+class TCMatrix_gwbse;
+
+/**
+ * \brief Frozen natural virtual orbitals from the MP2 virtual-virtual density
+ *
+ * The spin summed MP2 density of the virtual space is diagonalised, the
+ * natural orbitals with an occupation above a threshold are kept and
+ * semicanonicalised, i.e. rotated such that the DFT Hamiltonian is diagonal in
+ * the truncated space. The MP2 correlation energy lost by the truncation is
+ * returned as an estimate of the truncation error.
+ */
+class FrozenNaturalOrbitals {
+ public:
+  // Mmn holds the 3c integrals of the occupied (m) with all virtual levels
+  // (n). The first nfixed virtual levels are kept as they are, only the ones
+  // above are truncated.
+  void Compute(const TCMatrix_gwbse& Mmn, const Eigen::VectorXd& occ_energies,
+               const Eigen::VectorXd& virt_energies, Index nfixed,
+               double threshold);
+
+  // number of kept natural orbitals
+  Index size() const { return energies_.size(); }
+
+  // columns are the kept orbitals in the basis of the truncated virtuals
+  const Eigen::MatrixXd& Transformation() const { return transformation_; }
+
+  // semicanonical energies of the kept orbitals in ascending order
+  const Eigen::VectorXd& Energies() const { return energies_; }
+
+  // occupations of all natural orbitals in descending order
+  const Eigen::VectorXd& Occupations() const { return occupations_; }
+
+  double MP2CorrelationEnergy() const { return mp2_energy_; }
+
+  // MP2 correlation energy missing in the truncated space
+  double EnergyCorrection() const { return energy_correction_; }
+
+ private:
+  Eigen::MatrixXd transformation_;
+  Eigen::VectorXd energies_;
+  Eigen::VectorXd occupations_;
+  double mp2_energy_ = 0.0;
+  double energy_correction_ = 0.0;
+};
+
+}  // namespace xtp
+}  // namespace votca
+
+#endif  // VOTCA_XTP_FROZEN_NATURAL_ORBITALS_H
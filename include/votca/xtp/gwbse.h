@@ -65,11 +65,20 @@ class GWBSE {
 
   bool Evaluate();
 
+  // BSE without GW reuses the QP and RPA input energies of the .orb file,
+  // so its GW and RPA ranges have to be the requested ones. truncated means
+  // the RPA range of opt was shrunk by frozen natural orbitals.
+  static void CheckStoredRanges(const Orbitals& orb, const GW::options& opt,
+                                bool truncated);
+
   void addoutput(tools::Property& summary);
 
  private:
   Eigen::MatrixXd CalculateVXC(const AOBasis& dftbasis);
   Index CountCoreLevels();
+  void TruncateVirtuals(const AOBasis& auxbasis, const AOBasis& dftbasis,
+                        Index first, Eigen::MatrixXd& mos,
+                        Eigen::VectorXd& energies);
   Logger* pLog_;
   Orbitals& orbitals_;
 
@@ -80,6 +89,16 @@ class GWBSE {
   bool do_bse_triplets_ = false;
   bool do_dynamical_screening_bse_ = false;
 
+  // keep AO 3c integrals for cheap rebuilds in evGW
+  bool keep_ao3c_ = false;
+
+  // Mmn larger than this (in bytes) is stored in scratch_dir_, 0 no limit
+  Index mmn_max_memory_ = 0;
+  std::string scratch_dir_;
+
+  // occupation threshold for frozen natural virtuals, 0 no truncation
+  double fno_threshold_ = 0.0;
+
   // options for own Vxc calculation
   std::string functional_;
   std::string grid_;
@@ -92,6 +111,13 @@ class GWBSE {
   double sigma_plot_spacing_;
   std::string sigma_plot_filename_;
 
+  // absorption spectrum from Lanczos recursion in eV, 0 points means none
+  Index absorption_points_ = 0;
+  double absorption_lower_;
+  double absorption_upper_;
+  double absorption_fwhm_;
+  std::string absorption_filename_;
+
   // basis sets
   std::string auxbasis_name_;
   std::string dftbasis_name_;
@@ -24,7 +24,10 @@
 // Local VOTCA includes
 #include "job.h"
 #include "logger.h"
+#include "neutrallattice.h"
 #include "region.h"
+#include "segid.h"
+#include "segmentindex.h"
 #include "topology.h"
 
 /**
@@ -43,7 +46,7 @@
 
 namespace votca {
 namespace xtp {
-class SegId;
+
 class JobTopology {
  public:
   JobTopology(Job& job, Logger& log, std::string workdir)
@@ -51,6 +54,24 @@ class JobTopology {
   void BuildRegions(const Topology& top,
                     std::pair<std::string, tools::Property> options);
 
+  // for the next job on the same segments, e.g. another state in a
+  // multi-state job: rebuilds the regions the job modifies and keeps the
+  // others with their cached interactions, if their segments did not change.
+  // Only the modified regions are partitioned again, the others are searched
+  // again only if a region before them got other segments.
+  void UpdateRegions(const Topology& top,
+                     std::pair<std::string, tools::Property> options);
+
+  void setWorkdir(const std::string& workdir) { workdir_ = workdir; }
+
+  // index over the segments of the topology, shared by all jobs of a frame,
+  // without it each partitioning builds its own
+  void setSegmentIndex(const SegmentIndex* index) { segment_index_ = index; }
+
+  // Ewald lattice of the frame, shared by all jobs, without it each job with
+  // periodic regions builds its own
+  void setLatticeCache(NeutralLatticeCache* cache) { lattice_cache_ = cache; }
+
   void WriteToHdf5(std::string filename) const;
 
   void ReadFromHdf5(std::string filename);
@@ -80,13 +101,30 @@ class JobTopology {
   }
 
  private:
+  // the segments of a region with reusable set are taken from the last
+  // partitioning, if all regions before it did not change
   std::vector<std::vector<SegId> > PartitionRegions(
-      const tools::Property& regions_def, const Topology& top) const;
+      const tools::Property& regions_def, const Topology& top,
+      const std::vector<bool>& reusable) const;
+
+  std::vector<bool> ModifiedByJob(const tools::Property& regions_def) const;
 
   void CreateRegions(const std::pair<std::string, tools::Property>& options,
                      const Topology& top,
                      const std::vector<std::vector<SegId> >& region_seg_ids);
 
+  std::unique_ptr<Region> CreateRegion(const tools::Property& region_def,
+                                       const std::string& mapfile,
+                                       const Topology& top,
+                                       const std::vector<SegId>& seg_ids,
+                                       const Eigen::Vector3d& center) const;
+
+  // adds the field of the periodic images to polar regions that request it
+  void ApplyPeriodicImages(
+      const std::string& mapfile, const Topology& top,
+      const std::vector<std::vector<SegId> >& region_seg_ids,
+      const Eigen::Vector3d& center, const std::vector<Index>& region_ids);
+
   void ModifyOptionsByJobFile(tools::Property& regions_def) const;
 
   template <class T>
@@ -100,9 +138,14 @@ class JobTopology {
   Job& job_;
   Logger& log_;
   std::vector<std::unique_ptr<Region> > regions_;
+  std::vector<std::vector<SegId> > region_seg_ids_;
+  // regions whose definition the last job changed
+  std::vector<bool> modified_by_job_;
+  const SegmentIndex* segment_index_ = nullptr;
+  NeutralLatticeCache* lattice_cache_ = nullptr;
   std::string workdir_ = "";
 
-  static constexpr int jobtopology_version() { return 1; }
+  static constexpr int jobtopology_version() { return 2; }
 };
 }  // namespace xtp
 }  // namespace votca
@@ -23,6 +23,7 @@
 
 // Local VOTCA includes
 #include "classicalsegment.h"
+#include "ewaldsum.h"
 #include "region.h"
 
 namespace votca {
@@ -42,6 +43,8 @@ class MMRegion : public Region {
 
   Index size() const override { return Index(segments_.size()); }
 
+  Index NumberOfSites() const;
+
   using iterator = typename std::vector<T>::iterator;
 
   void Initialize(const tools::Property& prop) override = 0;
@@ -81,6 +84,19 @@ class MMRegion : public Region {
   double InteractwithPolarRegion(const PolarRegion& region) override = 0;
   double InteractwithStaticRegion(const StaticRegion& region) override = 0;
 
+  // potential, gradient and, for sites with quadrupoles, second derivatives
+  // of the periodic lattice at all sites, one column per site
+  Eigen::Matrix<double, 9, Eigen::Dynamic> CalcLatticeField(
+      const EwaldSum& ewald) const;
+
+  // energy of the multipoles of a site in one column of CalcLatticeField
+  static double LatticeEnergy(const StaticSite& site, const Vector9d& V) {
+    if (site.getRank() < 2) {
+      return V.head<4>().dot(site.Q().head<4>());
+    }
+    return V.dot(site.Q());
+  }
+
   std::vector<T> segments_;
 };
 
@@ -0,0 +1,94 @@
+/*
+ * Copyright 2009-2020 The VOTCA Development Team (http://www.votca.org)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#pragma once
+#ifndef VOTCA_XTP_NEUTRALLATTICE_H
+#define VOTCA_XTP_NEUTRALLATTICE_H
+
+// Standard includes
+#include <memory>
+#include <string>
+#include <vector>
+
+// VOTCA includes
+#include <votca/tools/mutex.h>
+
+// Local VOTCA includes
+#include "eigen.h"
+#include "ewaldsum.h"
+#include "logger.h"
+#include "segid.h"
+#include "topology.h"
+
+namespace votca {
+namespace xtp {
+
+/**
+ * \brief Ewald lattice of all segments of a topology in their neutral state
+ *
+ * Mapping every segment and the structure factors cost as much as the Ewald
+ * sum of a job, but do not depend on the job. A job only marks the copies of
+ * its region segments as explicit, see EwaldSum.
+ */
+class NeutralLattice {
+ public:
+  // ntargets only sets the balance of real and reciprocal space
+  NeutralLattice(const Topology& top, const std::string& mapfile,
+                 double tolerance, Index ntargets, Logger& log);
+
+  // sum without the copies of the region segments that JobTopology places
+  // around center
+  EwaldSum WithoutRegions(const std::vector<std::vector<SegId>>& region_seg_ids,
+                          const Eigen::Vector3d& center) const;
+
+  bool BuiltFor(const Topology& top, const std::string& mapfile,
+                double tolerance) const {
+    return &top == &top_ && top.getStep() == step_ && mapfile == mapfile_ &&
+           tolerance == tolerance_;
+  }
+
+  const EwaldSum& Sum() const { return *ewald_; }
+
+ private:
+  const Topology& top_;
+  Index step_;
+  std::string mapfile_;
+  double tolerance_;
+  // sites of segment i are first_site_[i] to first_site_[i+1]
+  std::vector<Index> first_site_;
+  std::vector<Eigen::Vector3d> segment_pos_;
+  std::vector<Eigen::Vector3d> site_pos_;
+  std::unique_ptr<EwaldSum> ewald_ = nullptr;
+};
+
+// built by the first job of a frame that needs it, all threads share it
+class NeutralLatticeCache {
+ public:
+  std::shared_ptr<const NeutralLattice> get(const Topology& top,
+                                            const std::string& mapfile,
+                                            double tolerance, Index ntargets,
+                                            Logger& log);
+
+ private:
+  std::shared_ptr<const NeutralLattice> lattice_ = nullptr;
+  tools::Mutex mutex_;
+};
+
+}  // namespace xtp
+}  // namespace votca
+
+#endif  // VOTCA_XTP_NEUTRALLATTICE_H
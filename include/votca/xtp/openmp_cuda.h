@@ -72,10 +72,9 @@ class OpenMP_CUDA {
   static Index AvailableGPUs();
   static void SetNoGPUs(Index number);
 
-  // 3c multiply
-  void setOperators(const std::vector<Eigen::MatrixXd>& tensor,
-                    const Eigen::MatrixXd& rightoperator);
-  void MultiplyRight(Eigen::MatrixXd& matrix, Index OpenmpThread);
+  // 3c multiply, all matrices have tensor_rows rows
+  void setOperators(Index tensor_rows, const Eigen::MatrixXd& rightoperator);
+  void MultiplyRight(Eigen::Ref<Eigen::MatrixXd> matrix, Index OpenmpThread);
 
   // 3c
   void setOperators(const Eigen::MatrixXd& leftoperator,
@@ -93,7 +92,7 @@ class OpenMP_CUDA {
                          Index cols);
   void PrepareMatrix1(Eigen::MatrixXd& mat, Index OpenmpThread);
   void SetTempZero(Index OpenmpThread);
-  void PrepareMatrix2(const Eigen::Block<const Eigen::MatrixXd>& mat, bool Hd2,
+  void PrepareMatrix2(const Eigen::Ref<const Eigen::MatrixXd>& mat, bool Hd2,
                       Index OpenmpThread);
   void Addvec(const Eigen::VectorXd& row, Index OpenmpThread);
   void MultiplyRow(Index row, Index OpenmpThread);
@@ -101,7 +100,7 @@ class OpenMP_CUDA {
   // Hx
   void createAdditionalTemporaries(Index rows, Index cols);
   void PushMatrix1(const Eigen::MatrixXd& mat, Index OpenmpThread);
-  void MultiplyBlocks(const Eigen::Block<const Eigen::MatrixXd>& mat, Index i1,
+  void MultiplyBlocks(const Eigen::Ref<const Eigen::MatrixXd>& mat, Index i1,
                       Index i2, Index OpenmpThread);
 
   Eigen::MatrixXd getReductionVar();
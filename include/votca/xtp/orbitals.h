@@ -330,6 +330,9 @@ class Orbitals {
 
   void CalcCoupledTransition_Dipoles();
 
+  // dipole matrix elements between the BSE conduction and valence levels
+  std::array<Eigen::MatrixXd, 3> CalcFreeTransition_Dipoles() const;
+
   void WriteToCpt(const std::string &filename) const;
 
   void ReadFromCpt(const std::string &filename);
@@ -341,8 +344,6 @@ class Orbitals {
   void SetFlagUseHqpOffdiag(bool flag) { use_Hqp_offdiag_ = flag; };
 
  private:
-  std::array<Eigen::MatrixXd, 3> CalcFreeTransition_Dipoles() const;
-
   // returns indeces of a re-sorted vector of energies from lowest to highest
   std::vector<Index> SortEnergies();
 
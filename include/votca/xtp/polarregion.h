@@ -22,10 +22,16 @@
 #define VOTCA_XTP_POLARREGION_H
 
 // Local VOTCA includes
+#include "blockjacobipreconditioner.h"
+#include "dipoledipoleinteraction.h"
+#include "dipolehistory.h"
 #include "eeinteractor.h"
 #include "energy_terms.h"
+#include "ewaldsum.h"
 #include "hist.h"
 #include "mmregion.h"
+#include "polarsiteblock.h"
+#include "segmentcelllist.h"
 
 /**
  * \brief defines a polar region and of interacting electrostatic and induction
@@ -55,12 +61,25 @@ class PolarRegion : public MMRegion<PolarSegment> {
 
   void Reset() override;
 
+  void ClearHistory() override;
+
   double Etotal() const override { return E_hist_.back().Etotal(); }
 
   void WriteToCpt(CheckpointWriter& w) const override;
 
   void ReadFromCpt(CheckpointReader& r) override;
 
+  // 0 if the periodic images are not included
+  double EwaldTolerance() const { return ewald_tolerance_; }
+
+  // tolerance to which the induced dipoles were solved in the last evaluation
+  double DipoleTolerance() const { return cg_tolerance_; }
+
+  // stores the field of the periodic lattice at all sites, it is added to the
+  // external field in every evaluation. From then on the induced dipoles
+  // also interact with their own periodic images.
+  void CalcPeriodicField(const EwaldSum& ewald);
+
  protected:
   void AppendResult(tools::Property& prop) const override;
   double InteractwithQMRegion(const QMRegion& region) override;
@@ -70,24 +89,69 @@ class PolarRegion : public MMRegion<PolarSegment> {
  private:
   void CalcInducedDipoles();
   double StaticInteraction();
+  double CalcStaticInteraction();
   void PolarInteraction_scf();
 
   double PolarEnergy_extern() const;
   eeInteractor::E_terms PolarEnergy() const;
   Index CalcPolDoF() const;
 
-  Eigen::VectorXd CalcInducedDipoleInsideSegments() const;
+  // stacked -(V+V_noE) of all sites, rhs of the induced dipole equations
+  Eigen::VectorXd CalcExternalField() const;
   Eigen::VectorXd ReadInducedDipolesFromLastIteration() const;
+  double ApplyPeriodicField();
+  void SetupDipoleLattice(const eeInteractor& interactor);
+  double InducedImageEnergy(const Eigen::VectorXd& x,
+                            eeInteractor::E_terms central);
 
   Eigen::VectorXd CalcInducedDipolesViaPCG(
-      const Eigen::VectorXd& initial_guess);
+      const Eigen::VectorXd& b, const Eigen::VectorXd& initial_guess,
+      BlockJacobiPreconditioner intra_segment, double tolerance);
+
+  void ClearStaleTensors();
+
+  Eigen::VectorXd ExtrapolateInducedDipoles(const Eigen::VectorXd& b) const;
+  double CGTolerance() const;
   void WriteInducedDipolesToSegments(const Eigen::VectorXd& x);
 
+  template <class T, enum Estatic CE>
+  double ApplyStaticFieldFromCells(const MMRegion<T>& sources,
+                                   const SegmentCellList& cells,
+                                   bool skip_self);
+
   hist<Energy_terms> E_hist_;
   double deltaE_ = 1e-5;
   double deltaD_ = 1e-5;
+  double deltaD_max_ = 1e-5;
+  double cg_tolerance_ = 0.0;  // used in the last evaluation
   Index max_iter_ = 100;
   double exp_damp_ = 0.39;
+  double nearfield_cutoff_ = 0.0;  // bohr
+  double nearfield_memory_ = 0.0;  // bytes
+  // persists over CG and QM/MM iterations as long as the geometry does not
+  // change
+  DipoleDipoleInteraction::NearFieldBlocks nearfield_;
+  // positions and Thole damping of all sites, packed once for the kernels
+  // and to tell whether the stored tensors still belong to the sites
+  PolarSiteBlock packed_sites_;
+  double farfield_cellsize_ = 0.0;  // bohr
+  double farfield_accuracy_ = 0.3;
+  // permanent multipoles of this region, for the static interaction
+  std::unique_ptr<SegmentCellList> cells_ = nullptr;
+  double ewald_tolerance_ = 0.0;
+  // potential, gradient and second derivatives of the periodic images of the
+  // permanent multipoles, one column per site
+  Eigen::Matrix<double, 9, Eigen::Dynamic> periodic_field_;
+  // the induced dipoles of this region and their images, rebuilt from the
+  // box when needed
+  Eigen::Matrix3d lattice_box_ = Eigen::Matrix3d::Zero();
+  std::unique_ptr<EwaldSum> dipole_lattice_ = nullptr;
+  DipoleDipoleInteraction::NearFieldBlocks lattice_damping_;
+  // field and energy of the permanent multipoles inside the region
+  Eigen::VectorXd static_field_;
+  double E_static_static_ = 0.0;
+  // external fields and induced dipoles of the last evaluations
+  DipoleHistory dipole_history_;
 };
 
 }  // namespace xtp
@@ -0,0 +1,132 @@
+/*
+ * Copyright 2009-2020 The VOTCA Development Team (http://www.votca.org)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#pragma once
+#ifndef VOTCA_XTP_POLARSITEBLOCK_H
+#define VOTCA_XTP_POLARSITEBLOCK_H
+
+// Standard includes
+#include <vector>
+
+// Local VOTCA includes
+#include "classicalsegment.h"
+#include "eigen.h"
+
+namespace votca {
+namespace xtp {
+
+/**
+ * \brief Positions and Thole damping factors of many polar sites in
+ * structure-of-arrays layout
+ *
+ * The PolarSite objects stay the owners of the data, this is a packed copy
+ * for the range kernels of eeInteractor. A region packs all its sites once
+ * and passes index ranges to the kernels, the induced dipoles change in
+ * every CG iteration and are passed separately. The kernels only turn into
+ * SIMD code if AVX is enabled, e.g. with -march=native; with the default
+ * SSE2 flags the Thole field costs about as much as the loop over pairs.
+ */
+class PolarSiteBlock {
+ public:
+  PolarSiteBlock() = default;
+
+  explicit PolarSiteBlock(const std::vector<const PolarSite*>& sites) {
+    Pack(sites);
+  }
+
+  // all sites of a region, segment after segment
+  explicit PolarSiteBlock(const std::vector<PolarSegment>& segments) {
+    std::vector<const PolarSite*> sites;
+    segment_start_.reserve(segments.size() + 1);
+    segment_start_.push_back(0);
+    for (const PolarSegment& seg : segments) {
+      for (const PolarSite& site : seg) {
+        sites.push_back(&site);
+      }
+      segment_start_.push_back(Index(sites.size()));
+    }
+    Pack(sites);
+  }
+
+  // true if the segments still have the positions and damping factors of
+  // the block, compared without packing them again
+  bool SameGeometry(const std::vector<PolarSegment>& segments) const {
+    if (Index(segments.size()) + 1 != Index(segment_start_.size())) {
+      return false;
+    }
+    Index index = 0;
+    for (Index k = 0; k < Index(segments.size()); k++) {
+      if (segment_start_[k + 1] - segment_start_[k] != segments[k].size()) {
+        return false;
+      }
+      for (const PolarSite& site : segments[k]) {
+        if (site.getPos() != getPos(index) ||
+            site.getSqrtInvEigenDamp() != damp_(index)) {
+          return false;
+        }
+        index++;
+      }
+    }
+    return true;
+  }
+
+  Index size() const { return x_.size(); }
+
+  // only set if the block was built from segments
+  Index NumberOfSegments() const { return Index(segment_start_.size()) - 1; }
+  Index SegmentStart(Index seg) const { return segment_start_[seg]; }
+  Index SegmentSize(Index seg) const {
+    return segment_start_[seg + 1] - segment_start_[seg];
+  }
+
+  Eigen::Vector3d getPos(Index i) const {
+    return Eigen::Vector3d(x_(i), y_(i), z_(i));
+  }
+
+  const Eigen::ArrayXd& x() const { return x_; }
+  const Eigen::ArrayXd& y() const { return y_; }
+  const Eigen::ArrayXd& z() const { return z_; }
+  const Eigen::ArrayXd& damp() const { return damp_; }
+
+ private:
+  void Pack(const std::vector<const PolarSite*>& sites) {
+    Index size = Index(sites.size());
+    x_.resize(size);
+    y_.resize(size);
+    z_.resize(size);
+    damp_.resize(size);
+    for (Index i = 0; i < size; i++) {
+      const Eigen::Vector3d& pos = sites[i]->getPos();
+      x_(i) = pos.x();
+      y_(i) = pos.y();
+      z_(i) = pos.z();
+      damp_(i) = sites[i]->getSqrtInvEigenDamp();
+    }
+  }
+
+  Eigen::ArrayXd x_;
+  Eigen::ArrayXd y_;
+  Eigen::ArrayXd z_;
+  Eigen::ArrayXd damp_;
+  // sites of segment k are segment_start_[k] to segment_start_[k+1]
+  std::vector<Index> segment_start_;
+};
+
+}  // namespace xtp
+}  // namespace votca
+
+#endif  // VOTCA_XTP_POLARSITEBLOCK_H
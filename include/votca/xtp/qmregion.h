@@ -71,6 +71,11 @@ class QMRegion : public Region {
 
   void Reset() override;
 
+  void ClearHistory() override {
+    E_hist_ = hist<double>();
+    Dmat_hist_ = hist<Eigen::MatrixXd>();
+  }
+
   double charge() const override;
   double Etotal() const override { return E_hist_.back(); }
 
@@ -92,6 +97,8 @@ class QMRegion : public Region {
   std::unique_ptr<QMPackage> qmpackage_ = nullptr;
 
   std::string grid_accuracy_for_ext_interaction_ = "medium";
+  // boxes of the density with radius/distance below it act as multipoles
+  double field_accuracy_ = 0.0;
 
   hist<double> E_hist_;
   hist<Eigen::MatrixXd> Dmat_hist_;
@@ -68,6 +68,10 @@ class Region {
 
   virtual void Reset() = 0;
 
+  // forgets the convergence history, so the region can be evaluated again
+  // in a different environment, e.g. for the next state of a multi-state job
+  virtual void ClearHistory() = 0;
+
   virtual double charge() const = 0;
 
   bool Successful() const { return info_; }
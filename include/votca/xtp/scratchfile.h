@@ -0,0 +1,65 @@
+/*
+ *            Copyright 2009-2020 The VOTCA Development Team
+ *                       (http://www.votca.org)
+ *
+ *      Licensed under the Apache License, Version 2.0 (the "License")
+ *
+ * You may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *              http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#pragma once
+#ifndef VOTCA_XTP_SCRATCHFILE_H
+#define VOTCA_XTP_SCRATCHFILE_H
+
+// Standard includes
+#include <string>
+
+// Local VOTCA includes
+#include "eigen.h"
+
+namespace votca {
+namespace xtp {
+
+/*
+ * An array of doubles, which lives in a temporary file in a scratch directory
+ * and is mapped into memory. The kernel reads pages in on access and writes
+ * them back under memory pressure, so only the part currently worked on has
+ * to fit into RAM. The file is removed as soon as it is created, so it
+ * disappears with the object or the process.
+ */
+class ScratchFile {
+ public:
+  // size is the number of doubles, the array is zero initialised
+  ScratchFile(const std::string& directory, Index size);
+  ~ScratchFile();
+
+  ScratchFile(const ScratchFile&) = delete;
+  ScratchFile& operator=(const ScratchFile&) = delete;
+
+  double* data() { return data_; }
+  const double* data() const { return data_; }
+  Index size() const { return size_; }
+
+  // asks the kernel to read [start, start+length) in the background
+  void Prefetch(Index start, Index length) const;
+
+ private:
+  int fd_ = -1;
+  double* data_ = nullptr;
+  Index size_ = 0;
+};
+
+}  // namespace xtp
+}  // namespace votca
+
+#endif  // VOTCA_XTP_SCRATCHFILE_H
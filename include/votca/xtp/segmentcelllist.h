@@ -0,0 +1,94 @@
+/*
+ * Copyright 2009-2020 The VOTCA Development Team (http://www.votca.org)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#pragma once
+#ifndef VOTCA_XTP_SEGMENTCELLLIST_H
+#define VOTCA_XTP_SEGMENTCELLLIST_H
+
+// Standard includes
+#include <algorithm>
+#include <vector>
+
+// Local VOTCA includes
+#include "classicalsegment.h"
+#include "eigen.h"
+
+namespace votca {
+namespace xtp {
+
+/**
+ * \brief Cell list over the segments of a region
+ *
+ * Segments are sorted into cubic cells by their centres. Every cell also
+ * carries the multipole expansion (up to quadrupoles) of the permanent
+ * multipoles of its sites around the cell centre, which replaces the cell for
+ * segments far enough away.
+ */
+class SegmentCellList {
+ public:
+  template <class T>
+  SegmentCellList(const std::vector<T>& segments, double cellsize);
+
+  Index size() const { return Index(cells_.size()); }
+
+  double CellSize() const { return cellsize_; }
+
+  const std::vector<Index>& Segments(Index cell) const {
+    return cells_[cell].segments;
+  }
+
+  const StaticSegment& Expansion(Index cell) const {
+    return cells_[cell].expansion;
+  }
+
+  // true if (cell radius + radius)/distance to the cell centre is below
+  // accuracy, i.e. the expansion can be used for a segment of this radius
+  bool isFar(Index cell, const Eigen::Vector3d& pos, double radius,
+             double accuracy) const {
+    const Cell& c = cells_[cell];
+    double distance = (pos - c.expansion.getPos()).norm();
+    return (c.radius + radius) < accuracy * distance;
+  }
+
+  // largest distance of a site from the centre of the segment
+  template <class T>
+  static double Radius(const T& segment) {
+    double radius = 0.0;
+    for (const auto& site : segment) {
+      radius = std::max(radius, (site.getPos() - segment.getPos()).norm());
+    }
+    return radius;
+  }
+
+ private:
+  struct Cell {
+    std::vector<Index> segments;
+    StaticSegment expansion = StaticSegment("cell", 0);
+    double radius = 0.0;
+  };
+
+  template <class T>
+  void CalcExpansion(const std::vector<T>& segments, Cell& cell) const;
+
+  double cellsize_;
+  std::vector<Cell> cells_;
+};
+
+}  // namespace xtp
+}  // namespace votca
+
+#endif  // VOTCA_XTP_SEGMENTCELLLIST_H
@@ -0,0 +1,76 @@
+/*
+ * Copyright 2009-2020 The VOTCA Development Team (http://www.votca.org)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#pragma once
+#ifndef VOTCA_XTP_SEGMENTINDEX_H
+#define VOTCA_XTP_SEGMENTINDEX_H
+
+// Standard includes
+#include <array>
+#include <vector>
+
+// Local VOTCA includes
+#include "eigen.h"
+#include "topology.h"
+
+namespace votca {
+namespace xtp {
+
+/**
+ * \brief Periodic cell grid over the segment centres of a topology
+ *
+ * Answers which segments are within a distance of a point, using the same
+ * periodic distance as Topology::PbShortestConnect. A query only visits the
+ * cells that overlap the sphere, so its cost grows with the number of
+ * segments found and not with the size of the topology. Triclinic boxes are
+ * binned in fractional coordinates, open boxes over the bounding box of the
+ * segments.
+ */
+class SegmentIndex {
+ public:
+  // cellsize<=0 chooses cells holding about 8 segments on average
+  explicit SegmentIndex(const Topology& top, double cellsize = 0.0);
+
+  // ids of all segments whose centre is closer than radius to pos, in
+  // ascending order
+  std::vector<Index> FindSegments(const Eigen::Vector3d& pos,
+                                  double radius) const;
+
+  const Topology& getTopology() const { return top_; }
+
+  Index NumberOfCells() const { return Index(cells_.size()); }
+
+ private:
+  std::array<Index, 3> CellOf(const Eigen::Vector3d& pos) const;
+
+  Index CellIndex(const std::array<Index, 3>& cell) const {
+    return (cell[0] * ncells_[1] + cell[1]) * ncells_[2] + cell[2];
+  }
+
+  const Topology& top_;
+  bool periodic_ = true;
+  Eigen::Vector3d origin_ = Eigen::Vector3d::Zero();
+  Eigen::Matrix3d inv_box_;
+  std::array<Index, 3> ncells_;
+  std::array<double, 3> cellheight_;
+  std::vector<std::vector<Index>> cells_;
+};
+
+}  // namespace xtp
+}  // namespace votca
+
+#endif  // VOTCA_XTP_SEGMENTINDEX_H
@@ -58,8 +58,8 @@ class Sigma_base {
   Eigen::MatrixXd CalcExchangeMatrix() const;
   // Calculates correlation diagonal
   Eigen::VectorXd CalcCorrelationDiag(const Eigen::VectorXd& frequencies) const;
-  // Calculates correlation off-diagonal
-  Eigen::MatrixXd CalcCorrelationOffDiag(
+  // Calculates correlation off-diagonal, the diagonal is left zero
+  virtual Eigen::MatrixXd CalcCorrelationOffDiag(
       const Eigen::VectorXd& frequencies) const;
 
   // Sets up the screening parametrisation
@@ -74,6 +74,13 @@ class Sigma_base {
                                                double frequency1,
                                                double frequency2) const = 0;
 
+  // Calculates Sigma_c diagonal element of one level on a set of frequencies,
+  // evaluators which can vectorise over frequencies should override these
+  virtual Eigen::VectorXd CalcCorrelationDiagElementOnGrid(
+      Index gw_level, const Eigen::VectorXd& frequencies) const;
+  virtual Eigen::VectorXd CalcCorrelationDiagElementDerivativeOnGrid(
+      Index gw_level, const Eigen::VectorXd& frequencies) const;
+
  protected:
   options opt_;
   TCMatrix_gwbse& Mmn_;
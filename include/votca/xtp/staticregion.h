@@ -21,8 +21,15 @@
 #ifndef VOTCA_XTP_STATICREGION_H
 #define VOTCA_XTP_STATICREGION_H
 
+// Standard includes
+#include <memory>
+
+// VOTCA includes
+#include <votca/tools/constants.h>
+
 // Local VOTCA includes
 #include "mmregion.h"
+#include "segmentcelllist.h"
 
 namespace votca {
 namespace xtp {
@@ -36,23 +43,75 @@ class StaticRegion : public MMRegion<StaticSegment> {
 
   std::string identify() const override { return "staticregion"; }
 
-  void Initialize(const tools::Property&) override { return; }
+  void Initialize(const tools::Property& prop) override {
+    ewald_tolerance_ =
+        prop.ifExistsReturnElseReturnDefault<double>("ewald_tolerance", 0.0);
+  }
 
   bool Converged() const override { return true; }
 
-  double Etotal() const override { return 0.0; }
+  // the multipoles are fixed, only their energy in the field of the periodic
+  // images is counted, the interaction with other regions is theirs
+  double Etotal() const override { return E_periodic_; }
+
+  // 0 if the periodic images are not included
+  double EwaldTolerance() const { return ewald_tolerance_; }
+
+  void CalcPeriodicField(const EwaldSum& ewald) {
+    const Eigen::Matrix<double, 9, Eigen::Dynamic> field =
+        CalcLatticeField(ewald);
+    E_periodic_ = 0.0;
+    Index index = 0;
+    for (const StaticSegment& seg : segments_) {
+      for (const StaticSite& site : seg) {
+        E_periodic_ += LatticeEnergy(site, field.col(index));
+        index++;
+      }
+    }
+  }
 
   void Evaluate(std::vector<std::unique_ptr<Region> >&) override { return; }
   void Reset() override { return; };
 
+  void ClearHistory() override { return; }
+
+  void WriteToCpt(CheckpointWriter& w) const override {
+    MMRegion<StaticSegment>::WriteToCpt(w);
+    w(ewald_tolerance_, "ewald_tolerance");
+    w(E_periodic_, "E_periodic");
+  }
+
+  void ReadFromCpt(CheckpointReader& r) override {
+    MMRegion<StaticSegment>::ReadFromCpt(r);
+    r(ewald_tolerance_, "ewald_tolerance");
+    r(E_periodic_, "E_periodic");
+    cells_ = nullptr;
+  }
+
+  // built on first use and shared by all regions interacting with this one
+  const SegmentCellList& CellList(double cellsize) const {
+    if (!cells_ || cells_->CellSize() != cellsize) {
+      cells_ = std::make_unique<SegmentCellList>(segments_, cellsize);
+    }
+    return *cells_;
+  }
+
  protected:
   void ResetRegion() { return; }
-  void AppendResult(tools::Property&) const override { return; }
+  void AppendResult(tools::Property& prop) const override {
+    if (ewald_tolerance_ > 0.0) {
+      prop.add("E_periodic",
+               std::to_string(E_periodic_ * tools::conv::hrt2ev));
+    }
+  }
   double InteractwithQMRegion(const QMRegion&) override { return 0.0; }
   double InteractwithPolarRegion(const PolarRegion&) override { return 0.0; }
   double InteractwithStaticRegion(const StaticRegion&) override { return 0.0; }
 
  private:
+  mutable std::unique_ptr<SegmentCellList> cells_ = nullptr;
+  double ewald_tolerance_ = 0.0;
+  double E_periodic_ = 0.0;
 };
 
 }  // namespace xtp
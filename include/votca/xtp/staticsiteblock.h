@@ -0,0 +1,130 @@
+/*
+ * Copyright 2009-2020 The VOTCA Development Team (http://www.votca.org)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#pragma once
+#ifndef VOTCA_XTP_STATICSITEBLOCK_H
+#define VOTCA_XTP_STATICSITEBLOCK_H
+
+// Standard includes
+#include <vector>
+
+// Local VOTCA includes
+#include "classicalsegment.h"
+#include "eigen.h"
+
+namespace votca {
+namespace xtp {
+
+/**
+ * \brief Positions, charges and permanent dipoles of the sites of a segment or
+ * region in structure-of-arrays layout
+ *
+ * Only sites up to rank 1 can be packed, see Packable. The block is a copy
+ * made for the range kernels of eeInteractor, it is built right before they
+ * run and does not follow later changes of the sites.
+ */
+class StaticSiteBlock {
+ public:
+  StaticSiteBlock() = default;
+
+  template <class T>
+  explicit StaticSiteBlock(const T& segment) {
+    Resize(segment.size());
+    for (Index i = 0; i < segment.size(); i++) {
+      Fill(i, segment[i]);
+    }
+  }
+
+  // all sites of a region, segment after segment, in the order of
+  // PolarSiteBlock. Sites of segments that are not Packable are truncated
+  // to rank 1 and must not be passed to the kernels.
+  template <class T>
+  explicit StaticSiteBlock(const std::vector<T>& segments) {
+    Index size = 0;
+    for (const T& seg : segments) {
+      size += seg.size();
+    }
+    Resize(size);
+    Index index = 0;
+    for (const T& seg : segments) {
+      for (const auto& site : seg) {
+        Fill(index, site);
+        index++;
+      }
+    }
+  }
+
+  // quadrupoles are not packed, segments with them use the pair kernels
+  template <class T>
+  static bool Packable(const T& segment) {
+    for (const auto& site : segment) {
+      if (site.getRank() > 1) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  Index size() const { return x_.size(); }
+
+  const Eigen::ArrayXd& x() const { return x_; }
+  const Eigen::ArrayXd& y() const { return y_; }
+  const Eigen::ArrayXd& z() const { return z_; }
+  const Eigen::ArrayXd& q() const { return q_; }
+  const Eigen::ArrayXd& dx() const { return dx_; }
+  const Eigen::ArrayXd& dy() const { return dy_; }
+  const Eigen::ArrayXd& dz() const { return dz_; }
+
+ private:
+  void Resize(Index size) {
+    x_.resize(size);
+    y_.resize(size);
+    z_.resize(size);
+    q_.resize(size);
+    dx_.resize(size);
+    dy_.resize(size);
+    dz_.resize(size);
+  }
+
+  void Fill(Index i, const StaticSite& site) {
+    const Eigen::Vector3d& pos = site.getPos();
+    x_(i) = pos.x();
+    y_(i) = pos.y();
+    z_(i) = pos.z();
+    q_(i) = site.getCharge();
+    // only the permanent dipole, induced dipoles are treated separately
+    const Eigen::Vector3d dipole = (site.getRank() > 0)
+                                       ? Eigen::Vector3d(site.Q().segment<3>(1))
+                                       : Eigen::Vector3d::Zero();
+    dx_(i) = dipole.x();
+    dy_(i) = dipole.y();
+    dz_(i) = dipole.z();
+  }
+
+  Eigen::ArrayXd x_;
+  Eigen::ArrayXd y_;
+  Eigen::ArrayXd z_;
+  Eigen::ArrayXd q_;
+  Eigen::ArrayXd dx_;
+  Eigen::ArrayXd dy_;
+  Eigen::ArrayXd dz_;
+};
+
+}  // namespace xtp
+}  // namespace votca
+
+#endif  // VOTCA_XTP_STATICSITEBLOCK_H
@@ -21,9 +21,14 @@
 #ifndef VOTCA_XTP_THREECENTER_H
 #define VOTCA_XTP_THREECENTER_H
 
+// Standard includes
+#include <memory>
+#include <string>
+
 // Local VOTCA includes
 #include "aobasis.h"
 #include "eigen.h"
+#include "scratchfile.h"
 #include "symmetric_matrix.h"
 
 /**
@@ -72,11 +77,17 @@ class TCMatrix_dft final : public TCMatrix {
 
 class TCMatrix_gwbse final : public TCMatrix {
  public:
-  // returns one level as a constant reference
-  const Eigen::MatrixXd& operator[](Index i) const { return matrix_[i]; }
-
-  // returns one level as a reference
-  Eigen::MatrixXd& operator[](Index i) { return matrix_[i]; }
+  // returns one level as a constant map
+  Eigen::Map<const Eigen::MatrixXd> operator[](Index i) const {
+    return Eigen::Map<const Eigen::MatrixXd>(data_ + i * blocksize(), ntotal_,
+                                             auxbasissize_);
+  }
+
+  // returns one level as a map
+  Eigen::Map<Eigen::MatrixXd> operator[](Index i) {
+    return Eigen::Map<Eigen::MatrixXd>(data_ + i * blocksize(), ntotal_,
+                                       auxbasissize_);
+  }
   // returns auxbasissize
   Index auxsize() const { return auxbasissize_; }
 
@@ -95,34 +106,94 @@ class TCMatrix_gwbse final : public TCMatrix {
   void Initialize(Index basissize, Index mmin, Index mmax, Index nmin,
                   Index nmax);
 
+  // If all levels need more than max_memory bytes, Initialize puts them into
+  // a file in scratch_dir instead of RAM. 0 means no limit.
+  void setMaxMemory(Index max_memory, const std::string& scratch_dir) {
+    max_memory_ = max_memory;
+    scratch_dir_ = scratch_dir;
+  }
+
+  // size of all levels in bytes
+  Index MemorySize() const {
+    return mtotal_ * blocksize() * Index(sizeof(double));
+  }
+
+  bool isOutOfCore() const { return scratch_ != nullptr; }
+
+  // Called by loops over levels which work on level i, so that the levels
+  // needed next are read from the scratch file in the background
+  void Prefetch(Index i) const;
+
+  // Keeps a single precision copy of all levels in memory and moves the
+  // double precision levels into a file in scratch_dir. Rows then streams
+  // the single precision copy, operator[] still gives the double levels.
+  // false frees the copy again.
+  void setSinglePrecision(bool single);
+
+  // Rows streams the double precision levels again even if a single
+  // precision copy exists, e.g. for a final refinement
+  void ReadDoublePrecision(bool read_double) { read_double_ = read_double; }
+
+  bool isSinglePrecision() const {
+    return memory_sp_.size() > 0 && !read_double_;
+  }
+
+  // rows [first, first+n) of level i in double precision, converted into
+  // buffer if the levels are read in single precision
+  Eigen::Map<const Eigen::MatrixXd, 0, Eigen::OuterStride<> > Rows(
+      Index i, Index first, Index n, Eigen::MatrixXd& buffer) const;
+
+  // Keeps the AO 3c integrals (lower triangle) in memory during Fill, so that
+  // Rebuild only has to redo the AO->MO transformation
+  void setKeepAO3c(bool keep) { keep_ao3c_ = keep; }
+
   void Fill(const AOBasis& auxbasis, const AOBasis& dftbasis,
             const Eigen::MatrixXd& dft_orbitals);
   // Rebuilds ThreeCenterIntegrals, only works if the original basisobjects
   // still exist
-  void Rebuild() { Fill(*auxbasis_, *dftbasis_, *dft_orbitals_); }
+  void Rebuild();
 
   void MultiplyRightWithAuxMatrix(const Eigen::MatrixXd& matrix);
 
  private:
-  // store vector of matrices
-  std::vector<Eigen::MatrixXd> matrix_;
+  // all levels one after the other, each one ntotal x auxsize column major,
+  // points either into memory_ or into scratch_
+  double* data_ = nullptr;
+  Eigen::VectorXd memory_;
+  std::unique_ptr<ScratchFile> scratch_ = nullptr;
+  // single precision copy of all levels, same layout as data_
+  Eigen::VectorXf memory_sp_;
+  bool read_double_ = false;
+
+  Index max_memory_ = 0;
+  std::string scratch_dir_ = ".";
+
+  Index blocksize() const { return ntotal_ * auxbasissize_; }
 
   // band summation indices
   Index mmin_;
   Index mmax_;
   Index nmin_;
   Index nmax_;
-  Index ntotal_;
-  Index mtotal_;
-  Index auxbasissize_;
+  Index ntotal_ = 0;
+  Index mtotal_ = 0;
+  Index auxbasissize_ = 0;
 
   const AOBasis* auxbasis_ = nullptr;
   const AOBasis* dftbasis_ = nullptr;
   const Eigen::MatrixXd* dft_orbitals_ = nullptr;
 
+  bool keep_ao3c_ = false;
+  // AO 3c integrals for each aux function, only filled if keep_ao3c_ is set
+  std::vector<Symmetric_Matrix> ao3c_;
+
   void Fill3cMO(const AOBasis& auxbasis, const AOBasis& dftbasis,
                 const Eigen::MatrixXd& dft_orbitals);
 
+  void Transform3cMO(const Eigen::MatrixXd& dft_orbitals);
+
+  void FillSinglePrecision();
+
   std::vector<Eigen::MatrixXd> ComputeAO3cBlock(const libint2::Shell& auxshell,
                                                 const AOBasis& dftbasis,
                                                 libint2::Engine& engine) const;
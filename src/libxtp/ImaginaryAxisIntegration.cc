@@ -92,7 +92,7 @@ double ImaginaryAxisIntegration::SigmaGQDiag(double frequency, Index gw_level,
   const Index occ = lumo - opt_.rpamin;
   const Index unocc = opt_.rpamax - opt_.homo;
   Index gw_level_offset = gw_level + opt_.qpmin - opt_.rpamin;
-  const Eigen::MatrixXd& Imx = Mmn_[gw_level_offset];
+  auto Imx = Mmn_[gw_level_offset];
   Eigen::ArrayXcd DeltaE = frequency - energies_.array();
   DeltaE.imag().head(occ) = eta;
   DeltaE.imag().tail(unocc) = -eta;
@@ -2117,5 +2117,60 @@ void AOMultipole::FillPotential(
   return;
 }
 
+Eigen::VectorXd AOMultipole::ElectronicPotential(
+    const AOBasis& aobasis, const Eigen::MatrixXd& dmat,
+    const std::vector<Eigen::Vector3d>& points) const {
+  constexpr double threshold = 1e-12;
+  // the gaussian product prefactor exp(-xi*dist^2) is largest for the most
+  // diffuse primitives of both shells
+  std::vector<std::pair<Index, Index> > shellpairs;
+  for (Index col = 0; col < aobasis.getNumofShells(); col++) {
+    const AOShell& shell_col = aobasis.getShell(col);
+    for (Index row = col; row < aobasis.getNumofShells(); row++) {
+      const AOShell& shell_row = aobasis.getShell(row);
+      const double decay_row = shell_row.getMinDecay();
+      const double decay_col = shell_col.getMinDecay();
+      const double xi = decay_row * decay_col / (decay_row + decay_col);
+      const double distsq =
+          (shell_row.getPos() - shell_col.getPos()).squaredNorm();
+      const double dmax =
+          dmat.block(shell_row.getStartIndex(), shell_col.getStartIndex(),
+                     shell_row.getNumFunc(), shell_col.getNumFunc())
+              .cwiseAbs()
+              .maxCoeff();
+      if (dmax * std::exp(-xi * distsq) > threshold) {
+        shellpairs.push_back(std::make_pair(row, col));
+      }
+    }
+  }
+
+  Eigen::VectorXd potential = Eigen::VectorXd::Zero(Index(points.size()));
+#pragma omp parallel for schedule(dynamic)
+  for (Index i = 0; i < Index(points.size()); i++) {
+    StaticSite s = StaticSite(0, "", points[i]);
+    s.setCharge(1.0);
+    AOMultipole multipole;
+    multipole.setSite(&s);
+    double result = 0.0;
+    for (const std::pair<Index, Index>& pair : shellpairs) {
+      const AOShell& shell_row = aobasis.getShell(pair.first);
+      const AOShell& shell_col = aobasis.getShell(pair.second);
+      const Index nrows = shell_row.getNumFunc();
+      const Index ncols = shell_col.getNumFunc();
+      Eigen::MatrixXd integrals = Eigen::MatrixXd::Zero(nrows, ncols);
+      Eigen::Block<Eigen::MatrixXd> block = integrals.block(0, 0, nrows, ncols);
+      multipole.FillBlock(block, shell_row, shell_col);
+      // only the lower triangle is calculated
+      const double factor = (pair.first == pair.second) ? 1.0 : 2.0;
+      result -= factor * dmat.block(shell_row.getStartIndex(),
+                                    shell_col.getStartIndex(), nrows, ncols)
+                             .cwiseProduct(integrals)
+                             .sum();
+    }
+    potential(i) = result;
+  }
+  return potential;
+}
+
 }  // namespace xtp
 }  // namespace votca
@@ -418,6 +418,10 @@ void BSECoupling::CalculateCouplings(const Orbitals& orbitalsA,
   opt.rpamin = orbitalsAB.getRPAmin();
   opt.useTDA = true;
   opt.vmin = orbitalsAB.getBSEvmin();
+  opt.davidson_warmstart = false;
+  opt.dense_max_memory = 0;
+  opt.truncation_window = 0;
+  opt.mixed_precision = false;
   opt.use_Hqp_offdiag = orbitalsAB.GetFlagUseHqpOffdiag();
   BSE bse(*pLog_, Mmn);
   bse.configure(opt, orbitalsAB.RPAInputEnergies(), Hqp);
@@ -91,12 +91,14 @@ void DavidsonSolver::printIterationData(
     const DavidsonSolver::RitzEigenPair &rep,
     const DavidsonSolver::ProjectedSpace &proj, Index neigen) const {
 
-  Index converged_roots = proj.root_converged.head(neigen).count();
+  Index nactive = neigen - proj.nlocked();
+  Index converged_roots =
+      proj.nlocked() + proj.root_converged.head(nactive).count();
   double percent_converged = 100 * double(converged_roots) / double(neigen);
   XTP_LOG(Log::error, log_)
       << TimeStamp()
       << format(" %1$4d %2$12d \t %3$4.2e \t %4$5.2f%% converged") % i_iter_ %
-             proj.search_space() % rep.res_norm().head(neigen).maxCoeff() %
+             proj.search_space() % rep.res_norm().head(nactive).maxCoeff() %
              percent_converged
       << std::flush;
 }
@@ -205,6 +207,25 @@ Eigen::MatrixXd DavidsonSolver::setupInitialEigenvectors(
       }
       break;
   }
+
+  if (initial_guess_.cols() > 0) {
+    if (initial_guess_.rows() != Adiag_.size()) {
+      throw std::runtime_error(
+          "Initial guess vectors have size " +
+          std::to_string(initial_guess_.rows()) + " but the operator has size " +
+          std::to_string(Adiag_.size()));
+    }
+    /* user supplied vectors come first, the remaining columns are the unit
+     * vectors from above. A QR decomposition makes the set orthonormal and
+     * does not break down if the guess overlaps with the unit vectors */
+    Index nguess = std::min(initial_guess_.cols(), size_initial_guess);
+    guess.rightCols(size_initial_guess - nguess) =
+        guess.leftCols(size_initial_guess - nguess).eval();
+    guess.leftCols(nguess) = initial_guess_.leftCols(nguess);
+    guess = DavidsonSolver::qr(guess);
+    XTP_LOG(Log::error, log_) << TimeStamp() << " Using " << nguess
+                              << " supplied guess vectors" << std::flush;
+  }
   return guess;
 }
 DavidsonSolver::RitzEigenPair DavidsonSolver::getRitzEigenPairs(
@@ -233,8 +254,10 @@ DavidsonSolver::RitzEigenPair DavidsonSolver::getRitz(
   // we only need enough pairs for either extension of space or restart
   Index needed_pairs =
       std::min(proj.T.cols(), std::max(restart_size_, proj.size_update));
-  rep.lambda = es.eigenvalues().head(needed_pairs);
-  rep.U = es.eigenvectors().leftCols(needed_pairs);
+  rep.lambda_all = es.eigenvalues();
+  rep.U_all = es.eigenvectors();
+  rep.lambda = rep.lambda_all.head(needed_pairs);
+  rep.U = rep.U_all.leftCols(needed_pairs);
 
   rep.q = proj.V * rep.U;                                       // Ritz vectors
   rep.res = proj.AV * rep.U - rep.q * rep.lambda.asDiagonal();  // residues
@@ -347,11 +370,141 @@ DavidsonSolver::ProjectedSpace DavidsonSolver::initProjectedSpace(
   return proj;
 }
 
+DavidsonSolver::ProjectedSpace DavidsonSolver::startSolve(
+    Index op_size, const Eigen::VectorXd &Adiag, Index neigen,
+    Index size_initial_guess) {
+
+  if (max_search_space_ < neigen) {
+    max_search_space_ = neigen * 5;
+  }
+  checkOptions(op_size);
+  printOptions(op_size);
+
+  // initial guess size
+  if (size_initial_guess == 0) {
+    size_initial_guess = 2 * neigen;
+  }
+  size_initial_guess = std::max(size_initial_guess, initial_guess_.cols());
+  size_initial_guess = std::min(size_initial_guess, op_size);
+
+  restart_size_ = size_initial_guess;
+
+  // get the diagonal of the operator
+  this->Adiag_ = Adiag;
+
+  // target the lowest diagonal element
+  ProjectedSpace proj = initProjectedSpace(neigen, size_initial_guess);
+  XTP_LOG(Log::error, log_)
+      << TimeStamp() << " iter\tSearch Space\tNorm" << std::flush;
+  return proj;
+}
+
+bool DavidsonSolver::iterate(DavidsonSolver::RitzEigenPair &rep,
+                             DavidsonSolver::ProjectedSpace &proj,
+                             Index neigen) {
+
+  rep = getRitzEigenPairs(proj);
+
+  bool converged = checkConvergence(rep, proj, neigen);
+
+  printIterationData(rep, proj, neigen);
+
+  bool last_iter = i_iter_ == (iter_max_ - 1);
+
+  if (converged) {
+    storeConvergedData(rep, proj, neigen);
+    return true;
+  } else if (last_iter) {
+    storeNotConvergedData(rep, proj, neigen);
+    return true;
+  }
+  if (matrix_type_ == MATRIX_TYPE::SYMM) {
+    lockConvergedRoots(rep, proj, neigen);
+  }
+  Index extension_size = extendProjection(rep, proj);
+  bool do_restart = (proj.search_space() > max_search_space_);
+
+  if (do_restart) {
+    restart(rep, proj, extension_size);
+  }
+  return false;
+}
+
+Eigen::MatrixXd DavidsonSolver::newVectors(
+    const DavidsonSolver::ProjectedSpace &proj, bool none) const {
+  Index nvec = none ? 0 : proj.V.cols() - proj.AV.cols();
+  return proj.V.rightCols(nvec);
+}
+
+void DavidsonSolver::appendProjection(DavidsonSolver::ProjectedSpace &proj,
+                                      const Eigen::MatrixXd &AV) const {
+  /* if we use a Gram Schmid(GS) orthogonalisation we do not have to
+  recompute the entire projection as GS doesn't change the original
+  subspace*/
+  Index old_dim = proj.AV.cols();
+  Index new_dim = proj.V.cols();
+  Index nvec = new_dim - old_dim;
+  proj.AV.conservativeResize(proj.V.rows(), new_dim);
+  proj.AV.rightCols(nvec) = AV;
+
+  proj.T.conservativeResize(new_dim, new_dim);
+  proj.T.rightCols(nvec) = proj.V.transpose() * proj.AV.rightCols(nvec);
+  proj.T.bottomLeftCorner(nvec, old_dim) =
+      proj.T.topRightCorner(old_dim, nvec).transpose();
+}
+
 bool DavidsonSolver::checkConvergence(const DavidsonSolver::RitzEigenPair &rep,
                                       DavidsonSolver::ProjectedSpace &proj,
                                       Index neigen) const {
+  Index nactive = neigen - proj.nlocked();
   proj.root_converged = (rep.res_norm().head(proj.size_update) < tol_);
-  return proj.root_converged.head(neigen).all();
+  return proj.root_converged.head(nactive).all();
+}
+
+void DavidsonSolver::lockConvergedRoots(DavidsonSolver::RitzEigenPair &rep,
+                                        DavidsonSolver::ProjectedSpace &proj,
+                                        Index neigen) const {
+  /* only the leading block of converged roots is locked, a root which
+   * converged early can otherwise be overtaken by a lower one that is not
+   * yet resolved */
+  Index nactive = neigen - proj.nlocked();
+  Index nlock = 0;
+  while (nlock < nactive && proj.root_converged[nlock]) {
+    nlock++;
+  }
+  if (nlock == 0) {
+    return;
+  }
+
+  Index nold = proj.nlocked();
+  proj.locked_vectors.conservativeResize(proj.V.rows(), nold + nlock);
+  proj.locked_vectors.rightCols(nlock) = rep.q.leftCols(nlock);
+  proj.locked_values.conservativeResize(nold + nlock);
+  proj.locked_values.tail(nlock) = rep.lambda.head(nlock);
+
+  /* rotate the search space onto the Ritz vectors and drop the locked ones,
+   * this requires no additional products with A and reuses the
+   * decomposition of getRitz */
+  Index nkeep = proj.T.cols() - nlock;
+  const Eigen::MatrixXd U = rep.U_all.rightCols(nkeep);
+  proj.V = proj.V * U;
+  proj.AV = proj.AV * U;
+  proj.T = rep.lambda_all.tail(nkeep).asDiagonal();
+
+  // in the rotated space the remaining Ritz vectors are the basis vectors
+  Index nrep = rep.lambda.size() - nlock;
+  rep.lambda_all = rep.lambda_all.tail(nkeep).eval();
+  rep.U_all = Eigen::MatrixXd::Identity(nkeep, nkeep);
+  rep.lambda = rep.lambda_all.head(nrep);
+  rep.U = rep.U_all.leftCols(nrep);
+  rep.q = proj.V.leftCols(nrep);
+  rep.res = proj.AV.leftCols(nrep) - rep.q * rep.lambda.asDiagonal();
+
+  proj.size_update = std::min(getSizeUpdate(nactive - nlock), nrep);
+  proj.root_converged = (rep.res_norm().head(proj.size_update) < tol_);
+
+  XTP_LOG(Log::info, log_) << TimeStamp() << " Locked " << proj.nlocked()
+                           << " converged roots" << std::flush;
 }
 
 Index DavidsonSolver::extendProjection(
@@ -376,6 +529,12 @@ Index DavidsonSolver::extendProjection(
     proj.V.col(oldsize + k) = w.normalized();
     k++;
   }
+  if (proj.nlocked() > 0) {
+    // keep the search space orthogonal to the locked roots
+    proj.V.rightCols(nupdate) -=
+        proj.locked_vectors *
+        (proj.locked_vectors.transpose() * proj.V.rightCols(nupdate));
+  }
   orthogonalize(proj.V, nupdate);
   return nupdate;
 }
@@ -445,34 +604,54 @@ void DavidsonSolver::orthogonalize(Eigen::MatrixXd &V, Index nupdate) const {
 void DavidsonSolver::gramschmidt(Eigen::MatrixXd &Q, Index nstart) const {
   Index nupdate = Q.cols() - nstart;
   Eigen::VectorXd norms = Q.rightCols(nupdate).colwise().norm();
-  // orthogonalize with respect to already existing vectors
-  if (nstart > 0) {
-    Q.rightCols(nupdate) -=
-        Q.leftCols(nstart) *
-        (Q.leftCols(nstart).transpose() * Q.rightCols(nupdate));
-    Q.rightCols(nupdate).colwise().normalize();
-  }
-  // orthogonalize vectors to each other
-  for (Index j = nstart + 1; j < Q.cols(); ++j) {
-    Index range = j - nstart;
-    Q.col(j) -= Q.middleCols(nstart, range) *
-                (Q.middleCols(nstart, range).transpose() * Q.col(j));
-    Q.col(j).normalize();
-  }
-  // repeat again two is enough GS
+  // two passes of block classical Gram-Schmidt are enough
   // http://stoppels.blog/posts/orthogonalization-performance
-  if (nstart > 0) {
-    Q.rightCols(nupdate) -=
-        Q.leftCols(nstart) *
-        (Q.leftCols(nstart).transpose() * Q.rightCols(nupdate));
-    Q.rightCols(nupdate).colwise().normalize();
+  for (Index pass = 0; pass < 2; pass++) {
+    // orthogonalize with respect to already existing vectors
+    if (nstart > 0) {
+      Q.rightCols(nupdate) -=
+          Q.leftCols(nstart) *
+          (Q.leftCols(nstart).transpose() * Q.rightCols(nupdate));
+    }
+    // orthogonalize vectors to each other
+    if (!choleskyqr(Q, nstart, norms)) {
+      bool check_dependence = (pass == 1);
+      columnwise_gramschmidt(Q, nstart, norms, check_dependence);
+    }
+  }
+}
+
+bool DavidsonSolver::choleskyqr(Eigen::MatrixXd &Q, Index nstart,
+                                const Eigen::VectorXd &norms) const {
+  /* Cholesky QR of the new block: with S = B.T*B = R.T*R the block B*R^-1 is
+   * orthonormal. Everything is done with matrix-matrix products, but the
+   * condition number of B enters squared, so nearly dependent blocks are left
+   * to the column-wise algorithm */
+  auto B = Q.rightCols(Q.cols() - nstart);
+  Eigen::LLT<Eigen::MatrixXd> llt(B.transpose() * B);
+  if (llt.info() != Eigen::ComputationInfo::Success) {
+    return false;
+  }
+  // the diagonal of R is the norm of each vector after removing the
+  // components of the previous ones
+  Eigen::ArrayXd rdiag = llt.matrixLLT().diagonal().array();
+  if ((rdiag <= 1E-6 * norms.array()).any()) {
+    return false;
   }
+  llt.matrixU().solveInPlace<Eigen::OnTheRight>(B);
+  return true;
+}
 
+void DavidsonSolver::columnwise_gramschmidt(Eigen::MatrixXd &Q, Index nstart,
+                                            const Eigen::VectorXd &norms,
+                                            bool check_dependence) const {
+  Index nupdate = Q.cols() - nstart;
+  Q.rightCols(nupdate).colwise().normalize();
   for (Index j = nstart + 1; j < Q.cols(); ++j) {
     Index range = j - nstart;
     Q.col(j) -= Q.middleCols(nstart, range) *
                 (Q.middleCols(nstart, range).transpose() * Q.col(j));
-    if (Q.col(j).norm() <= 1E-12 * norms(range)) {
+    if (check_dependence && Q.col(j).norm() <= 1E-12 * norms(range)) {
       // info_ = Eigen::ComputationInfo::NumericalIssue;
       throw std::runtime_error("Linear dependencies in Gram-Schmidt.");
     }
@@ -493,42 +672,43 @@ Eigen::MatrixXd DavidsonSolver::qr(const Eigen::MatrixXd &A) const {
 void DavidsonSolver::restart(const DavidsonSolver::RitzEigenPair &rep,
                              DavidsonSolver::ProjectedSpace &proj,
                              Index newvectors) const {
-  Eigen::MatrixXd newV =
-      Eigen::MatrixXd(proj.V.rows(), newvectors + restart_size_);
+  // after locking fewer Ritz pairs than restart_size_ may be left
+  Index nrestart = std::min(restart_size_, rep.q.cols());
+  Eigen::MatrixXd newV = Eigen::MatrixXd(proj.V.rows(), newvectors + nrestart);
   newV.rightCols(newvectors) = proj.V.rightCols(newvectors);
   if (matrix_type_ == MATRIX_TYPE::SYMM) {
 
-    newV.leftCols(restart_size_) = rep.q.leftCols(restart_size_);
-    proj.AV *= rep.U.leftCols(restart_size_);  // corresponds to replacing
-                                               // V with q.leftCols
+    newV.leftCols(nrestart) = rep.q.leftCols(nrestart);
+    proj.AV *= rep.U.leftCols(nrestart);  // corresponds to replacing
+                                          // V with q.leftCols
   } else {
-    Eigen::MatrixXd orthonormal =
-        DavidsonSolver::qr(rep.U.leftCols(restart_size_));
-    newV.leftCols(restart_size_) =
+    Eigen::MatrixXd orthonormal = DavidsonSolver::qr(rep.U.leftCols(nrestart));
+    newV.leftCols(nrestart) =
         proj.V.leftCols(proj.V.cols() - newvectors) * orthonormal;
     proj.AV *= orthonormal;
 
     proj.AAV *= orthonormal;
-    proj.B = newV.leftCols(restart_size_).transpose() * proj.AAV;
+    proj.B = newV.leftCols(nrestart).transpose() * proj.AAV;
   }
-  proj.T = newV.leftCols(restart_size_).transpose() * proj.AV;
+  proj.T = newV.leftCols(nrestart).transpose() * proj.AV;
   proj.V = newV;
 }
 
 void DavidsonSolver::storeConvergedData(
-    const DavidsonSolver::RitzEigenPair &rep, Index neigen) {
+    const DavidsonSolver::RitzEigenPair &rep,
+    const DavidsonSolver::ProjectedSpace &proj, Index neigen) {
 
-  DavidsonSolver::storeEigenPairs(rep, neigen);
+  DavidsonSolver::storeEigenPairs(rep, proj, neigen);
   XTP_LOG(Log::error, log_) << TimeStamp() << " Davidson converged after "
                             << i_iter_ << " iterations." << std::flush;
   info_ = Eigen::ComputationInfo::Success;
 }
 
 void DavidsonSolver::storeNotConvergedData(
-    const DavidsonSolver::RitzEigenPair &rep, const ArrayXb &root_converged,
-    Index neigen) {
+    const DavidsonSolver::RitzEigenPair &rep,
+    const DavidsonSolver::ProjectedSpace &proj, Index neigen) {
 
-  DavidsonSolver::storeEigenPairs(rep, neigen);
+  ArrayXb root_converged = DavidsonSolver::storeEigenPairs(rep, proj, neigen);
 
   double percent_converged = 0;
 
@@ -549,12 +729,37 @@ void DavidsonSolver::storeNotConvergedData(
   info_ = Eigen::ComputationInfo::NoConvergence;
 }
 
-void DavidsonSolver::storeEigenPairs(const DavidsonSolver::RitzEigenPair &rep,
-                                     Index neigen) {
+DavidsonSolver::ArrayXb DavidsonSolver::storeEigenPairs(
+    const DavidsonSolver::RitzEigenPair &rep,
+    const DavidsonSolver::ProjectedSpace &proj, Index neigen) {
   // store the eigenvalues/eigenvectors
-  this->eigenvalues_ = rep.lambda.head(neigen);
-  this->eigenvectors_ = rep.q.leftCols(neigen);
+  Index nlocked = proj.nlocked();
+  Index nactive = neigen - nlocked;
+  this->eigenvalues_ = Eigen::VectorXd(neigen);
+  this->eigenvalues_.tail(nactive) = rep.lambda.head(nactive);
+  this->eigenvectors_ = Eigen::MatrixXd(rep.q.rows(), neigen);
+  this->eigenvectors_.rightCols(nactive) = rep.q.leftCols(nactive);
+  ArrayXb root_converged = ArrayXb::Constant(neigen, true);
+  root_converged.tail(nactive) = proj.root_converged.head(nactive);
+
+  if (nlocked > 0) {
+    this->eigenvalues_.head(nlocked) = proj.locked_values;
+    this->eigenvectors_.leftCols(nlocked) = proj.locked_vectors;
+    // a root resolved after locking may lie below a locked one
+    ArrayXl idx = DavidsonSolver::argsort(this->eigenvalues_);
+    this->eigenvectors_ =
+        DavidsonSolver::extract_vectors(this->eigenvectors_, idx);
+    Eigen::VectorXd sorted_values = this->eigenvalues_;
+    ArrayXb sorted_converged = root_converged;
+    for (Index i = 0; i < neigen; i++) {
+      sorted_values(i) = this->eigenvalues_(idx(i));
+      sorted_converged(i) = root_converged(idx(i));
+    }
+    this->eigenvalues_ = sorted_values;
+    root_converged = sorted_converged;
+  }
   this->eigenvectors_.colwise().normalize();
+  return root_converged;
 }
 
 }  // namespace xtp
@@ -179,6 +179,130 @@ Eigen::Matrix3d eeInteractor::FillTholeInteraction(
   return result;  // T_1alpha,1beta (alpha,beta=x,y,z)
 }
 
+Eigen::Matrix3d eeInteractor::TholeCorrection(
+    const PolarSite& site1, const PolarSite& site2,
+    const Eigen::Vector3d& shift) const {
+  Eigen::Vector3d a = site2.getPos() + shift - site1.getPos();
+  const double R = a.norm();
+  const double fac1 = 1 / R;
+  a *= fac1;
+  const double au3 = expdamping_ * std::pow(R, 3) *
+                     site1.getSqrtInvEigenDamp() * site2.getSqrtInvEigenDamp();
+  if (au3 >= 40) {
+    return Eigen::Matrix3d::Zero();
+  }
+  // lambda3 and lambda5 of FillTholeInteraction minus their undamped values
+  const double exp_ua = std::exp(-au3);
+  const double fac3 = std::pow(fac1, 3);
+  Eigen::Matrix3d result = 3 * (1 + au3) * exp_ua * fac3 * a * a.transpose();
+  result.diagonal().array() -= exp_ua * fac3;
+  return result;
+}
+
+void eeInteractor::TholeFactors_Block(const PolarSiteBlock& sites, Index i,
+                                      Index first, Index n, Eigen::ArrayXd& ax,
+                                      Eigen::ArrayXd& ay, Eigen::ArrayXd& az,
+                                      Eigen::ArrayXd& lambda3,
+                                      Eigen::ArrayXd& lambda5) const {
+  ax = sites.x().segment(first, n) - sites.x()(i);
+  ay = sites.y().segment(first, n) - sites.y()(i);
+  az = sites.z().segment(first, n) - sites.z()(i);
+  const Eigen::ArrayXd R2 = ax.square() + ay.square() + az.square();
+  const Eigen::ArrayXd fac1 = R2.rsqrt();
+  ax *= fac1;
+  ay *= fac1;
+  az *= fac1;
+
+  const Eigen::ArrayXd au3 = (expdamping_ * sites.damp()(i)) *
+                             sites.damp().segment(first, n) * R2 * R2 * fac1;
+  const Eigen::ArrayXd exp_ua = (-au3).exp();
+  const Eigen::ArrayXd R3inv = fac1.cube();
+  lambda3 = R3inv * (au3 < 40).select(1 - exp_ua, 1.0);
+  lambda5 = 3 * R3inv * (au3 < 40).select(1 - (1 + au3) * exp_ua, 1.0);
+}
+
+void eeInteractor::TholeField_Block(const PolarSiteBlock& sites, Index i,
+                                    Index first, Index n,
+                                    const Eigen::MatrixXd& dipoles,
+                                    Eigen::MatrixXd& fields) const {
+  if (n < 1) {
+    return;
+  }
+  Eigen::ArrayXd ax, ay, az, lambda3, lambda5;
+  TholeFactors_Block(sites, i, first, n, ax, ay, az, lambda3, lambda5);
+
+  // T_ij = lambda3 - 3*lambda5 a a^T is symmetric
+  auto djx = dipoles.col(0).segment(first, n).array();
+  auto djy = dipoles.col(1).segment(first, n).array();
+  auto djz = dipoles.col(2).segment(first, n).array();
+  const Eigen::ArrayXd proj_j = lambda5 * (ax * djx + ay * djy + az * djz);
+  fields(i, 0) += (lambda3 * djx - proj_j * ax).sum();
+  fields(i, 1) += (lambda3 * djy - proj_j * ay).sum();
+  fields(i, 2) += (lambda3 * djz - proj_j * az).sum();
+
+  const double dix = dipoles(i, 0);
+  const double diy = dipoles(i, 1);
+  const double diz = dipoles(i, 2);
+  const Eigen::ArrayXd proj_i = lambda5 * (ax * dix + ay * diy + az * diz);
+  fields.col(0).segment(first, n).array() += lambda3 * dix - proj_i * ax;
+  fields.col(1).segment(first, n).array() += lambda3 * diy - proj_i * ay;
+  fields.col(2).segment(first, n).array() += lambda3 * diz - proj_i * az;
+}
+
+Eigen::Vector3d eeInteractor::TholeField_Block(
+    const PolarSiteBlock& sites, Index i, Index first, Index n,
+    const Eigen::MatrixXd& dipoles) const {
+  Eigen::Vector3d field = Eigen::Vector3d::Zero();
+  if (n < 1) {
+    return field;
+  }
+  Eigen::ArrayXd ax, ay, az, lambda3, lambda5;
+  TholeFactors_Block(sites, i, first, n, ax, ay, az, lambda3, lambda5);
+
+  auto djx = dipoles.col(0).segment(first, n).array();
+  auto djy = dipoles.col(1).segment(first, n).array();
+  auto djz = dipoles.col(2).segment(first, n).array();
+  const Eigen::ArrayXd proj_j = lambda5 * (ax * djx + ay * djy + az * djz);
+  field.x() = (lambda3 * djx - proj_j * ax).sum();
+  field.y() = (lambda3 * djy - proj_j * ay).sum();
+  field.z() = (lambda3 * djz - proj_j * az).sum();
+  return field;
+}
+
+Eigen::Vector4d eeInteractor::StaticField_Block(
+    const StaticSiteBlock& sources, Index first, Index n,
+    const Eigen::Vector3d& pos) const {
+  Eigen::Vector4d V = Eigen::Vector4d::Zero();
+  if (n < 1) {
+    return V;
+  }
+  // unit vectors pointing from pos to the sources
+  Eigen::ArrayXd ax = sources.x().segment(first, n) - pos.x();
+  Eigen::ArrayXd ay = sources.y().segment(first, n) - pos.y();
+  Eigen::ArrayXd az = sources.z().segment(first, n) - pos.z();
+  const Eigen::ArrayXd fac1 = (ax.square() + ay.square() + az.square()).rsqrt();
+  ax *= fac1;
+  ay *= fac1;
+  az *= fac1;
+  const Eigen::ArrayXd fac2 = fac1.square();
+  const Eigen::ArrayXd fac3 = fac2 * fac1;
+
+  auto q = sources.q().segment(first, n);
+  auto dx = sources.dx().segment(first, n);
+  auto dy = sources.dy().segment(first, n);
+  auto dz = sources.dz().segment(first, n);
+  const Eigen::ArrayXd a_d = ax * dx + ay * dy + az * dz;
+
+  // T_00,00 and T_00,1alpha
+  V(0) = (fac1 * q - fac2 * a_d).sum();
+  // T_1alpha,00 and T_1alpha,1beta
+  const Eigen::ArrayXd along_a = fac2 * q - 3 * fac3 * a_d;
+  V(1) = (along_a * ax + fac3 * dx).sum();
+  V(2) = (along_a * ay + fac3 * dy).sum();
+  V(3) = (along_a * az + fac3 * dz).sum();
+  return V;
+}
+
 template <enum Estatic CE>
 double eeInteractor::ApplyStaticField_site(const StaticSite& site1,
                                            PolarSite& site2) const {
@@ -236,6 +360,123 @@ double eeInteractor::CalcPolar_stat_Energy_site(const PolarSite& site1,
   return V_full.tail<3>().dot(site1.Induced_Dipole());
 }
 
+double eeInteractor::CalcPolar_stat_Energy_Block(
+    const PolarSegment& targets, const StaticSiteBlock& sources) const {
+  double e = 0.0;
+  for (const PolarSite& site : targets) {
+    const Eigen::Vector4d V_full =
+        StaticField_Block(sources, 0, sources.size(), site.getPos());
+    e += V_full.tail<3>().dot(site.Induced_Dipole());
+  }
+  return e;
+}
+
+eeInteractor::E_terms eeInteractor::CalcPolarEnergy_Block(
+    const PolarSegment& segment1, const StaticSegment& segment2) const {
+  eeInteractor::E_terms val;
+  val.E_indu_stat() =
+      CalcPolar_stat_Energy_Block(segment1, StaticSiteBlock(segment2));
+  return val;
+}
+
+double eeInteractor::StaticFieldEnergy_Block(
+    const StaticSiteBlock& sources, Index s, const PolarSiteBlock& targets,
+    const Eigen::MatrixXd& dipoles, Index first, Index n) const {
+  if (n < 1) {
+    return 0.0;
+  }
+  // unit vectors pointing from the targets to the source, as in
+  // StaticField_Block
+  Eigen::ArrayXd ax = sources.x()(s) - targets.x().segment(first, n);
+  Eigen::ArrayXd ay = sources.y()(s) - targets.y().segment(first, n);
+  Eigen::ArrayXd az = sources.z()(s) - targets.z().segment(first, n);
+  const Eigen::ArrayXd fac1 = (ax.square() + ay.square() + az.square()).rsqrt();
+  ax *= fac1;
+  ay *= fac1;
+  az *= fac1;
+  const Eigen::ArrayXd fac2 = fac1.square();
+  const Eigen::ArrayXd fac3 = fac2 * fac1;
+
+  const double q = sources.q()(s);
+  const double dx = sources.dx()(s);
+  const double dy = sources.dy()(s);
+  const double dz = sources.dz()(s);
+  const Eigen::ArrayXd along_a =
+      fac2 * q - 3 * fac3 * (ax * dx + ay * dy + az * dz);
+  auto ix = dipoles.col(0).segment(first, n).array();
+  auto iy = dipoles.col(1).segment(first, n).array();
+  auto iz = dipoles.col(2).segment(first, n).array();
+  return (along_a * (ax * ix + ay * iy + az * iz) +
+          fac3 * (dx * ix + dy * iy + dz * iz))
+      .sum();
+}
+
+double eeInteractor::CalcPolar_stat_Energy_Block(
+    const PolarSiteBlock& targets, const Eigen::MatrixXd& dipoles,
+    Index first, Index n, const StaticSiteBlock& sources, Index first_source,
+    Index nsources) const {
+  double e = 0.0;
+  // the kernels work on arrays over the inner range, which should be the
+  // longer
+  if (nsources >= n) {
+    for (Index i = first; i < first + n; i++) {
+      const Eigen::Vector4d V_full = StaticField_Block(
+          sources, first_source, nsources, targets.getPos(i));
+      e += V_full.tail<3>().dot(dipoles.row(i).transpose());
+    }
+  } else {
+    for (Index s = first_source; s < first_source + nsources; s++) {
+      e += StaticFieldEnergy_Block(sources, s, targets, dipoles, first, n);
+    }
+  }
+  return e;
+}
+
+eeInteractor::E_terms eeInteractor::CalcPolarEnergy_Block(
+    const PolarSegment& segment1, const PolarSegment& segment2) const {
+  eeInteractor::E_terms val;
+  val.E_indu_stat() =
+      CalcPolar_stat_Energy_Block(segment1, StaticSiteBlock(segment2));
+  val.E_indu_stat() +=
+      CalcPolar_stat_Energy_Block(segment2, StaticSiteBlock(segment1));
+
+  std::vector<const PolarSite*> sites;
+  for (const PolarSite& site : segment1) {
+    sites.push_back(&site);
+  }
+  for (const PolarSite& site : segment2) {
+    sites.push_back(&site);
+  }
+  const PolarSiteBlock block(sites);
+  Index n1 = segment1.size();
+  Index n2 = segment2.size();
+  Eigen::MatrixXd dipoles(n1 + n2, 3);
+  for (Index i = 0; i < n1 + n2; i++) {
+    dipoles.row(i) = sites[i]->Induced_Dipole().transpose();
+  }
+  for (Index i = 0; i < n1; i++) {
+    val.E_indu_indu() += TholeField_Block(block, i, n1, n2, dipoles)
+                             .dot(dipoles.row(i).transpose());
+  }
+  return val;
+}
+
+eeInteractor::E_terms eeInteractor::CalcPolarEnergy_Block(
+    const PolarSiteBlock& sites, const StaticSiteBlock& statics,
+    const Eigen::MatrixXd& dipoles, Index first1, Index n1, Index first2,
+    Index n2) const {
+  eeInteractor::E_terms val;
+  val.E_indu_stat() = CalcPolar_stat_Energy_Block(sites, dipoles, first1, n1,
+                                                  statics, first2, n2);
+  val.E_indu_stat() += CalcPolar_stat_Energy_Block(sites, dipoles, first2, n2,
+                                                   statics, first1, n1);
+  for (Index i = first1; i < first1 + n1; i++) {
+    val.E_indu_indu() += TholeField_Block(sites, i, first2, n2, dipoles)
+                             .dot(dipoles.row(i).transpose());
+  }
+  return val;
+}
+
 eeInteractor::E_terms eeInteractor::CalcPolarEnergy_site(
     const PolarSite& site1, const StaticSite& site2) const {
   eeInteractor::E_terms val;
@@ -259,9 +500,29 @@ template <class T, enum Estatic CE>
 double eeInteractor::ApplyStaticField(const T& segment1,
                                       PolarSegment& segment2) const {
   double e = 0.0;
+  if (!StaticSiteBlock::Packable(segment1)) {
+    for (PolarSite& s2 : segment2) {
+      for (const auto& s1 : segment1) {
+        e += ApplyStaticField_site<CE>(s1, s2);
+      }
+    }
+    return e;
+  }
+  const StaticSiteBlock sources(segment1);
   for (PolarSite& s2 : segment2) {
-    for (const auto& s1 : segment1) {
-      e += ApplyStaticField_site<CE>(s1, s2);
+    if (s2.getRank() > 1) {
+      for (const auto& s1 : segment1) {
+        e += ApplyStaticField_site<CE>(s1, s2);
+      }
+      continue;
+    }
+    const Eigen::Vector4d V_full =
+        StaticField_Block(sources, 0, sources.size(), s2.getPos());
+    e += V_full.dot(s2.Q().head<4>());
+    if (CE == Estatic::noE_V) {
+      s2.V_noE() += V_full.tail<3>();
+    } else {
+      s2.V() += V_full.tail<3>();
     }
   }
   return e;
@@ -297,10 +558,25 @@ template <class S1, class S2>
 double eeInteractor::CalcStaticEnergy(const S1& segment1,
                                       const S2& segment2) const {
   double e = 0;
+  if (!StaticSiteBlock::Packable(segment1)) {
+    for (const auto& s1 : segment2) {
+      for (const auto& s2 : segment1) {
+        e += CalcStaticEnergy_site(s2, s1);
+      }
+    }
+    return e;
+  }
+  const StaticSiteBlock sources(segment1);
   for (const auto& s1 : segment2) {
-    for (const auto& s2 : segment1) {
-      e += CalcStaticEnergy_site(s2, s1);
+    if (s1.getRank() > 1) {
+      for (const auto& s2 : segment1) {
+        e += CalcStaticEnergy_site(s2, s1);
+      }
+      continue;
     }
+    const Eigen::Vector4d V_full =
+        StaticField_Block(sources, 0, sources.size(), s1.getPos());
+    e += V_full.dot(s1.Q().template head<4>());
   }
   return e;
 }
@@ -316,10 +592,19 @@ template double eeInteractor::CalcStaticEnergy(const PolarSegment& seg1,
 template <class S>
 double eeInteractor::CalcStaticEnergy_IntraSegment(const S& seg) const {
   double e = 0;
-  for (Index i = 0; i < seg.size(); i++) {
-    for (Index j = 0; j < i; j++) {
-      e += CalcStaticEnergy_site(seg[i], seg[j]);
+  if (!StaticSiteBlock::Packable(seg)) {
+    for (Index i = 0; i < seg.size(); i++) {
+      for (Index j = 0; j < i; j++) {
+        e += CalcStaticEnergy_site(seg[i], seg[j]);
+      }
     }
+    return e;
+  }
+  const StaticSiteBlock sites(seg);
+  for (Index i = 1; i < seg.size(); i++) {
+    const Eigen::Vector4d V_full =
+        StaticField_Block(sites, 0, i, seg[i].getPos());
+    e += V_full.dot(seg[i].Q().template head<4>());
   }
   return e;
 }
@@ -331,6 +616,10 @@ template double eeInteractor::CalcStaticEnergy_IntraSegment(
 template <class S1, class S2>
 eeInteractor::E_terms eeInteractor::CalcPolarEnergy(const S1& segment1,
                                                     const S2& segment2) const {
+  if (StaticSiteBlock::Packable(segment1) &&
+      StaticSiteBlock::Packable(segment2)) {
+    return CalcPolarEnergy_Block(segment1, segment2);
+  }
   eeInteractor::E_terms e;
   for (const auto& s1 : segment2) {
     for (const auto& s2 : segment1) {
@@ -347,17 +636,32 @@ template eeInteractor::E_terms eeInteractor::CalcPolarEnergy(
 
 double eeInteractor::CalcPolarEnergy_IntraSegment(
     const PolarSegment& seg) const {
-  double e = 0;
-  for (Index i = 0; i < seg.size(); i++) {
-    for (Index j = 0; j < i; j++) {
-      e += seg[i].Induced_Dipole().transpose() *
-           FillTholeInteraction(seg[i], seg[j]) * seg[j].Induced_Dipole();
-    }
+  std::vector<const PolarSite*> sites;
+  for (const PolarSite& site : seg) {
+    sites.push_back(&site);
+  }
+  const PolarSiteBlock block(sites);
+  Index size = seg.size();
+  Eigen::MatrixXd dipoles = Eigen::MatrixXd(size, 3);
+  for (Index i = 0; i < size; i++) {
+    dipoles.row(i) = seg[i].Induced_Dipole().transpose();
+  }
+  return CalcPolarEnergy_IntraSegment(block, dipoles, 0, size);
+}
+
+double eeInteractor::CalcPolarEnergy_IntraSegment(
+    const PolarSiteBlock& sites, const Eigen::MatrixXd& dipoles, Index first,
+    Index n) const {
+  double e = 0.0;
+  const Index end = first + n;
+  for (Index i = first; i < end; i++) {
+    e += TholeField_Block(sites, i, i + 1, end - i - 1, dipoles)
+             .dot(dipoles.row(i).transpose());
   }
   return e;
 }
 
-Eigen::VectorXd eeInteractor::Cholesky_IntraSegment(
+Eigen::MatrixXd eeInteractor::IntraSegmentMatrix(
     const PolarSegment& seg) const {
   Index size = 3 * seg.size();
 
@@ -371,6 +675,13 @@ Eigen::VectorXd eeInteractor::Cholesky_IntraSegment(
   for (Index i = 0; i < seg.size(); i++) {
     A.block<3, 3>(3 * i, 3 * i) = seg[i].getPInv();
   }
+  return A;
+}
+
+Eigen::VectorXd eeInteractor::Cholesky_IntraSegment(
+    const PolarSegment& seg) const {
+  Index size = 3 * seg.size();
+  Eigen::MatrixXd A = IntraSegmentMatrix(seg);
   Eigen::VectorXd b = Eigen::VectorXd(size);
   for (Index i = 0; i < seg.size(); i++) {
     const Eigen::Vector3d V = seg[i].V() + seg[i].V_noE();
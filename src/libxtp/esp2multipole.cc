@@ -73,6 +73,8 @@ void Esp2multipole::Initialize(tools::Property& options) {
   }
 
   gridsize_ = options.get(".gridsize").as<std::string>();
+  esp_method_ = options.get(".esp_method").as<std::string>();
+  esp_accuracy_ = options.get(".esp_accuracy").as<double>();
 
   if (options.exists(".svd")) {
     do_svd_ = true;
@@ -124,6 +126,7 @@ StaticSegment Esp2multipole::Extractingcharges(const Orbitals& orbitals) const {
     if (do_svd_) {
       esp.setUseSVD(conditionnumber_);
     }
+    esp.setESPMethod(esp_method_, esp_accuracy_);
     result = esp.Fit2Density(orbitals, state_, gridsize_);
   }
 
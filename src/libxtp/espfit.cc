@@ -17,11 +17,15 @@
  *
  */
 
+// Standard includes
+#include <stdexcept>
+
 // VOTCA includes
 #include <votca/tools/constants.h>
 
 // Local VOTCA includes
 #include "votca/xtp/aomatrix.h"
+#include "votca/xtp/aopotential.h"
 #include "votca/xtp/density_integration.h"
 #include "votca/xtp/espfit.h"
 #include "votca/xtp/grid.h"
@@ -49,39 +53,31 @@ StaticSegment Espfit::Fit2Density(const Orbitals& orbitals,
   overlap.Fill(basis);
   double N_comp = dmat.cwiseProduct(overlap.Matrix()).sum();
 
-  Vxc_Grid numintgrid;
-  numintgrid.GridSetup(gridsize, orbitals.QMAtoms(), basis);
-  XTP_LOG(Log::info, log_) << TimeStamp() << " Setup " << gridsize
-                           << " Numerical Grid with "
-                           << numintgrid.getGridSize() << " gridpoints."
-                           << flush;
-  DensityIntegration<Vxc_Grid> numway(numintgrid);
-  double N = numway.IntegrateDensity(dmat);
-  XTP_LOG(Log::error, log_)
-      << TimeStamp()
-      << " Calculated Densities at Numerical Grid, Number of electrons is " << N
-      << flush;
-
-  if (std::abs(N - N_comp) > 0.001) {
-    XTP_LOG(Log::error, log_) << "=======================" << flush;
-    XTP_LOG(Log::error, log_)
-        << "WARNING: Calculated Densities at Numerical Grid, Number of "
-           "electrons "
-        << N << " is far away from the the real value " << N_comp
-        << ", you should increase the accuracy of the integration grid."
-        << flush;
-    N = N_comp;
+  double N = N_comp;
+  if (esp_method_ == "analytic") {
     XTP_LOG(Log::error, log_)
-        << "WARNING: Electronnumber set to " << N << flush;
-    XTP_LOG(Log::error, log_) << "=======================" << flush;
-  }
-
-  XTP_LOG(Log::error, log_)
-      << TimeStamp() << " Calculating ESP at CHELPG grid points" << flush;
-#pragma omp parallel for
-  for (Index i = 0; i < grid.size(); i++) {
-    grid.getGridValues()(i) =
-        numway.IntegratePotential(grid.getGridPositions()[i]);
+        << TimeStamp() << " Calculating ESP at CHELPG grid points from "
+        << "potential integrals" << flush;
+    AOMultipole esp;
+    grid.getGridValues() =
+        esp.ElectronicPotential(basis, dmat, grid.getGridPositions());
+  } else if (esp_method_ == "numeric" || esp_method_ == "multipole") {
+    N = EvalNumericalPotential(dmat, basis, orbitals.QMAtoms(), gridsize, grid);
+    if (std::abs(N - N_comp) > 0.001) {
+      XTP_LOG(Log::error, log_) << "=======================" << flush;
+      XTP_LOG(Log::error, log_)
+          << "WARNING: Calculated Densities at Numerical Grid, Number of "
+             "electrons "
+          << N << " is far away from the the real value " << N_comp
+          << ", you should increase the accuracy of the integration grid."
+          << flush;
+      N = N_comp;
+      XTP_LOG(Log::error, log_)
+          << "WARNING: Electronnumber set to " << N << flush;
+      XTP_LOG(Log::error, log_) << "=======================" << flush;
+    }
+  } else {
+    throw std::runtime_error("ESP method " + esp_method_ + " not known");
   }
 
   XTP_LOG(Log::info, log_) << TimeStamp() << " Electron contribution calculated"
@@ -102,6 +98,44 @@ StaticSegment Espfit::Fit2Density(const Orbitals& orbitals,
   ;
 }
 
+double Espfit::EvalNumericalPotential(const Eigen::MatrixXd& dmat,
+                                      const AOBasis& basis,
+                                      const QMMolecule& atoms,
+                                      const std::string& gridsize, Grid& grid) {
+  Vxc_Grid numintgrid;
+  numintgrid.GridSetup(gridsize, atoms, basis);
+  XTP_LOG(Log::info, log_) << TimeStamp() << " Setup " << gridsize
+                           << " Numerical Grid with "
+                           << numintgrid.getGridSize() << " gridpoints."
+                           << flush;
+  DensityIntegration<Vxc_Grid> numway(numintgrid);
+  double N = numway.IntegrateDensity(dmat);
+  XTP_LOG(Log::error, log_)
+      << TimeStamp()
+      << " Calculated Densities at Numerical Grid, Number of electrons is " << N
+      << flush;
+
+  XTP_LOG(Log::error, log_)
+      << TimeStamp() << " Calculating ESP at CHELPG grid points" << flush;
+  const std::vector<Eigen::Vector3d>& gridpoints = grid.getGridPositions();
+  Eigen::VectorXd& gridvalues = grid.getGridValues();
+  if (esp_method_ == "multipole") {
+    constexpr double boxsize = 2;  // 2 bohr
+    numway.SetupMultipoleBoxes(boxsize);
+#pragma omp parallel for schedule(dynamic)
+    for (Index i = 0; i < Index(gridpoints.size()); i++) {
+      gridvalues(i) =
+          numway.IntegratePotential_Multipoles(gridpoints[i], esp_accuracy_);
+    }
+  } else {
+#pragma omp parallel for
+    for (Index i = 0; i < Index(gridpoints.size()); i++) {
+      gridvalues(i) = numway.IntegratePotential(gridpoints[i]);
+    }
+  }
+  return N;
+}
+
 void Espfit::EvalNuclearPotential(const QMMolecule& atoms, Grid& grid) {
 
   const std::vector<Eigen::Vector3d>& gridpoints = grid.getGridPositions();
@@ -110,6 +144,7 @@ void Espfit::EvalNuclearPotential(const QMMolecule& atoms, Grid& grid) {
                            << " Calculating ESP of nuclei at CHELPG grid points"
                            << flush;
 
+#pragma omp parallel for
   for (Index i = 0; i < Index(gridpoints.size()); i++) {
     for (Index j = 0; j < atoms.size(); j++) {
       const Eigen::Vector3d& posatom = atoms[j].getPos();
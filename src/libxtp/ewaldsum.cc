@@ -0,0 +1,463 @@
+/*
+ *            Copyright 2009-2020 The VOTCA Development Team
+ *                       (http://www.votca.org)
+ *
+ *      Licensed under the Apache License, Version 2.0 (the "License")
+ *
+ * You may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *              http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+// Standard includes
+#include <cmath>
+#include <stdexcept>
+
+// VOTCA includes
+#include <votca/tools/constants.h>
+
+// Local VOTCA includes
+#include "votca/xtp/ewaldsum.h"
+
+namespace votca {
+namespace xtp {
+
+namespace {
+// traceless part of the second derivatives in the spherical layout of
+// eeInteractor::VSiteA<9>, the trace does not couple to quadrupoles
+Eigen::Matrix<double, 5, 1> SphericalHessian(const Eigen::Matrix3d& H) {
+  const double sqr3 = std::sqrt(3.0);
+  Eigen::Matrix<double, 5, 1> result;
+  result << (2 * H(2, 2) - H(0, 0) - H(1, 1)) / 6.0, H(0, 2) / sqr3,
+      H(1, 2) / sqr3, (H(0, 0) - H(1, 1)) / (2 * sqr3), H(0, 1) / sqr3;
+  return result;
+}
+}  // namespace
+
+EwaldSum::EwaldSum(const Eigen::Matrix3d& box, double tolerance,
+                   const std::vector<const StaticSite*>& sites,
+                   const std::vector<bool>& is_explicit, Index ntargets)
+    : box_(box) {
+  if (tolerance <= 0.0 || tolerance >= 1.0) {
+    throw std::runtime_error("Ewald tolerance has to be between 0 and 1");
+  }
+  if (sites.size() != is_explicit.size()) {
+    throw std::runtime_error("Ewald sum needs a flag for every site");
+  }
+  inv_box_ = box_.inverse();
+  volume_ = std::abs(box_.determinant());
+
+  std::shared_ptr<Lattice> lattice = std::make_shared<Lattice>();
+  std::vector<Source>& sources = lattice->sources;
+  double charge = 0.0;
+  sources.reserve(sites.size());
+  for (Index i = 0; i < Index(sites.size()); i++) {
+    const StaticSite& site = *sites[i];
+    Source s;
+    s.pos = site.getPos();
+    const Eigen::Vector3d frac = inv_box_ * s.pos;
+    s.origin = frac.array().floor();
+    s.frac = frac - s.origin;
+    s.q = site.getCharge();
+    s.d = Eigen::Vector3d::Zero();
+    s.theta = Eigen::Matrix3d::Zero();
+    if (site.getRank() > 0) {
+      s.d = site.Q().segment<3>(1);
+    }
+    if (site.getRank() > 1) {
+      s.theta = site.CalculateCartesianMultipole();
+    }
+    charge += s.q;
+    sources.push_back(s);
+  }
+
+  // balances the number of real space pairs against the number of k-vectors
+  // times sites, both scale with log(1/tolerance)^(3/2)
+  const double nsources = double(std::max(sources.size(), size_t(1)));
+  const double ntarget = double(std::max(ntargets, Index(1)));
+  const double pi = tools::conv::Pi;
+  alpha_ = std::pow(pi * pi * pi * nsources * ntarget /
+                        ((nsources + ntarget) * volume_ * volume_),
+                    1.0 / 6.0);
+  const double p = std::sqrt(-std::log(tolerance));
+  rcut_ = p / alpha_;
+  if (rcut_ > 0.5 * MinCellHeight()) {
+    rcut_ = 0.5 * MinCellHeight();
+    alpha_ = p / rcut_;
+  }
+  background_ = -pi * charge / (volume_ * alpha_ * alpha_);
+
+  SetupRealSpaceCells(*lattice);
+  SetupKvectors(*lattice, 2.0 * p * alpha_);
+  lattice_ = lattice;
+
+  std::vector<Index> explicit_sites;
+  std::vector<Eigen::Vector3d> explicit_pos;
+  for (Index i = 0; i < Index(sites.size()); i++) {
+    if (is_explicit[i]) {
+      explicit_sites.push_back(i);
+      explicit_pos.push_back(sites[i]->getPos());
+    }
+  }
+  SetExplicitCopies(explicit_sites, explicit_pos);
+}
+
+EwaldSum::EwaldSum(const EwaldSum& sum,
+                   const std::vector<Index>& explicit_sites,
+                   const std::vector<Eigen::Vector3d>& explicit_pos)
+    : box_(sum.box_),
+      inv_box_(sum.inv_box_),
+      volume_(sum.volume_),
+      alpha_(sum.alpha_),
+      rcut_(sum.rcut_),
+      background_(sum.background_),
+      ncells_(sum.ncells_),
+      mmax_(sum.mmax_),
+      lattice_(sum.lattice_) {
+  SetExplicitCopies(explicit_sites, explicit_pos);
+}
+
+void EwaldSum::SetExplicitCopies(
+    const std::vector<Index>& explicit_sites,
+    const std::vector<Eigen::Vector3d>& explicit_pos) {
+  if (explicit_sites.size() != explicit_pos.size()) {
+    throw std::runtime_error("Ewald sum needs a position for every explicit "
+                             "site");
+  }
+  explicit_ = explicit_sites;
+  explicit_image_.clear();
+  explicit_image_.reserve(explicit_.size());
+  explicit_slot_ = std::vector<Index>(lattice_->sources.size(), -1);
+  for (Index slot = 0; slot < Index(explicit_.size()); slot++) {
+    const Index j = explicit_[slot];
+    if (j < 0 || j >= NumberOfSites() || explicit_slot_[j] >= 0) {
+      throw std::runtime_error("Ewald sum got an invalid explicit site " +
+                               std::to_string(j));
+    }
+    const Eigen::Vector3d dr = explicit_pos[slot] - lattice_->sources[j].pos;
+    const Eigen::Vector3d image = (inv_box_ * dr).array().round();
+    if ((dr - box_ * image).norm() > 1e-6 * (1.0 + dr.norm())) {
+      throw std::runtime_error("Explicit site " + std::to_string(j) +
+                               " is not a periodic image of the Ewald source");
+    }
+    explicit_image_.push_back(image);
+    explicit_slot_[j] = slot;
+  }
+}
+
+void EwaldSum::SetupRealSpaceCells(Lattice& lattice) {
+  // cells are at least rcut wide, so all images within the cutoff of a point
+  // are in the neighbouring cells
+  for (Index i = 0; i < 3; i++) {
+    const double height = 1.0 / inv_box_.row(i).norm();
+    ncells_[i] = std::max(Index(1), Index(std::floor(height / rcut_)));
+  }
+  lattice.cells = std::vector<std::vector<Index>>(ncells_[0] * ncells_[1] *
+                                                  ncells_[2]);
+  for (Index j = 0; j < Index(lattice.sources.size()); j++) {
+    lattice.cells[CellIndex(FracToCell(lattice.sources[j].frac))].push_back(j);
+  }
+}
+
+void EwaldSum::SetupKvectors(Lattice& lattice, double kcut) {
+  const Eigen::Matrix3d recip = 2 * tools::conv::Pi * inv_box_.transpose();
+  for (Index i = 0; i < 3; i++) {
+    mmax_[i] = Index(std::floor(kcut * box_.col(i).norm() /
+                                (2 * tools::conv::Pi)));
+  }
+  // only one of k and -k, the sums are real, so their terms are equal
+  for (Index m0 = 0; m0 <= mmax_[0]; m0++) {
+    Index start1 = (m0 == 0) ? 0 : -mmax_[1];
+    for (Index m1 = start1; m1 <= mmax_[1]; m1++) {
+      Index start2 = (m0 == 0 && m1 == 0) ? 1 : -mmax_[2];
+      for (Index m2 = start2; m2 <= mmax_[2]; m2++) {
+        Kvector kv;
+        kv.m = {m0, m1, m2};
+        kv.k = recip * Eigen::Vector3d(double(m0), double(m1), double(m2));
+        const double k2 = kv.k.squaredNorm();
+        if (k2 > kcut * kcut) {
+          continue;
+        }
+        kv.prefactor = 2.0 * 4 * tools::conv::Pi / volume_ *
+                       std::exp(-0.25 * k2 / (alpha_ * alpha_)) / k2;
+        lattice.kvectors.push_back(kv);
+      }
+    }
+  }
+
+#pragma omp parallel for schedule(dynamic)
+  for (Index i = 0; i < Index(lattice.kvectors.size()); i++) {
+    Kvector& kv = lattice.kvectors[i];
+    std::complex<double> S = 0.0;
+    for (const Source& s : lattice.sources) {
+      const double phase = -kv.k.dot(s.pos);
+      const std::complex<double> multipoles(
+          s.q - kv.k.dot(s.theta * kv.k) / 3.0, -s.d.dot(kv.k));
+      S += std::complex<double>(std::cos(phase), std::sin(phase)) * multipoles;
+    }
+    kv.S = S;
+  }
+}
+
+std::array<Index, 3> EwaldSum::FracToCell(const Eigen::Vector3d& frac) const {
+  std::array<Index, 3> cell;
+  for (Index i = 0; i < 3; i++) {
+    cell[i] = std::min(Index(std::floor(frac[i] * double(ncells_[i]))),
+                       ncells_[i] - 1);
+  }
+  return cell;
+}
+
+std::array<Eigen::ArrayXcd, 3> EwaldSum::PhaseTables(
+    const Eigen::Vector3d& frac) const {
+  std::array<Eigen::ArrayXcd, 3> tables;
+  for (Index a = 0; a < 3; a++) {
+    const double phase = -2 * tools::conv::Pi * frac[a];
+    const std::complex<double> step(std::cos(phase), std::sin(phase));
+    Eigen::ArrayXcd& table = tables[a];
+    table.resize(2 * mmax_[a] + 1);
+    table(mmax_[a]) = 1.0;
+    for (Index m = 1; m <= mmax_[a]; m++) {
+      table(mmax_[a] + m) = table(mmax_[a] + m - 1) * step;
+      table(mmax_[a] - m) = std::conj(table(mmax_[a] + m));
+    }
+  }
+  return tables;
+}
+
+std::array<double, 5> EwaldSum::ErfcKernels(double R) const {
+  const double R2 = R * R;
+  const double fac = 2 * alpha_ / std::sqrt(tools::conv::Pi) *
+                     std::exp(-alpha_ * alpha_ * R2);
+  std::array<double, 5> B;
+  B[0] = std::erfc(alpha_ * R) / R;
+  double alphapow = 1.0;
+  for (Index l = 1; l < 5; l++) {
+    B[l] = (double(2 * l - 1) * B[l - 1] + alphapow * fac) / R2;
+    alphapow *= 2 * alpha_ * alpha_;
+  }
+  return B;
+}
+
+std::array<double, 5> EwaldSum::ErfKernels(double R) const {
+  const double x = alpha_ * alpha_ * R * R;
+  const double fac = 2 * alpha_ / std::sqrt(tools::conv::Pi);
+  std::array<double, 5> A;
+  if (x < 0.25) {
+    // Taylor series, the recursion below cancels badly for small R
+    double alphapow = 1.0;
+    for (Index l = 0; l < 5; l++) {
+      double sum = 0.0;
+      double term = 1.0;
+      for (Index m = 0; m < 12; m++) {
+        sum += term / double(2 * m + 2 * l + 1);
+        term *= -x / double(m + 1);
+      }
+      A[l] = fac * alphapow * sum;
+      alphapow *= 2 * alpha_ * alpha_;
+    }
+  } else {
+    const double R2 = R * R;
+    const double expfac = fac * std::exp(-x);
+    A[0] = std::erf(alpha_ * R) / R;
+    double alphapow = 1.0;
+    for (Index l = 1; l < 5; l++) {
+      A[l] = (double(2 * l - 1) * A[l - 1] - alphapow * expfac) / R2;
+      alphapow *= 2 * alpha_ * alpha_;
+    }
+  }
+  return A;
+}
+
+Eigen::Vector4d EwaldSum::MultipoleField(const Source& s,
+                                         const Eigen::Vector3d& R,
+                                         const std::array<double, 5>& B) {
+  // B[l] are the radial kernels (-1/R d/dR)^l f(R), the quadrupole follows
+  // the convention of StaticSite::CalculateCartesianMultipole
+  const double dR = s.d.dot(R);
+  const Eigen::Vector3d thetaR = s.theta * R;
+  const double RthetaR = R.dot(thetaR);
+  Eigen::Vector4d result;
+  result(0) = s.q * B[0] + dR * B[1] + RthetaR * B[2] / 3.0;
+  result.tail<3>() = -(s.q * B[1] + dR * B[2] + RthetaR * B[3] / 3.0) * R +
+                     B[1] * s.d + 2.0 / 3.0 * B[2] * thetaR;
+  return result;
+}
+
+Eigen::Matrix3d EwaldSum::MultipoleHessian(const Source& s,
+                                           const Eigen::Vector3d& R,
+                                           const std::array<double, 5>& B) {
+  // derivative of MultipoleField, using d/dR_a B[l] = -R_a B[l+1]
+  const double dR = s.d.dot(R);
+  const Eigen::Vector3d thetaR = s.theta * R;
+  const double RthetaR = R.dot(thetaR);
+  Eigen::Matrix3d result =
+      (s.q * B[2] + dR * B[3] + RthetaR * B[4] / 3.0) * R * R.transpose();
+  result.diagonal().array() -= s.q * B[1] + dR * B[2] + RthetaR * B[3] / 3.0;
+  const Eigen::Matrix3d mixed =
+      B[2] * s.d * R.transpose() + 2.0 / 3.0 * B[3] * thetaR * R.transpose();
+  result -= mixed + mixed.transpose();
+  result += 2.0 / 3.0 * B[2] * s.theta;
+  return result;
+}
+
+template <class F>
+void EwaldSum::LoopRealSpace(const Eigen::Vector3d& pos, F&& f) const {
+  const Eigen::Vector3d frac_raw = inv_box_ * pos;
+  const Eigen::Vector3d target_origin = frac_raw.array().floor();
+  const Eigen::Vector3d frac = frac_raw - target_origin;
+  const std::array<Index, 3> cell = FracToCell(frac);
+  const double rcut2 = rcut_ * rcut_;
+
+  for (Index o0 = -1; o0 <= 1; o0++) {
+    for (Index o1 = -1; o1 <= 1; o1++) {
+      for (Index o2 = -1; o2 <= 1; o2++) {
+        const std::array<Index, 3> offset = {o0, o1, o2};
+        std::array<Index, 3> neighbour;
+        Eigen::Vector3d image_shift;
+        for (Index i = 0; i < 3; i++) {
+          Index raw = cell[i] + offset[i];
+          Index shift = (raw < 0) ? -1 : ((raw >= ncells_[i]) ? 1 : 0);
+          neighbour[i] = raw - shift * ncells_[i];
+          image_shift[i] = double(shift);
+        }
+        const Eigen::Vector3d shift = image_shift + target_origin;
+        for (Index j : lattice_->cells[CellIndex(neighbour)]) {
+          const Source& s = lattice_->sources[j];
+          const Eigen::Vector3d R = pos - box_ * (s.frac + shift);
+          if (R.squaredNorm() > rcut2) {
+            continue;
+          }
+          const Eigen::Vector3d image = shift - s.origin;
+          f(j, R, image);
+        }
+      }
+    }
+  }
+}
+
+template <int N>
+Eigen::Matrix<double, N, 1> EwaldSum::Field(const Eigen::Vector3d& pos) const {
+  static_assert(N == 4 || N == 9, "the lattice field goes up to quadrupoles");
+  Eigen::Vector4d result = Eigen::Vector4d::Zero();
+  Eigen::Matrix3d hessian = Eigen::Matrix3d::Zero();
+  result(0) = background_;
+
+  LoopRealSpace(pos, [&](Index j, const Eigen::Vector3d& R,
+                         const Eigen::Vector3d& image) {
+    const Index slot = explicit_slot_[j];
+    if (slot >= 0 &&
+        (image - explicit_image_[slot]).cwiseAbs().maxCoeff() < 0.5) {
+      return;
+    }
+    const Source& s = lattice_->sources[j];
+    const std::array<double, 5> B = ErfcKernels(R.norm());
+    result += MultipoleField(s, R, B);
+    if (N > 4) {
+      hessian += MultipoleHessian(s, R, B);
+    }
+  });
+
+  // the reciprocal sum also contains the smooth part of the explicit copies,
+  // including a site's own one
+  for (Index slot = 0; slot < Index(explicit_.size()); slot++) {
+    const Source& s = lattice_->sources[explicit_[slot]];
+    const Eigen::Vector3d R = pos - s.pos - box_ * explicit_image_[slot];
+    const std::array<double, 5> A = ErfKernels(R.norm());
+    result -= MultipoleField(s, R, A);
+    if (N > 4) {
+      hessian -= MultipoleHessian(s, R, A);
+    }
+  }
+
+  for (const Kvector& kv : lattice_->kvectors) {
+    const double phase = kv.k.dot(pos);
+    const std::complex<double> f =
+        std::complex<double>(std::cos(phase), std::sin(phase)) * kv.S;
+    result(0) += kv.prefactor * f.real();
+    result.tail<3>() -= kv.prefactor * f.imag() * kv.k;
+    if (N > 4) {
+      hessian -= kv.prefactor * f.real() * kv.k * kv.k.transpose();
+    }
+  }
+
+  Eigen::Matrix<double, N, 1> field;
+  field.template head<4>() = result;
+  if (N > 4) {
+    field.segment(4, N - 4) = SphericalHessian(hessian);
+  }
+  return field;
+}
+
+template Eigen::Matrix<double, 4, 1> EwaldSum::Field<4>(
+    const Eigen::Vector3d& pos) const;
+template Eigen::Matrix<double, 9, 1> EwaldSum::Field<9>(
+    const Eigen::Vector3d& pos) const;
+
+Eigen::MatrixXd EwaldSum::DipoleField(const Eigen::MatrixXd& dipoles) const {
+  const Index nsites = NumberOfSites();
+  if (dipoles.rows() != nsites || dipoles.cols() != 3) {
+    throw std::runtime_error("Ewald sum needs one dipole per site");
+  }
+  const Index nk = NumberOfKvectors();
+  const std::vector<Source>& sources = lattice_->sources;
+  const std::vector<Kvector>& kvectors = lattice_->kvectors;
+  auto phase = [this](const std::array<Eigen::ArrayXcd, 3>& tables,
+                      const std::array<Index, 3>& m) {
+    return tables[0](m[0] + mmax_[0]) * tables[1](m[1] + mmax_[1]) *
+           tables[2](m[2] + mmax_[2]);
+  };
+
+  // structure factors of the dipoles, they change in every CG iteration
+  Eigen::VectorXd S_re = Eigen::VectorXd::Zero(nk);
+  Eigen::VectorXd S_im = Eigen::VectorXd::Zero(nk);
+#pragma omp parallel for schedule(static) reduction(+ : S_re, S_im)
+  for (Index j = 0; j < nsites; j++) {
+    const std::array<Eigen::ArrayXcd, 3> tables = PhaseTables(sources[j].frac);
+    const Eigen::Vector3d d = dipoles.row(j).transpose();
+    for (Index k = 0; k < nk; k++) {
+      const Kvector& kv = kvectors[k];
+      const std::complex<double> f =
+          phase(tables, kv.m) * std::complex<double>(0.0, -d.dot(kv.k));
+      S_re(k) += f.real();
+      S_im(k) += f.imag();
+    }
+  }
+
+  // the reciprocal sum contains the smooth part of a site's own copy
+  const double self = ErfKernels(0.0)[1];
+  Eigen::MatrixXd result(nsites, 3);
+#pragma omp parallel for schedule(dynamic)
+  for (Index i = 0; i < nsites; i++) {
+    Eigen::Vector3d gradient = -self * dipoles.row(i).transpose();
+    LoopRealSpace(sources[i].pos, [&](Index j, const Eigen::Vector3d& R,
+                                      const Eigen::Vector3d& image) {
+      if (j == i && image.cwiseAbs().maxCoeff() < 0.5) {
+        return;
+      }
+      const std::array<double, 5> B = ErfcKernels(R.norm());
+      const Eigen::Vector3d d = dipoles.row(j).transpose();
+      gradient += B[1] * d - B[2] * d.dot(R) * R;
+    });
+    const std::array<Eigen::ArrayXcd, 3> tables = PhaseTables(sources[i].frac);
+    for (Index k = 0; k < nk; k++) {
+      const Kvector& kv = kvectors[k];
+      const std::complex<double> f = std::conj(phase(tables, kv.m)) *
+                                     std::complex<double>(S_re(k), S_im(k));
+      gradient -= kv.prefactor * f.imag() * kv.k;
+    }
+    result.row(i) = gradient.transpose();
+  }
+  return result;
+}
+
+}  // namespace xtp
+}  // namespace votca
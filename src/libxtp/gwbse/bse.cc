@@ -18,8 +18,13 @@
  */
 
 // Standard includes
+#include <algorithm>
+#include <array>
 #include <chrono>
 #include <iostream>
+#include <map>
+#include <stdexcept>
+#include <vector>
 
 // VOTCA includes
 #include <votca/tools/linalg.h>
@@ -55,7 +60,14 @@ void BSE::configure(const options& opt, const Eigen::VectorXd& RPAInputEnergies,
   } else {
     Hqp_ = AdjustHqpSize(Hqp_in, RPAInputEnergies).diagonal().asDiagonal();
   }
+  // the static screening is always set up in double precision
+  Mmn_.setSinglePrecision(false);
   SetupDirectInteractionOperator(RPAInputEnergies, 0.0);
+  if (opt_.mixed_precision) {
+    Mmn_.setSinglePrecision(true);
+    XTP_LOG(Log::error, log_)
+        << TimeStamp() << " Mmn streamed in single precision" << flush;
+  }
 }
 
 Eigen::MatrixXd BSE::AdjustHqpSize(const Eigen::MatrixXd& Hqp,
@@ -128,39 +140,117 @@ void BSE::configureBSEOperator(BSE_OPERATOR& H) const {
   H.configure(opt);
 }
 
-tools::EigenSystem BSE::Solve_triplets_TDA() const {
+tools::EigenSystem BSE::Solve_triplets_TDA(
+    const Eigen::MatrixXd& guess) const {
 
   TripletOperator_TDA Ht(epsilon_0_inv_, Mmn_, Hqp_);
   configureBSEOperator(Ht);
-  return solve_hermitian(Ht);
+  return solve_hermitian_truncated(Ht, guess);
+}
+
+Eigen::MatrixXd BSE::InitialGuess(const tools::EigenSystem& previous) const {
+  // previous results are only usable if they live in the same product space
+  if (!opt_.davidson_warmstart || previous.eigenvectors().cols() == 0 ||
+      previous.eigenvectors().rows() != bse_size_) {
+    return Eigen::MatrixXd(0, 0);
+  }
+  Index nguess = std::min(previous.eigenvectors().cols(), opt_.nmax);
+  if (opt_.useTDA) {
+    return previous.eigenvectors().leftCols(nguess);
+  }
+  // full BSE vectors are (X,Y), a TDA result is used with Y=0
+  Eigen::MatrixXd guess = Eigen::MatrixXd::Zero(2 * bse_size_, nguess);
+  guess.topRows(bse_size_) = previous.eigenvectors().leftCols(nguess);
+  if (previous.eigenvectors2().rows() == bse_size_ &&
+      previous.eigenvectors2().cols() >= nguess) {
+    guess.bottomRows(bse_size_) = previous.eigenvectors2().leftCols(nguess);
+  }
+  return guess;
 }
 
 void BSE::Solve_singlets(Orbitals& orb) const {
+  Eigen::MatrixXd guess = InitialGuess(orb.BSESinglets());
   orb.setTDAApprox(opt_.useTDA);
   if (opt_.useTDA) {
-    orb.BSESinglets() = Solve_singlets_TDA();
+    orb.BSESinglets() = Solve_singlets_TDA(guess);
   } else {
-    orb.BSESinglets() = Solve_singlets_BTDA();
+    orb.BSESinglets() = Solve_singlets_BTDA(guess);
   }
   orb.CalcCoupledTransition_Dipoles();
 }
 
 void BSE::Solve_triplets(Orbitals& orb) const {
+  Eigen::MatrixXd guess = InitialGuess(orb.BSETriplets());
   orb.setTDAApprox(opt_.useTDA);
   if (opt_.useTDA) {
-    orb.BSETriplets() = Solve_triplets_TDA();
+    orb.BSETriplets() = Solve_triplets_TDA(guess);
   } else {
-    orb.BSETriplets() = Solve_triplets_BTDA();
+    orb.BSETriplets() = Solve_triplets_BTDA(guess);
+  }
+}
+
+void BSE::Solve_singlets_and_triplets(Orbitals& orb) const {
+  // the explicit hamiltonians, truncated product spaces and the full BSE are
+  // solved one by one
+  if (!opt_.useTDA || StoreHamiltonian(1, bse_size_) ||
+      opt_.truncation_window > 0) {
+    Solve_triplets(orb);
+    Solve_singlets(orb);
+    return;
+  }
+  Eigen::MatrixXd guess_singlets = InitialGuess(orb.BSESinglets());
+  Eigen::MatrixXd guess_triplets = InitialGuess(orb.BSETriplets());
+  orb.setTDAApprox(true);
+
+  TripletOperator_TDA Ht(epsilon_0_inv_, Mmn_, Hqp_);
+  configureBSEOperator(Ht);
+  HxOperator Hx(epsilon_0_inv_, Mmn_, Hqp_);
+  configureBSEOperator(Hx);
+  SingletTripletOperator_TDA H(Ht, Hx);
+  XTP_LOG(Log::error, log_)
+      << TimeStamp() << " Setup TDA singlet and triplet hamiltonian " << flush;
+
+  std::chrono::time_point<std::chrono::system_clock> start =
+      std::chrono::system_clock::now();
+
+  DavidsonSolver DS_singlets(log_);
+  configureDavidson(DS_singlets, guess_singlets);
+  DavidsonSolver DS_triplets(log_);
+  configureDavidson(DS_triplets, guess_triplets);
+  DS_singlets.solve_lockstep(H, opt_.nmax, DS_triplets, opt_.nmax);
+
+  tools::EigenSystem singlets;
+  singlets.eigenvalues() = DS_singlets.eigenvalues();
+  singlets.eigenvectors() = DS_singlets.eigenvectors();
+  tools::EigenSystem triplets;
+  triplets.eigenvalues() = DS_triplets.eigenvalues();
+  triplets.eigenvectors() = DS_triplets.eigenvectors();
+  if (Mmn_.isSinglePrecision()) {
+    SingletOperator_TDA Hs(epsilon_0_inv_, Mmn_, Hqp_);
+    configureBSEOperator(Hs);
+    RefineHermitian(Hs, singlets);
+    RefineHermitian(Ht, triplets);
   }
+  orb.BSESinglets() = singlets;
+  orb.BSETriplets() = triplets;
+
+  std::chrono::time_point<std::chrono::system_clock> end =
+      std::chrono::system_clock::now();
+  std::chrono::duration<double> elapsed_time = end - start;
+  XTP_LOG(Log::info, log_) << TimeStamp() << " Diagonalization done in "
+                           << elapsed_time.count() << " secs" << flush;
+
+  orb.CalcCoupledTransition_Dipoles();
 }
 
-tools::EigenSystem BSE::Solve_singlets_TDA() const {
+tools::EigenSystem BSE::Solve_singlets_TDA(
+    const Eigen::MatrixXd& guess) const {
 
   SingletOperator_TDA Hs(epsilon_0_inv_, Mmn_, Hqp_);
   configureBSEOperator(Hs);
   XTP_LOG(Log::error, log_)
       << TimeStamp() << " Setup TDA singlet hamiltonian " << flush;
-  return solve_hermitian(Hs);
+  return solve_hermitian_truncated(Hs, guess);
 }
 
 SingletOperator_TDA BSE::getSingletOperator_TDA() const {
@@ -177,71 +267,397 @@ TripletOperator_TDA BSE::getTripletOperator_TDA() const {
   return Ht;
 }
 
+bool BSE::StoreHamiltonian(Index nblocks, Index size) const {
+  Index memory = nblocks * size * size * Index(sizeof(double));
+  return memory <= opt_.dense_max_memory;
+}
+
+bool BSE::UseDenseSolver(Index size) const {
+  // once a sizeable fraction of all roots is requested a full
+  // diagonalisation is cheaper than Davidson on the stored matrix
+  return 20 * opt_.nmax >= size;
+}
+
 template <typename BSE_OPERATOR>
-tools::EigenSystem BSE::solve_hermitian(BSE_OPERATOR& h) const {
+tools::EigenSystem BSE::solve_hermitian(BSE_OPERATOR& h,
+                                        const Eigen::MatrixXd& guess) const {
 
   std::chrono::time_point<std::chrono::system_clock> start =
       std::chrono::system_clock::now();
 
   tools::EigenSystem result;
+  if (StoreHamiltonian(1, h.rows())) {
+    XTP_LOG(Log::error, log_)
+        << TimeStamp() << " Building BSE hamiltonian explicitly" << flush;
+    Eigen::MatrixXd H = h.get_full_matrix();
+    if (UseDenseSolver(h.rows())) {
+      XTP_LOG(Log::error, log_)
+          << TimeStamp() << " Full diagonalization of BSE hamiltonian" << flush;
+      Eigen::SelfAdjointEigenSolver<Eigen::MatrixXd> es(H);
+      result.eigenvalues() = es.eigenvalues().head(opt_.nmax);
+      result.eigenvectors() = es.eigenvectors().leftCols(opt_.nmax);
+    } else {
+      result = Solve_hermitian_Davidson(H, guess);
+    }
+  } else {
+    result = Solve_hermitian_Davidson(h, guess);
+  }
+  if (Mmn_.isSinglePrecision()) {
+    RefineHermitian(h, result);
+  }
 
-  DavidsonSolver DS(log_);
+  std::chrono::time_point<std::chrono::system_clock> end =
+      std::chrono::system_clock::now();
+  std::chrono::duration<double> elapsed_time = end - start;
 
+  XTP_LOG(Log::info, log_) << TimeStamp() << " Diagonalization done in "
+                           << elapsed_time.count() << " secs" << flush;
+
+  return result;
+}
+
+void BSE::configureDavidson(DavidsonSolver& DS,
+                            const Eigen::MatrixXd& guess) const {
   DS.set_correction(opt_.davidson_correction);
   DS.set_tolerance(opt_.davidson_tolerance);
   DS.set_size_update(opt_.davidson_update);
   DS.set_iter_max(opt_.davidson_maxiter);
   DS.set_max_search_space(10 * opt_.nmax);
-  DS.solve(h, opt_.nmax);
-  result.eigenvalues() = DS.eigenvalues();
-  result.eigenvectors() = DS.eigenvectors();
+  DS.set_initial_guess(guess);
+}
 
-  std::chrono::time_point<std::chrono::system_clock> end =
-      std::chrono::system_clock::now();
-  std::chrono::duration<double> elapsed_time = end - start;
+std::array<Index, 2> BSE::TruncatedWindow() const {
+  const Eigen::VectorXd occ = Hqp_.diagonal().head(bse_vtotal_);
+  const Eigen::VectorXd virt = Hqp_.diagonal().tail(bse_ctotal_);
+  const double e_homo = occ.maxCoeff();
+  const double e_lumo = virt.minCoeff();
+
+  // the nmax-th lowest transition energy estimates the highest root
+  std::vector<double> transitions;
+  transitions.reserve(bse_size_);
+  for (Index v = 0; v < bse_vtotal_; v++) {
+    for (Index c = 0; c < bse_ctotal_; c++) {
+      transitions.push_back(virt(c) - occ(v));
+    }
+  }
+  Index nth = std::min(opt_.nmax, bse_size_) - 1;
+  std::nth_element(transitions.begin(), transitions.begin() + nth,
+                   transitions.end());
+  const double cutoff = transitions[nth] + opt_.truncation_window;
+
+  // levels outside the window are kept if their transition couples
+  // strongly to the HOMO-LUMO transition, i.e. coupling^2/DeltaE is large
+  const Index homo = opt_.homo - opt_.rpamin;
+  const Index lumo = homo + 1;
+  auto strongly_coupled = [&](Index v, Index c, double delta) {
+    double exchange = 2 * Mmn_[v].row(c).dot(Mmn_[homo].row(lumo));
+    double direct = Mmn_[c]
+                        .row(lumo)
+                        .cwiseProduct(epsilon_0_inv_.transpose())
+                        .dot(Mmn_[v].row(homo));
+    double coupling = std::abs(exchange) + std::abs(direct);
+    return delta <= 0 ||
+           coupling * coupling / delta > opt_.truncation_coupling;
+  };
+
+  Index vfirst = 0;
+  for (; vfirst < bse_vtotal_ - 1; vfirst++) {
+    Index v = opt_.vmin + vfirst - opt_.rpamin;
+    Mmn_.Prefetch(v);
+    if (e_lumo - occ(vfirst) <= cutoff ||
+        strongly_coupled(v, lumo, e_homo - occ(vfirst))) {
+      break;
+    }
+  }
+  Index clast = bse_ctotal_ - 1;
+  for (; clast > 0; clast--) {
+    Index c = bse_cmin_ + clast - opt_.rpamin;
+    Mmn_.Prefetch(c);
+    if (virt(clast) - e_homo <= cutoff ||
+        strongly_coupled(homo, c, virt(clast) - e_lumo)) {
+      break;
+    }
+  }
+  return {opt_.vmin + vfirst, bse_cmin_ + clast};
+}
 
-  XTP_LOG(Log::info, log_) << TimeStamp() << " Diagonalization done in "
-                           << elapsed_time.count() << " secs" << flush;
+template <typename BSE_OPERATOR>
+tools::EigenSystem BSE::solve_hermitian_truncated(
+    BSE_OPERATOR& h, const Eigen::MatrixXd& guess) const {
+
+  if (opt_.truncation_window <= 0) {
+    return solve_hermitian(h, guess);
+  }
+  std::array<Index, 2> window = TruncatedWindow();
+  if (window[0] == opt_.vmin && window[1] == opt_.cmax) {
+    XTP_LOG(Log::error, log_)
+        << TimeStamp() << " BSE product space is not truncated" << flush;
+    return solve_hermitian(h, guess);
+  }
+
+  const Index voffset = window[0] - opt_.vmin;
+  const Index vtotal = bse_vtotal_ - voffset;
+  const Index ctotal = window[1] - bse_cmin_ + 1;
+  const Index size = vtotal * ctotal;
+  XTP_LOG(Log::error, log_)
+      << TimeStamp() << " BSE product space truncated to levels "
+      << window[0] << ":" << window[1] << " with " << size << " of "
+      << bse_size_ << " transitions" << flush;
+
+  // Hqp_ holds the occupied levels first, then the virtual ones
+  Eigen::MatrixXd Hqp(vtotal + ctotal, vtotal + ctotal);
+  Hqp.topLeftCorner(vtotal, vtotal) =
+      Hqp_.block(voffset, voffset, vtotal, vtotal);
+  Hqp.topRightCorner(vtotal, ctotal) =
+      Hqp_.block(voffset, bse_vtotal_, vtotal, ctotal);
+  Hqp.bottomLeftCorner(ctotal, vtotal) =
+      Hqp_.block(bse_vtotal_, voffset, ctotal, vtotal);
+  Hqp.bottomRightCorner(ctotal, ctotal) =
+      Hqp_.block(bse_vtotal_, bse_vtotal_, ctotal, ctotal);
+
+  BSE_OPERATOR h_truncated(epsilon_0_inv_, Mmn_, Hqp);
+  BSEOperator_Options opt;
+  opt.cmax = window[1];
+  opt.homo = opt_.homo;
+  opt.qpmin = opt_.qpmin;
+  opt.rpamin = opt_.rpamin;
+  opt.vmin = window[0];
+  h_truncated.configure(opt);
+
+  // index of each kept transition in the full product space
+  vc2index vc = vc2index(0, 0, bse_ctotal_);
+  std::vector<Index> kept;
+  kept.reserve(size);
+  for (Index v = 0; v < vtotal; v++) {
+    for (Index c = 0; c < ctotal; c++) {
+      kept.push_back(vc.I(v + voffset, c));
+    }
+  }
 
+  Eigen::MatrixXd guess_truncated(0, 0);
+  if (guess.rows() == bse_size_) {
+    guess_truncated = Eigen::MatrixXd(size, guess.cols());
+    for (Index i = 0; i < size; i++) {
+      guess_truncated.row(i) = guess.row(kept[i]);
+    }
+  }
+  tools::EigenSystem truncated = solve_hermitian(h_truncated, guess_truncated);
+
+  tools::EigenSystem result;
+  result.eigenvalues() = truncated.eigenvalues();
+  result.eigenvectors() =
+      Eigen::MatrixXd::Zero(bse_size_, truncated.eigenvectors().cols());
+  for (Index i = 0; i < size; i++) {
+    result.eigenvectors().row(kept[i]) = truncated.eigenvectors().row(i);
+  }
+
+  // second order correction from the discarded transitions, which only see
+  // the roots via the residual of one application of the full operator
+  Eigen::MatrixXd residual = h * result.eigenvectors();
+  residual -= result.eigenvectors() * result.eigenvalues().asDiagonal();
+  Eigen::VectorXd diagonal = h.diagonal();
+  std::vector<bool> discarded(bse_size_, true);
+  for (Index i : kept) {
+    discarded[i] = false;
+  }
+  Eigen::VectorXd correction =
+      Eigen::VectorXd::Zero(result.eigenvalues().size());
+  for (Index p = 0; p < bse_size_; p++) {
+    if (!discarded[p]) {
+      continue;
+    }
+    for (Index i = 0; i < correction.size(); i++) {
+      double delta = diagonal(p) - result.eigenvalues()(i);
+      if (delta > 0) {
+        correction(i) -= residual(p, i) * residual(p, i) / delta;
+      }
+    }
+  }
+  result.eigenvalues() += correction;
+  XTP_LOG(Log::error, log_)
+      << TimeStamp() << " Estimated truncation error (max over roots) "
+      << correction.cwiseAbs().maxCoeff() << " Hartree, added to the energies"
+      << flush;
   return result;
 }
 
-tools::EigenSystem BSE::Solve_singlets_BTDA() const {
+template <typename MatrixReplacement>
+tools::EigenSystem BSE::Solve_hermitian_Davidson(
+    MatrixReplacement& h, const Eigen::MatrixXd& guess) const {
+
+  tools::EigenSystem result;
+
+  DavidsonSolver DS(log_);
+  configureDavidson(DS, guess);
+  DS.solve(h, opt_.nmax);
+  result.eigenvalues() = DS.eigenvalues();
+  result.eigenvectors() = DS.eigenvectors();
+  return result;
+}
+
+tools::EigenSystem BSE::Solve_singlets_BTDA(
+    const Eigen::MatrixXd& guess) const {
   SingletOperator_TDA A(epsilon_0_inv_, Mmn_, Hqp_);
   configureBSEOperator(A);
   SingletOperator_BTDA_B B(epsilon_0_inv_, Mmn_, Hqp_);
   configureBSEOperator(B);
   XTP_LOG(Log::error, log_)
       << TimeStamp() << " Setup Full singlet hamiltonian " << flush;
-  return Solve_nonhermitian_Davidson(A, B);
+  return solve_nonhermitian(A, B, guess);
 }
 
-tools::EigenSystem BSE::Solve_triplets_BTDA() const {
+tools::EigenSystem BSE::Solve_triplets_BTDA(
+    const Eigen::MatrixXd& guess) const {
   TripletOperator_TDA A(epsilon_0_inv_, Mmn_, Hqp_);
   configureBSEOperator(A);
   Hd2Operator B(epsilon_0_inv_, Mmn_, Hqp_);
   configureBSEOperator(B);
   XTP_LOG(Log::error, log_)
       << TimeStamp() << " Setup Full triplet hamiltonian " << flush;
-  return Solve_nonhermitian_Davidson(A, B);
+  return solve_nonhermitian(A, B, guess);
 }
 
 template <typename BSE_OPERATOR_A, typename BSE_OPERATOR_B>
-tools::EigenSystem BSE::Solve_nonhermitian_Davidson(BSE_OPERATOR_A& Aop,
-                                                    BSE_OPERATOR_B& Bop) const {
+tools::EigenSystem BSE::solve_nonhermitian(BSE_OPERATOR_A& Aop,
+                                           BSE_OPERATOR_B& Bop,
+                                           const Eigen::MatrixXd& guess) const {
   std::chrono::time_point<std::chrono::system_clock> start =
       std::chrono::system_clock::now();
 
+  tools::EigenSystem result;
+  if (StoreHamiltonian(2, Aop.rows())) {
+    XTP_LOG(Log::error, log_)
+        << TimeStamp() << " Building BSE hamiltonian explicitly" << flush;
+    Eigen::MatrixXd A = Aop.get_full_matrix();
+    Eigen::MatrixXd B = Bop.get_full_matrix();
+    if (UseDenseSolver(Aop.rows())) {
+      XTP_LOG(Log::error, log_)
+          << TimeStamp() << " Full diagonalization of BSE hamiltonian" << flush;
+      result = Solve_nonhermitian_dense(A, B);
+    } else {
+      result = Solve_nonhermitian_Davidson(A, B, guess);
+    }
+  } else {
+    result = Solve_nonhermitian_Davidson(Aop, Bop, guess);
+  }
+  if (Mmn_.isSinglePrecision()) {
+    RefineNonHermitian(Aop, Bop, result);
+  }
+
+  std::chrono::time_point<std::chrono::system_clock> end =
+      std::chrono::system_clock::now();
+  std::chrono::duration<double> elapsed_time = end - start;
+
+  XTP_LOG(Log::info, log_) << TimeStamp() << " Diagonalization done in "
+                           << elapsed_time.count() << " secs" << flush;
+
+  return result;
+}
+
+template <typename BSE_OPERATOR>
+void BSE::RefineHermitian(BSE_OPERATOR& h, tools::EigenSystem& result) const {
+  const Eigen::MatrixXd& X = result.eigenvectors();
+  Mmn_.ReadDoublePrecision(true);
+  Eigen::MatrixXd HX = h * X;
+  Mmn_.ReadDoublePrecision(false);
+  Eigen::MatrixXd projected = X.transpose() * HX;
+  Eigen::SelfAdjointEigenSolver<Eigen::MatrixXd> es(
+      0.5 * (projected + projected.transpose()));
+  XTP_LOG(Log::info, log_)
+      << TimeStamp() << " Refined states in double precision, max change "
+      << (es.eigenvalues() - result.eigenvalues()).cwiseAbs().maxCoeff()
+      << " Hartree" << flush;
+  result.eigenvalues() = es.eigenvalues();
+  result.eigenvectors() = X * es.eigenvectors();
+}
+
+template <typename BSE_OPERATOR_A, typename BSE_OPERATOR_B>
+void BSE::RefineNonHermitian(BSE_OPERATOR_A& Aop, BSE_OPERATOR_B& Bop,
+                             tools::EigenSystem& result) const {
+  // trial vectors (Q a, Q b) keep the structure of the full BSE, so the
+  // projected problem is again a full BSE with Q^T A Q and Q^T B Q
+  Index nstates = result.eigenvectors().cols();
+  Eigen::MatrixXd XY(Aop.rows(), 2 * nstates);
+  XY << result.eigenvectors(), result.eigenvectors2();
+  Eigen::HouseholderQR<Eigen::MatrixXd> qr(XY);
+  Eigen::MatrixXd Q =
+      qr.householderQ() * Eigen::MatrixXd::Identity(XY.rows(), XY.cols());
+
+  Mmn_.ReadDoublePrecision(true);
+  Eigen::MatrixXd AQ = Aop * Q;
+  Eigen::MatrixXd BQ = Bop * Q;
+  Mmn_.ReadDoublePrecision(false);
+  Eigen::MatrixXd A = Q.transpose() * AQ;
+  Eigen::MatrixXd B = Q.transpose() * BQ;
+  tools::EigenSystem projected = Solve_nonhermitian_dense(
+      0.5 * (A + A.transpose()), 0.5 * (B + B.transpose()));
+  XTP_LOG(Log::info, log_)
+      << TimeStamp() << " Refined states in double precision, max change "
+      << (projected.eigenvalues() - result.eigenvalues())
+             .cwiseAbs()
+             .maxCoeff()
+      << " Hartree" << flush;
+  result.eigenvalues() = projected.eigenvalues();
+  result.eigenvectors() = Q * projected.eigenvectors();
+  result.eigenvectors2() = Q * projected.eigenvectors2();
+}
+
+tools::EigenSystem BSE::Solve_nonhermitian_dense(
+    const Eigen::MatrixXd& A, const Eigen::MatrixXd& B) const {
+  /* With A-B positive definite the problem reduces to the symmetric one
+   * (A-B)^1/2 (A+B) (A-B)^1/2 T = Omega^2 T with
+   * X+Y = Omega^-1/2 (A-B)^1/2 T and X-Y = Omega^1/2 (A-B)^-1/2 T,
+   * which already fulfils X^2-Y^2 = 1 */
+  Eigen::SelfAdjointEigenSolver<Eigen::MatrixXd> es_amb(A - B);
+  const double min_amb = es_amb.eigenvalues().minCoeff();
+  if (min_amb <= 0.0) {
+    XTP_LOG(Log::error, log_)
+        << TimeStamp() << " A-B has non-positive eigenvalue: " << min_amb
+        << flush;
+    throw std::runtime_error(
+        "A-B of the full BSE is not positive definite, the ground state is "
+        "unstable. Use the TDA instead.");
+  }
+  Eigen::MatrixXd sqrt_amb = es_amb.operatorSqrt();
+  Eigen::MatrixXd C = sqrt_amb * (A + B) * sqrt_amb;
+  Eigen::SelfAdjointEigenSolver<Eigen::MatrixXd> es(C);
+  // Omega^2 <= 0 means A+B is not positive definite in the requested states
+  const double min_omega2 = es.eigenvalues().head(opt_.nmax).minCoeff();
+  if (min_omega2 <= 0.0) {
+    XTP_LOG(Log::error, log_)
+        << TimeStamp() << " (A-B)^1/2 (A+B) (A-B)^1/2 has non-positive "
+        << "eigenvalue: " << min_omega2 << flush;
+    throw std::runtime_error(
+        "A+B of the full BSE is not positive definite, the ground state is "
+        "unstable. Use the TDA instead.");
+  }
+
+  Eigen::VectorXd omega = es.eigenvalues().head(opt_.nmax).cwiseSqrt();
+  Eigen::MatrixXd T = es.eigenvectors().leftCols(opt_.nmax);
+  Eigen::VectorXd sqrt_omega = omega.cwiseSqrt();
+  Eigen::MatrixXd XpY =
+      sqrt_amb * T * sqrt_omega.cwiseInverse().asDiagonal();
+  Eigen::MatrixXd XmY =
+      es_amb.operatorInverseSqrt() * T * sqrt_omega.asDiagonal();
+
+  tools::EigenSystem result;
+  result.eigenvalues() = omega;
+  result.eigenvectors() = 0.5 * (XpY + XmY);
+  result.eigenvectors2() = 0.5 * (XpY - XmY);
+  return result;
+}
+
+template <typename BSE_OPERATOR_A, typename BSE_OPERATOR_B>
+tools::EigenSystem BSE::Solve_nonhermitian_Davidson(
+    BSE_OPERATOR_A& Aop, BSE_OPERATOR_B& Bop,
+    const Eigen::MatrixXd& guess) const {
+
   // operator
   HamiltonianOperator<BSE_OPERATOR_A, BSE_OPERATOR_B> Hop(Aop, Bop);
 
   // Davidson solver
   DavidsonSolver DS(log_);
-  DS.set_correction(opt_.davidson_correction);
-  DS.set_tolerance(opt_.davidson_tolerance);
-  DS.set_size_update(opt_.davidson_update);
-  DS.set_iter_max(opt_.davidson_maxiter);
-  DS.set_max_search_space(10 * opt_.nmax);
+  configureDavidson(DS, guess);
   DS.set_matrix_type("HAM");
   DS.solve(Hop, opt_.nmax);
 
@@ -259,14 +675,6 @@ tools::EigenSystem BSE::Solve_nonhermitian_Davidson(BSE_OPERATOR_A& Aop,
 
   result.eigenvectors() = tmpX * sqinvnorm.matrix().asDiagonal();
   result.eigenvectors2() = tmpY * sqinvnorm.matrix().asDiagonal();
-
-  std::chrono::time_point<std::chrono::system_clock> end =
-      std::chrono::system_clock::now();
-  std::chrono::duration<double> elapsed_time = end - start;
-
-  XTP_LOG(Log::info, log_) << TimeStamp() << " Diagonalization done in "
-                           << elapsed_time.count() << " secs" << flush;
-
   return result;
 }
 
@@ -516,75 +924,227 @@ BSE::Interaction BSE::Analyze_eh_interaction(const QMStateType& type,
   return analysis;
 }
 
+namespace {
+// packs the upper triangle of a symmetric matrix column by column
+Eigen::VectorXd UpperTriangle(const Eigen::MatrixXd& M) {
+  Eigen::VectorXd packed(M.cols() * (M.cols() + 1) / 2);
+  Index offset = 0;
+  for (Index Q = 0; Q < M.cols(); Q++) {
+    packed.segment(offset, Q + 1) = M.col(Q).head(Q + 1);
+    offset += Q + 1;
+  }
+  return packed;
+}
+}  // namespace
+
+// <state|Hd+Hd2|state> = - sum_PQ epsilon^-1_PQ Z_PQ with
+// Z_PQ = sum X_v1c1 X_v2c2 M_c1c2^P M_v1v2^Q (+ same for Y)
+//        + 2 sum Y_v1c1 X_v2c2 M_c1v2^P M_v1c2^Q
+// Z does not depend on the frequency, so it is built once per state and
+// stored as the upper triangle of Z+Z^T with the diagonal halved
+Eigen::MatrixXd BSE::DirectInteractionDensities(const QMStateType& type,
+                                                const Orbitals& orb) const {
+
+  const tools::EigenSystem& BSECoefs =
+      (type == QMStateType::Singlet) ? orb.BSESinglets() : orb.BSETriplets();
+  const bool tda = orb.getTDAApprox();
+  const Index auxsize = Mmn_.auxsize();
+  const Index vmin = opt_.vmin - opt_.rpamin;
+  const Index cmin = bse_cmin_ - opt_.rpamin;
+
+  // Mvv(v1, v2 + vtotal * P) = M_v1v2^P and Mvc(v1, c2 + ctotal * P) = M_v1c2^P
+  Eigen::MatrixXd Mvv(bse_vtotal_, bse_vtotal_ * auxsize);
+  Eigen::MatrixXd Mvc;
+  if (!tda) {
+    Mvc = Eigen::MatrixXd(bse_vtotal_, bse_ctotal_ * auxsize);
+  }
+  for (Index v = 0; v < bse_vtotal_; v++) {
+    Mmn_.Prefetch(v + vmin);
+    Eigen::MatrixXd vv = Mmn_[v + vmin].middleRows(vmin, bse_vtotal_);
+    Mvv.row(v) =
+        Eigen::Map<const Eigen::VectorXd>(vv.data(), vv.size()).transpose();
+    if (!tda) {
+      Eigen::MatrixXd vc = Mmn_[v + vmin].middleRows(cmin, bse_ctotal_);
+      Mvc.row(v) =
+          Eigen::Map<const Eigen::VectorXd>(vc.data(), vc.size()).transpose();
+    }
+  }
+
+  const Index nstates = BSECoefs.eigenvalues().size();
+  Eigen::MatrixXd densities(auxsize * (auxsize + 1) / 2, nstates);
+#pragma omp parallel for schedule(dynamic)
+  for (Index state = 0; state < nstates; state++) {
+    // X(c,v) as vc2index runs fastest over c, Y is only read without TDA
+    Eigen::Map<const Eigen::MatrixXd> X(
+        BSECoefs.eigenvectors().col(state).data(), bse_ctotal_, bse_vtotal_);
+    Eigen::Map<const Eigen::MatrixXd> Y(
+        tda ? X.data() : BSECoefs.eigenvectors2().col(state).data(),
+        bse_ctotal_, bse_vtotal_);
+    // column c1 holds sum_v1 X_v1c1 M_v1v2^Q as a vtotal x auxsize matrix
+    const Eigen::MatrixXd XMvv = Mvv.transpose() * X.transpose();
+    Eigen::MatrixXd YMvv;
+    Eigen::MatrixXd YMvc;
+    if (!tda) {
+      YMvv = Mvv.transpose() * Y.transpose();
+      YMvc = Mvc.transpose() * Y.transpose();
+    }
+
+    Eigen::MatrixXd Z = Eigen::MatrixXd::Zero(auxsize, auxsize);
+    for (Index c1 = 0; c1 < bse_ctotal_; c1++) {
+      Mmn_.Prefetch(c1 + cmin);
+      const Eigen::MatrixXd Mcc = Mmn_[c1 + cmin].middleRows(cmin, bse_ctotal_);
+      Z.noalias() += (X.transpose() * Mcc).transpose() *
+                     Eigen::Map<const Eigen::MatrixXd>(XMvv.col(c1).data(),
+                                                       bse_vtotal_, auxsize);
+      if (!tda) {
+        Z.noalias() += (Y.transpose() * Mcc).transpose() *
+                       Eigen::Map<const Eigen::MatrixXd>(YMvv.col(c1).data(),
+                                                         bse_vtotal_, auxsize);
+        const Eigen::MatrixXd Mcv =
+            Mmn_[c1 + cmin].middleRows(vmin, bse_vtotal_);
+        Z.noalias() += 2 * (X * Mcv).transpose() *
+                       Eigen::Map<const Eigen::MatrixXd>(YMvc.col(c1).data(),
+                                                         bse_ctotal_, auxsize);
+      }
+    }
+    Eigen::MatrixXd Zsym = Z + Z.transpose();
+    Zsym.diagonal() *= 0.5;
+    densities.col(state) = UpperTriangle(Zsym);
+  }
+  return densities;
+}
+
+// upper triangle of epsilon^-1(frequency) in the current auxbasis
+Eigen::VectorXd BSE::InverseScreening(const RPA& rpa, double frequency,
+                                      Index& nonpositive) const {
+  Eigen::SelfAdjointEigenSolver<Eigen::MatrixXd> es(
+      rpa.calculate_epsilon_r(frequency));
+  Eigen::VectorXd eigenvalues_inv =
+      Eigen::VectorXd::Zero(es.eigenvalues().size());
+  nonpositive = 0;
+  for (Index i = 0; i < es.eigenvalues().size(); ++i) {
+    if (es.eigenvalues()(i) > 1e-8) {
+      eigenvalues_inv(i) = 1 / es.eigenvalues()(i);
+    } else {
+      nonpositive++;
+    }
+  }
+  return UpperTriangle(es.eigenvectors() * eigenvalues_inv.asDiagonal() *
+                       es.eigenvectors().transpose());
+}
+
 // Dynamical Screening in BSE as perturbation to static excitation energies
 // as in Phys. Rev. B 80, 241405 (2009) for the TDA case
+// epsilon^-1 is evaluated on a frequency mesh shared by all excitations and
+// interpolated to the energy of each excitation
 void BSE::Perturbative_DynamicalScreening(const QMStateType& type,
                                           Orbitals& orb) {
 
   const tools::EigenSystem& BSECoefs =
       (type == QMStateType::Singlet) ? orb.BSESinglets() : orb.BSETriplets();
 
-  const Eigen::VectorXd& RPAInputEnergies = orb.RPAInputEnergies();
+  const Eigen::VectorXd& BSEenergies = BSECoefs.eigenvalues();
+  const Index nstates = BSEenergies.size();
 
-  // static case as reference
-  SetupDirectInteractionOperator(RPAInputEnergies, 0.0);
-  HdOperator Hd_static(epsilon_0_inv_, Mmn_, Hqp_);
-  configureBSEOperator(Hd_static);
-  ExpectationValues expectation_values =
-      ExpectationValue_Operator(type, orb, Hd_static);
-  Eigen::VectorXd Hd_static_contribution = expectation_values.direct_term;
-  if (!orb.getTDAApprox()) {
-    Hd2Operator Hd2_static(epsilon_0_inv_, Mmn_, Hqp_);
-    configureBSEOperator(Hd2_static);
-    expectation_values = ExpectationValue_Operator(type, orb, Hd2_static);
-    Hd_static_contribution += expectation_values.cross_term;
+  // Mmn_ stays in the eigenbasis of the static epsilon from configure, only
+  // epsilon^-1 changes with the frequency
+  const Eigen::MatrixXd densities = DirectInteractionDensities(type, orb);
+
+  // static case as reference, epsilon^-1 is diagonal here
+  Eigen::VectorXd Hd_static_contribution = Eigen::VectorXd::Zero(nstates);
+  for (Index P = 0; P < epsilon_0_inv_.size(); P++) {
+    Hd_static_contribution -=
+        epsilon_0_inv_(P) * densities.row(P * (P + 1) / 2 + P).transpose();
   }
 
-  const Eigen::VectorXd& BSEenergies = BSECoefs.eigenvalues();
+  RPA rpa = RPA(log_, Mmn_);
+  rpa.configure(opt_.homo, opt_.rpamin, opt_.rpamax);
+  rpa.setRPAInputEnergies(orb.RPAInputEnergies());
+
+  // Hd for all excitations at mesh point k, i.e. frequency k*dyn_mesh
+  struct MeshPoint {
+    Eigen::VectorXd Hd;
+    Index nonpositive;
+  };
+  std::map<Index, MeshPoint> mesh;
+  auto Hd_mesh = [&](Index k) -> const MeshPoint& {
+    auto point = mesh.find(k);
+    if (point == mesh.end()) {
+      MeshPoint p;
+      Eigen::VectorXd eps_inv =
+          InverseScreening(rpa, double(k) * opt_.dyn_mesh, p.nonpositive);
+      p.Hd = -densities.transpose() * eps_inv;
+      point = mesh.emplace(k, p).first;
+    }
+    return point->second;
+  };
+
+  // cubic Lagrange interpolation on the four mesh points around the
+  // frequency, shifted so that no negative frequencies are used. If
+  // epsilon^-1 has a pole between them, the cubic would run across it and
+  // only the two enclosing points are used. Without a mesh the screening is
+  // evaluated at every frequency.
+  auto Hd_dynamic = [&](Index i_exc, double frequency) {
+    if (opt_.dyn_mesh <= 0.0) {
+      Index nonpositive = 0;
+      return -densities.col(i_exc).dot(
+          InverseScreening(rpa, frequency, nonpositive));
+    }
+    const double x = std::max(frequency, 0.0) / opt_.dyn_mesh;
+    const Index k = Index(std::floor(x));
+    const Index start = std::max(k - 1, Index(0));
+    bool pole = false;
+    for (Index i = start; i < start + 3; i++) {
+      pole = pole || (Hd_mesh(i).nonpositive != Hd_mesh(i + 1).nonpositive);
+    }
+    if (pole) {
+      const double t = x - double(k);
+      return (1 - t) * Hd_mesh(k).Hd(i_exc) + t * Hd_mesh(k + 1).Hd(i_exc);
+    }
+    double result = 0.0;
+    for (Index i = start; i < start + 4; i++) {
+      double weight = 1.0;
+      for (Index j = start; j < start + 4; j++) {
+        if (j != i) {
+          weight *= (x - double(j)) / double(i - j);
+        }
+      }
+      result += weight * Hd_mesh(i).Hd(i_exc);
+    }
+    return result;
+  };
 
   // initial copy of static BSE energies to dynamic
   Eigen::VectorXd BSEenergies_dynamic = BSEenergies;
-
-  // recalculate Hd at the various energies
-  for (Index i_exc = 0; i_exc < BSEenergies.size(); i_exc++) {
+  std::vector<bool> converged(nstates, false);
+  for (Index i_exc = 0; i_exc < nstates; i_exc++) {
     XTP_LOG(Log::info, log_) << "Dynamical Screening BSE, Excitation " << i_exc
                              << " static " << BSEenergies(i_exc) << flush;
+  }
 
-    for (Index iter = 0; iter < max_dyn_iter_; iter++) {
-
-      // setup the direct operator with the last energy as screening frequency
-      double old_energy = BSEenergies_dynamic(i_exc);
-      SetupDirectInteractionOperator(RPAInputEnergies, old_energy);
-      HdOperator Hd_dyn(epsilon_0_inv_, Mmn_, Hqp_);
-      configureBSEOperator(Hd_dyn);
-
-      // get the contribution of Hd for the dynamic case
-      QMState state(type, i_exc, false);
-      expectation_values = ExpectationValue_Operator_State(state, orb, Hd_dyn);
-      Eigen::VectorXd Hd_dynamic_contribution = expectation_values.direct_term;
-      if (!orb.getTDAApprox()) {
-        Hd2Operator Hd2_dyn(epsilon_0_inv_, Mmn_, Hqp_);
-        configureBSEOperator(Hd2_dyn);
-        expectation_values =
-            ExpectationValue_Operator_State(state, orb, Hd2_dyn);
-        Hd_dynamic_contribution += expectation_values.cross_term;
+  for (Index iter = 0; iter < max_dyn_iter_; iter++) {
+    for (Index i_exc = 0; i_exc < nstates; i_exc++) {
+      if (converged[i_exc]) {
+        continue;
       }
-
-      // new energy perturbatively
+      // the last energy is the screening frequency, new energy perturbatively
+      double old_energy = BSEenergies_dynamic(i_exc);
       BSEenergies_dynamic(i_exc) = BSEenergies(i_exc) +
                                    Hd_static_contribution(i_exc) -
-                                   Hd_dynamic_contribution(0);
+                                   Hd_dynamic(i_exc, old_energy);
 
       XTP_LOG(Log::info, log_)
           << "Dynamical Screening BSE, excitation " << i_exc << " iteration "
           << iter << " dynamic " << BSEenergies_dynamic(i_exc) << flush;
 
       // check tolerance
-      if (std::abs(BSEenergies_dynamic(i_exc) - old_energy) < dyn_tolerance_) {
-        break;
-      }
+      converged[i_exc] =
+          std::abs(BSEenergies_dynamic(i_exc) - old_energy) < dyn_tolerance_;
     }
   }
+  XTP_LOG(Log::info, log_)
+      << TimeStamp() << " Dynamical Screening BSE, screening evaluated at "
+      << mesh.size() << " frequencies" << flush;
 
   double hrt2ev = tools::conv::hrt2ev;
 
@@ -624,5 +1184,181 @@ void BSE::Perturbative_DynamicalScreening(const QMStateType& type,
   }
 }
 
+namespace {
+struct LanczosChain {
+  std::vector<double> alpha;  // diagonal of the tridiagonal matrix
+  std::vector<double> beta;   // offdiagonal of the tridiagonal matrix
+  double norm2 = 0.0;         // squared norm of the starting vector
+};
+
+// Lanczos recursion on H*S, which is hermitian in the inner product defined
+// by S, for all columns of start at once, so every step applies H and S to a
+// single block of vectors. A chain that breaks down stops early, its Krylov
+// space is then exhausted.
+template <class ApplyH, class ApplyS>
+std::vector<LanczosChain> LanczosRecursion(ApplyH H, ApplyS S,
+                                           const Eigen::MatrixXd& start,
+                                           Index steps) {
+  const Index nchains = start.cols();
+  std::vector<LanczosChain> chains(nchains);
+  std::vector<bool> active(nchains, true);
+  Eigen::MatrixXd q = start;
+  Eigen::MatrixXd p = S(q);
+  Eigen::MatrixXd q_prev = Eigen::MatrixXd::Zero(q.rows(), nchains);
+  for (Index i = 0; i < nchains; i++) {
+    chains[i].norm2 = q.col(i).dot(p.col(i));
+    if (chains[i].norm2 <= 0.0) {
+      active[i] = false;
+      q.col(i).setZero();
+      p.col(i).setZero();
+      continue;
+    }
+    double norm = std::sqrt(chains[i].norm2);
+    q.col(i) /= norm;
+    p.col(i) /= norm;
+  }
+
+  for (Index step = 0; step < steps; step++) {
+    Eigen::MatrixXd r = H(p);
+    for (Index i = 0; i < nchains; i++) {
+      if (!active[i]) {
+        r.col(i).setZero();
+        continue;
+      }
+      double alpha = p.col(i).dot(r.col(i));
+      r.col(i) -= alpha * q.col(i);
+      if (!chains[i].beta.empty()) {
+        r.col(i) -= chains[i].beta.back() * q_prev.col(i);
+      }
+      chains[i].alpha.push_back(alpha);
+    }
+    if (step == steps - 1 ||
+        std::none_of(active.begin(), active.end(), [](bool a) { return a; })) {
+      break;
+    }
+    Eigen::MatrixXd s = S(r);
+    for (Index i = 0; i < nchains; i++) {
+      if (!active[i]) {
+        continue;
+      }
+      double beta2 = r.col(i).dot(s.col(i));
+      if (beta2 <= 1e-16 * chains[i].alpha.back() * chains[i].alpha.back()) {
+        active[i] = false;
+        q.col(i).setZero();
+        p.col(i).setZero();
+        continue;
+      }
+      double beta = std::sqrt(beta2);
+      q_prev.col(i) = q.col(i);
+      q.col(i) = r.col(i) / beta;
+      p.col(i) = s.col(i) / beta;
+      chains[i].beta.push_back(beta);
+    }
+  }
+  return chains;
+}
+}  // namespace
+
+Eigen::MatrixXd BSE::AbsorptionSpectrum(const Orbitals& orb,
+                                        const Eigen::VectorXd& frequencies,
+                                        double fwhm) const {
+  if (fwhm <= 0.0) {
+    throw std::runtime_error(
+        "BSE: The broadening of the absorption spectrum has to be positive");
+  }
+  std::array<Eigen::MatrixXd, 3> interlevel_dipoles =
+      orb.CalcFreeTransition_Dipoles();
+  if (interlevel_dipoles[0].rows() != bse_ctotal_ ||
+      interlevel_dipoles[0].cols() != bse_vtotal_) {
+    throw std::runtime_error(
+        "BSE: Transition dipoles of orbitals do not match the BSE levels");
+  }
+  // ctotal x vtotal in column major order is the vc index of the BSE
+  Eigen::MatrixXd dipoles(bse_size_, 3);
+  for (Index i = 0; i < 3; i++) {
+    dipoles.col(i) = Eigen::Map<const Eigen::VectorXd>(
+        interlevel_dipoles[i].data(), bse_size_);
+  }
+
+  std::chrono::time_point<std::chrono::system_clock> start =
+      std::chrono::system_clock::now();
+
+  SingletOperator_TDA A(epsilon_0_inv_, Mmn_, Hqp_);
+  configureBSEOperator(A);
+  std::vector<LanczosChain> chains;
+  if (opt_.useTDA) {
+    XTP_LOG(Log::error, log_)
+        << TimeStamp() << " Lanczos recursion on TDA singlet hamiltonian "
+        << flush;
+    chains = LanczosRecursion(
+        [&](const Eigen::MatrixXd& v) { return Eigen::MatrixXd(A * v); },
+        [](const Eigen::MatrixXd& v) { return v; }, dipoles,
+        opt_.haydock_steps);
+  } else {
+    // the squared excitation energies are the eigenvalues of (A+B)(A-B),
+    // which is hermitian in the (A-B) inner product
+    SingletOperator_BTDA_B B(epsilon_0_inv_, Mmn_, Hqp_);
+    configureBSEOperator(B);
+    XTP_LOG(Log::error, log_)
+        << TimeStamp() << " Lanczos recursion on full singlet hamiltonian "
+        << flush;
+    auto apply = [&](const Eigen::MatrixXd& v, double sign) {
+      Eigen::MatrixXd Av = A * v;
+      Eigen::MatrixXd Bv = B * v;
+      return Eigen::MatrixXd(Av + sign * Bv);
+    };
+    chains = LanczosRecursion(
+        [&](const Eigen::MatrixXd& v) { return apply(v, 1.0); },
+        [&](const Eigen::MatrixXd& v) { return apply(v, -1.0); }, dipoles,
+        opt_.haydock_steps);
+  }
+
+  // The tridiagonal matrix of each chain resolves the continued fraction
+  // into poles and weights. In TDA the weights are |d.X|^2, for the full BSE
+  // Omega*|d.(X+Y)|^2, the oscillator strength is 4/3*Omega*|d.(X+Y)|^2
+  const double norm = 0.5 * fwhm / tools::conv::Pi;
+  Eigen::MatrixXd spectrum = Eigen::MatrixXd::Zero(frequencies.size(), 2);
+  Index length = 0;
+  for (const LanczosChain& chain : chains) {
+    if (chain.alpha.empty()) {
+      continue;
+    }
+    length = std::max(length, Index(chain.alpha.size()));
+    Eigen::SelfAdjointEigenSolver<Eigen::MatrixXd> es;
+    es.computeFromTridiagonal(
+        Eigen::Map<const Eigen::VectorXd>(chain.alpha.data(),
+                                          chain.alpha.size()),
+        Eigen::Map<const Eigen::VectorXd>(chain.beta.data(),
+                                          chain.beta.size()),
+        Eigen::ComputeEigenvectors);
+    Eigen::VectorXd weights =
+        chain.norm2 * es.eigenvectors().row(0).transpose().cwiseAbs2();
+    for (Index j = 0; j < weights.size(); j++) {
+      double pole = es.eigenvalues()(j);
+      if (!opt_.useTDA) {
+        if (pole <= 0.0) {
+          continue;
+        }
+        pole = std::sqrt(pole);
+      }
+      double osc = 4.0 / 3.0 * weights(j);
+      if (opt_.useTDA) {
+        osc *= pole;
+      }
+      Eigen::ArrayXd lorentzian =
+          norm / ((frequencies.array() - pole).square() + 0.25 * fwhm * fwhm);
+      spectrum.col(0) += (osc * lorentzian).matrix();
+      spectrum.col(1) += (osc * pole * lorentzian).matrix();
+    }
+  }
+
+  std::chrono::duration<double> elapsed_time =
+      std::chrono::system_clock::now() - start;
+  XTP_LOG(Log::info, log_) << TimeStamp() << " Absorption spectrum from "
+                           << length << " Lanczos steps done in "
+                           << elapsed_time.count() << " secs" << flush;
+  return spectrum;
+}
+
 }  // namespace xtp
 }  // namespace votca
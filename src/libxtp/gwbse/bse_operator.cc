@@ -63,15 +63,17 @@ Eigen::MatrixXd BSE_OPERATOR<cqp, cx, cd, cd2>::matmul(
     Index threadid = OPENMP::getThreadId();
 #pragma omp for schedule(dynamic)
     for (Index c1 = 0; c1 < bse_ctotal_; c1++) {
-
+      Mmn_.Prefetch(c1 + cmin);
       // Temp matrix has to stay in this scope, because it has transform only
       // holds a reference to it
       Eigen::MatrixXd Temp;
+      // conversion buffer for single precision Mmn
+      Eigen::MatrixXd buffer;
       if (cd != 0) {
-        Temp = -cd * (Mmn_[c1 + cmin].middleRows(cmin, bse_ctotal_));
+        Temp = -cd * Mmn_.Rows(c1 + cmin, cmin, bse_ctotal_, buffer);
         transform.PrepareMatrix1(Temp, threadid);
       } else if (cd2 != 0) {
-        Temp = -cd2 * (Mmn_[c1 + cmin].middleRows(vmin, bse_vtotal_));
+        Temp = -cd2 * Mmn_.Rows(c1 + cmin, vmin, bse_vtotal_, buffer);
         transform.PrepareMatrix1(Temp, threadid);
       }
 
@@ -79,12 +81,12 @@ Eigen::MatrixXd BSE_OPERATOR<cqp, cx, cd, cd2>::matmul(
         transform.SetTempZero(threadid);
         if (cd != 0) {
           transform.PrepareMatrix2(
-              Mmn_[v1 + vmin].middleRows(vmin, bse_vtotal_), cd2 != 0,
+              Mmn_.Rows(v1 + vmin, vmin, bse_vtotal_, buffer), cd2 != 0,
               threadid);
         }
         if (cd2 != 0) {
           transform.PrepareMatrix2(
-              Mmn_[v1 + vmin].middleRows(cmin, bse_ctotal_), cd2 != 0,
+              Mmn_.Rows(v1 + vmin, cmin, bse_ctotal_, buffer), cd2 != 0,
               threadid);
         }
         if (cqp != 0) {
@@ -104,12 +106,14 @@ Eigen::MatrixXd BSE_OPERATOR<cqp, cx, cd, cd2>::matmul(
 #pragma omp for schedule(dynamic)
       for (Index v1 = 0; v1 < bse_vtotal_; v1++) {
         Index va = v1 + vmin;
-        Eigen::MatrixXd Mmn1 = cx * Mmn_[va].middleRows(cmin, bse_ctotal_);
+        Mmn_.Prefetch(va);
+        Eigen::MatrixXd buffer;
+        Eigen::MatrixXd Mmn1 = cx * Mmn_.Rows(va, cmin, bse_ctotal_, buffer);
         transform.PushMatrix1(Mmn1, threadid);
         for (Index v2 = v1; v2 < bse_vtotal_; v2++) {
           Index vb = v2 + vmin;
-          transform.MultiplyBlocks(Mmn_[vb].middleRows(cmin, bse_ctotal_), v1,
-                                   v2, threadid);
+          transform.MultiplyBlocks(Mmn_.Rows(vb, cmin, bse_ctotal_, buffer),
+                                   v1, v2, threadid);
         }
       }
     }
@@ -174,6 +178,123 @@ Eigen::VectorXd BSE_OPERATOR<cqp, cx, cd, cd2>::diagonal() const {
   return result;
 }
 
+template <Index cqp, Index cx, Index cd, Index cd2>
+Eigen::MatrixXd BSE_OPERATOR<cqp, cx, cd, cd2>::get_full_matrix() const {
+
+  static_assert(!(cd2 != 0 && cd != 0),
+                "Hamiltonian cannot contain Hd and Hd2 at the same time");
+
+  Index auxsize = Mmn_.auxsize();
+  vc2index vc = vc2index(0, 0, bse_ctotal_);
+  Index vmin = opt_.vmin - opt_.rpamin;
+  Index cmin = bse_cmin_ - opt_.rpamin;
+
+  Eigen::MatrixXd H = Eigen::MatrixXd::Zero(bse_size_, bse_size_);
+
+  if (cqp != 0) {
+    Index cmin_qp = bse_vtotal_;
+    for (Index v1 = 0; v1 < bse_vtotal_; v1++) {
+      for (Index c1 = 0; c1 < bse_ctotal_; c1++) {
+        Index row = vc.I(v1, c1);
+        for (Index v2 = 0; v2 < bse_vtotal_; v2++) {
+          H(row, vc.I(v2, c1)) -= cqp * Hqp_(v2, v1);
+        }
+        for (Index c2 = 0; c2 < bse_ctotal_; c2++) {
+          H(row, vc.I(v1, c2)) += cqp * Hqp_(c2 + cmin_qp, c1 + cmin_qp);
+        }
+      }
+    }
+  }
+
+  // row I(v,c) holds Mmn_v,c, used for Hx and Hd2
+  Eigen::MatrixXd Mvc;
+  if (cx != 0 || cd2 != 0) {
+    Mvc = Eigen::MatrixXd(bse_size_, auxsize);
+    Eigen::MatrixXd buffer;
+    for (Index v = 0; v < bse_vtotal_; v++) {
+      Mmn_.Prefetch(v + vmin);
+      Mvc.middleRows(vc.I(v, 0), bse_ctotal_) =
+          Mmn_.Rows(v + vmin, cmin, bse_ctotal_, buffer);
+    }
+  }
+
+  if (cx != 0) {
+    H.noalias() += double(cx) * Mvc * Mvc.transpose();
+  }
+
+  if (cd != 0) {
+    // row v1*vtotal+v2 holds Mmn_v1,v2 * epsilon^-1
+    Eigen::MatrixXd Mvv(bse_vtotal_ * bse_vtotal_, auxsize);
+    Eigen::MatrixXd buffer;
+    for (Index v = 0; v < bse_vtotal_; v++) {
+      Mmn_.Prefetch(v + vmin);
+      Mvv.middleRows(v * bse_vtotal_, bse_vtotal_) =
+          Mmn_.Rows(v + vmin, vmin, bse_vtotal_, buffer) *
+          epsilon_0_inv_.asDiagonal();
+    }
+#pragma omp parallel for schedule(dynamic)
+    for (Index c1 = 0; c1 < bse_ctotal_; c1++) {
+      Mmn_.Prefetch(c1 + cmin);
+      Eigen::MatrixXd Mcc;
+      // W(c2, v1*vtotal+v2) = <c1 v1|W|c2 v2>
+      Eigen::MatrixXd W =
+          Mmn_.Rows(c1 + cmin, cmin, bse_ctotal_, Mcc) * Mvv.transpose();
+      for (Index v1 = 0; v1 < bse_vtotal_; v1++) {
+        Index row = vc.I(v1, c1);
+        for (Index v2 = 0; v2 < bse_vtotal_; v2++) {
+          for (Index c2 = 0; c2 < bse_ctotal_; c2++) {
+            H(row, vc.I(v2, c2)) -= cd * W(c2, v1 * bse_vtotal_ + v2);
+          }
+        }
+      }
+    }
+  }
+
+  if (cd2 != 0) {
+#pragma omp parallel for schedule(dynamic)
+    for (Index c1 = 0; c1 < bse_ctotal_; c1++) {
+      Mmn_.Prefetch(c1 + cmin);
+      Eigen::MatrixXd Mcv;
+      // W(v2, I(v1,c2)) = <c1 v2|W|v1 c2>
+      Eigen::MatrixXd W = Mmn_.Rows(c1 + cmin, vmin, bse_vtotal_, Mcv) *
+                          epsilon_0_inv_.asDiagonal() * Mvc.transpose();
+      for (Index v1 = 0; v1 < bse_vtotal_; v1++) {
+        Index row = vc.I(v1, c1);
+        for (Index v2 = 0; v2 < bse_vtotal_; v2++) {
+          for (Index c2 = 0; c2 < bse_ctotal_; c2++) {
+            H(row, vc.I(v2, c2)) -= cd2 * W(v2, vc.I(v1, c2));
+          }
+        }
+      }
+    }
+  }
+  return H;
+}
+
+std::pair<Eigen::MatrixXd, Eigen::MatrixXd>
+    SingletTripletOperator_TDA::matmul(const Eigen::MatrixXd& singlets,
+                                       const Eigen::MatrixXd& triplets) const {
+  Index nsinglets = singlets.cols();
+  Index ntriplets = triplets.cols();
+  std::pair<Eigen::MatrixXd, Eigen::MatrixXd> result;
+  if (nsinglets + ntriplets == 0) {
+    result.first = Eigen::MatrixXd::Zero(rows(), 0);
+    result.second = Eigen::MatrixXd::Zero(rows(), 0);
+    return result;
+  }
+  Eigen::MatrixXd input(rows(), nsinglets + ntriplets);
+  input.leftCols(nsinglets) = singlets;
+  input.rightCols(ntriplets) = triplets;
+  Eigen::MatrixXd Ht_input = Ht_.matmul(input);
+
+  result.first = Ht_input.leftCols(nsinglets);
+  if (nsinglets > 0) {
+    result.first += 2 * Hx_.matmul(singlets);
+  }
+  result.second = Ht_input.rightCols(ntriplets);
+  return result;
+}
+
 template class BSE_OPERATOR<1, 2, 1, 0>;
 template class BSE_OPERATOR<1, 0, 1, 0>;
 
@@ -0,0 +1,119 @@
+/*
+ *            Copyright 2009-2020 The VOTCA Development Team
+ *                       (http://www.votca.org)
+ *
+ *      Licensed under the Apache License, Version 2.0 (the "License")
+ *
+ * You may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *              http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+// Standard includes
+#include <vector>
+
+// Local VOTCA includes
+#include "votca/xtp/frozen_natural_orbitals.h"
+#include "votca/xtp/threecenter.h"
+
+namespace votca {
+namespace xtp {
+
+namespace {
+// MP2 amplitudes t_ij^ab = (ia|jb)/(e_i+e_j-e_a-e_b) of one pair of occupied
+// levels, with K(a,b) = (ia|jb)
+Eigen::MatrixXd Amplitudes(const Eigen::MatrixXd& K, double e_ij,
+                           const Eigen::VectorXd& virt_energies) {
+  Index nvirt = virt_energies.size();
+  Eigen::ArrayXXd delta = Eigen::ArrayXXd::Constant(nvirt, nvirt, e_ij);
+  delta.colwise() -= virt_energies.array();
+  delta.rowwise() -= virt_energies.array().transpose();
+  return (K.array() / delta).matrix();
+}
+
+// closed shell MP2 energy of the pairs ij and ji
+double PairEnergy(const Eigen::MatrixXd& t, const Eigen::MatrixXd& K,
+                  bool diagonal) {
+  double factor = diagonal ? 1.0 : 2.0;
+  return factor * (t.array() * (2 * K - K.transpose()).array()).sum();
+}
+}  // namespace
+
+void FrozenNaturalOrbitals::Compute(const TCMatrix_gwbse& Mmn,
+                                    const Eigen::VectorXd& occ_energies,
+                                    const Eigen::VectorXd& virt_energies,
+                                    Index nfixed, double threshold) {
+  const Index nocc = occ_energies.size();
+  const Index nvirt = virt_energies.size();
+  const Index ntrunc = nvirt - nfixed;
+
+  // D_ab = 2 sum_ijc t_ij^ac (2 t_ij^bc - t_ij^cb) for the truncated block,
+  // the pair ji is added together with ij via t_ji = t_ij^T
+  Eigen::MatrixXd density = Eigen::MatrixXd::Zero(ntrunc, ntrunc);
+  double mp2_energy = 0.0;
+#pragma omp parallel for schedule(dynamic) reduction(+ : density, mp2_energy)
+  for (Index i = 0; i < nocc; i++) {
+    for (Index j = i; j < nocc; j++) {
+      Eigen::MatrixXd K = Mmn[i] * Mmn[j].transpose();
+      Eigen::MatrixXd t =
+          Amplitudes(K, occ_energies(i) + occ_energies(j), virt_energies);
+      mp2_energy += PairEnergy(t, K, i == j);
+      auto t_rows = t.bottomRows(ntrunc);
+      auto t_cols = t.rightCols(ntrunc);
+      Eigen::MatrixXd exchange = t_rows * t_cols;
+      density += 2 * (2 * t_rows * t_rows.transpose() - exchange);
+      if (i != j) {
+        density += 2 * (2 * t_cols.transpose() * t_cols - exchange.transpose());
+      }
+    }
+  }
+  mp2_energy_ = mp2_energy;
+
+  Eigen::SelfAdjointEigenSolver<Eigen::MatrixXd> es(density);
+  occupations_ = es.eigenvalues().reverse();
+  Index nkeep = (occupations_.array() > threshold).count();
+  Eigen::MatrixXd natural =
+      es.eigenvectors().rightCols(nkeep).rowwise().reverse();
+
+  // semicanonicalisation, the DFT Hamiltonian is diagonal in the virtuals
+  Eigen::MatrixXd hamiltonian = natural.transpose() *
+                                virt_energies.tail(ntrunc).asDiagonal() *
+                                natural;
+  Eigen::SelfAdjointEigenSolver<Eigen::MatrixXd> es_h(hamiltonian);
+  transformation_ = natural * es_h.eigenvectors();
+  energies_ = es_h.eigenvalues();
+
+  // MP2 energy in the truncated space
+  Eigen::VectorXd kept_energies(nfixed + nkeep);
+  kept_energies << virt_energies.head(nfixed), energies_;
+  std::vector<Eigen::MatrixXd> Bia(nocc);
+#pragma omp parallel for
+  for (Index i = 0; i < nocc; i++) {
+    Bia[i] = Eigen::MatrixXd(nfixed + nkeep, Mmn.auxsize());
+    Bia[i].topRows(nfixed) = Mmn[i].topRows(nfixed);
+    Bia[i].bottomRows(nkeep) =
+        transformation_.transpose() * Mmn[i].bottomRows(ntrunc);
+  }
+  double mp2_truncated = 0.0;
+#pragma omp parallel for schedule(dynamic) reduction(+ : mp2_truncated)
+  for (Index i = 0; i < nocc; i++) {
+    for (Index j = i; j < nocc; j++) {
+      Eigen::MatrixXd K = Bia[i] * Bia[j].transpose();
+      Eigen::MatrixXd t =
+          Amplitudes(K, occ_energies(i) + occ_energies(j), kept_energies);
+      mp2_truncated += PairEnergy(t, K, i == j);
+    }
+  }
+  energy_correction_ = mp2_energy_ - mp2_truncated;
+}
+
+}  // namespace xtp
+}  // namespace votca
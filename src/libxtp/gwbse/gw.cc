@@ -314,15 +314,25 @@ boost::optional<double> GW::SolveQP_Grid(double intercept0, double frequency0,
   const double range =
       opt_.qp_grid_spacing * double(opt_.qp_grid_steps - 1) / 2.0;
   boost::optional<double> newf = boost::none;
-  double freq_prev = frequency0 - range;
   QPFunc fqp(gw_level, *sigma_.get(), intercept0);
-  double targ_prev = fqp.value(freq_prev);
+  // evaluate sigma_c on the whole grid at once, only the bisection steps
+  // around a sign change are evaluated pointwise
+  const Eigen::VectorXd freqs =
+      frequency0 - range +
+      Eigen::ArrayXd::LinSpaced(opt_.qp_grid_steps, 0.0,
+                                double(opt_.qp_grid_steps - 1)) *
+          opt_.qp_grid_spacing;
+  const Eigen::VectorXd targs =
+      sigma_->CalcCorrelationDiagElementOnGrid(gw_level, freqs).array() +
+      intercept0 - freqs.array();
   double qp_energy = 0.0;
   double gradient_max = std::numeric_limits<double>::max();
   bool pole_found = false;
   for (Index i_node = 1; i_node < opt_.qp_grid_steps; ++i_node) {
-    double freq = freq_prev + opt_.qp_grid_spacing;
-    double targ = fqp.value(freq);
+    double freq_prev = freqs(i_node - 1);
+    double targ_prev = targs(i_node - 1);
+    double freq = freqs(i_node);
+    double targ = targs(i_node);
     if (targ_prev * targ < 0.0) {  // Sign change
       double f = SolveQP_Bisection(freq_prev, targ_prev, freq, targ, fqp);
       double gradient = fqp.deriv(f);
@@ -334,8 +344,6 @@ boost::optional<double> GW::SolveQP_Grid(double intercept0, double frequency0,
         pole_found = true;
       }
     }
-    freq_prev = freq;
-    targ_prev = targ;
   }
   if (Log::current_level > Log::error) {
 #pragma omp critical
@@ -450,17 +458,18 @@ void GW::PlotSigma(std::string filename, Index steps, double spacing,
       dft_energies_.segment(opt_.qpmin, qptotal_) + Sigma_x_.diagonal() -
       vxc_.diagonal();
   Eigen::MatrixXd mat = Eigen::MatrixXd::Zero(steps, 2 * num_states);
+  const Eigen::ArrayXd offsets =
+      (Eigen::ArrayXd::LinSpaced(steps, 0.0, double(steps - 1)) -
+       (double)(steps - 1) / 2.0) *
+      spacing;
 #pragma omp parallel for schedule(dynamic)
-  for (Index grid_point = 0; grid_point < steps; grid_point++) {
-    const double offset =
-        ((double)grid_point - ((double)(steps - 1) / 2.0)) * spacing;
-    for (Index i = 0; i < num_states; i++) {
-      const Index gw_level = state_inds[i];
-      const double omega = frequencies(gw_level) + offset;
-      double sigma = sigma_->CalcCorrelationDiagElement(gw_level, omega);
-      mat(grid_point, 2 * i) = omega;
-      mat(grid_point, 2 * i + 1) = sigma + intercept[gw_level];
-    }
+  for (Index i = 0; i < num_states; i++) {
+    const Index gw_level = state_inds[i];
+    const Eigen::VectorXd omegas = frequencies(gw_level) + offsets;
+    mat.col(2 * i) = omegas;
+    mat.col(2 * i + 1) =
+        sigma_->CalcCorrelationDiagElementOnGrid(gw_level, omegas).array() +
+        intercept[gw_level];
   }
 
   std::ofstream out;
@@ -19,6 +19,9 @@
  *
  */
 
+// Standard includes
+#include <fstream>
+
 // Third party includes
 #include <boost/algorithm/string.hpp>
 #include <boost/filesystem.hpp>
@@ -32,6 +35,7 @@
 #include "votca/xtp/basisset.h"
 #include "votca/xtp/bse.h"
 #include "votca/xtp/ecpbasisset.h"
+#include "votca/xtp/frozen_natural_orbitals.h"
 #include "votca/xtp/gwbse.h"
 #include "votca/xtp/logger.h"
 #include "votca/xtp/openmp_cuda.h"
@@ -176,8 +180,6 @@ void GWBSE::Initialize(tools::Property& options) {
   bseopt_.rpamin = rpamin;
   bseopt_.rpamax = rpamax;
 
-  orbitals_.setRPAindices(rpamin, rpamax);
-  orbitals_.setGWindices(qpmin, qpmax);
   orbitals_.setBSEindices(bse_vmin, bse_cmax);
   orbitals_.SetFlagUseHqpOffdiag(bseopt_.use_Hqp_offdiag);
 
@@ -196,6 +198,10 @@ void GWBSE::Initialize(tools::Property& options) {
       << "]  virt[" << bse_cmin << ":" << bse_cmax << "]" << flush;
 
   gwopt_.reset_3c = options.get(".gw.rebuild_3c_freq").as<Index>();
+  keep_ao3c_ = options.get(".gw.keep_ao3c").as<bool>();
+  mmn_max_memory_ = Index(options.get(".mmn_max_memory").as<double>() * 1e9);
+  scratch_dir_ = options.get(".scratch_dir").as<std::string>();
+  fno_threshold_ = options.get(".fno_threshold").as<double>();
 
   bseopt_.nmax = options.get(".bse.exctotal").as<Index>();
   if (bseopt_.nmax > bse_size || bseopt_.nmax < 0) {
@@ -213,6 +219,19 @@ void GWBSE::Initialize(tools::Property& options) {
 
   bseopt_.davidson_maxiter = options.get("bse.davidson.maxiter").as<Index>();
 
+  bseopt_.davidson_warmstart =
+      options.get("bse.davidson.warmstart").as<bool>();
+
+  bseopt_.dense_max_memory =
+      Index(options.get("bse.dense_max_memory").as<double>() * 1e9);
+
+  bseopt_.mixed_precision = options.get("bse.mixed_precision").as<bool>();
+  if (bseopt_.mixed_precision) {
+    XTP_LOG(Log::error, *pLog_)
+        << " BSE with single precision Mmn and double precision refinement"
+        << flush;
+  }
+
   bseopt_.useTDA = options.get("bse.useTDA").as<bool>();
   orbitals_.setTDAApprox(bseopt_.useTDA);
   if (!bseopt_.useTDA) {
@@ -237,6 +256,28 @@ void GWBSE::Initialize(tools::Property& options) {
 
   bseopt_.max_dyn_iter = options.get("bse.dyn_screen_max_iter").as<Index>();
   bseopt_.dyn_tolerance = options.get("bse.dyn_screen_tol").as<double>();
+  bseopt_.dyn_mesh = options.get("bse.dyn_screen_mesh").as<double>();
+
+  bseopt_.truncation_window =
+      options.get("bse.truncation_window").as<double>();
+  bseopt_.truncation_coupling =
+      options.get("bse.truncation_coupling").as<double>();
+  if (bseopt_.truncation_window > 0 && !bseopt_.useTDA) {
+    XTP_LOG(Log::error, *pLog_)
+        << " BSE product space truncation is only used with TDA" << flush;
+  }
+  if (options.exists("bse.absorption")) {
+    bseopt_.haydock_steps = options.get("bse.absorption.steps").as<Index>();
+    absorption_lower_ = options.get("bse.absorption.lower").as<double>();
+    absorption_upper_ = options.get("bse.absorption.upper").as<double>();
+    absorption_points_ = options.get("bse.absorption.points").as<Index>();
+    absorption_fwhm_ = options.get("bse.absorption.fwhm").as<double>();
+    absorption_filename_ =
+        options.get("bse.absorption.filename").as<std::string>();
+    XTP_LOG(Log::error, *pLog_)
+        << " Absorption spectrum from " << bseopt_.haydock_steps
+        << " Lanczos steps written to: " << absorption_filename_ << flush;
+  }
   if (bseopt_.max_dyn_iter > 0) {
     do_dynamical_screening_bse_ = true;
   }
@@ -320,6 +361,11 @@ void GWBSE::Initialize(tools::Property& options) {
   if (tasks_string.find("triplets") != std::string::npos) {
     do_bse_triplets_ = true;
   }
+  // without GW the ranges of the .orb file stay, Evaluate checks them
+  if (do_gw_) {
+    orbitals_.setRPAindices(rpamin, rpamax);
+    orbitals_.setGWindices(qpmin, qpmax);
+  }
 
   XTP_LOG(Log::error, *pLog_) << " Tasks: " << flush;
   if (do_gw_) {
@@ -543,6 +589,71 @@ Eigen::MatrixXd GWBSE::CalculateVXC(const AOBasis& dftbasis) {
   return vxc;
 }
 
+/*
+ * Replaces the virtual levels from first to rpamax by frozen natural orbitals
+ * and shrinks the RPA range accordingly. The levels below first, i.e. the GW
+ * and BSE levels, are left untouched.
+ */
+void GWBSE::TruncateVirtuals(const AOBasis& auxbasis, const AOBasis& dftbasis,
+                             Index first, Eigen::MatrixXd& mos,
+                             Eigen::VectorXd& energies) {
+  const Index homo = gwopt_.homo;
+  const Index rpamin = gwopt_.rpamin;
+  const Index nocc = homo - rpamin + 1;
+  const Index nvirt = gwopt_.rpamax - homo;
+  const Index ntrunc = gwopt_.rpamax - first + 1;
+  XTP_LOG(Log::error, *pLog_)
+      << TimeStamp() << " Calculating frozen natural orbitals for levels ["
+      << first << ":" << gwopt_.rpamax << "]" << flush;
+
+  FrozenNaturalOrbitals fno;
+  {
+    TCMatrix_gwbse Bia;
+    Bia.setMaxMemory(mmn_max_memory_, scratch_dir_);
+    Bia.Initialize(auxbasis.AOBasisSize(), rpamin, homo, homo + 1,
+                   gwopt_.rpamax);
+    Bia.Fill(auxbasis, dftbasis, mos);
+    fno.Compute(Bia, energies.segment(rpamin, nocc),
+                energies.segment(homo + 1, nvirt), first - homo - 1,
+                fno_threshold_);
+  }
+  mos.middleCols(first, fno.size()) =
+      mos.middleCols(first, ntrunc) * fno.Transformation();
+  energies.segment(first, fno.size()) = fno.Energies();
+
+  Index rpamax = first + fno.size() - 1;
+  XTP_LOG(Log::error, *pLog_)
+      << TimeStamp() << " Kept " << fno.size() << " of " << ntrunc
+      << " virtual levels, RPA level range [" << rpamin << ":" << rpamax
+      << "]" << flush;
+  XTP_LOG(Log::error, *pLog_)
+      << TimeStamp() << " MP2 correlation energy "
+      << (boost::format("%1$1.6f") % fno.MP2CorrelationEnergy()).str()
+      << " Hartree, missing due to truncation "
+      << (boost::format("%1$1.6f") % fno.EnergyCorrection()).str()
+      << " Hartree" << flush;
+
+  gwopt_.rpamax = rpamax;
+  bseopt_.rpamax = rpamax;
+}
+
+void GWBSE::CheckStoredRanges(const Orbitals& orb, const GW::options& opt,
+                              bool truncated) {
+  if (orb.getGWAmax() != opt.qpmax || orb.getGWAmin() != opt.qpmin ||
+      orb.getRPAmax() != opt.rpamax || orb.getRPAmin() != opt.rpamin) {
+    std::string reason =
+        "The ranges for GW and RPA do not agree with the ranges from the .orb "
+        "file, rerun your GW calculation";
+    if (truncated) {
+      reason +=
+          ". With fno_threshold the RPA range is the one after truncation, "
+          "the .orb file has to come from a GW run with the same "
+          "fno_threshold";
+    }
+    throw std::runtime_error(reason);
+  }
+}
+
 bool GWBSE::Evaluate() {
 
   // set the parallelization
@@ -620,15 +731,60 @@ bool GWBSE::Evaluate() {
         "You want no GW calculation but the orb file has no QPcoefficients for "
         "BSE");
   }
-  TCMatrix_gwbse Mmn;
   // rpamin here, because RPA needs till rpamin
   Index max_3c = std::max(bseopt_.cmax, gwopt_.qpmax);
+  // MOs and energies GW-BSE works with, only differ from the DFT ones for
+  // truncated virtuals
+  Eigen::MatrixXd mos = orbitals_.MOs().eigenvectors();
+  Eigen::VectorXd mo_energies = orbitals_.MOs().eigenvalues();
+  Index first_fno = std::max(max_3c, gwopt_.homo) + 1;
+  bool truncated = false;
+  if (fno_threshold_ > 0.0 && gwopt_.rpamax >= first_fno) {
+    // the QP and RPA input energies of the .orb file belong to its own
+    // virtual space, an untruncated one cannot be combined with truncation
+    if (!do_gw_ && orbitals_.getRPAmax() >= gwopt_.rpamax) {
+      throw std::runtime_error(
+          "fno_threshold without GW needs a .orb file from a GW run with "
+          "frozen natural orbitals, rerun your GW calculation");
+    }
+    TruncateVirtuals(auxbasis, dftbasis, first_fno, mos, mo_energies);
+    truncated = true;
+  }
+  if (do_gw_) {
+    orbitals_.setRPAindices(gwopt_.rpamin, gwopt_.rpamax);
+  } else {
+    CheckStoredRanges(orbitals_, gwopt_, truncated);
+  }
+
+  TCMatrix_gwbse Mmn;
+  Mmn.setMaxMemory(mmn_max_memory_, scratch_dir_);
   Mmn.Initialize(auxbasis.AOBasisSize(), gwopt_.rpamin, max_3c, gwopt_.rpamin,
                  gwopt_.rpamax);
+  std::string mmn_memory =
+      (boost::format("%1$1.3f") % (double(Mmn.MemorySize()) / 1e9)).str();
+  if (Mmn.isOutOfCore()) {
+    XTP_LOG(Log::error, *pLog_)
+        << TimeStamp() << " Mmn_beta needs " << mmn_memory
+        << " GB, storing it in a scratch file in " << scratch_dir_ << flush;
+  } else {
+    XTP_LOG(Log::info, *pLog_)
+        << TimeStamp() << " Mmn_beta needs " << mmn_memory << " GB" << flush;
+  }
+  // the AO integrals are only reused if the 3c integrals are rebuilt
+  if (keep_ao3c_ && do_gw_ && gwopt_.gw_sc_max_iterations > gwopt_.reset_3c) {
+    Mmn.setKeepAO3c(true);
+    Index dftsize = dftbasis.AOBasisSize();
+    double memory = double(auxbasis.AOBasisSize() * dftsize * (dftsize + 1) /
+                           2 * Index(sizeof(double))) /
+                    1e9;
+    XTP_LOG(Log::error, *pLog_)
+        << TimeStamp() << " Keeping AO 3c integrals in memory ("
+        << (boost::format("%1$1.3f") % memory).str() << " GB)" << flush;
+  }
   XTP_LOG(Log::error, *pLog_)
       << TimeStamp()
       << " Calculating Mmn_beta (3-center-repulsion x orbitals)  " << flush;
-  Mmn.Fill(auxbasis, dftbasis, orbitals_.MOs().eigenvectors());
+  Mmn.Fill(auxbasis, dftbasis, mos);
   XTP_LOG(Log::info, *pLog_)
       << TimeStamp() << " Removed " << Mmn.Removedfunctions()
       << " functions from Aux Coulomb matrix to avoid near linear dependencies"
@@ -643,7 +799,7 @@ bool GWBSE::Evaluate() {
     std::chrono::time_point<std::chrono::system_clock> start =
         std::chrono::system_clock::now();
     Eigen::MatrixXd vxc = CalculateVXC(dftbasis);
-    GW gw = GW(*pLog_, Mmn, vxc, orbitals_.MOs().eigenvalues());
+    GW gw = GW(*pLog_, Mmn, vxc, mo_energies);
     gw.configure(gwopt_);
     gw.CalculateGWPerturbation();
 
@@ -680,14 +836,6 @@ bool GWBSE::Evaluate() {
                                 << elapsed_time.count() << " seconds." << flush;
 
   } else {
-    if (orbitals_.getGWAmax() != gwopt_.qpmax ||
-        orbitals_.getGWAmin() != gwopt_.qpmin ||
-        orbitals_.getRPAmax() != gwopt_.rpamax ||
-        orbitals_.getRPAmin() != gwopt_.rpamin) {
-      throw std::runtime_error(
-          "The ranges for GW and RPA do not agree with the ranges from the "
-          ".orb file, rerun your GW calculation");
-    }
     const Eigen::MatrixXd& qpcoeff = orbitals_.QPdiag().eigenvectors();
 
     Hqp = qpcoeff * orbitals_.QPdiag().eigenvalues().asDiagonal() *
@@ -707,20 +855,46 @@ bool GWBSE::Evaluate() {
     Eigen::VectorXd Hd_static_contrib_triplet;
     Eigen::VectorXd Hd_static_contrib_singlet;
 
-    if (do_bse_triplets_) {
+    if (do_bse_singlets_ && do_bse_triplets_) {
+      bse.Solve_singlets_and_triplets(orbitals_);
+    } else if (do_bse_triplets_) {
       bse.Solve_triplets(orbitals_);
+    } else {
+      bse.Solve_singlets(orbitals_);
+    }
+
+    if (do_bse_triplets_) {
       XTP_LOG(Log::error, *pLog_)
           << TimeStamp() << " Solved BSE for triplets " << flush;
       bse.Analyze_triplets(fragments_, orbitals_);
     }
 
     if (do_bse_singlets_) {
-      bse.Solve_singlets(orbitals_);
       XTP_LOG(Log::error, *pLog_)
           << TimeStamp() << " Solved BSE for singlets " << flush;
       bse.Analyze_singlets(fragments_, orbitals_);
     }
 
+    if (do_bse_singlets_ && absorption_points_ > 0) {
+      const double hrt2ev = tools::conv::hrt2ev;
+      Eigen::VectorXd frequencies =
+          Eigen::VectorXd::LinSpaced(absorption_points_, absorption_lower_,
+                                     absorption_upper_) /
+          hrt2ev;
+      Eigen::MatrixXd spectrum = bse.AbsorptionSpectrum(
+          orbitals_, frequencies, absorption_fwhm_ / hrt2ev);
+      std::ofstream ofs(absorption_filename_, std::ofstream::out);
+      ofs << "# E(eV)    epsLorentz    Im(eps)Lorentz\n";
+      for (Index i = 0; i < absorption_points_; i++) {
+        // per eV like the spectrum tool, omega*f(omega) is unit free
+        ofs << frequencies(i) * hrt2ev << "    " << spectrum(i, 0) / hrt2ev
+            << "   " << spectrum(i, 1) << std::endl;
+      }
+      XTP_LOG(Log::error, *pLog_)
+          << TimeStamp() << " Absorption spectrum written to '"
+          << absorption_filename_ << "'" << flush;
+    }
+
     // do perturbative dynamical screening in BSE
     if (do_dynamical_screening_bse_) {
 
@@ -90,7 +90,10 @@ Eigen::MatrixXd RPA::calculate_epsilon(double frequency) const {
     for (Index m_level = 0; m_level < n_occ; m_level++) {
       const double qp_energy_m = energies_(m_level);
 
-      Eigen::MatrixXd Mmn_RPA = Mmn_[m_level].bottomRows(n_unocc);
+      Mmn_.Prefetch(m_level);
+      Eigen::MatrixXd buffer;
+      Eigen::MatrixXd Mmn_RPA =
+          Mmn_.Rows(m_level, Mmn_.nsize() - n_unocc, n_unocc, buffer);
       transform.PushMatrix(Mmn_RPA, threadid);
       const Eigen::ArrayXd deltaE =
           energies_.tail(n_unocc).array() - qp_energy_m;
@@ -132,7 +135,10 @@ Eigen::MatrixXd RPA::calculate_epsilon_r(std::complex<double> frequency) const {
     for (Index m_level = 0; m_level < n_occ; m_level++) {
 
       const double qp_energy_m = energies_(m_level);
-      Eigen::MatrixXd Mmn_RPA = Mmn_[m_level].bottomRows(n_unocc);
+      Mmn_.Prefetch(m_level);
+      Eigen::MatrixXd buffer;
+      Eigen::MatrixXd Mmn_RPA =
+          Mmn_.Rows(m_level, Mmn_.nsize() - n_unocc, n_unocc, buffer);
       transform.PushMatrix(Mmn_RPA, threadid);
       const Eigen::ArrayXd deltaE =
           energies_.tail(n_unocc).array() - qp_energy_m;
@@ -39,9 +39,10 @@ Eigen::MatrixXd Sigma_base::CalcExchangeMatrix() const {
   Index qpmin = opt_.qpmin - opt_.rpamin;
 #pragma omp parallel for schedule(dynamic)
   for (Index gw_level1 = 0; gw_level1 < qptotal_; gw_level1++) {
-    const Eigen::MatrixXd& Mmn1 = Mmn_[gw_level1 + qpmin];
+    Mmn_.Prefetch(gw_level1 + qpmin);
+    auto Mmn1 = Mmn_[gw_level1 + qpmin];
     for (Index gw_level2 = gw_level1; gw_level2 < qptotal_; gw_level2++) {
-      const Eigen::MatrixXd& Mmn2 = Mmn_[gw_level2 + qpmin];
+      auto Mmn2 = Mmn_[gw_level2 + qpmin];
       double sigma_x =
           -(Mmn1.topRows(occlevel).cwiseProduct(Mmn2.topRows(occlevel))).sum();
       result(gw_level2, gw_level1) = sigma_x;
@@ -77,5 +78,23 @@ Eigen::MatrixXd Sigma_base::CalcCorrelationOffDiag(
   return result;
 }
 
+Eigen::VectorXd Sigma_base::CalcCorrelationDiagElementOnGrid(
+    Index gw_level, const Eigen::VectorXd& frequencies) const {
+  Eigen::VectorXd result = Eigen::VectorXd::Zero(frequencies.size());
+  for (Index i = 0; i < frequencies.size(); i++) {
+    result(i) = CalcCorrelationDiagElement(gw_level, frequencies(i));
+  }
+  return result;
+}
+
+Eigen::VectorXd Sigma_base::CalcCorrelationDiagElementDerivativeOnGrid(
+    Index gw_level, const Eigen::VectorXd& frequencies) const {
+  Eigen::VectorXd result = Eigen::VectorXd::Zero(frequencies.size());
+  for (Index i = 0; i < frequencies.size(); i++) {
+    result(i) = CalcCorrelationDiagElementDerivative(gw_level, frequencies(i));
+  }
+  return result;
+}
+
 }  // namespace xtp
 }  // namespace votca
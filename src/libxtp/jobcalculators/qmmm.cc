@@ -48,6 +48,7 @@ void QMMM::ParseSpecificOptions(const tools::Property& options) {
   regions_def_.second = options.get(".regions");
   regions_def_.first = mapfile_;
   use_gs_for_ex_ = options.get("io_jobfile.use_gs_for_ex").as<bool>();
+  multistate_ = options.get("io_jobfile.multistate").as<bool>();
 
   states_ = options.get("io_jobfile.states").as<std::vector<QMState>>();
   which_segments_ = options.get("io_jobfile.segments").as<std::string>();
@@ -60,10 +61,19 @@ void QMMM::ParseSpecificOptions(const tools::Property& options) {
   }
 }
 
-Job::JobResult QMMM::EvalJob(const Topology& top, Job& job, QMThread& Thread) {
-  std::chrono::time_point<std::chrono::system_clock> start =
-      std::chrono::system_clock::now();
+const SegmentIndex& QMMM::getSegmentIndex(const Topology& top) {
+  // built by the first job of a frame, all threads share it
+  index_mutex_.Lock();
+  if (!segment_index_ || &segment_index_->getTopology() != &top ||
+      indexed_step_ != top.getStep()) {
+    segment_index_ = std::make_unique<SegmentIndex>(top);
+    indexed_step_ = top.getStep();
+  }
+  index_mutex_.Unlock();
+  return *segment_index_;
+}
 
+std::string QMMM::getWorkdir(const Topology& top, const Job& job) const {
   std::string qmmm_work_dir = "QMMM";
   if (!this->hasQMRegion()) {
     qmmm_work_dir = "MMMM";
@@ -73,10 +83,18 @@ Job::JobResult QMMM::EvalJob(const Topology& top, Job& job, QMThread& Thread) {
   std::string job_dir =
       "job_" + std::to_string(job.getId()) + "_" + job.getTag();
   boost::filesystem::path arg_path;
-  std::string workdir =
-      (arg_path / qmmm_work_dir / frame_dir / job_dir).generic_string();
+  return (arg_path / qmmm_work_dir / frame_dir / job_dir).generic_string();
+}
+
+Job::JobResult QMMM::EvalJob(const Topology& top, Job& job, QMThread& Thread) {
+  if (job.getInput().exists("states")) {
+    return EvalMultiStateJob(top, job, Thread);
+  }
+  std::chrono::time_point<std::chrono::system_clock> start =
+      std::chrono::system_clock::now();
+
+  std::string workdir = getWorkdir(top, job);
   boost::filesystem::create_directories(workdir);
-  Job::JobResult jres = Job::JobResult();
   Logger& pLog = Thread.getLogger();
 
   JobTopology jobtop = JobTopology(job, pLog, workdir);
@@ -86,8 +104,84 @@ Job::JobResult QMMM::EvalJob(const Topology& top, Job& job, QMThread& Thread) {
         << TimeStamp() << " Restart job from " << checkptfile << std::flush;
     jobtop.ReadFromHdf5(checkptfile);
   } else {
+    jobtop.setSegmentIndex(&getSegmentIndex(top));
+    jobtop.setLatticeCache(&lattice_cache_);
     jobtop.BuildRegions(top, regions_def_);
   }
+  return SolveRegions(jobtop, workdir, pLog, start);
+}
+
+Job::JobResult QMMM::EvalMultiStateJob(const Topology& top, Job& job,
+                                       QMThread& Thread) {
+  std::string workdir = getWorkdir(top, job);
+  Logger& pLog = Thread.getLogger();
+  if (job.getInput().exists("restart")) {
+    XTP_LOG(Log::error, pLog)
+        << TimeStamp()
+        << " WARNING: restart is not supported for jobs with several states, "
+           "ignoring "
+        << job.getInput().get("restart").as<std::string>() << std::flush;
+  }
+
+  // the states share one JobTopology, which only rebuilds the regions that
+  // differ between them
+  tools::Property empty_input;
+  empty_input.add("input", "");
+  Job state_job(job.getId(), job.getTag(), empty_input, Job::AVAILABLE);
+  JobTopology jobtop = JobTopology(state_job, pLog, workdir);
+  jobtop.setSegmentIndex(&getSegmentIndex(top));
+  jobtop.setLatticeCache(&lattice_cache_);
+
+  Job::JobResult jres = Job::JobResult();
+  jres.setStatus(Job::JobStatus::COMPLETE);
+  tools::Property results;
+  tools::Property& jobresult = results.add("output", "");
+  bool first_state = true;
+  for (const tools::Property* state_input :
+       job.getInput().Select("states.state")) {
+    std::chrono::time_point<std::chrono::system_clock> start =
+        std::chrono::system_clock::now();
+    std::string marker = state_input->get("site_energies").as<std::string>();
+    std::string state_dir =
+        workdir + "/state_" + tools::Tokenizer(marker, ":").ToVector().back();
+    boost::filesystem::create_directories(state_dir);
+    XTP_LOG(Log::error, pLog)
+        << TimeStamp() << " Evaluating state " << marker << std::flush;
+
+    state_job.getInput() = *state_input;
+    jobtop.setWorkdir(state_dir);
+    if (first_state) {
+      jobtop.BuildRegions(top, regions_def_);
+      first_state = false;
+    } else {
+      jobtop.UpdateRegions(top, regions_def_);
+    }
+    Job::JobResult state_result = SolveRegions(jobtop, state_dir, pLog, start);
+    if (state_result.getStatus() != Job::JobStatus::COMPLETE) {
+      // the states before stay in the output, ReadJobFile uses them even
+      // though the job as a whole is not complete
+      jres.setStatus(state_result.getStatus());
+      if (state_result.hasError()) {
+        jres.setError(marker + ": " + state_result.getError());
+      }
+      break;
+    }
+
+    tools::Property& stateresult = jobresult.add("state", "");
+    stateresult.add("site_energies", marker);
+    for (const tools::Property& child : state_result.getOutput()) {
+      stateresult.add(child);
+    }
+  }
+  jres.setOutput(results);
+  return jres;
+}
+
+Job::JobResult QMMM::SolveRegions(
+    JobTopology& jobtop, const std::string& workdir, Logger& pLog,
+    std::chrono::time_point<std::chrono::system_clock> start) const {
+  Job::JobResult jres = Job::JobResult();
+  Index max_iterations = max_iterations_;
 
   if (print_regions_pdb_) {
     std::string pdb_filename = "regions.pdb";
@@ -109,14 +203,14 @@ Job::JobResult QMMM::EvalJob(const Topology& top, Job& job, QMThread& Thread) {
            "inter regions scf is required. "
         << std::flush;
     no_top_scf = true;
-    max_iterations_ = 1;
+    max_iterations = 1;
   }
   Index iteration = 0;
-  for (; iteration < max_iterations_; iteration++) {
+  for (; iteration < max_iterations; iteration++) {
 
     XTP_LOG(Log::error, pLog)
         << TimeStamp() << " --Inter Region SCF Iteration " << iteration + 1
-        << " of " << max_iterations_ << std::flush;
+        << " of " << max_iterations << std::flush;
 
     for (std::unique_ptr<Region>& region : jobtop) {
       XTP_LOG(Log::error, pLog)
@@ -161,13 +255,13 @@ Job::JobResult QMMM::EvalJob(const Topology& top, Job& job, QMThread& Thread) {
         jres.setStatus(Job::JobStatus::COMPLETE);
         break;
       }
-      if (iteration == max_iterations_ - 1) {
+      if (iteration == max_iterations - 1) {
         XTP_LOG(Log::error, pLog)
             << TimeStamp() << " Job did not converge after " << iteration + 1
             << " iterations.\n Writing results to jobfile." << std::flush;
         jres.setStatus(Job::JobStatus::FAILED);
         jres.setError("Inter Region SCF did not converge in " +
-                      std::to_string(max_iterations_) + " iterations.");
+                      std::to_string(max_iterations) + " iterations.");
       }
     } else {
       jres.setStatus(Job::JobStatus::COMPLETE);
@@ -240,6 +334,12 @@ void QMMM::WriteJobFile(const Topology& top) {
   Index jobid = 0;
   for (Index segID : segments_to_write) {
     const Segment& seg = top.Segments()[segID];
+    if (multistate_) {
+      Job job = createMultiStateJob(seg, jobid);
+      job.ToStream(ofs);
+      jobid++;
+      continue;
+    }
     for (const QMState& state : states_) {
       Job job = createJob(seg, state, jobid);
       job.ToStream(ofs);
@@ -261,6 +361,25 @@ Job QMMM::createJob(const Segment& seg, const QMState& state,
 
   tools::Property Input;
   tools::Property& pInput = Input.add("input", "");
+  FillJobInput(pInput, seg, state);
+  Job job(jobid, tag, Input, Job::AVAILABLE);
+  return job;
+}
+
+Job QMMM::createMultiStateJob(const Segment& seg, Index jobid) const {
+  std::string tag = seg.getType() + "_" + std::to_string(seg.getId());
+  tools::Property Input;
+  tools::Property& states = Input.add("input", "").add("states", "");
+  for (const QMState& state : states_) {
+    FillJobInput(states.add("state", ""), seg, state);
+  }
+  Job job(jobid, tag, Input, Job::AVAILABLE);
+  return job;
+}
+
+void QMMM::FillJobInput(tools::Property& pInput, const Segment& seg,
+                        const QMState& state) const {
+  std::string marker = std::to_string(seg.getId()) + ":" + state.ToString();
   pInput.add("site_energies", marker);
   tools::Property& regions = pInput.add("regions", "");
   tools::Property& region = regions.add(getFirstRegionName(), "");
@@ -274,8 +393,37 @@ Job QMMM::createJob(const Segment& seg, const QMState& state,
   } else {
     region.add("segments", marker);
   }
-  Job job(jobid, tag, Input, Job::AVAILABLE);
-  return job;
+}
+
+void QMMM::ReadJobResult(
+    const std::string& site_energies, double energy, Index jobid,
+    Eigen::Matrix<double, Eigen::Dynamic, 5>& energies,
+    Eigen::Matrix<bool, Eigen::Dynamic, 5>& found) const {
+  std::vector<std::string> split =
+      tools::Tokenizer(site_energies, ":").ToVector();
+
+  Index segid = std::stoi(split[0]);
+  if (segid < 0 || segid >= Index(energies.rows())) {
+    throw std::runtime_error("JobSegment id" + std::to_string(segid) +
+                             " is not in topology for job " +
+                             std::to_string(jobid));
+  }
+  QMState state;
+  try {
+    state.FromString(split[1]);
+  } catch (std::runtime_error& e) {
+    std::stringstream message;
+    message << e.what() << " for job " << jobid;
+    throw std::runtime_error(message.str());
+  }
+  if (found(segid, state.Type().Type()) != 0) {
+    throw std::runtime_error("There are two entries in jobfile for segment " +
+                             std::to_string(segid) +
+                             " state:" + state.ToString());
+  }
+
+  energies(segid, state.Type().Type()) = energy;
+  found(segid, state.Type().Type()) = true;
 }
 
 void QMMM::ReadJobFile(Topology& top) {
@@ -297,39 +445,29 @@ void QMMM::ReadJobFile(Topology& top) {
           "Jobfile is malformed. <status> tag missing for job " +
           std::to_string(jobid));
     }
-    if (job->get("status").as<std::string>() != "COMPLETE" ||
-        !job->exists("output")) {
+    bool complete = job->get("status").as<std::string>() == "COMPLETE" &&
+                    job->exists("output");
+    if (!complete) {
       incomplete_jobs++;
-      continue;
     }
 
-    std::vector<std::string> split =
-        tools::Tokenizer(job->get("input.site_energies").as<std::string>(), ":")
-            .ToVector();
-
-    Index segid = std::stoi(split[0]);
-    if (segid < 0 || segid >= Index(top.Segments().size())) {
-      throw std::runtime_error("JobSegment id" + std::to_string(segid) +
-                               " is not in topology for job " +
-                               std::to_string(jobid));
-    }
-    QMState state;
-    try {
-      state.FromString(split[1]);
-    } catch (std::runtime_error& e) {
-      std::stringstream message;
-      message << e.what() << " for job " << jobid;
-      throw std::runtime_error(message.str());
-    }
-    double energy = job->get("output.E_tot").as<double>() * tools::conv::ev2hrt;
-    if (found(segid, state.Type().Type()) != 0) {
-      throw std::runtime_error("There are two entries in jobfile for segment " +
-                               std::to_string(segid) +
-                               " state:" + state.ToString());
+    if (job->exists("input.states")) {
+      // a job with several states keeps the states that were done before one
+      // failed
+      for (const tools::Property* state : job->Select("output.state")) {
+        if (!state->exists("E_tot")) {
+          continue;
+        }
+        ReadJobResult(
+            state->get("site_energies").as<std::string>(),
+            state->get("E_tot").as<double>() * tools::conv::ev2hrt, jobid,
+            energies, found);
+      }
+    } else if (complete) {
+      ReadJobResult(job->get("input.site_energies").as<std::string>(),
+                    job->get("output.E_tot").as<double>() * tools::conv::ev2hrt,
+                    jobid, energies, found);
     }
-
-    energies(segid, state.Type().Type()) = energy;
-    found(segid, state.Type().Type()) = true;
   }
 
   Eigen::Matrix<Index, 1, 5> found_states = found.colwise().count();
@@ -21,7 +21,12 @@
 #ifndef VOTCA_XTP_QMMM_H
 #define VOTCA_XTP_QMMM_H
 
+// Standard includes
+#include <chrono>
+#include <memory>
+
 // Local VOTCA includes
+#include "votca/xtp/jobtopology.h"
 #include "votca/xtp/parallelxjobcalc.h"
 
 namespace votca {
@@ -48,6 +53,23 @@ class QMMM final : public ParallelXJobCalc<std::vector<Job> > {
  private:
   bool hasQMRegion() const;
   Job createJob(const Segment& seg, const QMState& state, Index jobid) const;
+  Job createMultiStateJob(const Segment& seg, Index jobid) const;
+  void FillJobInput(tools::Property& input, const Segment& seg,
+                    const QMState& state) const;
+  std::string getWorkdir(const Topology& top, const Job& job) const;
+  const SegmentIndex& getSegmentIndex(const Topology& top);
+
+  // evaluates all states of a segment, regions which do not depend on the
+  // state are set up once
+  Job::JobResult EvalMultiStateJob(const Topology& top, Job& job,
+                                   QMThread& Thread);
+  Job::JobResult SolveRegions(
+      JobTopology& jobtop, const std::string& workdir, Logger& pLog,
+      std::chrono::time_point<std::chrono::system_clock> start) const;
+  void ReadJobResult(const std::string& site_energies, double energy,
+                     Index jobid,
+                     Eigen::Matrix<double, Eigen::Dynamic, 5>& energies,
+                     Eigen::Matrix<bool, Eigen::Dynamic, 5>& found) const;
   std::string getFirstRegionName() const;
 
   std::pair<std::string, tools::Property> regions_def_;
@@ -55,8 +77,15 @@ class QMMM final : public ParallelXJobCalc<std::vector<Job> > {
   Index max_iterations_;
   bool print_regions_pdb_ = false;
   bool use_gs_for_ex_ = false;
+  bool multistate_ = false;
   std::vector<QMState> states_;
   std::string which_segments_;
+
+  // shared by the jobs of one frame
+  std::unique_ptr<SegmentIndex> segment_index_ = nullptr;
+  Index indexed_step_ = -1;
+  tools::Mutex index_mutex_;
+  NeutralLatticeCache lattice_cache_;
 };
 
 }  // namespace xtp
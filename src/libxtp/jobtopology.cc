@@ -29,6 +29,7 @@
 #include "votca/xtp/jobtopology.h"
 #include "votca/xtp/polarregion.h"
 #include "votca/xtp/qmregion.h"
+#include "votca/xtp/segmentindex.h"
 #include "votca/xtp/segmentmapper.h"
 #include "votca/xtp/staticregion.h"
 #include "votca/xtp/version.h"
@@ -133,12 +134,14 @@ void JobTopology::BuildRegions(
 
   CheckEnumerationOfRegions(options.second);
   ModifyOptionsByJobFile(options.second);
+  modified_by_job_ = ModifiedByJob(options.second);
 
-  std::vector<std::vector<SegId>> region_seg_ids =
-      PartitionRegions(options.second, top);
+  std::vector<std::vector<SegId>> region_seg_ids = PartitionRegions(
+      options.second, top, std::vector<bool>(modified_by_job_.size(), false));
 
   // // around this point the whole jobtopology will be centered
   CreateRegions(options, top, region_seg_ids);
+  region_seg_ids_ = region_seg_ids;
   XTP_LOG(Log::error, log_) << " Regions created" << std::flush;
   for (const auto& region : regions_) {
     XTP_LOG(Log::error, log_) << *region << std::flush;
@@ -147,6 +150,94 @@ void JobTopology::BuildRegions(
   return;
 }
 
+namespace {
+bool SameSegments(const std::vector<SegId>& a, const std::vector<SegId>& b,
+                  bool compare_geometry) {
+  if (a.size() != b.size()) {
+    return false;
+  }
+  for (Index i = 0; i < Index(a.size()); i++) {
+    if (a[i].Id() != b[i].Id()) {
+      return false;
+    }
+    if (compare_geometry &&
+        (a[i].hasFile() != b[i].hasFile() ||
+         a[i].FileName() != b[i].FileName() ||
+         a[i].getQMState().ToString() != b[i].getQMState().ToString())) {
+      return false;
+    }
+  }
+  return true;
+}
+}  // namespace
+
+void JobTopology::UpdateRegions(
+    const Topology& top, std::pair<std::string, tools::Property> options) {
+
+  CheckEnumerationOfRegions(options.second);
+  ModifyOptionsByJobFile(options.second);
+
+  // only regions with the same definition in the last and this job can be
+  // kept, the others are built again from their definition
+  std::vector<bool> modified_by_job = ModifiedByJob(options.second);
+  std::vector<bool> rebuild(modified_by_job.size(), true);
+  std::vector<bool> reusable(modified_by_job.size(), false);
+  if (region_seg_ids_.size() == modified_by_job.size() &&
+      modified_by_job_.size() == modified_by_job.size()) {
+    for (Index i = 0; i < Index(rebuild.size()); i++) {
+      rebuild[i] = modified_by_job[i] || modified_by_job_[i];
+      reusable[i] = !rebuild[i];
+    }
+  }
+  std::vector<std::vector<SegId>> region_seg_ids =
+      PartitionRegions(options.second, top, reusable);
+  modified_by_job_ = modified_by_job;
+
+  // the environment can only be kept, if all regions contain the same
+  // segments, otherwise the centre, the partitioning or the explicit segments
+  // of the periodic images differ
+  bool keep_environment = (regions_.size() == region_seg_ids.size());
+  for (Index i = 0; keep_environment && i < Index(region_seg_ids.size());
+       i++) {
+    keep_environment =
+        SameSegments(region_seg_ids[i], region_seg_ids_[i], !rebuild[i]);
+  }
+  if (!keep_environment) {
+    XTP_LOG(Log::error, log_)
+        << " Segments of the regions changed, rebuilding all regions"
+        << std::flush;
+    regions_.clear();
+    CreateRegions(options, top, region_seg_ids);
+  } else {
+    std::string mapfile = options.first;
+    Eigen::Vector3d center =
+        top.getSegment(region_seg_ids[0][0].Id()).getPos();
+    std::vector<Index> rebuilt_ids;
+    for (const tools::Property& region_def : options.second) {
+      Index id = region_def.get("id").as<Index>();
+      auto region = std::find_if(
+          regions_.begin(), regions_.end(),
+          [id](const std::unique_ptr<Region>& r) { return r->getId() == id; });
+      if (rebuild[id]) {
+        *region =
+            CreateRegion(region_def, mapfile, top, region_seg_ids[id], center);
+        rebuilt_ids.push_back(id);
+      } else {
+        (*region)->ClearHistory();
+      }
+    }
+    ApplyPeriodicImages(mapfile, top, region_seg_ids, center, rebuilt_ids);
+    XTP_LOG(Log::error, log_)
+        << " Rebuilt " << rebuilt_ids.size()
+        << " regions modified by this or the last job, kept the others"
+        << std::flush;
+  }
+  region_seg_ids_ = region_seg_ids;
+  for (const auto& region : regions_) {
+    XTP_LOG(Log::error, log_) << *region << std::flush;
+  }
+}
+
 template <class T>
 void JobTopology::ShiftPBC(const Topology& top, const Eigen::Vector3d& center,
                            T& mol) const {
@@ -158,6 +249,65 @@ void JobTopology::ShiftPBC(const Topology& top, const Eigen::Vector3d& center,
   }
 }
 
+std::unique_ptr<Region> JobTopology::CreateRegion(
+    const tools::Property& region_def, const std::string& mapfile,
+    const Topology& top, const std::vector<SegId>& seg_ids,
+    const Eigen::Vector3d& center) const {
+  Index id = region_def.get("id").as<Index>();
+  std::string type = region_def.name();
+  std::unique_ptr<Region> region;
+  QMRegion QMdummy(0, log_, "");
+  StaticRegion Staticdummy(0, log_);
+  PolarRegion Polardummy(0, log_);
+  if (type == QMdummy.identify()) {
+    std::unique_ptr<QMRegion> qmregion =
+        std::make_unique<QMRegion>(id, log_, workdir_);
+    QMMapper qmmapper(log_);
+    qmmapper.LoadMappingFile(mapfile);
+    for (const SegId& seg_index : seg_ids) {
+      const Segment& segment = top.getSegment(seg_index.Id());
+      QMMolecule mol = qmmapper.map(segment, seg_index);
+      mol.setType("qm" + std::to_string(id));
+      ShiftPBC(top, center, mol);
+      qmregion->push_back(mol);
+    }
+    region = std::move(qmregion);
+  } else if (type == Polardummy.identify()) {
+    std::unique_ptr<PolarRegion> polarregion =
+        std::make_unique<PolarRegion>(id, log_);
+    PolarMapper polmap(log_);
+    polmap.LoadMappingFile(mapfile);
+    for (const SegId& seg_index : seg_ids) {
+      const Segment& segment = top.getSegment(seg_index.Id());
+
+      PolarSegment mol = polmap.map(segment, seg_index);
+
+      ShiftPBC(top, center, mol);
+      mol.setType("mm" + std::to_string(id));
+      polarregion->push_back(mol);
+    }
+    region = std::move(polarregion);
+  } else if (type == Staticdummy.identify()) {
+    std::unique_ptr<StaticRegion> staticregion =
+        std::make_unique<StaticRegion>(id, log_);
+    StaticMapper staticmap(log_);
+    staticmap.LoadMappingFile(mapfile);
+    for (const SegId& seg_index : seg_ids) {
+      const Segment& segment = top.getSegment(seg_index.Id());
+      StaticSegment mol = staticmap.map(segment, seg_index);
+      mol.setType("mm" + std::to_string(id));
+      ShiftPBC(top, center, mol);
+      staticregion->push_back(mol);
+    }
+    region = std::move(staticregion);
+
+  } else {
+    throw std::runtime_error("Region type not known!");
+  }
+  region->Initialize(region_def);
+  return region;
+}
+
 void JobTopology::CreateRegions(
     const std::pair<std::string, tools::Property>& options, const Topology& top,
     const std::vector<std::vector<SegId>>& region_seg_ids) {
@@ -165,61 +315,68 @@ void JobTopology::CreateRegions(
   // around this point the whole jobtopology will be centered for removing pbc
   Eigen::Vector3d center = top.getSegment(region_seg_ids[0][0].Id()).getPos();
 
+  std::vector<Index> ids;
   for (const tools::Property& region_def : options.second) {
     Index id = region_def.get("id").as<Index>();
-    const std::vector<SegId>& seg_ids = region_seg_ids[id];
-    std::string type = region_def.name();
-    std::unique_ptr<Region> region;
-    QMRegion QMdummy(0, log_, "");
-    StaticRegion Staticdummy(0, log_);
-    PolarRegion Polardummy(0, log_);
-    if (type == QMdummy.identify()) {
-      std::unique_ptr<QMRegion> qmregion =
-          std::make_unique<QMRegion>(id, log_, workdir_);
-      QMMapper qmmapper(log_);
-      qmmapper.LoadMappingFile(mapfile);
-      for (const SegId& seg_index : seg_ids) {
-        const Segment& segment = top.getSegment(seg_index.Id());
-        QMMolecule mol = qmmapper.map(segment, seg_index);
-        mol.setType("qm" + std::to_string(id));
-        ShiftPBC(top, center, mol);
-        qmregion->push_back(mol);
-      }
-      region = std::move(qmregion);
-    } else if (type == Polardummy.identify()) {
-      std::unique_ptr<PolarRegion> polarregion =
-          std::make_unique<PolarRegion>(id, log_);
-      PolarMapper polmap(log_);
-      polmap.LoadMappingFile(mapfile);
-      for (const SegId& seg_index : seg_ids) {
-        const Segment& segment = top.getSegment(seg_index.Id());
-
-        PolarSegment mol = polmap.map(segment, seg_index);
-
-        ShiftPBC(top, center, mol);
-        mol.setType("mm" + std::to_string(id));
-        polarregion->push_back(mol);
-      }
-      region = std::move(polarregion);
-    } else if (type == Staticdummy.identify()) {
-      std::unique_ptr<StaticRegion> staticregion =
-          std::make_unique<StaticRegion>(id, log_);
-      StaticMapper staticmap(log_);
-      staticmap.LoadMappingFile(mapfile);
-      for (const SegId& seg_index : seg_ids) {
-        const Segment& segment = top.getSegment(seg_index.Id());
-        StaticSegment mol = staticmap.map(segment, seg_index);
-        mol.setType("mm" + std::to_string(id));
-        ShiftPBC(top, center, mol);
-        staticregion->push_back(mol);
-      }
-      region = std::move(staticregion);
+    regions_.push_back(
+        CreateRegion(region_def, mapfile, top, region_seg_ids[id], center));
+    ids.push_back(id);
+  }
+  ApplyPeriodicImages(mapfile, top, region_seg_ids, center, ids);
+}
 
-    } else {
-      throw std::runtime_error("Region type not known!");
+void JobTopology::ApplyPeriodicImages(
+    const std::string& mapfile, const Topology& top,
+    const std::vector<std::vector<SegId>>& region_seg_ids,
+    const Eigen::Vector3d& center, const std::vector<Index>& region_ids) {
+  std::vector<PolarRegion*> periodic_polar;
+  std::vector<StaticRegion*> periodic_static;
+  double tolerance = 1.0;
+  Index ntargets = 0;
+  for (std::unique_ptr<Region>& region : regions_) {
+    if (std::find(region_ids.begin(), region_ids.end(), region->getId()) ==
+        region_ids.end()) {
+      continue;
     }
-    region->Initialize(region_def);
-    regions_.push_back(std::move(region));
+    PolarRegion* polarregion = dynamic_cast<PolarRegion*>(region.get());
+    StaticRegion* staticregion = dynamic_cast<StaticRegion*>(region.get());
+    if (polarregion != nullptr && polarregion->EwaldTolerance() > 0.0) {
+      periodic_polar.push_back(polarregion);
+      tolerance = std::min(tolerance, polarregion->EwaldTolerance());
+      ntargets += polarregion->NumberOfSites();
+    } else if (staticregion != nullptr &&
+               staticregion->EwaldTolerance() > 0.0) {
+      periodic_static.push_back(staticregion);
+      tolerance = std::min(tolerance, staticregion->EwaldTolerance());
+      ntargets += staticregion->NumberOfSites();
+    }
+  }
+  if (periodic_polar.empty() && periodic_static.empty()) {
+    return;
+  }
+  if (top.getBox().isApproxToConstant(0)) {
+    throw std::runtime_error(
+        "Ewald summation of the periodic images requires a box");
+  }
+
+  // every segment of the topology in its neutral state, the copies of
+  // segments in a region are treated explicitly and left out of the sum
+  std::shared_ptr<const NeutralLattice> lattice = nullptr;
+  if (lattice_cache_ != nullptr) {
+    lattice = lattice_cache_->get(top, mapfile, tolerance, ntargets, log_);
+  } else {
+    lattice = std::make_shared<NeutralLattice>(top, mapfile, tolerance,
+                                               ntargets, log_);
+  }
+  EwaldSum ewald = lattice->WithoutRegions(region_seg_ids, center);
+  XTP_LOG(Log::error, log_)
+      << TimeStamp() << " Ewald sum without " << ewald.NumberOfExplicitSites()
+      << " explicit sites" << std::flush;
+  for (PolarRegion* polarregion : periodic_polar) {
+    polarregion->CalcPeriodicField(ewald);
+  }
+  for (StaticRegion* staticregion : periodic_static) {
+    staticregion->CalcPeriodicField(ewald);
   }
 }
 
@@ -234,17 +391,45 @@ void JobTopology::WriteToPdb(std::string filename) const {
   writer.Close();
 }
 
+std::vector<bool> JobTopology::ModifiedByJob(
+    const tools::Property& regions_def) const {
+  Index nregions = 0;
+  for (const tools::Property& region_def : regions_def) {
+    nregions = std::max(nregions, region_def.get("id").as<Index>() + 1);
+  }
+  std::vector<bool> modified(nregions, false);
+  for (const tools::Property* job_region :
+       job_.getInput().Select("regions.*region")) {
+    Index id = job_region->get("id").as<Index>();
+    if (id >= 0 && id < nregions) {
+      modified[id] = true;
+    }
+  }
+  return modified;
+}
+
 std::vector<std::vector<SegId>> JobTopology::PartitionRegions(
-    const tools::Property& regions_def, const Topology& top) const {
+    const tools::Property& regions_def, const Topology& top,
+    const std::vector<bool>& reusable) const {
 
   std::vector<const tools::Property*> sorted_regions =
       SortRegionsDefbyId(regions_def);
 
+  // a shared index saves the binning of the segments for every job
+  std::unique_ptr<SegmentIndex> local_index = nullptr;
+  if (segment_index_ == nullptr || &segment_index_->getTopology() != &top) {
+    local_index = std::make_unique<SegmentIndex>(top);
+  }
+  const SegmentIndex& index = local_index ? *local_index : *segment_index_;
+
   std::vector<Index> explicitly_named_segs_per_region;
   std::vector<std::vector<SegId>> segids_per_region;
   std::vector<bool> processed_segments =
       std::vector<bool>(top.Segments().size(), false);
+  // the cutoffs of a region depend on the segments of all regions before it
+  bool previous_unchanged = true;
   for (const tools::Property* region_def : sorted_regions) {
+    const Index region_id = Index(segids_per_region.size());
 
     if (!region_def->exists("segments") && !region_def->exists("cutoff")) {
       throw std::runtime_error(
@@ -263,6 +448,15 @@ std::vector<std::vector<SegId>> JobTopology::PartitionRegions(
     }
     explicitly_named_segs_per_region.push_back(Index(seg_ids.size()));
 
+    if (previous_unchanged && reusable[region_id]) {
+      seg_ids = region_seg_ids_[region_id];
+      for (const SegId& seg_id : seg_ids) {
+        processed_segments[seg_id.Id()] = true;
+      }
+      segids_per_region.push_back(seg_ids);
+      continue;
+    }
+
     if (region_def->exists("cutoff")) {
       double cutoff =
           tools::conv::nm2bohr * region_def->get("cutoff.radius").as<double>();
@@ -308,19 +502,18 @@ std::vector<std::vector<SegId>> JobTopology::PartitionRegions(
       }
       for (const SegId& segid : center) {
         const Segment& center_seg = top.getSegment(segid.Id());
-        for (const Segment& otherseg : top.Segments()) {
-          if (center_seg.getId() == otherseg.getId() ||
-              processed_segments[otherseg.getId()]) {
+        for (Index otherid : index.FindSegments(center_seg.getPos(), cutoff)) {
+          if (center_seg.getId() == otherid || processed_segments[otherid]) {
             continue;
           }
-          if (top.PbShortestConnect(center_seg.getPos(), otherseg.getPos())
-                  .norm() < cutoff) {
-            seg_ids.push_back(SegId(otherseg.getId(), seg_geometry));
-            processed_segments[otherseg.getId()] = true;
-          }
+          seg_ids.push_back(SegId(otherid, seg_geometry));
+          processed_segments[otherid] = true;
         }
       }
     }
+    previous_unchanged =
+        previous_unchanged && region_id < Index(region_seg_ids_.size()) &&
+        SameSegments(seg_ids, region_seg_ids_[region_id], false);
     segids_per_region.push_back(seg_ids);
   }
   return segids_per_region;
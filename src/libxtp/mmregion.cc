@@ -34,6 +34,38 @@ double MMRegion<T>::charge() const {
   return charge;
 }
 
+template <class T>
+Index MMRegion<T>::NumberOfSites() const {
+  Index nsites = 0;
+  for (const auto& seg : segments_) {
+    nsites += seg.size();
+  }
+  return nsites;
+}
+
+template <class T>
+Eigen::Matrix<double, 9, Eigen::Dynamic> MMRegion<T>::CalcLatticeField(
+    const EwaldSum& ewald) const {
+  std::vector<const StaticSite*> sites;
+  for (const auto& seg : segments_) {
+    for (const auto& site : seg) {
+      sites.push_back(&site);
+    }
+  }
+  Eigen::Matrix<double, 9, Eigen::Dynamic> field =
+      Eigen::Matrix<double, 9, Eigen::Dynamic>::Zero(9, sites.size());
+#pragma omp parallel for schedule(dynamic)
+  for (Index i = 0; i < Index(sites.size()); i++) {
+    const Eigen::Vector3d& pos = sites[i]->getPos();
+    if (sites[i]->getRank() > 1) {
+      field.col(i) = ewald.Field<9>(pos);
+    } else {
+      field.col(i).head<4>() = ewald.Field<4>(pos);
+    }
+  }
+  return field;
+}
+
 template <class T>
 void MMRegion<T>::WritePDB(csg::PDBWriter& writer) const {
   for (const auto& seg : segments_) {
@@ -0,0 +1,103 @@
+/*
+ *            Copyright 2009-2020 The VOTCA Development Team
+ *                       (http://www.votca.org)
+ *
+ *      Licensed under the Apache License, Version 2.0 (the "License")
+ *
+ * You may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *              http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+// Local VOTCA includes
+#include "votca/xtp/neutrallattice.h"
+#include "votca/xtp/segmentmapper.h"
+
+namespace votca {
+namespace xtp {
+
+NeutralLattice::NeutralLattice(const Topology& top, const std::string& mapfile,
+                               double tolerance, Index ntargets, Logger& log)
+    : top_(top),
+      step_(top.getStep()),
+      mapfile_(mapfile),
+      tolerance_(tolerance) {
+  StaticMapper staticmap(log);
+  staticmap.LoadMappingFile(mapfile);
+  std::vector<StaticSegment> lattice;
+  lattice.reserve(top.Segments().size());
+  first_site_.reserve(top.Segments().size() + 1);
+  first_site_.push_back(0);
+  for (const Segment& segment : top.Segments()) {
+    lattice.push_back(staticmap.map(segment, SegId(segment.getId(), "n")));
+    segment_pos_.push_back(lattice.back().getPos());
+    first_site_.push_back(first_site_.back() + lattice.back().size());
+  }
+  std::vector<const StaticSite*> sites;
+  sites.reserve(first_site_.back());
+  site_pos_.reserve(first_site_.back());
+  for (const StaticSegment& seg : lattice) {
+    for (const StaticSite& site : seg) {
+      sites.push_back(&site);
+      site_pos_.push_back(site.getPos());
+    }
+  }
+  ewald_ = std::make_unique<EwaldSum>(top.getBox(), tolerance, sites,
+                                      std::vector<bool>(sites.size(), false),
+                                      ntargets);
+  XTP_LOG(Log::error, log)
+      << TimeStamp() << " Ewald lattice of frame " << step_ << " with "
+      << sites.size() << " sites, alpha=" << ewald_->Alpha()
+      << " 1/bohr, real space cutoff=" << ewald_->RealSpaceCutoff()
+      << " bohr, " << ewald_->NumberOfKvectors() << " k-vectors" << std::flush;
+}
+
+EwaldSum NeutralLattice::WithoutRegions(
+    const std::vector<std::vector<SegId>>& region_seg_ids,
+    const Eigen::Vector3d& center) const {
+  std::vector<Index> explicit_sites;
+  std::vector<Eigen::Vector3d> explicit_pos;
+  for (const std::vector<SegId>& seg_ids : region_seg_ids) {
+    for (const SegId& seg_id : seg_ids) {
+      const Index id = seg_id.Id();
+      // the shift of JobTopology::ShiftPBC
+      const Eigen::Vector3d shift =
+          top_.PbShortestConnect(center, segment_pos_[id]) -
+          (segment_pos_[id] - center);
+      for (Index i = first_site_[id]; i < first_site_[id + 1]; i++) {
+        explicit_sites.push_back(i);
+        explicit_pos.push_back(site_pos_[i] + shift);
+      }
+    }
+  }
+  return EwaldSum(*ewald_, explicit_sites, explicit_pos);
+}
+
+std::shared_ptr<const NeutralLattice> NeutralLatticeCache::get(
+    const Topology& top, const std::string& mapfile, double tolerance,
+    Index ntargets, Logger& log) {
+  mutex_.Lock();
+  if (!lattice_ || !lattice_->BuiltFor(top, mapfile, tolerance)) {
+    try {
+      lattice_ = std::make_shared<NeutralLattice>(top, mapfile, tolerance,
+                                                  ntargets, log);
+    } catch (...) {
+      mutex_.Unlock();
+      throw;
+    }
+  }
+  std::shared_ptr<const NeutralLattice> lattice = lattice_;
+  mutex_.Unlock();
+  return lattice;
+}
+
+}  // namespace xtp
+}  // namespace votca
@@ -17,6 +17,11 @@
  *
  */
 
+// Standard includes
+#include <array>
+#include <cmath>
+#include <map>
+
 // Local VOTCA includes
 #include "votca/xtp/density_integration.h"
 #include "votca/xtp/aopotential.h"
@@ -58,8 +63,113 @@ Eigen::Vector3d DensityIntegration<Grid>::IntegrateField(
   return result;
 }
 
+template <class Grid>
+void DensityIntegration<Grid>::SetupMultipoleBoxes(double boxsize) {
+  assert(!densities_.empty() && "Density not calculated");
+  multipole_boxes_.clear();
+  std::map<std::array<Index, 3>, Index> box_ids;
+  for (Index i = 0; i < grid_.getBoxesSize(); i++) {
+    const std::vector<Eigen::Vector3d>& points = grid_[i].getGridPoints();
+    const std::vector<double>& densities = densities_[i];
+    for (Index j = 0; j < grid_[i].size(); j++) {
+      const Eigen::Vector3d index = points[j] / boxsize;
+      std::array<Index, 3> key = {Index(std::floor(index.x())),
+                                  Index(std::floor(index.y())),
+                                  Index(std::floor(index.z()))};
+      auto it = box_ids.find(key);
+      if (it == box_ids.end()) {
+        it = box_ids.emplace(key, Index(multipole_boxes_.size())).first;
+        multipole_boxes_.push_back(MultipoleBox());
+      }
+      MultipoleBox& box = multipole_boxes_[it->second];
+      box.points.push_back(points[j]);
+      box.densities.push_back(densities[j]);
+    }
+  }
+
+#pragma omp parallel for schedule(guided)
+  for (Index i = 0; i < Index(multipole_boxes_.size()); i++) {
+    MultipoleBox& box = multipole_boxes_[i];
+    for (const Eigen::Vector3d& point : box.points) {
+      box.center += point;
+    }
+    box.center /= double(box.points.size());
+    for (Index j = 0; j < Index(box.points.size()); j++) {
+      const Eigen::Vector3d r = box.points[j] - box.center;
+      const double rho = box.densities[j];
+      box.radius = std::max(box.radius, r.norm());
+      box.charge += rho;
+      box.abs_charge += std::abs(rho);
+      box.dipole += rho * r;
+      box.quadrupole += 0.5 * rho *
+                        (3 * r * r.transpose() -
+                         r.squaredNorm() * Eigen::Matrix3d::Identity());
+    }
+  }
+}
+
+template <class Grid>
+Eigen::Vector3d DensityIntegration<Grid>::IntegrateField_Multipoles(
+    const Eigen::Vector3d& rvector, double accuracy) const {
+  assert(!multipole_boxes_.empty() && "Multipole boxes not calculated");
+  Eigen::Vector3d result = Eigen::Vector3d::Zero();
+  for (const MultipoleBox& box : multipole_boxes_) {
+    const Eigen::Vector3d R = rvector - box.center;
+    const double dist = R.norm();
+    if (box.radius < accuracy * dist) {
+      // minus gradient of q/R + d*R/R^3 + R*Q*R/R^5
+      const double R3inv = 1.0 / (dist * dist * dist);
+      const double R5inv = R3inv / (dist * dist);
+      const double R7inv = R5inv / (dist * dist);
+      const Eigen::Vector3d QR = box.quadrupole * R;
+      result += box.charge * R3inv * R;
+      result += 3 * box.dipole.dot(R) * R5inv * R - box.dipole * R3inv;
+      result += 5 * R.dot(QR) * R7inv * R - 2 * R5inv * QR;
+    } else {
+      for (Index j = 0; j < Index(box.points.size()); j++) {
+        Eigen::Vector3d r = box.points[j] - rvector;
+        result -= box.densities[j] * r / std::pow(r.norm(), 3);
+      }
+    }
+  }
+  return result;
+}
+
+template <class Grid>
+double DensityIntegration<Grid>::IntegratePotential_Multipoles(
+    const Eigen::Vector3d& rvector, double accuracy) const {
+  assert(!multipole_boxes_.empty() && "Multipole boxes not calculated");
+  const double box_accuracy = accuracy / double(multipole_boxes_.size());
+  double result = 0.0;
+  for (const MultipoleBox& box : multipole_boxes_) {
+    const Eigen::Vector3d R = rvector - box.center;
+    const double dist = R.norm();
+    // the terms beyond the quadrupole sum up to at most
+    // abs_charge/(dist-radius)*(radius/dist)^3
+    bool use_expansion = false;
+    if (dist > box.radius) {
+      const double ratio = box.radius / dist;
+      const double bound =
+          box.abs_charge / (dist - box.radius) * ratio * ratio * ratio;
+      use_expansion = bound < box_accuracy;
+    }
+    if (use_expansion) {
+      const double R3inv = 1.0 / (dist * dist * dist);
+      const double R5inv = R3inv / (dist * dist);
+      result -= box.charge / dist + box.dipole.dot(R) * R3inv +
+                R.dot(box.quadrupole * R) * R5inv;
+    } else {
+      for (Index j = 0; j < Index(box.points.size()); j++) {
+        result -= box.densities[j] / (box.points[j] - rvector).norm();
+      }
+    }
+  }
+  return result;
+}
+
 template <class Grid>
 void DensityIntegration<Grid>::SetupDensityContainer() {
+  multipole_boxes_.clear();
   densities_ = std::vector<std::vector<double> >(grid_.getBoxesSize());
   for (Index i = 0; i < grid_.getBoxesSize(); i++) {
     densities_[i] = std::vector<double>(grid_[i].size(), 0.0);
@@ -71,7 +71,7 @@ OpenMP_CUDA::OpenMP_CUDA() {
 }
 
 #ifdef USE_CUDA
-void OpenMP_CUDA::setOperators(const std::vector<Eigen::MatrixXd>& tensor,
+void OpenMP_CUDA::setOperators(Index tensor_rows,
                                const Eigen::MatrixXd& rightoperator) {
   rOP_ = rightoperator;
 
@@ -79,15 +79,13 @@ void OpenMP_CUDA::setOperators(const std::vector<Eigen::MatrixXd>& tensor,
   for (Index i = 0; i < Index(gpus_.size()); i++) {
     GPU_data& gpu = gpus_[i];
     gpu.activateGPU();
-    const Eigen::MatrixXd& head = tensor.front();
-    gpu.push_back(head.rows(), head.cols());
+    gpu.push_back(tensor_rows, rightoperator.rows());
     gpu.push_back(rightoperator);
-    gpu.push_back(head.rows(), rightoperator.cols());
+    gpu.push_back(tensor_rows, rightoperator.cols());
   }
 }
 #else
-void OpenMP_CUDA::setOperators(const std::vector<Eigen::MatrixXd>&,
-                               const Eigen::MatrixXd& rightoperator) {
+void OpenMP_CUDA::setOperators(Index, const Eigen::MatrixXd& rightoperator) {
   rOP_ = rightoperator;
 }
 #endif
@@ -128,7 +126,8 @@ Index OpenMP_CUDA::getNumberThreads() const {
  */
 
 #ifdef USE_CUDA
-void OpenMP_CUDA::MultiplyRight(Eigen::MatrixXd& tensor, Index OpenmpThread) {
+void OpenMP_CUDA::MultiplyRight(Eigen::Ref<Eigen::MatrixXd> tensor,
+                                Index OpenmpThread) {
 
   Index threadid = getParentThreadId(OpenmpThread);
   if (isGPUthread(threadid)) {
@@ -136,7 +135,7 @@ void OpenMP_CUDA::MultiplyRight(Eigen::MatrixXd& tensor, Index OpenmpThread) {
     gpu.activateGPU();
     gpu.Mat(0).copy_to_gpu(tensor);
     gpu.pipe().gemm(gpu.Mat(0), gpu.Mat(1), gpu.Mat(2));
-    tensor = gpu.Mat(2);
+    tensor = Eigen::MatrixXd(gpu.Mat(2));
   } else {
     tensor *= rOP_();
   }
@@ -144,7 +143,7 @@ void OpenMP_CUDA::MultiplyRight(Eigen::MatrixXd& tensor, Index OpenmpThread) {
 }
 
 #else
-void OpenMP_CUDA::MultiplyRight(Eigen::MatrixXd& tensor, Index) {
+void OpenMP_CUDA::MultiplyRight(Eigen::Ref<Eigen::MatrixXd> tensor, Index) {
   tensor *= rOP_();
 }
 #endif
@@ -331,7 +330,7 @@ void OpenMP_CUDA::SetTempZero(Index OpenmpThread) {
 #endif
 }
 
-void OpenMP_CUDA::PrepareMatrix2(const Eigen::Block<const Eigen::MatrixXd>& mat,
+void OpenMP_CUDA::PrepareMatrix2(const Eigen::Ref<const Eigen::MatrixXd>& mat,
                                  bool Hd2, Index OpenmpThread) {
   Index parentid = getParentThreadId(OpenmpThread);
   Index threadid = getLocalThreadId(parentid);
@@ -439,7 +438,7 @@ void OpenMP_CUDA::PushMatrix1(const Eigen::MatrixXd& mat, Index OpenmpThread) {
 #endif
 }
 
-void OpenMP_CUDA::MultiplyBlocks(const Eigen::Block<const Eigen::MatrixXd>& mat,
+void OpenMP_CUDA::MultiplyBlocks(const Eigen::Ref<const Eigen::MatrixXd>& mat,
                                  Index i1, Index i2, Index OpenmpThread) {
   Index parentid = getParentThreadId(OpenmpThread);
   Index threadid = getLocalThreadId(parentid);
@@ -18,8 +18,11 @@
  */
 
 // Standard includes
+#include <cassert>
 #include <iomanip>
+#include <memory>
 #include <numeric>
+#include <stdexcept>
 
 // Local VOTCA includes
 #include "votca/xtp/dipoledipoleinteraction.h"
@@ -27,6 +30,7 @@
 #include "votca/xtp/polarregion.h"
 #include "votca/xtp/qmregion.h"
 #include "votca/xtp/staticregion.h"
+#include "votca/xtp/staticsiteblock.h"
 
 namespace votca {
 namespace xtp {
@@ -35,7 +39,50 @@ void PolarRegion::Initialize(const tools::Property& prop) {
   max_iter_ = prop.get("max_iter").as<Index>();
   deltaD_ = prop.get("tolerance_dipole").as<double>();
   deltaE_ = prop.get("tolerance_energy").as<double>();
+  deltaD_max_ =
+      std::max(prop.get("tolerance_dipole_max").as<double>(), deltaD_);
+  dipole_history_.setMaxSize(prop.get("dipole_history").as<Index>());
   exp_damp_ = prop.get("exp_damp").as<double>();
+  nearfield_cutoff_ =
+      prop.get("nearfield_cutoff").as<double>() * tools::conv::nm2bohr;
+  nearfield_memory_ =
+      prop.get("nearfield_memory").as<double>() * 1024.0 * 1024.0;
+  farfield_cellsize_ =
+      prop.get("farfield_cellsize").as<double>() * tools::conv::nm2bohr;
+  farfield_accuracy_ = prop.get("farfield_accuracy").as<double>();
+  ewald_tolerance_ = prop.get("ewald_tolerance").as<double>();
+  if (farfield_accuracy_ >= 1.0) {
+    throw std::runtime_error(
+        "farfield_accuracy has to be smaller than 1, otherwise segments "
+        "would interact with their own cell");
+  }
+}
+
+template <class T, enum Estatic CE>
+double PolarRegion::ApplyStaticFieldFromCells(const MMRegion<T>& sources,
+                                              const SegmentCellList& cells,
+                                              bool skip_self) {
+  double e = 0.0;
+#pragma omp parallel for schedule(dynamic) reduction(+ : e)
+  for (Index i = 0; i < size(); ++i) {
+    PolarSegment& target = segments_[i];
+    const double radius = SegmentCellList::Radius(target);
+    eeInteractor eeinteractor;
+    for (Index c = 0; c < cells.size(); c++) {
+      if (cells.isFar(c, target.getPos(), radius, farfield_accuracy_)) {
+        e += eeinteractor.ApplyStaticField<StaticSegment, CE>(
+            cells.Expansion(c), target);
+        continue;
+      }
+      for (Index j : cells.Segments(c)) {
+        if (skip_self && j == i) {
+          continue;
+        }
+        e += eeinteractor.ApplyStaticField<T, CE>(sources[j], target);
+      }
+    }
+  }
+  return e;
 }
 
 bool PolarRegion::Converged() const {
@@ -46,7 +93,9 @@ bool PolarRegion::Converged() const {
   double Echange = E_hist_.getDiff().Etotal();
   std::string info = "not converged";
   bool converged = false;
-  if (std::abs(Echange) < deltaE_) {
+  if (cg_tolerance_ > deltaD_) {
+    info = "not converged, dipoles were not solved to tolerance_dipole,";
+  } else if (std::abs(Echange) < deltaE_) {
     info = "converged";
     converged = true;
   }
@@ -57,6 +106,48 @@ bool PolarRegion::Converged() const {
 }
 
 double PolarRegion::StaticInteraction() {
+  // the permanent multipoles of the region never change, so the field they
+  // create is computed once and reapplied after every Reset
+  if (static_field_.size() == 0) {
+    Eigen::VectorXd before = Eigen::VectorXd(CalcPolDoF());
+    Index index = 0;
+    for (const PolarSegment& seg : segments_) {
+      for (const PolarSite& site : seg) {
+        before.segment<3>(index) = site.V_noE();
+        index += 3;
+      }
+    }
+    E_static_static_ = CalcStaticInteraction();
+    static_field_ = Eigen::VectorXd(CalcPolDoF());
+    index = 0;
+    for (const PolarSegment& seg : segments_) {
+      for (const PolarSite& site : seg) {
+        static_field_.segment<3>(index) =
+            site.V_noE() - before.segment<3>(index);
+        index += 3;
+      }
+    }
+    return E_static_static_;
+  }
+  Index index = 0;
+  for (PolarSegment& seg : segments_) {
+    for (PolarSite& site : seg) {
+      site.V_noE() += static_field_.segment<3>(index);
+      index += 3;
+    }
+  }
+  return E_static_static_;
+}
+
+double PolarRegion::CalcStaticInteraction() {
+
+  if (farfield_cellsize_ > 0.0) {
+    if (!cells_) {
+      cells_ = std::make_unique<SegmentCellList>(segments_, farfield_cellsize_);
+    }
+    return 0.5 * ApplyStaticFieldFromCells<PolarSegment, Estatic::noE_V>(
+                     *this, *cells_, true);
+  }
 
   eeInteractor eeinteractor;
   double e = 0.0;
@@ -81,21 +172,59 @@ eeInteractor::E_terms PolarRegion::PolarEnergy() const {
                               : eeInteractor::E_terms \
                               : omp_out += omp_in)
 
+  assert(packed_sites_.SameGeometry(segments_) &&
+         "packed sites are stale, call ClearStaleTensors first");
   eeInteractor eeinteractor(exp_damp_);
+  // the permanent multipoles can change without the geometry, e.g. for
+  // another state of a segment, so they are packed for every evaluation
+  const StaticSiteBlock statics(segments_);
+  Eigen::MatrixXd dipoles(NumberOfSites(), 3);
+  std::vector<bool> packable(segments_.size());
+  Index index = 0;
+  for (Index i = 0; i < size(); ++i) {
+    packable[i] = StaticSiteBlock::Packable(segments_[i]);
+    for (const PolarSite& site : segments_[i]) {
+      dipoles.row(index) = site.Induced_Dipole().transpose();
+      index++;
+    }
+  }
 
   eeInteractor::E_terms terms;
 
-#pragma omp parallel for reduction(CustomPlus : terms)
+#pragma omp parallel for schedule(dynamic) reduction(CustomPlus : terms)
   for (Index i = 0; i < size(); ++i) {
-    for (Index j = 0; j < i; ++j) {
-      terms += eeinteractor.CalcPolarEnergy(segments_[i], segments_[j]);
+    if (!packable[i]) {
+      for (Index j = 0; j < i; ++j) {
+        terms += eeinteractor.CalcPolarEnergy(segments_[i], segments_[j]);
+      }
+      continue;
+    }
+    // consecutive packable segments are one range of the blocks, only the
+    // others need the pair kernels
+    Index first = 0;
+    for (Index j = 0; j <= i; ++j) {
+      if (j < i && packable[j]) {
+        continue;
+      }
+      const Index start = packed_sites_.SegmentStart(first);
+      const Index end = packed_sites_.SegmentStart(j);
+      if (end > start) {
+        terms += eeinteractor.CalcPolarEnergy_Block(
+            packed_sites_, statics, dipoles, packed_sites_.SegmentStart(i),
+            packed_sites_.SegmentSize(i), start, end - start);
+      }
+      if (j < i) {
+        terms += eeinteractor.CalcPolarEnergy(segments_[i], segments_[j]);
+      }
+      first = j + 1;
     }
   }
 
 #pragma omp parallel for reduction(CustomPlus : terms)
   for (Index i = 0; i < size(); ++i) {
-    terms.E_indu_indu() +=
-        eeinteractor.CalcPolarEnergy_IntraSegment(segments_[i]);
+    terms.E_indu_indu() += eeinteractor.CalcPolarEnergy_IntraSegment(
+        packed_sites_, dipoles, packed_sites_.SegmentStart(i),
+        packed_sites_.SegmentSize(i));
   }
 
 #pragma omp parallel for reduction(CustomPlus : terms)
@@ -118,6 +247,11 @@ double PolarRegion::PolarEnergy_extern() const {
   return e;
 }
 
+void PolarRegion::ClearHistory() {
+  E_hist_ = hist<Energy_terms>();
+  cg_tolerance_ = 0.0;
+}
+
 void PolarRegion::Reset() {
   for (PolarSegment& seg : segments_) {
     for (PolarSite& site : seg) {
@@ -133,26 +267,87 @@ void PolarRegion::AppendResult(tools::Property& prop) const {
   prop.add("E_total", std::to_string(e.Etotal() * tools::conv::hrt2ev));
 }
 
-Index PolarRegion::CalcPolDoF() const {
-  Index dof_polarization = 0;
+Index PolarRegion::CalcPolDoF() const { return 3 * NumberOfSites(); }
+
+void PolarRegion::CalcPeriodicField(const EwaldSum& ewald) {
+  periodic_field_ = CalcLatticeField(ewald);
+  lattice_box_ = ewald.Box();
+  dipole_lattice_ = nullptr;
+  lattice_damping_ = DipoleDipoleInteraction::NearFieldBlocks();
+}
+
+double PolarRegion::ApplyPeriodicField() {
+  if (periodic_field_.cols() == 0) {
+    return 0.0;
+  }
+  double e = 0.0;
+  Index index = 0;
+  for (PolarSegment& seg : segments_) {
+    for (PolarSite& site : seg) {
+      const Vector9d V = periodic_field_.col(index);
+      e += LatticeEnergy(site, V);
+      site.V() += V.segment<3>(1);
+      index++;
+    }
+  }
+  return e;
+}
+
+void PolarRegion::SetupDipoleLattice(const eeInteractor& interactor) {
+  std::vector<const StaticSite*> sites;
+  const PolarSite* softest = nullptr;
   for (const PolarSegment& seg : segments_) {
-    dof_polarization += seg.size() * 3;
+    for (const PolarSite& site : seg) {
+      sites.push_back(&site);
+      if (softest == nullptr || site.getSqrtInvEigenDamp() >
+                                    softest->getSqrtInvEigenDamp()) {
+        softest = &site;
+      }
+    }
+  }
+  dipole_lattice_ = std::make_unique<EwaldSum>(
+      lattice_box_, ewald_tolerance_, sites,
+      std::vector<bool>(sites.size(), true), Index(sites.size()));
+  // damped pairs are found through their closest image only
+  if (softest != nullptr &&
+      2 * interactor.TholeRange(*softest, *softest) >
+      dipole_lattice_->MinCellHeight()) {
+    throw std::runtime_error(
+        "The Thole damping range of region " + std::to_string(getId()) +
+        " exceeds half the cell height, the periodic images of its induced "
+        "dipoles cannot be included");
   }
-  return dof_polarization;
+  DipoleDipoleInteraction A(interactor, segments_, packed_sites_);
+  lattice_damping_ = A.CalcLatticeDampingBlocks(*dipole_lattice_);
+  XTP_LOG(Log::info, log_) << TimeStamp()
+                           << " Ewald sum of the induced dipoles with "
+                           << dipole_lattice_->NumberOfKvectors()
+                           << " k-vectors, " << lattice_damping_.block.size()
+                           << " Thole damped pairs" << std::flush;
 }
 
-Eigen::VectorXd PolarRegion::CalcInducedDipoleInsideSegments() const {
-  Index dof_polarization = CalcPolDoF();
-  Eigen::VectorXd initial_induced_dipoles =
-      Eigen::VectorXd::Zero(dof_polarization);
+double PolarRegion::InducedImageEnergy(const Eigen::VectorXd& x,
+                                       eeInteractor::E_terms central) {
+  // the periodic operator holds P^-1 and the interaction with all other
+  // dipoles and images, the pairs inside the cell are already in central
   eeInteractor interactor(exp_damp_);
+  DipoleDipoleInteraction A(interactor, segments_, packed_sites_);
+  A.setLattice(*dipole_lattice_, lattice_damping_);
+  return 0.5 * x.dot(A.multiply(x)) - central.E_internal() -
+         central.E_indu_indu();
+}
+
+Eigen::VectorXd PolarRegion::CalcExternalField() const {
+  Eigen::VectorXd b = Eigen::VectorXd::Zero(CalcPolDoF());
   Index index = 0;
   for (const PolarSegment& seg : segments_) {
-    initial_induced_dipoles.segment(index, 3 * seg.size()) =
-        interactor.Cholesky_IntraSegment(seg);
-    index += 3 * seg.size();
+    for (const PolarSite& site : seg) {
+      auto V = site.V() + site.V_noE();
+      b.segment<3>(index) = -V;
+      index += 3;
+    }
   }
-  return initial_induced_dipoles;
+  return b;
 }
 
 Eigen::VectorXd PolarRegion::ReadInducedDipolesFromLastIteration() const {
@@ -169,6 +364,25 @@ Eigen::VectorXd PolarRegion::ReadInducedDipolesFromLastIteration() const {
   return last_induced_dipoles;
 }
 
+Eigen::VectorXd PolarRegion::ExtrapolateInducedDipoles(
+    const Eigen::VectorXd& b) const {
+  XTP_LOG(Log::info, log_) << TimeStamp()
+                           << " Extrapolated induced dipoles from "
+                           << dipole_history_.size() << " previous solutions"
+                           << std::flush;
+  return dipole_history_.Extrapolate(b);
+}
+
+double PolarRegion::CGTolerance() const {
+  if (!E_hist_.filled()) {
+    return deltaD_;
+  }
+  // as long as the energy of the surrounding iterations changes a lot, the
+  // dipoles need not be accurate, the final ones are solved to deltaD_
+  double Echange = std::abs(E_hist_.getDiff().Etotal());
+  return std::min(std::max(deltaD_ * Echange / deltaE_, deltaD_), deltaD_max_);
+}
+
 void PolarRegion::WriteInducedDipolesToSegments(const Eigen::VectorXd& x) {
   Index index = 0;
   for (PolarSegment& seg : segments_) {
@@ -179,30 +393,49 @@ void PolarRegion::WriteInducedDipolesToSegments(const Eigen::VectorXd& x) {
   }
 }
 
+void PolarRegion::ClearStaleTensors() {
+  // segments can be replaced or moved between solves, the sites are compared
+  // directly instead of tracking every change
+  if (!packed_sites_.SameGeometry(segments_)) {
+    nearfield_ = DipoleDipoleInteraction::NearFieldBlocks();
+    dipole_lattice_ = nullptr;
+    lattice_damping_ = DipoleDipoleInteraction::NearFieldBlocks();
+    packed_sites_ = PolarSiteBlock(segments_);
+  }
+}
+
 Eigen::VectorXd PolarRegion::CalcInducedDipolesViaPCG(
-    const Eigen::VectorXd& initial_guess) {
-  Eigen::VectorXd b = Eigen::VectorXd::Zero(initial_guess.size());
-  Index index = 0;
-  for (PolarSegment& seg : segments_) {
-    for (const PolarSite& site : seg) {
-      auto V = site.V() + site.V_noE();
-      b.segment<3>(index) = -V;
-      index += 3;
+    const Eigen::VectorXd& b, const Eigen::VectorXd& initial_guess,
+    BlockJacobiPreconditioner intra_segment, double tolerance) {
+  eeInteractor interactor(exp_damp_);
+  DipoleDipoleInteraction A(interactor, segments_, packed_sites_);
+  if (periodic_field_.cols() > 0) {
+    if (!dipole_lattice_) {
+      SetupDipoleLattice(interactor);
+    }
+    A.setLattice(*dipole_lattice_, lattice_damping_);
+  } else if (nearfield_cutoff_ > 0.0) {
+    if (nearfield_.row_start.empty()) {
+      nearfield_ = A.CalcNearFieldBlocks(nearfield_cutoff_, nearfield_memory_);
+      XTP_LOG(Log::info, log_)
+          << TimeStamp() << " Stored " << nearfield_.block.size()
+          << " near field Thole tensors" << std::flush;
     }
+    A.setNearFieldBlocks(nearfield_);
   }
-  eeInteractor interactor(exp_damp_);
-  DipoleDipoleInteraction A(interactor, segments_);
   Eigen::ConjugateGradient<DipoleDipoleInteraction, Eigen::Lower | Eigen::Upper,
-                           Eigen::DiagonalPreconditioner<double>>
+                           BlockJacobiPreconditioner>
       cg;
+  cg.preconditioner() = std::move(intra_segment);
   cg.setMaxIterations(max_iter_);
-  cg.setTolerance(deltaD_);
+  cg.setTolerance(tolerance);
   cg.compute(A);
   Eigen::VectorXd x = cg.solveWithGuess(b, initial_guess);
 
   XTP_LOG(Log::error, log_)
       << TimeStamp() << " CG: #iterations: " << cg.iterations()
-      << ", estimated error: " << cg.error() << std::flush;
+      << ", estimated error: " << cg.error() << ", tolerance: " << tolerance
+      << std::flush;
 
   if (cg.info() == Eigen::ComputationInfo::NoConvergence) {
     info_ = false;
@@ -222,6 +455,12 @@ void PolarRegion::Evaluate(std::vector<std::unique_ptr<Region>>& regions) {
   Energy_terms e_contrib;
   e_contrib.E_static_ext() =
       std::accumulate(energies.begin(), energies.end(), 0.0);
+  if (periodic_field_.cols() > 0) {
+    e_contrib.E_static_ext() += ApplyPeriodicField();
+    XTP_LOG(Log::info, log_) << TimeStamp()
+                             << " Applied field of the periodic images"
+                             << std::flush;
+  }
   XTP_LOG(Log::info, log_) << TimeStamp()
                            << " Calculated static-static and polar-static "
                               "interaction with other regions"
@@ -235,30 +474,63 @@ void PolarRegion::Evaluate(std::vector<std::unique_ptr<Region>>& regions) {
       << TimeStamp() << " Starting Solving for classical polarization with "
       << dof_polarization << " degrees of freedom." << std::flush;
 
+  ClearStaleTensors();
+  // the factorised segment blocks give the initial guess and precondition
+  // the CG iterations
+  eeInteractor interactor(exp_damp_);
+  BlockJacobiPreconditioner intra_segment;
+  intra_segment.setup(interactor, segments_);
+  if (intra_segment.info() != Eigen::Success) {
+    info_ = false;
+    errormsg_ = "Cholesky decomposition of a segment failed";
+    return;
+  }
+  const Eigen::VectorXd b = CalcExternalField();
+  // a single segment is solved exactly, unless it sees its periodic images
+  const bool periodic = (periodic_field_.cols() > 0);
+  const bool single_segment = (segments_.size() == 1 && !periodic);
+
+  // earlier solutions stay valid after ClearHistory, the interaction matrix
+  // only depends on the geometry of the region
   Eigen::VectorXd initial_induced_dipoles;
-  if (!E_hist_.filled() || segments_.size() == 1) {
-    initial_induced_dipoles = CalcInducedDipoleInsideSegments();
-  } else {
+  if (single_segment) {
+    initial_induced_dipoles = intra_segment.solve(b);
+  } else if (!dipole_history_.empty()) {
+    initial_induced_dipoles = ExtrapolateInducedDipoles(b);
+  } else if (E_hist_.filled()) {
     initial_induced_dipoles = ReadInducedDipolesFromLastIteration();
+  } else {
+    initial_induced_dipoles = intra_segment.solve(b);
   }
 
   Eigen::VectorXd x;  // if only one segment
   // it is solved exactly through the initial guess
-  if (segments_.size() != 1) {
-    x = CalcInducedDipolesViaPCG(initial_induced_dipoles);
+  if (!single_segment) {
+    cg_tolerance_ = CGTolerance();
+    x = CalcInducedDipolesViaPCG(b, initial_induced_dipoles,
+                                 std::move(intra_segment), cg_tolerance_);
     if (!info_) {
       return;
     }
+    dipole_history_.push_back(b, x);
   } else {
+    cg_tolerance_ = deltaD_;
     x = initial_induced_dipoles;
   }
 
   WriteInducedDipolesToSegments(x);
 
-  e_contrib.addInternalPolarContrib(PolarEnergy());
+  const eeInteractor::E_terms polar_terms = PolarEnergy();
+  e_contrib.addInternalPolarContrib(polar_terms);
   XTP_LOG(Log::info, log_) << TimeStamp()
                            << " Calculated polar interaction in region"
                            << std::flush;
+  double E_images = 0.0;
+  if (periodic) {
+    // the images of the induced dipoles of other regions are not included
+    E_images = InducedImageEnergy(x, polar_terms);
+    e_contrib.E_indu_indu() += E_images;
+  }
   e_contrib.E_polar_ext() = PolarEnergy_extern();
   XTP_LOG(Log::info, log_) << TimeStamp()
                            << " Calculated polar interaction with other regions"
@@ -277,6 +549,11 @@ void PolarRegion::Evaluate(std::vector<std::unique_ptr<Region>>& regions) {
   XTP_LOG(Log::info, log_) << std::setprecision(10)
                            << "   internal dQ-dQ energy [hrt]= "
                            << e_contrib.E_indu_indu() << std::flush;
+  if (periodic) {
+    XTP_LOG(Log::info, log_) << std::setprecision(10)
+                             << "    of which with periodic images [hrt]= "
+                             << E_images << std::flush;
+  }
 
   XTP_LOG(Log::info, log_) << std::setprecision(10)
                            << "   internal Q-dQ energy [hrt]= "
@@ -335,6 +612,11 @@ double PolarRegion::InteractwithPolarRegion(const PolarRegion& region) {
 double PolarRegion::InteractwithStaticRegion(const StaticRegion& region) {
   // Static regions always have higher ids than other regions
 
+  if (farfield_cellsize_ > 0.0) {
+    return ApplyStaticFieldFromCells<StaticSegment, Estatic::V>(
+        region, region.CellList(farfield_cellsize_), false);
+  }
+
   double e = 0.0;
 #pragma omp parallel for reduction(+ : e)
   for (Index i = 0; i < Index(segments_.size()); i++) {
@@ -352,10 +634,33 @@ double PolarRegion::InteractwithStaticRegion(const StaticRegion& region) {
 
 void PolarRegion::WriteToCpt(CheckpointWriter& w) const {
   MMRegion<PolarSegment>::WriteToCpt(w);
+  // a restarted job does not rebuild the lattice, so the field is stored
+  w(ewald_tolerance_, "ewald_tolerance");
+  bool periodic = (periodic_field_.cols() > 0);
+  w(periodic, "periodic");
+  if (periodic) {
+    w(periodic_field_, "periodic_field");
+    w(lattice_box_, "lattice_box");
+  }
 }
 
 void PolarRegion::ReadFromCpt(CheckpointReader& r) {
   MMRegion<PolarSegment>::ReadFromCpt(r);
+  nearfield_ = DipoleDipoleInteraction::NearFieldBlocks();
+  cells_ = nullptr;
+  r(ewald_tolerance_, "ewald_tolerance");
+  bool periodic = false;
+  r(periodic, "periodic");
+  if (periodic) {
+    r(periodic_field_, "periodic_field");
+    r(lattice_box_, "lattice_box");
+  } else {
+    periodic_field_.resize(9, 0);
+  }
+  dipole_lattice_ = nullptr;
+  lattice_damping_ = DipoleDipoleInteraction::NearFieldBlocks();
+  dipole_history_.clear();
+  static_field_.resize(0);
 }
 
 }  // namespace xtp
@@ -63,6 +63,7 @@ void QMRegion::Initialize(const tools::Property& prop) {
 
   grid_accuracy_for_ext_interaction_ =
       prop.get("grid_for_potential").as<std::string>();
+  field_accuracy_ = prop.get("field_accuracy").as<double>();
   DeltaE_ = prop.get("tolerance_energy").as<double>();
   DeltaD_ = prop.get("tolerance_density").as<double>();
 
@@ -260,11 +261,20 @@ void QMRegion::ApplyQMFieldToPolarSegments(
         << ", you should increase the accuracy of the integration grid."
         << std::flush;
   }
-#pragma omp parallel for
+  if (field_accuracy_ > 0.0) {
+    constexpr double boxsize = 2;  // 2 bohr
+    numint.SetupMultipoleBoxes(boxsize);
+  }
+#pragma omp parallel for schedule(dynamic)
   for (Index i = 0; i < Index(segments.size()); ++i) {
     PolarSegment& seg = segments[i];
     for (PolarSite& site : seg) {
-      site.V_noE() += numint.IntegrateField(site.getPos());
+      if (field_accuracy_ > 0.0) {
+        site.V_noE() +=
+            numint.IntegrateField_Multipoles(site.getPos(), field_accuracy_);
+      } else {
+        site.V_noE() += numint.IntegrateField(site.getPos());
+      }
     }
   }
 
@@ -0,0 +1,89 @@
+/*
+ *            Copyright 2009-2020 The VOTCA Development Team
+ *                       (http://www.votca.org)
+ *
+ *      Licensed under the Apache License, Version 2.0 (the "License")
+ *
+ * You may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *              http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+// Standard includes
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <stdexcept>
+#include <sys/mman.h>
+#include <unistd.h>
+#include <vector>
+
+// Local VOTCA includes
+#include "votca/xtp/scratchfile.h"
+
+namespace votca {
+namespace xtp {
+
+ScratchFile::ScratchFile(const std::string& directory, Index size)
+    : size_(size) {
+  std::string name = directory + "/xtp_scratch_XXXXXX";
+  std::vector<char> path(name.begin(), name.end());
+  path.push_back('\0');
+  fd_ = mkstemp(path.data());
+  if (fd_ < 0) {
+    throw std::runtime_error("Could not create scratch file in " + directory +
+                             ": " + std::strerror(errno));
+  }
+  // the file stays accessible via fd_ only
+  unlink(path.data());
+
+  // a file extended by ftruncate reads as zeros
+  off_t bytes = off_t(size_) * off_t(sizeof(double));
+  void* map = MAP_FAILED;
+  if (bytes > 0 && ftruncate(fd_, bytes) == 0) {
+    map = mmap(nullptr, size_t(bytes), PROT_READ | PROT_WRITE, MAP_SHARED, fd_,
+               0);
+  }
+  if (bytes > 0 && map == MAP_FAILED) {
+    std::string error = std::strerror(errno);
+    close(fd_);
+    throw std::runtime_error("Could not map scratch file of " +
+                             std::to_string(bytes) + " bytes in " + directory +
+                             ": " + error);
+  }
+  data_ = (bytes > 0) ? static_cast<double*>(map) : nullptr;
+}
+
+ScratchFile::~ScratchFile() {
+  if (data_ != nullptr) {
+    munmap(data_, size_t(size_) * sizeof(double));
+  }
+  if (fd_ >= 0) {
+    close(fd_);
+  }
+}
+
+void ScratchFile::Prefetch(Index start, Index length) const {
+  if (data_ == nullptr || length <= 0) {
+    return;
+  }
+  // madvise needs a page aligned address
+  const size_t pagesize = size_t(sysconf(_SC_PAGESIZE));
+  size_t begin = size_t(start) * sizeof(double);
+  size_t end = size_t(start + length) * sizeof(double);
+  begin -= begin % pagesize;
+  char* address = reinterpret_cast<char*>(data_) + begin;
+  // only a hint, so failures are ignored
+  madvise(address, end - begin, MADV_WILLNEED);
+}
+
+}  // namespace xtp
+}  // namespace votca
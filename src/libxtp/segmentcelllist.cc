@@ -0,0 +1,117 @@
+/*
+ *            Copyright 2009-2020 The VOTCA Development Team
+ *                       (http://www.votca.org)
+ *
+ *      Licensed under the Apache License, Version 2.0 (the "License")
+ *
+ * You may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *              http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+// Standard includes
+#include <array>
+#include <cmath>
+#include <map>
+
+// Local VOTCA includes
+#include "votca/xtp/segmentcelllist.h"
+
+namespace votca {
+namespace xtp {
+
+template <class T>
+SegmentCellList::SegmentCellList(const std::vector<T>& segments,
+                                 double cellsize)
+    : cellsize_(cellsize) {
+  if (segments.empty()) {
+    return;
+  }
+  Eigen::Vector3d min = segments.front().getPos();
+  for (const T& seg : segments) {
+    min = min.cwiseMin(seg.getPos());
+  }
+
+  std::map<std::array<Index, 3>, Index> cell_ids;
+  for (Index i = 0; i < Index(segments.size()); i++) {
+    const Eigen::Vector3d index = (segments[i].getPos() - min) / cellsize_;
+    std::array<Index, 3> key = {Index(std::floor(index.x())),
+                                Index(std::floor(index.y())),
+                                Index(std::floor(index.z()))};
+    auto it = cell_ids.find(key);
+    if (it == cell_ids.end()) {
+      it = cell_ids.emplace(key, Index(cells_.size())).first;
+      cells_.push_back(Cell());
+    }
+    cells_[it->second].segments.push_back(i);
+  }
+
+  for (Cell& cell : cells_) {
+    CalcExpansion(segments, cell);
+  }
+}
+
+template <class T>
+void SegmentCellList::CalcExpansion(const std::vector<T>& segments,
+                                    Cell& cell) const {
+  Eigen::Vector3d center = Eigen::Vector3d::Zero();
+  Index nsites = 0;
+  for (Index i : cell.segments) {
+    for (const auto& site : segments[i]) {
+      center += site.getPos();
+      nsites++;
+    }
+  }
+  center /= double(nsites);
+
+  // shifts all multipoles to the centre, quadrupoles are traceless
+  // theta=1/2 sum q (3rr-r^2) like StaticSite::CalculateCartesianMultipole
+  double charge = 0.0;
+  Eigen::Vector3d dipole = Eigen::Vector3d::Zero();
+  Eigen::Matrix3d theta = Eigen::Matrix3d::Zero();
+  for (Index i : cell.segments) {
+    for (const auto& site : segments[i]) {
+      const Eigen::Vector3d r = site.getPos() - center;
+      cell.radius = std::max(cell.radius, r.norm());
+      const double q = site.getCharge();
+      charge += q;
+      dipole += q * r;
+      theta += 0.5 * q *
+               (3 * r * r.transpose() -
+                r.squaredNorm() * Eigen::Matrix3d::Identity());
+      if (site.getRank() > 0) {
+        const Eigen::Vector3d d = site.Q().template segment<3>(1);
+        dipole += d;
+        theta += 0.5 * (3 * (r * d.transpose() + d * r.transpose()) -
+                        2 * r.dot(d) * Eigen::Matrix3d::Identity());
+      }
+      if (site.getRank() > 1) {
+        theta += site.CalculateCartesianMultipole();
+      }
+    }
+  }
+
+  Vector9d multipoles;
+  multipoles(0) = charge;
+  multipoles.segment<3>(1) = dipole;
+  multipoles.segment<5>(4) = StaticSite::CalculateSphericalMultipole(theta);
+  StaticSite expansion(0, "X", center);
+  expansion.setMultipole(multipoles, 2);
+  cell.expansion.push_back(expansion);
+}
+
+template SegmentCellList::SegmentCellList(
+    const std::vector<StaticSegment>& segments, double cellsize);
+template SegmentCellList::SegmentCellList(
+    const std::vector<PolarSegment>& segments, double cellsize);
+
+}  // namespace xtp
+}  // namespace votca
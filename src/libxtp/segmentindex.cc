@@ -0,0 +1,123 @@
+/*
+ *            Copyright 2009-2020 The VOTCA Development Team
+ *                       (http://www.votca.org)
+ *
+ *      Licensed under the Apache License, Version 2.0 (the "License")
+ *
+ * You may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *              http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+// Standard includes
+#include <algorithm>
+#include <cmath>
+
+// Local VOTCA includes
+#include "votca/xtp/segment.h"
+#include "votca/xtp/segmentindex.h"
+
+namespace votca {
+namespace xtp {
+
+SegmentIndex::SegmentIndex(const Topology& top, double cellsize) : top_(top) {
+  const std::vector<Segment>& segments = top_.Segments();
+  Eigen::Matrix3d box = top_.getBox();
+  if (box.isApproxToConstant(0)) {
+    periodic_ = false;
+    Eigen::Vector3d min = Eigen::Vector3d::Zero();
+    Eigen::Vector3d max = Eigen::Vector3d::Zero();
+    if (!segments.empty()) {
+      min = segments.front().getPos();
+      max = min;
+    }
+    for (const Segment& seg : segments) {
+      min = min.cwiseMin(seg.getPos());
+      max = max.cwiseMax(seg.getPos());
+    }
+    origin_ = min;
+    box = (max - min + Eigen::Vector3d::Ones()).asDiagonal();
+  }
+  inv_box_ = box.inverse();
+
+  if (cellsize <= 0.0) {
+    double volume = std::abs(box.determinant());
+    cellsize = std::cbrt(8.0 * volume /
+                         double(std::max(segments.size(), size_t(1))));
+  }
+  for (Index i = 0; i < 3; i++) {
+    const double height = 1.0 / inv_box_.row(i).norm();
+    ncells_[i] = std::max(Index(1), Index(std::floor(height / cellsize)));
+    cellheight_[i] = height / double(ncells_[i]);
+  }
+
+  cells_ = std::vector<std::vector<Index>>(ncells_[0] * ncells_[1] *
+                                           ncells_[2]);
+  for (const Segment& seg : segments) {
+    cells_[CellIndex(CellOf(seg.getPos()))].push_back(seg.getId());
+  }
+}
+
+std::array<Index, 3> SegmentIndex::CellOf(const Eigen::Vector3d& pos) const {
+  Eigen::Vector3d frac = inv_box_ * (pos - origin_);
+  if (periodic_) {
+    frac = frac.array() - frac.array().floor();
+  }
+  std::array<Index, 3> cell;
+  for (Index i = 0; i < 3; i++) {
+    Index c = Index(std::floor(frac[i] * double(ncells_[i])));
+    cell[i] = std::min(std::max(c, Index(0)), ncells_[i] - 1);
+  }
+  return cell;
+}
+
+std::vector<Index> SegmentIndex::FindSegments(const Eigen::Vector3d& pos,
+                                              double radius) const {
+  const std::array<Index, 3> center = CellOf(pos);
+  std::array<std::vector<Index>, 3> ranges;
+  for (Index i = 0; i < 3; i++) {
+    Index reach = Index(std::ceil(radius / cellheight_[i]));
+    if (periodic_ && 2 * reach + 1 >= ncells_[i]) {
+      // every cell once, the sphere wraps around the box
+      for (Index c = 0; c < ncells_[i]; c++) {
+        ranges[i].push_back(c);
+      }
+      continue;
+    }
+    for (Index c = center[i] - reach; c <= center[i] + reach; c++) {
+      if (periodic_) {
+        ranges[i].push_back((c + ncells_[i]) % ncells_[i]);
+      } else if (c >= 0 && c < ncells_[i]) {
+        ranges[i].push_back(c);
+      }
+    }
+  }
+
+  std::vector<Index> result;
+  const double radius2 = radius * radius;
+  for (Index c0 : ranges[0]) {
+    for (Index c1 : ranges[1]) {
+      for (Index c2 : ranges[2]) {
+        for (Index id : cells_[CellIndex({c0, c1, c2})]) {
+          const Eigen::Vector3d& other = top_.getSegment(id).getPos();
+          if (top_.PbShortestConnect(pos, other).squaredNorm() < radius2) {
+            result.push_back(id);
+          }
+        }
+      }
+    }
+  }
+  std::sort(result.begin(), result.end());
+  return result;
+}
+
+}  // namespace xtp
+}  // namespace votca
@@ -50,7 +50,7 @@ void Sigma_CDA::PrepareScreening() {
 // inversion and multiplication with and Imx vector, a linear system
 // is solved.
 double Sigma_CDA::CalcDiagContribution(
-    const Eigen::MatrixXd::ConstRowXpr& Imx_row, double delta,
+    const Eigen::Ref<const Eigen::RowVectorXd>& Imx_row, double delta,
     double eta) const {
   std::complex<double> delta_eta(delta, eta);
 
@@ -91,7 +91,7 @@ double Sigma_CDA::CalcResidueContribution(double frequency,
   Index homo = opt_.homo - opt_.rpamin;
   Index lumo = homo + 1;
   double fermi_rpa = (rpa_energies(lumo) + rpa_energies(homo)) / 2.0;
-  const Eigen::MatrixXd& Imx = Mmn_[gw_level_offset];
+  auto Imx = Mmn_[gw_level_offset];
 
   for (Index i = 0; i < rpatotal; ++i) {
     double delta = rpa_energies(i) - frequency;
@@ -120,7 +120,9 @@ double Sigma_CDA::CalcResidueContribution(double frequency,
 // and residue contributions
 double Sigma_CDA::CalcCorrelationDiagElement(Index gw_level,
                                              double frequency) const {
-
+  // callers run over the levels in parallel, so the block of the level one
+  // round of threads ahead is read from the scratch file in the background
+  Mmn_.Prefetch(gw_level + opt_.qpmin - opt_.rpamin);
   double sigma_c_residue = CalcResidueContribution(frequency, gw_level);
   double sigma_c_integral = gq_.SigmaGQDiag(frequency, gw_level, rpa_.getEta());
   return sigma_c_residue + sigma_c_integral;
@@ -129,7 +131,7 @@ double Sigma_CDA::CalcCorrelationDiagElement(Index gw_level,
 // Calculates the contribuion of the tail correction to the
 // residue term
 double Sigma_CDA::CalcDiagContributionValue_tail(
-    const Eigen::MatrixXd::ConstRowXpr& Imx_row, double delta,
+    const Eigen::Ref<const Eigen::RowVectorXd>& Imx_row, double delta,
     double alpha) const {
 
   double erfc_factor = 0.5 * std::copysign(1.0, delta) *
@@ -74,12 +74,13 @@ class Sigma_CDA : public Sigma_base {
   double CalcResidueContribution(double frequency, Index gw_level) const;
 
   // Sigma_c part from a single residue for a given gw_level and frequency
-  double CalcDiagContribution(const Eigen::MatrixXd::ConstRowXpr& Imx_row,
-                              double delta, double eta) const;
+  double CalcDiagContribution(
+      const Eigen::Ref<const Eigen::RowVectorXd>& Imx_row, double delta,
+      double eta) const;
 
   // Sigma_c part from Gaussian tail correction
   double CalcDiagContributionValue_tail(
-      const Eigen::MatrixXd::ConstRowXpr& Imx_row, double delta,
+      const Eigen::Ref<const Eigen::RowVectorXd>& Imx_row, double delta,
       double alpha) const;
 
   ImaginaryAxisIntegration gq_;
@@ -75,6 +75,54 @@ double Sigma_Exact::CalcCorrelationDiagElementDerivative(
   return 2 * dsigma_domega;
 }
 
+Eigen::VectorXd Sigma_Exact::CalcCorrelationDiagElementOnGrid(
+    Index gw_level, const Eigen::VectorXd& frequencies) const {
+  const double eta2 = opt_.eta * opt_.eta;
+  const Index lumo = opt_.homo + 1;
+  const Index n_occ = lumo - opt_.rpamin;
+  const Index n_unocc = opt_.rpamax - opt_.homo;
+  const Eigen::MatrixXd res2 = residues_[gw_level].cwiseAbs2();
+  const Eigen::VectorXd& RPAEnergies = rpa_.getRPAInputEnergies();
+  Eigen::ArrayXXd temp(RPAEnergies.size(), frequencies.size());
+  Eigen::VectorXd sigma = Eigen::VectorXd::Zero(frequencies.size());
+  for (Index s = 0; s < rpa_omegas_.size(); s++) {
+    const double eigenvalue = rpa_omegas_(s);
+    Eigen::ArrayXd poles = RPAEnergies;
+    poles.segment(0, n_occ) -= eigenvalue;
+    poles.segment(n_occ, n_unocc) += eigenvalue;
+    temp.colwise() = -poles;
+    temp.rowwise() += frequencies.transpose().array();
+    sigma.noalias() +=
+        (temp / (temp.abs2() + eta2)).matrix().transpose() * res2.col(s);
+  }
+  return 2 * sigma;
+}
+
+Eigen::VectorXd Sigma_Exact::CalcCorrelationDiagElementDerivativeOnGrid(
+    Index gw_level, const Eigen::VectorXd& frequencies) const {
+  const double eta2 = opt_.eta * opt_.eta;
+  const Index lumo = opt_.homo + 1;
+  const Index n_occ = lumo - opt_.rpamin;
+  const Index n_unocc = opt_.rpamax - opt_.homo;
+  const Eigen::MatrixXd res2 = residues_[gw_level].cwiseAbs2();
+  const Eigen::VectorXd& RPAEnergies = rpa_.getRPAInputEnergies();
+  Eigen::ArrayXXd temp(RPAEnergies.size(), frequencies.size());
+  Eigen::VectorXd dsigma_domega = Eigen::VectorXd::Zero(frequencies.size());
+  for (Index s = 0; s < rpa_omegas_.size(); s++) {
+    const double eigenvalue = rpa_omegas_(s);
+    Eigen::ArrayXd poles = RPAEnergies;
+    poles.segment(0, n_occ) -= eigenvalue;
+    poles.segment(n_occ, n_unocc) += eigenvalue;
+    temp.colwise() = -poles;
+    temp.rowwise() += frequencies.transpose().array();
+    const Eigen::ArrayXXd temp2 = temp.abs2();
+    dsigma_domega.noalias() +=
+        ((eta2 - temp2) / (temp2 + eta2).abs2()).matrix().transpose() *
+        res2.col(s);
+  }
+  return 2 * dsigma_domega;
+}
+
 double Sigma_Exact::CalcCorrelationOffDiagElement(Index gw_level1,
                                                   Index gw_level2,
                                                   double frequency1,
@@ -105,6 +153,39 @@ double Sigma_Exact::CalcCorrelationOffDiagElement(Index gw_level1,
   return 2.0 * sigma_c;
 }
 
+// Same structure as the off-diagonal elements in Sigma_PPM with the residues
+// in place of the Mmn and the RPA excitations in place of the PPM poles
+Eigen::MatrixXd Sigma_Exact::CalcCorrelationOffDiag(
+    const Eigen::VectorXd& frequencies) const {
+  const double eta2 = opt_.eta * opt_.eta;
+  const Index lumo = opt_.homo + 1;
+  const Index n_occ = lumo - opt_.rpamin;
+  const Index rpasize = rpa_omegas_.size();
+  const Eigen::VectorXd& RPAEnergies = rpa_.getRPAInputEnergies();
+
+  Eigen::MatrixXd T = Eigen::MatrixXd::Zero(qptotal_, qptotal_);
+#pragma omp parallel for schedule(dynamic) reduction(+ : T)
+  for (Index k = 0; k < RPAEnergies.size(); k++) {
+    Eigen::MatrixXd Rk(qptotal_, rpasize);
+    for (Index gw_level = 0; gw_level < qptotal_; gw_level++) {
+      Rk.row(gw_level) = residues_[gw_level].row(k);
+    }
+    const Eigen::ArrayXd poles =
+        (k < n_occ) ? Eigen::ArrayXd(RPAEnergies(k) - rpa_omegas_.array())
+                    : Eigen::ArrayXd(RPAEnergies(k) + rpa_omegas_.array());
+    Eigen::ArrayXXd temp(qptotal_, rpasize);
+    temp.colwise() = frequencies.array();
+    temp.rowwise() -= poles.transpose();
+    temp /= temp.abs2() + eta2;
+    T.noalias() += (temp * Rk.array()).matrix() * Rk.transpose();
+  }
+  // the factor 2.0 for both (identical) spin states cancels the factor 0.5
+  // of the two frequency terms
+  Eigen::MatrixXd result = T + T.transpose();
+  result.diagonal().setZero();
+  return result;
+}
+
 Eigen::MatrixXd Sigma_Exact::CalcResidues(Index gw_level,
                                           const Eigen::MatrixXd& XpY) const {
   const Index lumo = opt_.homo + 1;
@@ -113,7 +194,7 @@ Eigen::MatrixXd Sigma_Exact::CalcResidues(Index gw_level,
   const Index rpasize = n_occ * n_unocc;
   const Index qpoffset = opt_.qpmin - opt_.rpamin;
   vc2index vc = vc2index(0, 0, n_unocc);
-  const Eigen::MatrixXd& Mmn_i = Mmn_[gw_level + qpoffset];
+  auto Mmn_i = Mmn_[gw_level + qpoffset];
   Eigen::MatrixXd res = Eigen::MatrixXd::Zero(rpatotal_, rpasize);
   for (Index v = 0; v < n_occ; v++) {  // Sum over v
     auto Mmn_v = Mmn_[v].middleRows(n_occ, n_unocc);
@@ -48,6 +48,17 @@ class Sigma_Exact : public Sigma_base {
                                        double frequency1,
                                        double frequency2) const final;
 
+  // Calculates all Sigma_c off-diagonal elements via matrix products
+  Eigen::MatrixXd CalcCorrelationOffDiag(
+      const Eigen::VectorXd& frequencies) const final;
+
+  // Calculates Sigma_c diagonal element of one level on a set of frequencies
+  Eigen::VectorXd CalcCorrelationDiagElementOnGrid(
+      Index gw_level, const Eigen::VectorXd& frequencies) const final;
+
+  Eigen::VectorXd CalcCorrelationDiagElementDerivativeOnGrid(
+      Index gw_level, const Eigen::VectorXd& frequencies) const final;
+
  private:
   Eigen::VectorXd rpa_omegas_;             // Eigenvalues from RPA
   std::vector<Eigen::MatrixXd> residues_;  // Residues
@@ -40,6 +40,7 @@ double Sigma_PPM::CalcCorrelationDiagElement(Index gw_level,
   const double eta2 = opt_.eta * opt_.eta;
   const Index levelsum = Mmn_.nsize();  // total number of bands
   const Index qpmin_offset = opt_.qpmin - opt_.rpamin;
+  Mmn_.Prefetch(gw_level + qpmin_offset);
   double sigma = 0.0;
   for (Index i_aux = 0; i_aux < Mmn_.auxsize(); i_aux++) {
     // the ppm_weights smaller 1.e-5 are set to zero in rpa.cc
@@ -66,6 +67,7 @@ double Sigma_PPM::CalcCorrelationDiagElementDerivative(Index gw_level,
   const double eta2 = opt_.eta * opt_.eta;
   const Index levelsum = Mmn_.nsize();  // total number of bands
   const Index qpmin_offset = opt_.qpmin - opt_.rpamin;
+  Mmn_.Prefetch(gw_level + qpmin_offset);
   double dsigma_domega = 0.0;
   for (Index i_aux = 0; i_aux < Mmn_.auxsize(); i_aux++) {
     // the ppm_weights smaller 1.e-5 are set to zero in rpa.cc
@@ -86,6 +88,73 @@ double Sigma_PPM::CalcCorrelationDiagElementDerivative(Index gw_level,
   return dsigma_domega;
 }
 
+// The Mmn column of each auxiliary function is read once and the
+// denominators for all frequencies are evaluated as one (levels x
+// frequencies) array, which is then contracted with the Mmn column.
+Eigen::VectorXd Sigma_PPM::CalcCorrelationDiagElementOnGrid(
+    Index gw_level, const Eigen::VectorXd& frequencies) const {
+  const Index lumo = opt_.homo + 1;
+  const double eta2 = opt_.eta * opt_.eta;
+  const Index levelsum = Mmn_.nsize();  // total number of bands
+  const Index qpmin_offset = opt_.qpmin - opt_.rpamin;
+  Mmn_.Prefetch(gw_level + qpmin_offset);
+  auto Mmn = Mmn_[gw_level + qpmin_offset];
+  const Eigen::VectorXd& RPAEnergies = rpa_.getRPAInputEnergies();
+  Eigen::ArrayXXd temp(levelsum, frequencies.size());
+  Eigen::VectorXd sigma = Eigen::VectorXd::Zero(frequencies.size());
+  for (Index i_aux = 0; i_aux < Mmn_.auxsize(); i_aux++) {
+    // the ppm_weights smaller 1.e-5 are set to zero in rpa.cc
+    // PPM_construct_parameters
+    if (ppm_.getPpm_weight()(i_aux) < 1.e-9) {
+      continue;
+    }
+    const double ppm_freq = ppm_.getPpm_freq()(i_aux);
+    const double fac = 0.5 * ppm_.getPpm_weight()(i_aux) * ppm_freq;
+    const Eigen::VectorXd Mmn2 = Mmn.col(i_aux).cwiseAbs2();
+    Eigen::ArrayXd poles = RPAEnergies;
+    poles.segment(0, lumo) -= ppm_freq;
+    poles.segment(lumo, levelsum - lumo) += ppm_freq;
+    temp.colwise() = -poles;
+    temp.rowwise() += frequencies.transpose().array();
+    sigma.noalias() +=
+        fac * (temp / (temp.abs2() + eta2)).matrix().transpose() * Mmn2;
+  }
+  return sigma;
+}
+
+Eigen::VectorXd Sigma_PPM::CalcCorrelationDiagElementDerivativeOnGrid(
+    Index gw_level, const Eigen::VectorXd& frequencies) const {
+  const Index lumo = opt_.homo + 1;
+  const double eta2 = opt_.eta * opt_.eta;
+  const Index levelsum = Mmn_.nsize();  // total number of bands
+  const Index qpmin_offset = opt_.qpmin - opt_.rpamin;
+  Mmn_.Prefetch(gw_level + qpmin_offset);
+  auto Mmn = Mmn_[gw_level + qpmin_offset];
+  const Eigen::VectorXd& RPAEnergies = rpa_.getRPAInputEnergies();
+  Eigen::ArrayXXd temp(levelsum, frequencies.size());
+  Eigen::VectorXd dsigma_domega = Eigen::VectorXd::Zero(frequencies.size());
+  for (Index i_aux = 0; i_aux < Mmn_.auxsize(); i_aux++) {
+    // the ppm_weights smaller 1.e-5 are set to zero in rpa.cc
+    // PPM_construct_parameters
+    if (ppm_.getPpm_weight()(i_aux) < 1.e-9) {
+      continue;
+    }
+    const double ppm_freq = ppm_.getPpm_freq()(i_aux);
+    const double fac = 0.5 * ppm_.getPpm_weight()(i_aux) * ppm_freq;
+    const Eigen::VectorXd Mmn2 = Mmn.col(i_aux).cwiseAbs2();
+    Eigen::ArrayXd poles = RPAEnergies;
+    poles.segment(0, lumo) -= ppm_freq;
+    poles.segment(lumo, levelsum - lumo) += ppm_freq;
+    temp.colwise() = -poles;
+    temp.rowwise() += frequencies.transpose().array();
+    const Eigen::ArrayXXd temp2 = temp.abs2();
+    dsigma_domega.noalias() +=
+        fac * ((eta2 - temp2) / (temp2 + eta2).abs2()).matrix().transpose() *
+        Mmn2;
+  }
+  return dsigma_domega;
+}
+
 double Sigma_PPM::CalcCorrelationOffDiagElement(Index gw_level1,
                                                 Index gw_level2,
                                                 double frequency1,
@@ -107,8 +176,8 @@ double Sigma_PPM::CalcCorrelationOffDiagElement(Index gw_level1,
     }
     const double ppm_freq = ppm_freqs(i_aux);
     const double fac = 0.25 * ppm_weight(i_aux) * ppm_freq;
-    const Eigen::MatrixXd& Mmn1 = Mmn_[gw_level1 + qpmin_offset];
-    const Eigen::MatrixXd& Mmn2 = Mmn_[gw_level2 + qpmin_offset];
+    auto Mmn1 = Mmn_[gw_level1 + qpmin_offset];
+    auto Mmn2 = Mmn_[gw_level2 + qpmin_offset];
     const Eigen::ArrayXd Mmn1xMmn2 =
         Mmn1.col(i_aux).cwiseProduct(Mmn2.col(i_aux));
     Eigen::ArrayXd temp1 = RPAEnergies;
@@ -124,5 +193,46 @@ double Sigma_PPM::CalcCorrelationOffDiagElement(Index gw_level1,
   return sigma_c;
 }
 
+// Sigma_c(m,n) = T(m,n) + T(n,m) with
+// T(m,n) = sum_k sum_aux fac(aux) * g(w_m - pole(k,aux)) * M_m(k,aux) *
+// M_n(k,aux), g(x) = x / (x^2 + eta^2). For each band k the row k of all qp
+// levels is gathered into a (qp x aux) block and T is accumulated as one
+// matrix product per band.
+Eigen::MatrixXd Sigma_PPM::CalcCorrelationOffDiag(
+    const Eigen::VectorXd& frequencies) const {
+  const Index lumo = opt_.homo + 1;
+  const double eta2 = opt_.eta * opt_.eta;
+  const Index levelsum = Mmn_.nsize();   // total number of bands
+  const Index auxsize = Mmn_.auxsize();  // size of the GW basis
+  const Index qpmin_offset = opt_.qpmin - opt_.rpamin;
+  const Eigen::VectorXd& RPAEnergies = rpa_.getRPAInputEnergies();
+  const Eigen::ArrayXd ppm_freqs = ppm_.getPpm_freq();
+  // the ppm_weights smaller 1.e-5 are set to zero in rpa.cc
+  // PPM_construct_parameters
+  const Eigen::ArrayXd fac =
+      (ppm_.getPpm_weight().array() < 1.e-9)
+          .select(0.0, 0.25 * ppm_.getPpm_weight().array() * ppm_freqs);
+
+  Eigen::MatrixXd T = Eigen::MatrixXd::Zero(qptotal_, qptotal_);
+#pragma omp parallel for schedule(dynamic) reduction(+ : T)
+  for (Index k = 0; k < levelsum; k++) {
+    Eigen::MatrixXd Mk(qptotal_, auxsize);
+    for (Index gw_level = 0; gw_level < qptotal_; gw_level++) {
+      Mk.row(gw_level) = Mmn_[gw_level + qpmin_offset].row(k);
+    }
+    const Eigen::ArrayXd poles =
+        (k < lumo) ? Eigen::ArrayXd(RPAEnergies(k) - ppm_freqs)
+                   : Eigen::ArrayXd(RPAEnergies(k) + ppm_freqs);
+    Eigen::ArrayXXd temp(qptotal_, auxsize);
+    temp.colwise() = frequencies.array();
+    temp.rowwise() -= poles.transpose();
+    temp = (temp / (temp.abs2() + eta2)).rowwise() * fac.transpose();
+    T.noalias() += (temp * Mk.array()).matrix() * Mk.transpose();
+  }
+  Eigen::MatrixXd result = T + T.transpose();
+  result.diagonal().setZero();
+  return result;
+}
+
 }  // namespace xtp
 }  // namespace votca
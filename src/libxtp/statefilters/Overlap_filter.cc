@@ -17,6 +17,10 @@
  *
  */
 
+// Standard includes
+#include <stdexcept>
+#include <string>
+
 // Local VOTCA includes
 #include "votca/xtp/aomatrix.h"
 
@@ -45,118 +49,103 @@ Eigen::VectorXd Overlap_filter::CalculateOverlap(const Orbitals& orb,
   AOOverlap S_ao;
   S_ao.Fill(orb.SetupDftBasis());
 
-  Eigen::MatrixXd coeffs = CalcAOCoeffs(orb, type);
   if (type.isSingleParticleState()) {
+    Eigen::MatrixXd coeffs = CalcAOCoeffs(orb, type);
     return (coeffs.transpose() * S_ao.Matrix() * laststatecoeff_).cwiseAbs();
-  } else {
+  }
 
-    Index basis = orb.getBasisSetSize();
-    Eigen::VectorXd overlap = Eigen::VectorXd::Zero(coeffs.cols());
-#pragma omp parallel for schedule(dynamic)
-    for (Index i = 0; i < coeffs.cols(); i++) {
-      {
-        Eigen::VectorXd state = coeffs.col(i).head(basis * basis);
-        Eigen::Map<const Eigen::MatrixXd> mat(state.data(), basis, basis);
-        Eigen::VectorXd laststate = laststatecoeff_.head(basis * basis);
-        Eigen::Map<const Eigen::MatrixXd> lastmat(laststate.data(), basis,
-                                                  basis);
-
-        overlap(i) = (mat * S_ao.Matrix() * lastmat.transpose())
-                         .cwiseProduct(S_ao.Matrix())
-                         .sum();
-      }
-      if (!orb.getTDAApprox()) {
-        Eigen::VectorXd state = coeffs.col(i).tail(basis * basis);
-        Eigen::Map<const Eigen::MatrixXd> mat(state.data(), basis, basis);
-        Eigen::VectorXd laststate = laststatecoeff_.tail(basis * basis);
-        Eigen::Map<const Eigen::MatrixXd> lastmat(laststate.data(), basis,
-                                                  basis);
-
-        overlap(i) -= (mat * S_ao.Matrix() * lastmat.transpose())
-                          .cwiseProduct(S_ao.Matrix())
-                          .sum();
-      }
-    }
-    return overlap.cwiseAbs();
+  if (lastocclevels_.cols() == 0 || lastvirtlevels_.cols() == 0) {
+    throw std::runtime_error(
+        "Overlap filter: no exciton to compare with. The last state is a "
+        "single particle state or comes from a checkpoint of an older "
+        "version, which stores excitons in another layout. Restart the state "
+        "tracking without the checkpoint.");
+  }
+  Index last_size = lastocclevels_.cols() * lastvirtlevels_.cols();
+  Index last_copies = orb.getTDAApprox() ? 1 : 2;
+  if (laststatecoeff_.size() != last_copies * last_size) {
+    throw std::runtime_error(
+        "Overlap filter: the last exciton has " +
+        std::to_string(laststatecoeff_.size()) +
+        " coefficients, which does not fit its levels and the TDA setting");
   }
-}
 
-Eigen::MatrixXd Overlap_filter::CalcExcitonAORepresentation(
-    const Orbitals& orb, QMStateType type) const {
-  Eigen::MatrixXd coeffs;
-  Index nostates = orb.NumberofStates(type);
-  Index bse_cmax = orb.getBSEcmax();
-  Index bse_cmin = orb.getBSEcmin();
-  Index bse_vmax = orb.getBSEvmax();
+  // The AO overlap of two excitons sum_vc,v'c' X_vc S_cc' X'_v'c' S_vv' only
+  // needs the MO overlaps S_cc' and S_vv' between the current and the last
+  // levels, so the last exciton is projected onto the current product space
   Index bse_vmin = orb.getBSEvmin();
-  Index bse_vtotal = bse_vmax - bse_vmin + 1;
-  Index bse_ctotal = bse_cmax - bse_cmin + 1;
-  Index basis = orb.getBasisSetSize();
-  Index bse_size_ao = basis * basis;
-  auto occlevels = orb.MOs().eigenvectors().middleCols(bse_vmin, bse_vtotal);
-  auto virtlevels = orb.MOs().eigenvectors().middleCols(bse_cmin, bse_ctotal);
-
-  if (orb.getTDAApprox()) {
-    coeffs.resize(bse_size_ao, nostates);
-  } else {
-    coeffs.resize(2 * bse_size_ao, nostates);
+  Index bse_cmin = orb.getBSEcmin();
+  Index bse_vtotal = orb.getBSEvmax() - bse_vmin + 1;
+  Index bse_ctotal = orb.getBSEcmax() - bse_cmin + 1;
+  Index bse_size = bse_vtotal * bse_ctotal;
+  Eigen::MatrixXd S_occ =
+      orb.MOs().eigenvectors().middleCols(bse_vmin, bse_vtotal).transpose() *
+      S_ao.Matrix() * lastocclevels_;
+  Eigen::MatrixXd S_virt =
+      orb.MOs().eigenvectors().middleCols(bse_cmin, bse_ctotal).transpose() *
+      S_ao.Matrix() * lastvirtlevels_;
+
+  const tools::EigenSystem& exciton = (type == QMStateType::Singlet)
+                                          ? orb.BSESinglets()
+                                          : orb.BSETriplets();
+  Eigen::VectorXd overlap;
+  {
+    Eigen::Map<const Eigen::MatrixXd> lastmat(
+        laststatecoeff_.data(), lastvirtlevels_.cols(), lastocclevels_.cols());
+    const Eigen::MatrixXd projected = S_virt * lastmat * S_occ.transpose();
+    overlap = exciton.eigenvectors().transpose() *
+              Eigen::Map<const Eigen::VectorXd>(projected.data(), bse_size);
   }
-#pragma omp parallel for schedule(dynamic)
-  for (Index i = 0; i < nostates; i++) {
-    {
-      Eigen::VectorXd exciton;
-      if (type == QMStateType::Singlet) {
-        exciton = orb.BSESinglets().eigenvectors().col(i);
-      } else {
-        exciton = orb.BSETriplets().eigenvectors().col(i);
-      }
-      Eigen::Map<const Eigen::MatrixXd> mat(exciton.data(), bse_ctotal,
-                                            bse_vtotal);
-      const Eigen::MatrixXd aomatrix =
-          occlevels * mat.transpose() * virtlevels.transpose();
-      coeffs.col(i).head(bse_size_ao) =
-          Eigen::Map<const Eigen::VectorXd>(aomatrix.data(), bse_size_ao);
-    }
-    if (!orb.getTDAApprox()) {
-      Eigen::VectorXd exciton;
-      if (type == QMStateType::Singlet) {
-        exciton = orb.BSESinglets().eigenvectors2().col(i);
-      } else {
-        exciton = orb.BSETriplets().eigenvectors2().col(i);
-      }
-      Eigen::Map<const Eigen::MatrixXd> mat(exciton.data(), bse_ctotal,
-                                            bse_vtotal);
-      const Eigen::MatrixXd aomatrix =
-          occlevels * mat.transpose() * virtlevels.transpose();
-      coeffs.col(i).tail(bse_size_ao) =
-          Eigen::Map<const Eigen::VectorXd>(aomatrix.data(), bse_size_ao);
-    }
+  if (!orb.getTDAApprox()) {
+    Eigen::Map<const Eigen::MatrixXd> lastmat(
+        laststatecoeff_.data() + last_size, lastvirtlevels_.cols(),
+        lastocclevels_.cols());
+    const Eigen::MatrixXd projected = S_virt * lastmat * S_occ.transpose();
+    overlap -= exciton.eigenvectors2().transpose() *
+               Eigen::Map<const Eigen::VectorXd>(projected.data(), bse_size);
   }
-  return coeffs;
+  return overlap.cwiseAbs();
 }
 
 Eigen::MatrixXd Overlap_filter::CalcAOCoeffs(const Orbitals& orb,
                                              QMStateType type) const {
-  Eigen::MatrixXd coeffs;
-  if (type.isSingleParticleState()) {
-    if (type == QMStateType::DQPstate) {
-      coeffs = orb.CalculateQParticleAORepresentation();
-    } else {
-      coeffs = orb.MOs().eigenvectors();
-    }
+  if (type == QMStateType::DQPstate) {
+    return orb.CalculateQParticleAORepresentation();
   } else {
-    coeffs = CalcExcitonAORepresentation(orb, type);
+    return orb.MOs().eigenvectors();
   }
-  return coeffs;
 }
 
 void Overlap_filter::UpdateHist(const Orbitals& orb, QMState state) {
-  Eigen::MatrixXd aocoeffs = CalcAOCoeffs(orb, state.Type());
-  Index offset = 0;
-  if (state.Type() == QMStateType::DQPstate) {
-    offset = orb.getGWAmin();
+  if (state.Type().isSingleParticleState()) {
+    Eigen::MatrixXd aocoeffs = CalcAOCoeffs(orb, state.Type());
+    Index offset = 0;
+    if (state.Type() == QMStateType::DQPstate) {
+      offset = orb.getGWAmin();
+    }
+    laststatecoeff_ = aocoeffs.col(state.StateIdx() - offset);
+    lastocclevels_.resize(0, 0);
+    lastvirtlevels_.resize(0, 0);
+    return;
   }
-  laststatecoeff_ = aocoeffs.col(state.StateIdx() - offset);
+
+  const tools::EigenSystem& exciton = (state.Type() == QMStateType::Singlet)
+                                          ? orb.BSESinglets()
+                                          : orb.BSETriplets();
+  Index size = exciton.eigenvectors().rows();
+  if (orb.getTDAApprox()) {
+    laststatecoeff_ = exciton.eigenvectors().col(state.StateIdx());
+  } else {
+    laststatecoeff_.resize(2 * size);
+    laststatecoeff_.head(size) = exciton.eigenvectors().col(state.StateIdx());
+    laststatecoeff_.tail(size) = exciton.eigenvectors2().col(state.StateIdx());
+  }
+  Index bse_vmin = orb.getBSEvmin();
+  Index bse_cmin = orb.getBSEcmin();
+  lastocclevels_ = orb.MOs().eigenvectors().middleCols(
+      bse_vmin, orb.getBSEvmax() - bse_vmin + 1);
+  lastvirtlevels_ = orb.MOs().eigenvectors().middleCols(
+      bse_cmin, orb.getBSEcmax() - bse_cmin + 1);
 }
 
 std::vector<Index> Overlap_filter::CalcIndeces(const Orbitals& orb,
@@ -170,12 +159,30 @@ std::vector<Index> Overlap_filter::CalcIndeces(const Orbitals& orb,
 }
 
 void Overlap_filter::WriteToCpt(CheckpointWriter& w) {
+  w(overlap_filter_version(), "version");
   w(laststatecoeff_, "laststatecoeff");
+  w(lastocclevels_, "lastocclevels");
+  w(lastvirtlevels_, "lastvirtlevels");
   w(threshold_, "threshold");
 }
 
 void Overlap_filter::ReadFromCpt(CheckpointReader& r) {
+  // checkpoints without a version stored excitons as AO coefficients without
+  // their levels, single particle states did not change
+  int version = 1;
+  try {
+    r(version, "version");
+  } catch (std::runtime_error&) {
+    version = 1;
+  }
   r(laststatecoeff_, "laststatecoeff");
+  if (version < 2) {
+    lastocclevels_.resize(0, 0);
+    lastvirtlevels_.resize(0, 0);
+  } else {
+    r(lastocclevels_, "lastocclevels");
+    r(lastvirtlevels_, "lastvirtlevels");
+  }
   r(threshold_, "threshold");
 }
 
@@ -55,11 +55,15 @@ class Overlap_filter : public StateFilter_base {
   Eigen::VectorXd CalculateOverlap(const Orbitals& orb, QMStateType type) const;
   Eigen::MatrixXd CalcAOCoeffs(const Orbitals& orb, QMStateType type) const;
 
-  Eigen::MatrixXd CalcExcitonAORepresentation(const Orbitals& orb,
-                                              QMStateType type) const;
   double threshold_ = 0.0;
 
+  // AO coefficients for single particle states, BSE coefficients for
+  // excitons, which are completed by the MOs of their levels
   Eigen::VectorXd laststatecoeff_;
+  Eigen::MatrixXd lastocclevels_;
+  Eigen::MatrixXd lastvirtlevels_;
+
+  static constexpr int overlap_filter_version() { return 2; }
 };
 
 }  // namespace xtp
@@ -17,6 +17,9 @@
  *
  */
 
+// Standard includes
+#include <algorithm>
+
 // Local VOTCA includes
 #include "votca/xtp/threecenter.h"
 #include "votca/xtp/aomatrix.h"
@@ -130,13 +133,78 @@ void TCMatrix_gwbse::Initialize(Index basissize, Index mmin, Index mmax,
   mtotal_ = mmax - mmin + 1;
   auxbasissize_ = basissize;
 
-  // vector has mtotal elements
-  // largest object should be allocated in multithread fashion
-  matrix_ = std::vector<Eigen::MatrixXd>(mtotal_);
+  scratch_ = nullptr;
+  memory_.resize(0);
+  memory_sp_.resize(0);
+  if (max_memory_ > 0 && MemorySize() > max_memory_) {
+    // the scratch file starts out as zeros
+    scratch_ =
+        std::make_unique<ScratchFile>(scratch_dir_, mtotal_ * blocksize());
+    data_ = scratch_->data();
+  } else {
+    memory_.resize(mtotal_ * blocksize());
+    data_ = memory_.data();
+    // largest object should be allocated in multithread fashion
 #pragma omp parallel for schedule(dynamic, 4)
+    for (Index i = 0; i < mtotal_; i++) {
+      (*this)[i].setZero();
+    }
+  }
+}
+
+void TCMatrix_gwbse::Prefetch(Index i) const {
+  if (scratch_ == nullptr || isSinglePrecision()) {
+    return;
+  }
+  // with dynamic scheduling each thread roughly takes the level one round of
+  // threads ahead next
+  Index next = i + OPENMP::getMaxThreads();
+  if (next < mtotal_) {
+    scratch_->Prefetch(next * blocksize(), blocksize());
+  }
+}
+
+void TCMatrix_gwbse::setSinglePrecision(bool single) {
+  if (!single) {
+    memory_sp_.resize(0);
+    return;
+  }
+  memory_sp_.resize(mtotal_ * blocksize());
+  FillSinglePrecision();
+  if (scratch_ == nullptr) {
+    // the double precision levels are only needed for a final refinement
+    scratch_ =
+        std::make_unique<ScratchFile>(scratch_dir_, mtotal_ * blocksize());
+    std::copy_n(memory_.data(), memory_.size(), scratch_->data());
+    memory_.resize(0);
+    data_ = scratch_->data();
+  }
+}
+
+void TCMatrix_gwbse::FillSinglePrecision() {
+#pragma omp parallel for schedule(dynamic)
   for (Index i = 0; i < mtotal_; i++) {
-    matrix_[i] = Eigen::MatrixXd::Zero(ntotal_, auxbasissize_);
+    memory_sp_.segment(i * blocksize(), blocksize()) =
+        Eigen::Map<const Eigen::VectorXd>(data_ + i * blocksize(), blocksize())
+            .cast<float>();
+  }
+}
+
+Eigen::Map<const Eigen::MatrixXd, 0, Eigen::OuterStride<> >
+    TCMatrix_gwbse::Rows(Index i, Index first, Index n,
+                         Eigen::MatrixXd& buffer) const {
+  if (!isSinglePrecision()) {
+    return Eigen::Map<const Eigen::MatrixXd, 0, Eigen::OuterStride<> >(
+        data_ + i * blocksize() + first, n, auxbasissize_,
+        Eigen::OuterStride<>(ntotal_));
   }
+  // the conversion happens in cache, only the floats come from memory
+  buffer = Eigen::Map<const Eigen::MatrixXf, 0, Eigen::OuterStride<> >(
+               memory_sp_.data() + i * blocksize() + first, n, auxbasissize_,
+               Eigen::OuterStride<>(ntotal_))
+               .cast<double>();
+  return Eigen::Map<const Eigen::MatrixXd, 0, Eigen::OuterStride<> >(
+      buffer.data(), n, auxbasissize_, Eigen::OuterStride<>(n));
 }
 
 /*
@@ -145,15 +213,19 @@ void TCMatrix_gwbse::Initialize(Index basissize, Index mmin, Index mmax,
  */
 void TCMatrix_gwbse::MultiplyRightWithAuxMatrix(const Eigen::MatrixXd& matrix) {
   OpenMP_CUDA gemm;
-  gemm.setOperators(matrix_, matrix);
+  gemm.setOperators(ntotal_, matrix);
 #pragma omp parallel
   {
     Index threadid = OPENMP::getThreadId();
 #pragma omp for schedule(dynamic)
     for (Index i = 0; i < msize(); i++) {
-      gemm.MultiplyRight(matrix_[i], threadid);
+      Prefetch(i);
+      gemm.MultiplyRight((*this)[i], threadid);
     }
   }
+  if (memory_sp_.size() > 0) {
+    FillSinglePrecision();
+  }
 }
 /*
  * Fill the 3-center object by looping over shells of GW basis set and
@@ -168,19 +240,37 @@ void TCMatrix_gwbse::Fill(const AOBasis& auxbasis, const AOBasis& dftbasis,
   dftbasis_ = &dftbasis;
   dft_orbitals_ = &dft_orbitals;
 
+  ao3c_.clear();
+  if (keep_ao3c_) {
+    ao3c_.resize(auxbasis.AOBasisSize());
+  }
+
   Fill3cMO(auxbasis, dftbasis, dft_orbitals);
 
   AOOverlap auxoverlap;
   auxoverlap.Fill(auxbasis);
   AOCoulomb auxcoulomb;
   auxcoulomb.Fill(auxbasis);
-  Eigen::MatrixXd inv_sqrt = auxcoulomb.Pseudo_InvSqrt_GWBSE(auxoverlap, 5e-7);
+  inv_sqrt_ = auxcoulomb.Pseudo_InvSqrt_GWBSE(auxoverlap, 5e-7);
   removedfunctions_ = auxcoulomb.Removedfunctions();
-  MultiplyRightWithAuxMatrix(inv_sqrt);
+  MultiplyRightWithAuxMatrix(inv_sqrt_);
 
   return;
 }
 
+/*
+ * If the AO 3c integrals were kept, neither the integrals nor the aux
+ * Coulomb metric have to be recomputed, only the AO->MO transformation.
+ */
+void TCMatrix_gwbse::Rebuild() {
+  if (ao3c_.empty()) {
+    Fill(*auxbasis_, *dftbasis_, *dft_orbitals_);
+  } else {
+    Transform3cMO(*dft_orbitals_);
+    MultiplyRightWithAuxMatrix(inv_sqrt_);
+  }
+}
+
 /*
  * Determines the 3-center integrals for a given shell in the aux basis
  * by calculating the 3-center repulsion integral of the functions in the
@@ -272,14 +362,17 @@ void TCMatrix_gwbse::Fill3cMO(const AOBasis& auxbasis, const AOBasis& dftbasis,
 
       // this is basically a transpose of AO3c and at the same time the ao->mo
       // transformation
-      // we do not want to put it into  matrix_ straight away is because,
-      //  matrix_ is shared between all threads and we want a nice clean access
+      // we do not want to put it into the levels straight away is because,
+      //  they are shared between all threads and we want a nice clean access
       // pattern to it
       std::vector<Eigen::MatrixXd> block = std::vector<Eigen::MatrixXd>(
           mtotal_, Eigen::MatrixXd::Zero(ntotal_, ao3c.size()));
 
       Index dim = static_cast<Index>(ao3c.size());
       for (Index k = 0; k < dim; ++k) {
+        if (keep_ao3c_) {
+          ao3c_[auxshell2bf[aux] + k] = Symmetric_Matrix(ao3c[k]);
+        }
         transform.MultiplyLeftRight(ao3c[k], threadid);
         for (Index i = 0; i < ao3c[k].cols(); ++i) {
           block[i].col(k) = ao3c[k].col(i);
@@ -288,12 +381,34 @@ void TCMatrix_gwbse::Fill3cMO(const AOBasis& auxbasis, const AOBasis& dftbasis,
 
       // put into correct position
       for (Index m_level = 0; m_level < mtotal_; m_level++) {
-        matrix_[m_level].middleCols(auxshell2bf[aux], auxshell.size()) =
+        (*this)[m_level].middleCols(auxshell2bf[aux], auxshell.size()) =
             block[m_level];
       }  // m-th DFT orbital
     }    // shells of GW basis set
   }
 }
 
+void TCMatrix_gwbse::Transform3cMO(const Eigen::MatrixXd& dft_orbitals) {
+
+  const Eigen::MatrixXd dftm = dft_orbitals.middleCols(mmin_, mtotal_);
+  const Eigen::MatrixXd dftn =
+      dft_orbitals.middleCols(nmin_, ntotal_).transpose();
+
+  OpenMP_CUDA transform;
+  transform.setOperators(dftn, dftm);
+#pragma omp parallel
+  {
+    Index threadid = OPENMP::getThreadId();
+#pragma omp for schedule(dynamic)
+    for (Index aux = 0; aux < Index(ao3c_.size()); aux++) {
+      Eigen::MatrixXd mo3c = ao3c_[aux].FullMatrix();
+      transform.MultiplyLeftRight(mo3c, threadid);
+      for (Index m_level = 0; m_level < mtotal_; m_level++) {
+        (*this)[m_level].col(aux) = mo3c.col(m_level);
+      }
+    }
+  }
+}
+
 }  // namespace xtp
 }  // namespace votca
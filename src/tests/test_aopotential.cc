@@ -319,4 +319,43 @@ BOOST_AUTO_TEST_CASE(large_l_test) {
   libint2::finalize();
 }
 
+BOOST_AUTO_TEST_CASE(electronic_potential) {
+  libint2::initialize();
+  Orbitals orbitals;
+  orbitals.QMAtoms().LoadFromFile(std::string(XTP_TEST_DATA_FOLDER) +
+                                  "/aopotential/molecule.xyz");
+  BasisSet basis;
+  basis.Load(std::string(XTP_TEST_DATA_FOLDER) + "/aopotential/3-21G.xml");
+  AOBasis aobasis;
+  aobasis.Fill(basis, orbitals.QMAtoms());
+
+  Index size = aobasis.AOBasisSize();
+  Eigen::MatrixXd dmat = Eigen::MatrixXd::Zero(size, size);
+  for (Index i = 0; i < size; i++) {
+    for (Index j = 0; j < size; j++) {
+      dmat(i, j) = 1.0 / double(1 + i + j);
+    }
+  }
+  std::vector<Eigen::Vector3d> points = {Eigen::Vector3d(0.5, 0.2, -0.1),
+                                         Eigen::Vector3d(3.0, -2.0, 4.0),
+                                         Eigen::Vector3d(-10.0, 0.0, 1.0)};
+  AOMultipole esp;
+  Eigen::VectorXd potential = esp.ElectronicPotential(aobasis, dmat, points);
+  Eigen::VectorXd potential_ref = Eigen::VectorXd::Zero(3);
+  for (Index i = 0; i < 3; i++) {
+    AOMultipole point;
+    point.FillPotential(aobasis, points[i]);
+    potential_ref(i) = -dmat.cwiseProduct(point.Matrix()).sum();
+  }
+  bool check_potential = potential.isApprox(potential_ref, 1e-8);
+  if (!check_potential) {
+    std::cout << "potential" << std::endl;
+    std::cout << potential.transpose() << std::endl;
+    std::cout << "ref" << std::endl;
+    std::cout << potential_ref.transpose() << std::endl;
+  }
+  BOOST_CHECK_EQUAL(check_potential, true);
+  libint2::finalize();
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -27,6 +27,7 @@
 #include "votca/xtp/bse.h"
 #include "votca/xtp/convergenceacc.h"
 #include "votca/xtp/qmfragment.h"
+#include "votca/xtp/rpa.h"
 #include <libint2/initialize.h>
 #include <votca/tools/eigenio_matrixmarket.h>
 using namespace votca::xtp;
@@ -77,10 +78,16 @@ BOOST_AUTO_TEST_CASE(bse_hamiltonian) {
   opt.qpmax = 16;
   opt.max_dyn_iter = 10;
   opt.dyn_tolerance = 1e-5;
+  opt.dyn_mesh = 0.005;
   opt.davidson_correction = "DPR";
   opt.davidson_tolerance = "lapack";
   opt.davidson_update = "safe";
   opt.davidson_maxiter = 50;
+  opt.davidson_warmstart = false;
+  opt.dense_max_memory = 0;
+  opt.truncation_window = 0;
+  opt.truncation_coupling = 1e-4;
+  opt.mixed_precision = false;
 
   orbitals.setBSEindices(0, 16);
 
@@ -192,6 +199,66 @@ BOOST_AUTO_TEST_CASE(bse_hamiltonian) {
   }
   BOOST_CHECK_EQUAL(check_se_dyn_tda, true);
 
+  // interpolated screening against the screening at every frequency, for a
+  // single perturbative step at frequencies that replace the singlet energies
+  const Eigen::VectorXd singlet_energies = orbitals.BSESinglets().eigenvalues();
+  auto dynamic_at = [&](double frequency, double mesh) {
+    opt.max_dyn_iter = 1;
+    opt.dyn_mesh = mesh;
+    bse.configure(opt, orbitals.RPAInputEnergies(), Hqp);
+    orbitals.BSESinglets().eigenvalues().setConstant(frequency);
+    bse.Perturbative_DynamicalScreening(QMStateType(QMStateType::Singlet),
+                                        orbitals);
+    orbitals.BSESinglets().eigenvalues() = singlet_energies;
+    return Eigen::VectorXd(orbitals.BSESinglets_dynamic());
+  };
+  const double transition = orbitals.RPAInputEnergies()(opt.homo + 1) -
+                            orbitals.RPAInputEnergies()(opt.homo);
+  // the lowest RPA transition lies just below the mesh point k_pole+1
+  const Index k_pole = 31;
+  const double mesh = transition / (double(k_pole) + 0.9);
+  RPA rpa(log, Mmn);
+  rpa.configure(opt.homo, opt.rpamin, opt.rpamax);
+  rpa.setRPAInputEnergies(orbitals.RPAInputEnergies());
+  auto nonpositive = [&](double frequency) {
+    Eigen::SelfAdjointEigenSolver<Eigen::MatrixXd> es(
+        rpa.calculate_epsilon_r(frequency));
+    return (es.eigenvalues().array() <= 1e-8).count();
+  };
+  // below all transitions epsilon is positive definite, right above the
+  // first one it has a negative eigenvalue
+  BOOST_REQUIRE_EQUAL(nonpositive(double(k_pole) * mesh), 0);
+  BOOST_REQUIRE(nonpositive(double(k_pole + 1) * mesh) > 0);
+
+  // in the first interval the stencil starts at frequency 0
+  Eigen::VectorXd dyn_first = dynamic_at(0.4 * mesh, mesh);
+  Eigen::VectorXd dyn_first_ref = dynamic_at(0.4 * mesh, 0.0);
+  bool check_dyn_first = dyn_first.isApprox(dyn_first_ref, 1e-5);
+  if (!check_dyn_first) {
+    cout << "Dynamical screening first mesh interval" << endl;
+    cout << dyn_first << endl;
+    cout << "Dynamical screening at every frequency" << endl;
+    cout << dyn_first_ref << endl;
+  }
+  BOOST_CHECK_EQUAL(check_dyn_first, true);
+
+  // across the sign change only the enclosing mesh points are used
+  Eigen::VectorXd dyn_pole = dynamic_at((double(k_pole) + 0.5) * mesh, mesh);
+  Eigen::VectorXd dyn_pole_ref =
+      0.5 * (dynamic_at(double(k_pole) * mesh, 0.0) +
+             dynamic_at(double(k_pole + 1) * mesh, 0.0));
+  bool check_dyn_pole = dyn_pole.isApprox(dyn_pole_ref, 1e-8);
+  if (!check_dyn_pole) {
+    cout << "Dynamical screening across a sign change of epsilon" << endl;
+    cout << dyn_pole << endl;
+    cout << "Linear interpolation of the screening at the mesh points"
+         << endl;
+    cout << dyn_pole_ref << endl;
+  }
+  BOOST_CHECK_EQUAL(check_dyn_pole, true);
+  opt.max_dyn_iter = 10;
+  opt.dyn_mesh = 0.005;
+
   ////////////////////////////////////////////////////////
   // BTDA Singlet Davidson
   ////////////////////////////////////////////////////////
@@ -283,6 +350,63 @@ BOOST_AUTO_TEST_CASE(bse_hamiltonian) {
   }
   BOOST_CHECK_EQUAL(check_se_dyn_full, true);
 
+  ////////////////////////////////////////////////////////
+  // Singlets with explicit hamiltonian
+  ////////////////////////////////////////////////////////
+
+  opt.dense_max_memory = 1000000000;
+  bse.configure(opt, orbitals.RPAInputEnergies(), Hqp);
+  bse.Solve_singlets(orbitals);
+  bool check_se_btda_dense =
+      se_ref_btda.isApprox(orbitals.BSESinglets().eigenvalues(), 0.001);
+  if (!check_se_btda_dense) {
+    cout << "Singlets energy BTDA explicit" << endl;
+    cout << orbitals.BSESinglets().eigenvalues() << endl;
+    cout << "Singlets energy BTDA ref" << endl;
+    cout << se_ref_btda << endl;
+  }
+  BOOST_CHECK_EQUAL(check_se_btda_dense, true);
+  Eigen::VectorXd norm_btda_dense =
+      orbitals.BSESinglets().eigenvectors().colwise().squaredNorm() -
+      orbitals.BSESinglets().eigenvectors2().colwise().squaredNorm();
+  BOOST_CHECK_EQUAL(norm_btda_dense.isApproxToConstant(1, 1e-9), true);
+
+  opt.useTDA = true;
+  orbitals.setTDAApprox(true);
+  bse.configure(opt, orbitals.RPAInputEnergies(), Hqp);
+  bse.Solve_singlets(orbitals);
+  bool check_se_dense =
+      se_ref.isApprox(orbitals.BSESinglets().eigenvalues(), 0.001);
+  if (!check_se_dense) {
+    cout << "Singlets energy explicit" << endl;
+    cout << orbitals.BSESinglets().eigenvalues() << endl;
+    cout << "Singlets energy ref" << endl;
+    cout << se_ref << endl;
+  }
+  BOOST_CHECK_EQUAL(check_se_dense, true);
+  opt.dense_max_memory = 0;
+
+  ////////////////////////////////////////////////////////
+  // Singlets in truncated product space
+  ////////////////////////////////////////////////////////
+
+  // drops the highest virtual level only
+  opt.truncation_window = 1.7;
+  opt.truncation_coupling = 1e-2;
+  bse.configure(opt, orbitals.RPAInputEnergies(), Hqp);
+  bse.Solve_singlets(orbitals);
+  bool check_se_truncated =
+      se_ref.isApprox(orbitals.BSESinglets().eigenvalues(), 0.001);
+  if (!check_se_truncated) {
+    cout << "Singlets energy truncated" << endl;
+    cout << orbitals.BSESinglets().eigenvalues() << endl;
+    cout << "Singlets energy ref" << endl;
+    cout << se_ref << endl;
+  }
+  BOOST_CHECK_EQUAL(check_se_truncated, true);
+  BOOST_CHECK_EQUAL(orbitals.BSESinglets().eigenvectors().rows(), 60);
+  opt.truncation_window = 0;
+
   ////////////////////////////////////////////////////////
   // TDA Triplet davidson
   ////////////////////////////////////////////////////////
@@ -341,6 +465,105 @@ BOOST_AUTO_TEST_CASE(bse_hamiltonian) {
   }
   BOOST_CHECK_EQUAL(check_te_dyn_tda, true);
 
+  // singlets and triplets TDA in lockstep
+  bse.Solve_singlets_and_triplets(orbitals);
+  bool check_te_lockstep =
+      te_ref.isApprox(orbitals.BSETriplets().eigenvalues(), 0.001);
+  bool check_se_lockstep =
+      se_ref.head(1).isApprox(orbitals.BSESinglets().eigenvalues(), 0.001);
+  if (!check_te_lockstep || !check_se_lockstep) {
+    cout << "Triplet and singlet energy lockstep" << endl;
+    cout << orbitals.BSETriplets().eigenvalues() << endl;
+    cout << orbitals.BSESinglets().eigenvalues() << endl;
+    cout << "Triplet and singlet energy lockstep ref" << endl;
+    cout << te_ref << endl;
+    cout << se_ref.head(1) << endl;
+  }
+  BOOST_CHECK_EQUAL(check_te_lockstep, true);
+  BOOST_CHECK_EQUAL(check_se_lockstep, true);
+
+  ////////////////////////////////////////////////////////
+  // Absorption spectrum from Lanczos recursion
+  ////////////////////////////////////////////////////////
+
+  // the transition dipoles of the orbitals have to span the BSE levels
+  orbitals.setNumberOfOccupiedLevels(5);
+  orbitals.setBSEindices(0, 16);
+  opt.nmax = 60;
+  opt.dense_max_memory = 1000000000;
+  Eigen::VectorXd frequencies = Eigen::VectorXd::LinSpaced(101, 0.0, 2.0);
+  for (bool tda : {true, false}) {
+    opt.useTDA = tda;
+    orbitals.setTDAApprox(tda);
+    bse.configure(opt, orbitals.RPAInputEnergies(), Hqp);
+    bse.Solve_singlets(orbitals);
+    Eigen::VectorXd osc = orbitals.Oscillatorstrengths();
+    const Eigen::VectorXd& energies = orbitals.BSESinglets().eigenvalues();
+    // the full Krylov space is exact, a quarter of it still resolves a broad
+    // spectrum
+    for (auto steps_fwhm : {std::make_pair(Index(60), 0.05),
+                            std::make_pair(Index(15), 2.0)}) {
+      double fwhm = steps_fwhm.second;
+      double tolerance = (steps_fwhm.first == 60) ? 1e-6 : 1e-3;
+      // broadening of all states like the spectrum tool does
+      Eigen::MatrixXd spectrum_ref = Eigen::MatrixXd::Zero(101, 2);
+      for (Index i = 0; i < osc.size(); i++) {
+        Eigen::ArrayXd lorentzian =
+            0.5 * fwhm / votca::tools::conv::Pi /
+            ((frequencies.array() - energies(i)).square() +
+             0.25 * fwhm * fwhm);
+        spectrum_ref.col(0) += (osc(i) * lorentzian).matrix();
+        spectrum_ref.col(1) += (osc(i) * energies(i) * lorentzian).matrix();
+      }
+      opt.haydock_steps = steps_fwhm.first;
+      bse.configure(opt, orbitals.RPAInputEnergies(), Hqp);
+      Eigen::MatrixXd spectrum =
+          bse.AbsorptionSpectrum(orbitals, frequencies, fwhm);
+      bool check_spectrum = spectrum_ref.isApprox(spectrum, tolerance);
+      if (!check_spectrum) {
+        cout << "Absorption spectrum Lanczos, TDA " << tda << " steps "
+             << steps_fwhm.first << endl;
+        cout << spectrum << endl;
+        cout << "Absorption spectrum Lanczos ref" << endl;
+        cout << spectrum_ref << endl;
+      }
+      BOOST_CHECK_EQUAL(check_spectrum, true);
+    }
+  }
+  BOOST_CHECK_THROW(bse.AbsorptionSpectrum(orbitals, frequencies, 0.0),
+                    std::runtime_error);
+  opt.useTDA = true;
+  orbitals.setTDAApprox(true);
+  opt.dense_max_memory = 0;
+
+  ////////////////////////////////////////////////////////
+  // Single precision Mmn with double precision refinement
+  ////////////////////////////////////////////////////////
+  opt.nmax = 3;
+  for (bool tda : {true, false}) {
+    opt.useTDA = tda;
+    orbitals.setTDAApprox(tda);
+    opt.mixed_precision = false;
+    bse.configure(opt, orbitals.RPAInputEnergies(), Hqp);
+    bse.Solve_singlets(orbitals);
+    Eigen::VectorXd se_double = orbitals.BSESinglets().eigenvalues();
+    opt.mixed_precision = true;
+    bse.configure(opt, orbitals.RPAInputEnergies(), Hqp);
+    bse.Solve_singlets(orbitals);
+    bool check_se_mixed =
+        se_double.isApprox(orbitals.BSESinglets().eigenvalues(), 1e-9);
+    if (!check_se_mixed) {
+      cout << "Singlets energy mixed precision, TDA " << tda << endl;
+      cout << orbitals.BSESinglets().eigenvalues() << endl;
+      cout << "Singlets energy double precision" << endl;
+      cout << se_double << endl;
+    }
+    BOOST_CHECK_EQUAL(check_se_mixed, true);
+  }
+  opt.mixed_precision = false;
+  opt.useTDA = true;
+  orbitals.setTDAApprox(true);
+
   // Cutout Hamiltonian
   Eigen::MatrixXd Hqp_cut_ref = votca::tools::EigenIO_MatrixMarket::ReadMatrix(
       std::string(XTP_TEST_DATA_FOLDER) + "/bse/Hqp_cut.mm");
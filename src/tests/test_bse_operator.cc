@@ -97,6 +97,8 @@ BOOST_AUTO_TEST_CASE(bse_operator) {
   BOOST_CHECK_EQUAL(check_hqp, true);
   bool check_hqpdiag = hqp_mat.diagonal().isApprox(Hqp_op.diagonal(), 0.001);
   BOOST_CHECK_EQUAL(check_hqpdiag, true);
+  bool check_hqpfull = hqp_mat.isApprox(Hqp_op.get_full_matrix(), 1e-10);
+  BOOST_CHECK_EQUAL(check_hqpfull, true);
   HxOperator Hx(epsilon_inv, Mmn, Hqp);
   Hx.configure(opt);
   Eigen::MatrixXd hx_mat = Hx * identity;
@@ -114,6 +116,8 @@ BOOST_AUTO_TEST_CASE(bse_operator) {
 
   bool check_hxdiag = hx_mat.diagonal().isApprox(Hx.diagonal(), 0.001);
   BOOST_CHECK_EQUAL(check_hxdiag, true);
+  bool check_hxfull = hx_mat.isApprox(Hx.get_full_matrix(), 1e-10);
+  BOOST_CHECK_EQUAL(check_hxfull, true);
   HdOperator Hd(epsilon_inv, Mmn, Hqp);
   Hd.configure(opt);
   Eigen::MatrixXd hd_mat = Hd * identity;
@@ -133,6 +137,8 @@ BOOST_AUTO_TEST_CASE(bse_operator) {
 
   bool check_hddiag = hd_mat.diagonal().isApprox(Hd.diagonal(), 0.001);
   BOOST_CHECK_EQUAL(check_hddiag, true);
+  bool check_hdfull = hd_mat.isApprox(Hd.get_full_matrix(), 1e-10);
+  BOOST_CHECK_EQUAL(check_hdfull, true);
 
   Hd2Operator Hd2(epsilon_inv, Mmn, Hqp);
   Hd2.configure(opt);
@@ -150,6 +156,8 @@ BOOST_AUTO_TEST_CASE(bse_operator) {
   BOOST_CHECK_EQUAL(check_hd2, true);
   bool check_hd2diag = hd2_mat.diagonal().isApprox(Hd2.diagonal(), 0.001);
   BOOST_CHECK_EQUAL(check_hd2diag, true);
+  bool check_hd2full = hd2_mat.isApprox(Hd2.get_full_matrix(), 1e-10);
+  BOOST_CHECK_EQUAL(check_hd2full, true);
 
   libint2::finalize();
 }
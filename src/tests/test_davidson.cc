@@ -104,6 +104,78 @@ BOOST_AUTO_TEST_CASE(davidson_full_matrix_large) {
   BOOST_CHECK_EQUAL(check_eigenvalues, 1);
 }
 
+BOOST_AUTO_TEST_CASE(davidson_full_matrix_warmstart) {
+
+  Index size = 100;
+  Index neigen = 10;
+  double eps = 0.01;
+  Eigen::MatrixXd A = init_matrix(size, eps);
+  Logger log;
+  DavidsonSolver DS(log);
+  DS.set_tolerance("strict");
+  DS.solve(A, neigen);
+
+  // a slightly different problem, starting from the previous eigenvectors
+  Eigen::MatrixXd A2 = init_matrix(size, 1.1 * eps);
+  DavidsonSolver DS_cold(log);
+  DS_cold.set_tolerance("strict");
+  DS_cold.solve(A2, neigen);
+
+  DavidsonSolver DS_warm(log);
+  DS_warm.set_tolerance("strict");
+  DS_warm.set_initial_guess(DS.eigenvectors());
+  DS_warm.solve(A2, neigen);
+
+  Eigen::SelfAdjointEigenSolver<Eigen::MatrixXd> es(A2);
+  auto lambda_ref = es.eigenvalues().head(neigen);
+  bool check_eigenvalues = DS_warm.eigenvalues().isApprox(lambda_ref, 1E-6);
+  if (!check_eigenvalues) {
+    std::cout << "ref" << std::endl;
+    std::cout << lambda_ref.transpose() << std::endl;
+    std::cout << "result" << std::endl;
+    std::cout << DS_warm.eigenvalues().transpose() << std::endl;
+  }
+  BOOST_CHECK_EQUAL(check_eigenvalues, 1);
+  BOOST_CHECK(DS_warm.info() == Eigen::ComputationInfo::Success);
+  BOOST_CHECK_LE(DS_warm.num_iterations(), DS_cold.num_iterations());
+
+  DavidsonSolver DS_wrong(log);
+  DS_wrong.set_initial_guess(Eigen::MatrixXd::Identity(size + 1, neigen));
+  BOOST_REQUIRE_THROW(DS_wrong.solve(A2, neigen), std::runtime_error);
+}
+
+BOOST_AUTO_TEST_CASE(davidson_full_matrix_many_roots) {
+
+  // enough roots that the early ones are locked before the last converge
+  Index size = 600;
+  Index neigen = 40;
+  Eigen::MatrixXd A = symm_matrix(size, 0.02);
+  A.diagonal() += Eigen::VectorXd::LinSpaced(size, 0, 0.1 * double(size - 1));
+  Logger log;
+  DavidsonSolver DS(log);
+  DS.set_tolerance("strict");
+  DS.set_max_search_space(5 * neigen);
+  DS.solve(A, neigen);
+  Eigen::SelfAdjointEigenSolver<Eigen::MatrixXd> es(A);
+
+  auto lambda = DS.eigenvalues();
+  auto lambda_ref = es.eigenvalues().head(neigen);
+  bool check_eigenvalues = lambda.isApprox(lambda_ref, 1E-6);
+  if (!check_eigenvalues) {
+    std::cout << "ref" << std::endl;
+    std::cout << lambda_ref.transpose() << std::endl;
+    std::cout << "result" << std::endl;
+    std::cout << lambda.transpose() << std::endl;
+  }
+  BOOST_CHECK_EQUAL(check_eigenvalues, 1);
+
+  Eigen::MatrixXd V = DS.eigenvectors();
+  Eigen::MatrixXd overlap = V.transpose() * V;
+  bool check_orthonormal =
+      overlap.isApprox(Eigen::MatrixXd::Identity(neigen, neigen), 1E-8);
+  BOOST_CHECK_EQUAL(check_orthonormal, 1);
+}
+
 BOOST_AUTO_TEST_CASE(davidson_full_matrix_fail) {
 
   Index size = 100;
@@ -124,6 +196,110 @@ BOOST_AUTO_TEST_CASE(davidson_full_matrix_fail) {
   BOOST_CHECK_EQUAL(check_eigenvalues, 0);
 }
 
+BOOST_AUTO_TEST_CASE(davidson_full_matrix_dependent_corrections) {
+
+  /* with a rank one coupling all residues of the unit vector start space are
+   * parallel and the DPR corrections only differ by their denominators. The
+   * start space has clustered diagonal elements, so the correction block is
+   * nearly dependent and the Cholesky QR has to fall back to column-wise
+   * Gram-Schmidt */
+  Index size = 200;
+  Index neigen = 4;
+  Eigen::VectorXd diagonal =
+      Eigen::VectorXd::LinSpaced(size, 10.0, 0.1 * double(size - 1) + 10.0);
+  diagonal.head(8) = Eigen::VectorXd::LinSpaced(8, 1.0, 1.007);
+  Eigen::VectorXd u = Eigen::VectorXd::Random(size);
+  Eigen::MatrixXd A = 0.05 * u * u.transpose();
+  A.diagonal() += diagonal;
+
+  Logger log;
+  DavidsonSolver DS(log);
+  DS.set_tolerance("strict");
+  DS.solve(A, neigen);
+  Eigen::SelfAdjointEigenSolver<Eigen::MatrixXd> es(A);
+
+  auto lambda = DS.eigenvalues();
+  auto lambda_ref = es.eigenvalues().head(neigen);
+  bool check_eigenvalues = lambda.isApprox(lambda_ref, 1E-6);
+  if (!check_eigenvalues) {
+    std::cout << "ref" << std::endl;
+    std::cout << lambda_ref.transpose() << std::endl;
+    std::cout << "result" << std::endl;
+    std::cout << lambda.transpose() << std::endl;
+  }
+  BOOST_CHECK_EQUAL(check_eigenvalues, 1);
+
+  Eigen::MatrixXd V = DS.eigenvectors();
+  Eigen::MatrixXd overlap = V.transpose() * V;
+  bool check_orthonormal =
+      overlap.isApprox(Eigen::MatrixXd::Identity(neigen, neigen), 1E-8);
+  BOOST_CHECK_EQUAL(check_orthonormal, 1);
+}
+
+// two matrices which share a common part, like singlet and triplet BSE
+class PairOperator {
+ public:
+  PairOperator(const Eigen::MatrixXd &common, const Eigen::MatrixXd &extra)
+      : common_(common), extra_(extra) {}
+  Index rows() const { return common_.rows(); }
+  Eigen::VectorXd diagonal1() const {
+    return common_.diagonal() + extra_.diagonal();
+  }
+  Eigen::VectorXd diagonal2() const { return common_.diagonal(); }
+  std::pair<Eigen::MatrixXd, Eigen::MatrixXd> matmul(
+      const Eigen::MatrixXd &V1, const Eigen::MatrixXd &V2) const {
+    Eigen::MatrixXd V(rows(), V1.cols() + V2.cols());
+    V.leftCols(V1.cols()) = V1;
+    V.rightCols(V2.cols()) = V2;
+    Eigen::MatrixXd AV = common_ * V;
+    return {AV.leftCols(V1.cols()) + extra_ * V1, AV.rightCols(V2.cols())};
+  }
+
+ private:
+  Eigen::MatrixXd common_;
+  Eigen::MatrixXd extra_;
+};
+
+BOOST_AUTO_TEST_CASE(davidson_full_matrix_lockstep) {
+
+  Index size = 200;
+  Index neigen = 10;
+  Index neigen2 = 6;
+  Eigen::MatrixXd common = init_matrix(size, 0.01);
+  Eigen::MatrixXd extra = symm_matrix(size, 0.01);
+  extra.diagonal().array() += 0.5;
+  PairOperator A(common, extra);
+
+  Logger log;
+  DavidsonSolver DS1(log);
+  DavidsonSolver DS2(log);
+  DS1.solve_lockstep(A, neigen, DS2, neigen2);
+
+  Eigen::MatrixXd A1 = common + extra;
+  Eigen::SelfAdjointEigenSolver<Eigen::MatrixXd> es1(A1);
+  Eigen::SelfAdjointEigenSolver<Eigen::MatrixXd> es2(common);
+
+  bool check_eigenvalues1 =
+      DS1.eigenvalues().isApprox(es1.eigenvalues().head(neigen), 1E-6);
+  bool check_eigenvalues2 =
+      DS2.eigenvalues().isApprox(es2.eigenvalues().head(neigen2), 1E-6);
+  if (!check_eigenvalues1 || !check_eigenvalues2) {
+    std::cout << "ref" << std::endl;
+    std::cout << es1.eigenvalues().head(neigen).transpose() << std::endl;
+    std::cout << es2.eigenvalues().head(neigen2).transpose() << std::endl;
+    std::cout << "result" << std::endl;
+    std::cout << DS1.eigenvalues().transpose() << std::endl;
+    std::cout << DS2.eigenvalues().transpose() << std::endl;
+  }
+  BOOST_CHECK_EQUAL(check_eigenvalues1, 1);
+  BOOST_CHECK_EQUAL(check_eigenvalues2, 1);
+
+  // same trajectory as two independent solves
+  DavidsonSolver DS_single(log);
+  DS_single.solve(common, neigen2);
+  BOOST_CHECK_EQUAL(DS2.num_iterations(), DS_single.num_iterations());
+}
+
 class TestOperator final : public MatrixFreeOperator {
  public:
   TestOperator() = default;
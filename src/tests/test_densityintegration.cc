@@ -76,6 +76,36 @@ BOOST_AUTO_TEST_CASE(density_test) {
     std::cout << "ref" << std::endl;
     std::cout << field_ref.transpose() << std::endl;
   }
+
+  num.SetupMultipoleBoxes(2.0);
+  // accuracy 0 integrates every box explicitly
+  Eigen::Vector3d field_boxes = num.IntegrateField_Multipoles(pos, 0.0);
+  bool boxes_check = field_boxes.isApprox(field, 1e-10);
+  BOOST_CHECK_EQUAL(boxes_check, true);
+  if (!boxes_check) {
+    std::cout << "field boxes" << std::endl;
+    std::cout << field_boxes.transpose() << std::endl;
+  }
+
+  Eigen::Vector3d far_pos = {30, 30, 30};
+  Eigen::Vector3d far_field = num.IntegrateField(far_pos);
+  Eigen::Vector3d far_multipoles = num.IntegrateField_Multipoles(far_pos, 0.5);
+  bool multipole_check = far_multipoles.isApprox(far_field, 1e-3);
+  BOOST_CHECK_EQUAL(multipole_check, true);
+  if (!multipole_check) {
+    std::cout << "multipoles" << std::endl;
+    std::cout << far_multipoles.transpose() << std::endl;
+    std::cout << "ref" << std::endl;
+    std::cout << far_field.transpose() << std::endl;
+  }
+
+  // accuracy 0 integrates every box explicitly
+  BOOST_CHECK_CLOSE(num.IntegratePotential_Multipoles(pos, 0.0),
+                    num.IntegratePotential(pos), 1e-8);
+  double far_potential = num.IntegratePotential(far_pos);
+  double far_potential_multipoles =
+      num.IntegratePotential_Multipoles(far_pos, 1e-5);
+  BOOST_CHECK_LE(std::abs(far_potential_multipoles - far_potential), 1e-5);
   libint2::finalize();
 }
 
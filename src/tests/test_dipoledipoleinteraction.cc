@@ -24,6 +24,7 @@
 #include <boost/test/unit_test.hpp>
 
 // Local VOTCA includes
+#include "votca/xtp/blockjacobipreconditioner.h"
 #include "votca/xtp/dipoledipoleinteraction.h"
 #include "votca/xtp/eigen.h"
 
@@ -114,4 +115,115 @@ BOOST_AUTO_TEST_CASE(dipoledipoleinteraction_test) {
   }
 }
 
+BOOST_AUTO_TEST_CASE(blockjacobipreconditioner_test) {
+
+  PolarSegment seg0("zero", 0);
+  seg0.push_back(PolarSite(0, "H", Eigen::Vector3d::UnitX()));
+  seg0.push_back(PolarSite(1, "C", Eigen::Vector3d::UnitZ()));
+  PolarSegment seg1("one", 1);
+  seg1.push_back(PolarSite(2, "N", 3 * Eigen::Vector3d::UnitY()));
+  seg0[0].V() = Eigen::Vector3d(0.1, -0.2, 0.3);
+  seg0[1].V() = Eigen::Vector3d(-0.1, 0.05, 0.2);
+  seg1[0].V() = Eigen::Vector3d(0.3, 0.1, -0.1);
+
+  std::vector<PolarSegment> segs;
+  segs.push_back(seg0);
+  segs.push_back(seg1);
+  eeInteractor interactor(0.39);
+  DipoleDipoleInteraction dipdip(interactor, segs);
+
+  BlockJacobiPreconditioner precond;
+  precond.setup(interactor, segs);
+  BOOST_CHECK_EQUAL(precond.info() == Eigen::Success, true);
+
+  Eigen::VectorXd b = Eigen::VectorXd::Zero(9);
+  Index index = 0;
+  for (const PolarSegment& seg : segs) {
+    for (const PolarSite& site : seg) {
+      b.segment<3>(index) = -site.V();
+      index += 3;
+    }
+  }
+
+  // the preconditioner solves each segment exactly
+  Eigen::VectorXd ref_blocks = Eigen::VectorXd::Zero(9);
+  ref_blocks.head<6>() = interactor.Cholesky_IntraSegment(seg0);
+  ref_blocks.tail<3>() = interactor.Cholesky_IntraSegment(seg1);
+  Eigen::VectorXd blocks = precond.solve(b);
+  bool block_check = blocks.isApprox(ref_blocks, 1e-10);
+  BOOST_CHECK_EQUAL(block_check, true);
+  if (!block_check) {
+    std::cout << "ref" << std::endl;
+    std::cout << ref_blocks.transpose() << std::endl;
+    std::cout << "preconditioner" << std::endl;
+    std::cout << blocks.transpose() << std::endl;
+  }
+
+  Eigen::MatrixXd full = Eigen::MatrixXd::Zero(9, 9);
+  Eigen::MatrixXd ident = Eigen::MatrixXd::Identity(9, 9);
+  for (Index i = 0; i < 9; i++) {
+    full.col(i) = dipdip * ident.col(i);
+  }
+  Eigen::VectorXd ref = full.llt().solve(b);
+
+  Eigen::ConjugateGradient<DipoleDipoleInteraction, Eigen::Lower | Eigen::Upper,
+                           BlockJacobiPreconditioner>
+      cg;
+  cg.preconditioner() = precond;
+  cg.setTolerance(1e-12);
+  cg.compute(dipdip);
+  Eigen::VectorXd x = cg.solveWithGuess(b, blocks);
+  bool cg_check = x.isApprox(ref, 1e-8);
+  BOOST_CHECK_EQUAL(cg_check, true);
+  if (!cg_check) {
+    std::cout << "ref" << std::endl;
+    std::cout << ref.transpose() << std::endl;
+    std::cout << "cg" << std::endl;
+    std::cout << x.transpose() << std::endl;
+  }
+}
+
+BOOST_AUTO_TEST_CASE(nearfield_test) {
+
+  PolarSegment seg0("zero", 0);
+  seg0.push_back(PolarSite(0, "H", Eigen::Vector3d::UnitX()));
+  seg0.push_back(PolarSite(1, "C", Eigen::Vector3d::UnitZ()));
+  PolarSegment seg1("one", 1);
+  seg1.push_back(PolarSite(2, "N", 3 * Eigen::Vector3d::UnitY()));
+  seg1.push_back(PolarSite(3, "O", 10 * Eigen::Vector3d::UnitY()));
+
+  std::vector<PolarSegment> segs;
+  segs.push_back(seg0);
+  segs.push_back(seg1);
+  eeInteractor interactor(0.39);
+  DipoleDipoleInteraction dipdip(interactor, segs);
+
+  Eigen::VectorXd v = Eigen::VectorXd::Zero(12);
+  for (Index i = 0; i < 12; i++) {
+    v(i) = 0.1 * double(i) - 0.4;
+  }
+  Eigen::VectorXd ref = dipdip * v;
+
+  // all pairs, pairs below 5 bohr and a budget for five blocks only
+  std::vector<std::pair<double, double>> settings = {
+      {100.0, 1e9}, {5.0, 1e9}, {100.0, 400.0}};
+  std::vector<Index> nblocks = {6, 3, 5};
+  for (Index i = 0; i < Index(settings.size()); i++) {
+    DipoleDipoleInteraction::NearFieldBlocks near =
+        dipdip.CalcNearFieldBlocks(settings[i].first, settings[i].second);
+    BOOST_CHECK_EQUAL(Index(near.block.size()), nblocks[i]);
+    DipoleDipoleInteraction cached(interactor, segs);
+    cached.setNearFieldBlocks(near);
+    Eigen::VectorXd result = cached * v;
+    bool check = result.isApprox(ref, 1e-12);
+    BOOST_CHECK_EQUAL(check, true);
+    if (!check) {
+      std::cout << "ref" << std::endl;
+      std::cout << ref.transpose() << std::endl;
+      std::cout << "cached" << std::endl;
+      std::cout << result.transpose() << std::endl;
+    }
+  }
+}
+
 BOOST_AUTO_TEST_SUITE_END()
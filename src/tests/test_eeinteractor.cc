@@ -18,6 +18,7 @@
 #define BOOST_TEST_MODULE eeinteractor_test
 
 // Standard includes
+#include <cmath>
 #include <iostream>
 
 // Third party includes
@@ -499,4 +500,260 @@ BOOST_AUTO_TEST_CASE(polar_case_monopole) {
   BOOST_CHECK_CLOSE(einternal, 0.04, 1e-12);
 }
 
+BOOST_AUTO_TEST_CASE(thole_block_kernel) {
+  std::vector<PolarSite> sites;
+  sites.push_back(PolarSite(0, "H", Eigen::Vector3d::Zero()));
+  sites.push_back(PolarSite(1, "C", Eigen::Vector3d(1.0, 0.5, 0.0)));
+  sites.push_back(PolarSite(2, "N", Eigen::Vector3d(-0.5, 2.0, 1.0)));
+  sites.push_back(PolarSite(3, "O", Eigen::Vector3d(4.0, 0.0, -3.0)));
+  std::vector<const PolarSite*> pointers;
+  for (const PolarSite& site : sites) {
+    pointers.push_back(&site);
+  }
+  PolarSiteBlock block(pointers);
+  eeInteractor interactor(0.39);
+
+  Eigen::MatrixXd dipoles = Eigen::MatrixXd::Zero(4, 3);
+  for (Index i = 0; i < 4; i++) {
+    dipoles.row(i) << 0.1 * double(i), -0.2, 0.05 * double(i * i);
+  }
+
+  Eigen::MatrixXd fields_ref = Eigen::MatrixXd::Zero(4, 3);
+  Eigen::MatrixXd fields = Eigen::MatrixXd::Zero(4, 3);
+  for (Index i = 0; i < 4; i++) {
+    for (Index j = i + 1; j < 4; j++) {
+      Eigen::Matrix3d T = interactor.FillTholeInteraction(sites[i], sites[j]);
+      fields_ref.row(i) += dipoles.row(j) * T.transpose();
+      fields_ref.row(j) += dipoles.row(i) * T;
+    }
+    interactor.TholeField_Block(block, i, i + 1, 3 - i, dipoles, fields);
+  }
+  bool check = fields.isApprox(fields_ref, 1e-12);
+  BOOST_CHECK_EQUAL(check, true);
+  if (!check) {
+    std::cout << "ref" << std::endl;
+    std::cout << fields_ref << std::endl;
+    std::cout << "block" << std::endl;
+    std::cout << fields << std::endl;
+  }
+}
+
+BOOST_AUTO_TEST_CASE(thole_block_damping_limit) {
+  eeInteractor interactor(0.39);
+  PolarSite site1(0, "C", Eigen::Vector3d::Zero());
+  Eigen::Vector3d direction = Eigen::Vector3d(1.0, -2.0, 0.5).normalized();
+  double damp = 0.39 * site1.getSqrtInvEigenDamp() *
+                PolarSite(1, "C").getSqrtInvEigenDamp();
+  // au3 from nearly overlapping sites, where 1-exp(-au3) cancels, to both
+  // sides of the cutoff at 40, where the damping is switched off
+  std::vector<double> au3_values = {1e-6, 1e-4,        39.9,  40.0 - 1e-9,
+                                    40.0, 40.0 + 1e-9, 40.1, 200.0};
+  for (double au3 : au3_values) {
+    double R = std::cbrt(au3 / damp);
+    PolarSite site2(1, "C", R * direction);
+    std::vector<const PolarSite*> pointers = {&site1, &site2};
+    PolarSiteBlock block(pointers);
+
+    Eigen::MatrixXd dipoles(2, 3);
+    dipoles << 0.3, -0.1, 0.2, -0.4, 0.5, 0.1;
+    Eigen::MatrixXd fields = Eigen::MatrixXd::Zero(2, 3);
+    interactor.TholeField_Block(block, 0, 1, 1, dipoles, fields);
+
+    Eigen::Matrix3d T = interactor.FillTholeInteraction(site1, site2);
+    Eigen::MatrixXd fields_ref(2, 3);
+    fields_ref.row(0) = dipoles.row(1) * T.transpose();
+    fields_ref.row(1) = dipoles.row(0) * T;
+    // the cancellation for small au3 limits the agreement of the two
+    // exponential implementations
+    bool check = fields.isApprox(fields_ref, 1e-8);
+    BOOST_CHECK_EQUAL(check, true);
+    if (!check) {
+      std::cout << "au3 " << au3 << std::endl;
+      std::cout << "ref" << std::endl;
+      std::cout << fields_ref << std::endl;
+      std::cout << "block" << std::endl;
+      std::cout << fields << std::endl;
+    }
+  }
+}
+
+template <class T>
+void FillSegment(T& seg, Index nsites, double shift) {
+  for (Index i = 0; i < nsites; i++) {
+    double x = double(i);
+    Eigen::Vector3d pos(shift + 1.3 * x, 0.7 * x * x - 1.0, std::sin(x));
+    typename T::iterator::value_type site(i, "C", pos);
+    Vector9d mpoles = Vector9d::Zero();
+    mpoles.head<4>() << 0.2 * std::cos(x), 0.1 * x, -0.3, 0.05 * x * x;
+    site.setMultipole(mpoles, 1);
+    seg.push_back(site);
+  }
+}
+
+// a site with rank 2 but no multipoles does not change any interaction, but
+// sends the segment to the pair kernels
+template <class T>
+T WithQuadrupoleSite(const T& seg) {
+  T result = seg;
+  typename T::iterator::value_type site(seg.size(), "C",
+                                        Eigen::Vector3d(30.0, -20.0, 10.0));
+  site.setMultipole(Vector9d::Zero(), 2);
+  result.push_back(site);
+  return result;
+}
+
+BOOST_AUTO_TEST_CASE(static_block_kernels) {
+  eeInteractor interactor(0.39);
+  StaticSegment sources("sources", 0);
+  FillSegment(sources, 5, 0.0);
+  StaticSegment sources_pair = WithQuadrupoleSite(sources);
+
+  PolarSegment targets("targets", 1);
+  FillSegment(targets, 4, 6.0);
+  for (Index i = 0; i < targets.size(); i++) {
+    targets[i].setInduced_Dipole(
+        Eigen::Vector3d(0.01 * double(i), -0.02, 0.03 * double(i)));
+  }
+  PolarSegment targets_pair = WithQuadrupoleSite(targets);
+
+  BOOST_CHECK_CLOSE(interactor.CalcStaticEnergy(sources, targets),
+                    interactor.CalcStaticEnergy(sources_pair, targets), 1e-10);
+  BOOST_CHECK_CLOSE(interactor.CalcStaticEnergy_IntraSegment(sources),
+                    interactor.CalcStaticEnergy_IntraSegment(sources_pair),
+                    1e-10);
+
+  PolarSegment block_result = targets;
+  PolarSegment pair_result = targets;
+  double e_block =
+      interactor.ApplyStaticField<StaticSegment, Estatic::V>(sources,
+                                                             block_result);
+  double e_pair = interactor.ApplyStaticField<StaticSegment, Estatic::V>(
+      sources_pair, pair_result);
+  BOOST_CHECK_CLOSE(e_block, e_pair, 1e-10);
+  for (Index i = 0; i < targets.size(); i++) {
+    bool check = block_result[i].V().isApprox(pair_result[i].V(), 1e-10);
+    BOOST_CHECK_EQUAL(check, true);
+    if (!check) {
+      std::cout << "site " << i << std::endl;
+      std::cout << "block " << block_result[i].V().transpose() << std::endl;
+      std::cout << "pair " << pair_result[i].V().transpose() << std::endl;
+    }
+  }
+
+  eeInteractor::E_terms polar_static =
+      interactor.CalcPolarEnergy(targets, sources);
+  eeInteractor::E_terms polar_static_ref =
+      interactor.CalcPolarEnergy(targets, sources_pair);
+  BOOST_CHECK_CLOSE(polar_static.E_indu_stat(),
+                    polar_static_ref.E_indu_stat(), 1e-10);
+
+  PolarSegment others("others", 2);
+  FillSegment(others, 3, -5.0);
+  for (Index i = 0; i < others.size(); i++) {
+    others[i].setInduced_Dipole(
+        Eigen::Vector3d(-0.02, 0.01 * double(i), 0.04));
+  }
+  eeInteractor::E_terms polar_polar =
+      interactor.CalcPolarEnergy(targets, others);
+  eeInteractor::E_terms polar_polar_ref =
+      interactor.CalcPolarEnergy(targets_pair, others);
+  BOOST_CHECK_CLOSE(polar_polar.E_indu_stat(), polar_polar_ref.E_indu_stat(),
+                    1e-10);
+  BOOST_CHECK_CLOSE(polar_polar.E_indu_indu(), polar_polar_ref.E_indu_indu(),
+                    1e-10);
+
+  double e_intra_ref = 0.0;
+  for (Index i = 0; i < targets.size(); i++) {
+    for (Index j = 0; j < i; j++) {
+      e_intra_ref += targets[i].Induced_Dipole().transpose() *
+                     interactor.FillTholeInteraction(targets[i], targets[j]) *
+                     targets[j].Induced_Dipole();
+    }
+  }
+  BOOST_CHECK_CLOSE(interactor.CalcPolarEnergy_IntraSegment(targets),
+                    e_intra_ref, 1e-10);
+}
+
+
+BOOST_AUTO_TEST_CASE(region_block_kernels) {
+  eeInteractor interactor(0.39);
+  std::vector<PolarSegment> segments;
+  for (Index k = 0; k < 3; k++) {
+    PolarSegment seg("seg", k);
+    FillSegment(seg, 3 + k, 5.0 * double(k));
+    for (Index i = 0; i < seg.size(); i++) {
+      seg[i].setInduced_Dipole(
+          Eigen::Vector3d(0.01 * double(i + k), -0.02, 0.03 * double(i - k)));
+    }
+    segments.push_back(seg);
+  }
+  PolarSiteBlock sites(segments);
+  StaticSiteBlock statics(segments);
+  Eigen::MatrixXd dipoles(sites.size(), 3);
+  Index index = 0;
+  for (const PolarSegment& seg : segments) {
+    for (const PolarSite& site : seg) {
+      dipoles.row(index) = site.Induced_Dipole().transpose();
+      index++;
+    }
+  }
+  BOOST_CHECK_EQUAL(sites.NumberOfSegments(), 3);
+
+  for (Index k = 0; k < 3; k++) {
+    const PolarSegment& seg = segments[k];
+    double e_intra_ref = 0.0;
+    for (Index i = 0; i < seg.size(); i++) {
+      for (Index j = 0; j < i; j++) {
+        e_intra_ref += seg[i].Induced_Dipole().transpose() *
+                       interactor.FillTholeInteraction(seg[i], seg[j]) *
+                       seg[j].Induced_Dipole();
+      }
+    }
+    BOOST_CHECK_CLOSE(
+        interactor.CalcPolarEnergy_IntraSegment(
+            sites, dipoles, sites.SegmentStart(k), sites.SegmentSize(k)),
+        e_intra_ref, 1e-10);
+
+    for (Index l = 0; l < k; l++) {
+      eeInteractor::E_terms block = interactor.CalcPolarEnergy_Block(
+          sites, statics, dipoles, sites.SegmentStart(k), sites.SegmentSize(k),
+          sites.SegmentStart(l), sites.SegmentSize(l));
+      // the pair kernels as reference
+      eeInteractor::E_terms ref =
+          interactor.CalcPolarEnergy(WithQuadrupoleSite(seg), segments[l]);
+      BOOST_CHECK_CLOSE(block.E_indu_stat(), ref.E_indu_stat(), 1e-10);
+      BOOST_CHECK_CLOSE(block.E_indu_indu(), ref.E_indu_indu(), 1e-10);
+    }
+  }
+
+  // one segment with the range of all segments before it
+  eeInteractor::E_terms range = interactor.CalcPolarEnergy_Block(
+      sites, statics, dipoles, sites.SegmentStart(2), sites.SegmentSize(2), 0,
+      sites.SegmentStart(2));
+  eeInteractor::E_terms range_ref =
+      interactor.CalcPolarEnergy(segments[2], segments[0]) +
+      interactor.CalcPolarEnergy(segments[2], segments[1]);
+  BOOST_CHECK_CLOSE(range.E_indu_stat(), range_ref.E_indu_stat(), 1e-10);
+  BOOST_CHECK_CLOSE(range.E_indu_indu(), range_ref.E_indu_indu(), 1e-10);
+
+  Eigen::VectorXd v = Eigen::VectorXd::LinSpaced(3 * sites.size(), -0.05, 0.08);
+  DipoleDipoleInteraction own(interactor, segments);
+  DipoleDipoleInteraction shared(interactor, segments, sites);
+  Eigen::VectorXd field_own = own * v;
+  Eigen::VectorXd field_shared = shared * v;
+  bool check = field_shared.isApprox(field_own, 1e-12);
+  BOOST_CHECK_EQUAL(check, true);
+  if (!check) {
+    std::cout << "own" << std::endl;
+    std::cout << field_own.transpose() << std::endl;
+    std::cout << "shared" << std::endl;
+    std::cout << field_shared.transpose() << std::endl;
+  }
+
+  BOOST_CHECK_EQUAL(sites.SameGeometry(segments), true);
+  segments[1][0].setPos(segments[1][0].getPos() +
+                        Eigen::Vector3d(0.1, 0.0, 0.0));
+  BOOST_CHECK_EQUAL(sites.SameGeometry(segments), false);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
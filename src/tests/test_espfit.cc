@@ -117,4 +117,59 @@ BOOST_AUTO_TEST_CASE(esp_charges) {
   libint2::finalize();
 }
 
+BOOST_AUTO_TEST_CASE(esp_methods) {
+  libint2::initialize();
+  Orbitals orbitals;
+  orbitals.QMAtoms().LoadFromFile(std::string(XTP_TEST_DATA_FOLDER) +
+                                  "/espfit/molecule.xyz");
+  orbitals.setDFTbasisName(std::string(XTP_TEST_DATA_FOLDER) +
+                           "/espfit/3-21G.xml");
+  orbitals.setBasisSetSize(13);
+  orbitals.setNumberOfOccupiedLevels(5);
+
+  Eigen::MatrixXd MOs = votca::tools::EigenIO_MatrixMarket::ReadMatrix(
+      std::string(XTP_TEST_DATA_FOLDER) + "/espfit/MOs.mm");
+  orbitals.MOs().eigenvectors() = MOs;
+  orbitals.MOs().eigenvalues() = Eigen::VectorXd::Ones(13);
+  QMState gs = QMState("n");
+  Logger log;
+  Eigen::VectorXd p_ref = Eigen::VectorXd::Zero(3);
+  p_ref << -0.827774, 0.413985, 0.41379;
+
+  // same integration grid as the reference, the potential differs by less
+  // than the accuracy
+  Espfit multipole = Espfit(log);
+  multipole.setUseSVD(1e-8);
+  multipole.setESPMethod("multipole", 1e-6);
+  StaticSegment result = multipole.Fit2Density(orbitals, gs, "xcoarse");
+  Eigen::VectorXd pcharges = Eigen::VectorXd::Zero(result.size());
+  for (Index i = 0; i < result.size(); i++) {
+    pcharges(i) = result[i].getCharge();
+  }
+  bool check_multipole = p_ref.isApprox(pcharges, 0.01);
+  if (!check_multipole) {
+    std::cout << "multipole" << std::endl;
+    std::cout << pcharges << std::endl;
+  }
+  BOOST_CHECK_EQUAL(check_multipole, true);
+
+  // no integration grid at all, the reference carries the grid error
+  Espfit analytic = Espfit(log);
+  analytic.setUseSVD(1e-8);
+  analytic.setESPMethod("analytic", 0.0);
+  StaticSegment result2 = analytic.Fit2Density(orbitals, gs, "xcoarse");
+  for (Index i = 0; i < result2.size(); i++) {
+    pcharges(i) = result2[i].getCharge();
+  }
+  bool check_analytic = p_ref.isApprox(pcharges, 0.05);
+  if (!check_analytic) {
+    std::cout << "analytic" << std::endl;
+    std::cout << pcharges << std::endl;
+  }
+  BOOST_CHECK_EQUAL(check_analytic, true);
+  BOOST_CHECK_SMALL(pcharges.sum(), 1e-6);
+
+  libint2::finalize();
+}
+
 BOOST_AUTO_TEST_SUITE_END()
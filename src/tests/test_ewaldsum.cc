@@ -0,0 +1,311 @@
+/*
+ * Copyright 2009-2020 The VOTCA Development Team (http://www.votca.org)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+#define BOOST_TEST_MAIN
+
+#define BOOST_TEST_MODULE ewaldsum_test
+
+// Standard includes
+#include <cmath>
+#include <iostream>
+
+// Third party includes
+#include <boost/test/unit_test.hpp>
+
+// Local VOTCA includes
+#include "votca/xtp/ewaldsum.h"
+
+using namespace votca::xtp;
+using namespace votca;
+
+BOOST_AUTO_TEST_SUITE(ewaldsum_test)
+
+BOOST_AUTO_TEST_CASE(charges_direct_sum) {
+  // neutral cell without dipole moment, so the spherical direct sum converges
+  // to the tinfoil result
+  Eigen::Matrix3d box = 8 * Eigen::Matrix3d::Identity();
+  std::vector<StaticSite> sites;
+  sites.push_back(StaticSite(0, "C", Eigen::Vector3d(5, 4, 4)));
+  sites.push_back(StaticSite(1, "C", Eigen::Vector3d(3, 4, 4)));
+  sites.push_back(StaticSite(2, "C", Eigen::Vector3d(4, 5, 4)));
+  sites.push_back(StaticSite(3, "C", Eigen::Vector3d(4, 3, 4)));
+  sites[0].setCharge(1.0);
+  sites[1].setCharge(1.0);
+  sites[2].setCharge(-1.0);
+  sites[3].setCharge(-1.0);
+  std::vector<const StaticSite*> pointers;
+  for (const StaticSite& site : sites) {
+    pointers.push_back(&site);
+  }
+  EwaldSum ewald(box, 1e-10, pointers, std::vector<bool>(4, false), 1);
+
+  const Eigen::Vector3d pos(4.5, 5.5, 3.0);
+  Eigen::Vector3d gradient = Eigen::Vector3d::Zero();
+  const Index N = 10;
+  for (Index i = -N; i <= N; i++) {
+    for (Index j = -N; j <= N; j++) {
+      for (Index k = -N; k <= N; k++) {
+        if (i * i + j * j + k * k > N * N) {
+          continue;
+        }
+        for (const StaticSite& site : sites) {
+          const Eigen::Vector3d R =
+              pos - site.getPos() -
+              box * Eigen::Vector3d(double(i), double(j), double(k));
+          gradient -= site.getCharge() * R / std::pow(R.norm(), 3);
+        }
+      }
+    }
+  }
+  Eigen::Vector4d field = ewald.Field<4>(pos);
+  bool check_gradient = field.tail<3>().isApprox(gradient, 1e-5);
+  if (!check_gradient) {
+    std::cout << "ewald" << std::endl;
+    std::cout << field.tail<3>().transpose() << std::endl;
+    std::cout << "direct" << std::endl;
+    std::cout << gradient.transpose() << std::endl;
+  }
+  BOOST_CHECK_EQUAL(check_gradient, true);
+}
+
+BOOST_AUTO_TEST_CASE(multipoles_splitting_and_exclusion) {
+  Eigen::Matrix3d box;
+  box << 10, 1.5, 0.5, 0, 11, -1, 0, 0, 12;
+  std::vector<StaticSite> sites;
+  for (Index i = 0; i < 6; i++) {
+    const Eigen::Vector3d pos(5.0 + 1.3 * double(i), 4.0 - 0.7 * double(i),
+                              2.0 + 1.1 * double(i * i % 5));
+    StaticSite site(i, "C", pos);
+    Vector9d multipoles;
+    multipoles << 0.5 - 0.2 * double(i), 0.1, -0.2 * double(i % 2), 0.3, 0.1,
+        -0.05, 0.02 * double(i), 0.03, -0.1;
+    site.setMultipole(multipoles, 2);
+    sites.push_back(site);
+  }
+  std::vector<const StaticSite*> pointers;
+  for (const StaticSite& site : sites) {
+    pointers.push_back(&site);
+  }
+  std::vector<bool> none(sites.size(), false);
+  std::vector<bool> first = none;
+  first[0] = true;
+
+  // the result does not depend on the splitting of real and reciprocal space
+  EwaldSum accurate(box, 1e-12, pointers, first, 1);
+  EwaldSum coarse(box, 1e-8, pointers, first, 1);
+  BOOST_CHECK(accurate.Alpha() != coarse.Alpha());
+  EwaldSum all(box, 1e-12, pointers, none, 1);
+
+  std::vector<Eigen::Vector3d> points = {sites[0].getPos(),
+                                         Eigen::Vector3d(2.0, 3.0, 4.0),
+                                         Eigen::Vector3d(-7.0, 25.0, 13.0)};
+  for (const Eigen::Vector3d& pos : points) {
+    Eigen::Vector4d field = accurate.Field<4>(pos);
+    bool check_splitting = field.isApprox(coarse.Field<4>(pos), 1e-6);
+    if (!check_splitting) {
+      std::cout << field.transpose() << std::endl;
+      std::cout << coarse.Field<4>(pos).transpose() << std::endl;
+    }
+    BOOST_CHECK_EQUAL(check_splitting, true);
+  }
+
+  // leaving out the central copy removes its bare field
+  const Eigen::Vector3d pos(2.0, 3.0, 4.0);
+  const Eigen::Vector3d R = pos - sites[0].getPos();
+  const Eigen::Vector3d d = sites[0].Q().segment<3>(1);
+  const Eigen::Matrix3d theta = sites[0].CalculateCartesianMultipole();
+  const double r = R.norm();
+  const double q = sites[0].getCharge();
+  Eigen::Vector4d bare;
+  bare(0) = q / r + d.dot(R) / std::pow(r, 3) +
+            R.dot(theta * R) / std::pow(r, 5);
+  bare.tail<3>() = -q * R / std::pow(r, 3) + d / std::pow(r, 3) -
+                   3 * d.dot(R) * R / std::pow(r, 5) +
+                   2 * theta * R / std::pow(r, 5) -
+                   5 * R.dot(theta * R) * R / std::pow(r, 7);
+  Eigen::Vector4d difference = all.Field<4>(pos) - accurate.Field<4>(pos);
+  bool check_exclusion = difference.isApprox(bare, 1e-8);
+  if (!check_exclusion) {
+    std::cout << difference.transpose() << std::endl;
+    std::cout << bare.transpose() << std::endl;
+  }
+  BOOST_CHECK_EQUAL(check_exclusion, true);
+}
+
+std::vector<StaticSite> QuadrupoleSites() {
+  std::vector<StaticSite> sites;
+  for (Index i = 0; i < 6; i++) {
+    const Eigen::Vector3d pos(5.0 + 1.3 * double(i), 4.0 - 0.7 * double(i),
+                              2.0 + 1.1 * double(i * i % 5));
+    StaticSite site(i, "C", pos);
+    Vector9d multipoles;
+    multipoles << 0.5 - 0.2 * double(i), 0.1, -0.2 * double(i % 2), 0.3, 0.1,
+        -0.05, 0.02 * double(i), 0.03, -0.1;
+    site.setMultipole(multipoles, 2);
+    sites.push_back(site);
+  }
+  return sites;
+}
+
+BOOST_AUTO_TEST_CASE(second_derivatives) {
+  Eigen::Matrix3d box;
+  box << 10, 1.5, 0.5, 0, 11, -1, 0, 0, 12;
+  std::vector<StaticSite> sites = QuadrupoleSites();
+  std::vector<const StaticSite*> pointers;
+  for (const StaticSite& site : sites) {
+    pointers.push_back(&site);
+  }
+  std::vector<bool> first(sites.size(), false);
+  first[0] = true;
+  EwaldSum ewald(box, 1e-12, pointers, first, 1);
+
+  // central differences of the gradient, in the layout of VSiteA<9>
+  std::vector<Eigen::Vector3d> points = {sites[0].getPos(),
+                                         Eigen::Vector3d(2.0, 3.0, 4.0)};
+  for (const Eigen::Vector3d& pos : points) {
+    Eigen::Matrix3d H;
+    const double h = 1e-4;
+    for (Index a = 0; a < 3; a++) {
+      Eigen::Vector3d step = Eigen::Vector3d::Zero();
+      step(a) = h;
+      H.col(a) = (ewald.Field<4>(pos + step).tail<3>() -
+                  ewald.Field<4>(pos - step).tail<3>()) /
+                 (2 * h);
+    }
+    const double sqr3 = std::sqrt(3.0);
+    Vector9d ref;
+    ref.head<4>() = ewald.Field<4>(pos);
+    ref.tail<5>() << (2 * H(2, 2) - H(0, 0) - H(1, 1)) / 6.0, H(0, 2) / sqr3,
+        H(1, 2) / sqr3, (H(0, 0) - H(1, 1)) / (2 * sqr3), H(0, 1) / sqr3;
+    Vector9d field = ewald.Field<9>(pos);
+    bool check = field.isApprox(ref, 1e-6);
+    if (!check) {
+      std::cout << "ewald" << std::endl;
+      std::cout << field.transpose() << std::endl;
+      std::cout << "finite differences" << std::endl;
+      std::cout << ref.transpose() << std::endl;
+    }
+    BOOST_CHECK_EQUAL(check, true);
+  }
+}
+
+BOOST_AUTO_TEST_CASE(shared_lattice) {
+  Eigen::Matrix3d box;
+  box << 10, 1.5, 0.5, 0, 11, -1, 0, 0, 12;
+  std::vector<StaticSite> sites = QuadrupoleSites();
+  std::vector<const StaticSite*> pointers;
+  for (const StaticSite& site : sites) {
+    pointers.push_back(&site);
+  }
+  EwaldSum lattice(box, 1e-12, pointers, std::vector<bool>(sites.size(), false),
+                   1);
+
+  // the explicit copies of sites 1 and 4 are periodic images
+  const Eigen::Vector3d image1 = box * Eigen::Vector3d(1, 0, -1);
+  const Eigen::Vector3d image4 = box * Eigen::Vector3d(0, -1, 0);
+  EwaldSum shared(lattice, {1, 4},
+                  {sites[1].getPos() + image1, sites[4].getPos() + image4});
+  BOOST_CHECK_EQUAL(shared.NumberOfExplicitSites(), 2);
+  BOOST_CHECK_EQUAL(shared.NumberOfKvectors(), lattice.NumberOfKvectors());
+
+  std::vector<StaticSite> shifted = sites;
+  shifted[1].Translate(image1);
+  shifted[4].Translate(image4);
+  std::vector<const StaticSite*> shifted_pointers;
+  for (const StaticSite& site : shifted) {
+    shifted_pointers.push_back(&site);
+  }
+  std::vector<bool> is_explicit(sites.size(), false);
+  is_explicit[1] = true;
+  is_explicit[4] = true;
+  EwaldSum reference(box, 1e-12, shifted_pointers, is_explicit, 1);
+
+  std::vector<Eigen::Vector3d> points = {shifted[1].getPos(),
+                                         shifted[4].getPos(),
+                                         Eigen::Vector3d(2.0, 3.0, 4.0)};
+  for (const Eigen::Vector3d& pos : points) {
+    Vector9d field = shared.Field<9>(pos);
+    Vector9d ref = reference.Field<9>(pos);
+    bool check = field.isApprox(ref, 1e-8);
+    if (!check) {
+      std::cout << "shared" << std::endl;
+      std::cout << field.transpose() << std::endl;
+      std::cout << "rebuilt" << std::endl;
+      std::cout << ref.transpose() << std::endl;
+    }
+    BOOST_CHECK_EQUAL(check, true);
+  }
+
+  BOOST_CHECK_THROW(EwaldSum(lattice, {1}, {sites[1].getPos() + 0.5 * image1}),
+                    std::runtime_error);
+}
+
+BOOST_AUTO_TEST_CASE(dipole_lattice) {
+  Eigen::Matrix3d box;
+  box << 10, 1.5, 0.5, 0, 11, -1, 0, 0, 12;
+  std::vector<StaticSite> sites = QuadrupoleSites();
+  const Index nsites = Index(sites.size());
+  Eigen::MatrixXd dipoles = Eigen::MatrixXd::Random(nsites, 3);
+  std::vector<const StaticSite*> pointers;
+  for (Index i = 0; i < nsites; i++) {
+    // some sites outside of the cell
+    sites[i].Translate(box * Eigen::Vector3d(double(i % 2), 0, -double(i % 3)));
+    Vector9d multipoles = Vector9d::Zero();
+    multipoles.segment<3>(1) = dipoles.row(i).transpose();
+    sites[i].setMultipole(multipoles, 1);
+    pointers.push_back(&sites[i]);
+  }
+  EwaldSum ewald(box, 1e-12, pointers, std::vector<bool>(nsites, true),
+                 nsites);
+  Eigen::MatrixXd gradient = ewald.DipoleField(dipoles);
+
+  // images of all sites from the explicit lattice plus the bare central
+  // copies of the other sites
+  for (Index i = 0; i < nsites; i++) {
+    Eigen::Vector3d ref = ewald.Field<4>(sites[i].getPos()).tail<3>();
+    for (Index j = 0; j < nsites; j++) {
+      if (j == i) {
+        continue;
+      }
+      const Eigen::Vector3d R = sites[i].getPos() - sites[j].getPos();
+      const Eigen::Vector3d d = dipoles.row(j).transpose();
+      const double r = R.norm();
+      ref += d / std::pow(r, 3) - 3 * d.dot(R) * R / std::pow(r, 5);
+    }
+    bool check = gradient.row(i).transpose().isApprox(ref, 1e-8);
+    if (!check) {
+      std::cout << "site " << i << std::endl;
+      std::cout << gradient.row(i) << std::endl;
+      std::cout << ref.transpose() << std::endl;
+    }
+    BOOST_CHECK_EQUAL(check, true);
+  }
+
+  // the operator is symmetric and independent of the splitting
+  Eigen::MatrixXd matrix(3 * nsites, 3 * nsites);
+  for (Index c = 0; c < 3 * nsites; c++) {
+    Eigen::MatrixXd unit = Eigen::MatrixXd::Zero(nsites, 3);
+    unit(c / 3, c % 3) = 1.0;
+    Eigen::MatrixXd column = ewald.DipoleField(unit);
+    for (Index r = 0; r < 3 * nsites; r++) {
+      matrix(r, c) = column(r / 3, r % 3);
+    }
+  }
+  BOOST_CHECK(matrix.isApprox(matrix.transpose(), 1e-10));
+  EwaldSum coarse(box, 1e-8, pointers, std::vector<bool>(nsites, true), 1);
+  BOOST_CHECK(coarse.DipoleField(dipoles).isApprox(gradient, 1e-6));
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,132 @@
+/*
+ * Copyright 2009-2020 The VOTCA Development Team (http://www.votca.org)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+#include <libint2/initialize.h>
+#define BOOST_TEST_MAIN
+
+#define BOOST_TEST_MODULE frozen_natural_orbitals_test
+
+// Third party includes
+#include <boost/test/unit_test.hpp>
+
+// VOTCA includes
+#include <votca/tools/eigenio_matrixmarket.h>
+
+// Local VOTCA includes
+#include "votca/xtp/aobasis.h"
+#include "votca/xtp/frozen_natural_orbitals.h"
+#include "votca/xtp/gwbse.h"
+#include "votca/xtp/orbitals.h"
+#include "votca/xtp/threecenter.h"
+
+using namespace votca::xtp;
+using namespace votca;
+using namespace std;
+
+BOOST_AUTO_TEST_SUITE(frozen_natural_orbitals_test)
+
+BOOST_AUTO_TEST_CASE(fno_truncation) {
+  libint2::initialize();
+  Orbitals orbitals;
+  orbitals.QMAtoms().LoadFromFile(std::string(XTP_TEST_DATA_FOLDER) +
+                                  "/rpa/molecule.xyz");
+  BasisSet basis;
+  basis.Load(std::string(XTP_TEST_DATA_FOLDER) + "/rpa/3-21G.xml");
+
+  AOBasis aobasis;
+  aobasis.Fill(basis, orbitals.QMAtoms());
+
+  Eigen::VectorXd eigenvals = votca::tools::EigenIO_MatrixMarket::ReadVector(
+      std::string(XTP_TEST_DATA_FOLDER) + "/rpa/eigenvals.mm");
+
+  Eigen::MatrixXd eigenvectors = votca::tools::EigenIO_MatrixMarket::ReadMatrix(
+      std::string(XTP_TEST_DATA_FOLDER) + "/rpa/eigenvectors.mm");
+
+  // occupied 0:4, virtual 5:16, the lowest 2 virtuals are not truncated
+  Index homo = 4;
+  Index nfixed = 2;
+  TCMatrix_gwbse Bia;
+  Bia.Initialize(aobasis.AOBasisSize(), 0, homo, homo + 1, 16);
+  Bia.Fill(aobasis, aobasis, eigenvectors);
+  Eigen::VectorXd occ_energies = eigenvals.head(homo + 1);
+  Eigen::VectorXd virt_energies = eigenvals.segment(homo + 1, 12);
+  Index ntrunc = 12 - nfixed;
+
+  // keeping all natural orbitals only rotates the virtual space
+  FrozenNaturalOrbitals all;
+  all.Compute(Bia, occ_energies, virt_energies, nfixed, -1.0);
+  BOOST_CHECK_EQUAL(all.size(), ntrunc);
+  BOOST_CHECK_SMALL(all.EnergyCorrection(), 1e-10);
+  BOOST_CHECK_LT(all.MP2CorrelationEnergy(), 0.0);
+  bool check_energies = all.Energies().isApprox(virt_energies.tail(ntrunc));
+  if (!check_energies) {
+    cout << "energies" << endl;
+    cout << all.Energies().transpose() << endl;
+    cout << "energies_ref" << endl;
+    cout << virt_energies.tail(ntrunc).transpose() << endl;
+  }
+  BOOST_CHECK_EQUAL(check_energies, true);
+  for (Index i = 1; i < ntrunc; i++) {
+    BOOST_CHECK_GE(all.Occupations()(i - 1), all.Occupations()(i));
+  }
+
+  // keep the three most occupied ones
+  FrozenNaturalOrbitals fno;
+  fno.Compute(Bia, occ_energies, virt_energies, nfixed,
+              all.Occupations()(3));
+  BOOST_CHECK_EQUAL(fno.size(), 3);
+  BOOST_CHECK_CLOSE(fno.MP2CorrelationEnergy(), all.MP2CorrelationEnergy(),
+                    1e-8);
+  BOOST_CHECK_LT(std::abs(fno.EnergyCorrection()),
+                 std::abs(fno.MP2CorrelationEnergy()));
+  Eigen::MatrixXd overlap =
+      fno.Transformation().transpose() * fno.Transformation();
+  bool check_orthonormal =
+      overlap.isApprox(Eigen::MatrixXd::Identity(3, 3), 1e-10);
+  BOOST_CHECK_EQUAL(check_orthonormal, true);
+  BOOST_CHECK_GE(fno.Energies().minCoeff(), virt_energies(nfixed) - 1e-10);
+  BOOST_CHECK_LE(fno.Energies().maxCoeff(), virt_energies(11) + 1e-10);
+
+  libint2::finalize();
+}
+
+BOOST_AUTO_TEST_CASE(bse_only_ranges) {
+  // .orb file of a GW run with rpamax 16 truncated to 9
+  Orbitals orbitals;
+  orbitals.setGWindices(0, 6);
+  orbitals.setRPAindices(0, 9);
+
+  GW::options opt;
+  opt.qpmin = 0;
+  opt.qpmax = 6;
+  opt.rpamin = 0;
+  opt.rpamax = 9;
+  BOOST_CHECK_NO_THROW(GWBSE::CheckStoredRanges(orbitals, opt, true));
+
+  // the same truncation without fno_threshold or a different truncation
+  opt.rpamax = 16;
+  BOOST_CHECK_THROW(GWBSE::CheckStoredRanges(orbitals, opt, false),
+                    std::runtime_error);
+  opt.rpamax = 11;
+  BOOST_CHECK_THROW(GWBSE::CheckStoredRanges(orbitals, opt, true),
+                    std::runtime_error);
+
+  opt.rpamax = 9;
+  opt.qpmax = 7;
+  BOOST_CHECK_THROW(GWBSE::CheckStoredRanges(orbitals, opt, true),
+                    std::runtime_error);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -58,4 +58,127 @@ BOOST_AUTO_TEST_CASE(constructor) {
   JobTopology top(job, log, workdir);
 }
 
+void WriteNeonFiles() {
+  ofstream mapstream("neon_map.xml");
+  mapstream << "<topology><molecules><molecule>" << std::endl;
+  mapstream << "<name>Neon</name><mdname>Neon</mdname>" << std::endl;
+  mapstream << "<segments><segment>" << std::endl;
+  mapstream << "<name>Neon</name>" << std::endl;
+  mapstream << "<qmcoords_n>neon.xyz</qmcoords_n>" << std::endl;
+  mapstream << "<multipoles_n>neon_n.mps</multipoles_n>" << std::endl;
+  mapstream << "<map2md>0</map2md>" << std::endl;
+  mapstream << "<fragments><fragment>" << std::endl;
+  mapstream << "<name>Ne</name>" << std::endl;
+  mapstream << "<mdatoms>0:Ne:0</mdatoms>" << std::endl;
+  mapstream << "<qmatoms>0:Ne</qmatoms>" << std::endl;
+  mapstream << "<mpoles>0:Ne</mpoles>" << std::endl;
+  mapstream << "<weights>20</weights>" << std::endl;
+  mapstream << "<localframe>0</localframe>" << std::endl;
+  mapstream << "</fragment></fragments>" << std::endl;
+  mapstream << "</segment></segments>" << std::endl;
+  mapstream << "</molecule></molecules></topology>" << std::endl;
+  mapstream.close();
+
+  ofstream xyzstream("neon.xyz");
+  xyzstream << "1" << std::endl;
+  xyzstream << "neon" << std::endl;
+  xyzstream << "Ne 0.0 0.0 0.0" << std::endl;
+  xyzstream.close();
+
+  ofstream xyzstream2("neon_shifted.xyz");
+  xyzstream2 << "1" << std::endl;
+  xyzstream2 << "neon shifted" << std::endl;
+  xyzstream2 << "Ne 0.1 0.0 0.0" << std::endl;
+  xyzstream2.close();
+
+  ofstream mpsstream("neon_n.mps");
+  mpsstream << "! Neon" << std::endl;
+  mpsstream << "Units angstrom" << std::endl;
+  mpsstream << "Ne 0.0 0.0 0.0 Rank 0" << std::endl;
+  mpsstream << "+0.0" << std::endl;
+  mpsstream << "P +0.4" << std::endl;
+  mpsstream.close();
+}
+
+Topology NeonTopology() {
+  Topology top;
+  Eigen::Matrix3d box = 40.0 * Eigen::Matrix3d::Identity();
+  top.setBox(box);
+  std::vector<Eigen::Vector3d> positions = {
+      Eigen::Vector3d(0, 0, 0), Eigen::Vector3d(5, 0, 0),
+      Eigen::Vector3d(0, 6, 0), Eigen::Vector3d(20, 20, 20)};
+  for (Index i = 0; i < Index(positions.size()); i++) {
+    Segment& seg = top.AddSegment("Neon");
+    seg.push_back(Atom(0, "Ne", i, positions[i], "Ne"));
+  }
+  return top;
+}
+
+votca::tools::Property NeonRegions() {
+  votca::tools::Property regions;
+  votca::tools::Property& qm = regions.add("qmregion", "");
+  qm.add("id", "0");
+  qm.add("segments", "jobfile");
+  qm.add("state", "n");
+  qm.add("grid_for_potential", "medium");
+  qm.add("field_accuracy", "1e-4");
+  qm.add("tolerance_energy", "1e-6");
+  qm.add("tolerance_density", "1e-5");
+  qm.add("dftpackage", "");
+  votca::tools::Property& mm = regions.add("staticregion", "");
+  mm.add("id", "1");
+  votca::tools::Property& cutoff = mm.add("cutoff", "");
+  cutoff.add("radius", "0.5");
+  cutoff.add("geometry", "n");
+  cutoff.add("region", "0");
+  cutoff.add("explicit_segs", "false");
+  return regions;
+}
+
+void SetJobSegments(Job& job, const std::string& segments) {
+  votca::tools::Property input;
+  votca::tools::Property& qm = input.add("regions", "").add("qmregion", "");
+  qm.add("id", "0");
+  qm.add("segments", segments);
+  job.getInput() = input;
+}
+
+BOOST_AUTO_TEST_CASE(update_regions) {
+  WriteNeonFiles();
+  Topology top = NeonTopology();
+  std::pair<std::string, votca::tools::Property> options("neon_map.xml",
+                                                         NeonRegions());
+  votca::tools::Property empty_input;
+  empty_input.add("input", "");
+  Job job(0, "neon", empty_input, Job::AVAILABLE);
+  Logger log;
+  JobTopology jobtop(job, log, ".");
+
+  SetJobSegments(job, "0:n");
+  jobtop.BuildRegions(top, options);
+  BOOST_CHECK_EQUAL(jobtop.size(), 2);
+  const Region* qm_first = jobtop.Regions()[0].get();
+  const Region* mm_first = jobtop.Regions()[1].get();
+  BOOST_CHECK_EQUAL(qm_first->identify(), "qmregion");
+  BOOST_CHECK_EQUAL(mm_first->identify(), "staticregion");
+  BOOST_CHECK_EQUAL(mm_first->size(), 2);
+
+  // another state of the same segment, only the qm region is rebuilt
+  SetJobSegments(job, "0:neon_shifted.xyz");
+  jobtop.UpdateRegions(top, options);
+  BOOST_CHECK_EQUAL(jobtop.size(), 2);
+  BOOST_CHECK(jobtop.Regions()[0].get() != qm_first);
+  BOOST_CHECK(jobtop.Regions()[1].get() == mm_first);
+  BOOST_CHECK_EQUAL(jobtop.Regions()[0]->getId(), 0);
+  BOOST_CHECK_EQUAL(jobtop.Regions()[1]->getId(), 1);
+
+  // a different centre changes the environment, all regions are rebuilt
+  const Region* qm_second = jobtop.Regions()[0].get();
+  SetJobSegments(job, "1:n");
+  jobtop.UpdateRegions(top, options);
+  BOOST_CHECK_EQUAL(jobtop.size(), 2);
+  BOOST_CHECK(jobtop.Regions()[0].get() != qm_second);
+  BOOST_CHECK(jobtop.Regions()[1].get() != mm_first);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
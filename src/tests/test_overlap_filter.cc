@@ -18,12 +18,16 @@
 #define BOOST_TEST_MODULE overlap_filter_test
 
 // Standard includes
+#include <algorithm>
 #include <iostream>
+#include <numeric>
+#include <sstream>
 
 // Third party includes
 #include <boost/test/unit_test.hpp>
 
 // Local VOTCA includes
+#include <votca/xtp/aomatrix.h>
 #include <votca/xtp/filterfactory.h>
 
 // VOTCA includes
@@ -160,4 +164,170 @@ BOOST_AUTO_TEST_CASE(coeffs_test) {
   libint2::finalize();
 }
 
+Orbitals MethaneOrbitals() {
+  Orbitals A;
+  A.setDFTbasisName(std::string(XTP_TEST_DATA_FOLDER) +
+                    "/overlap_filter/3-21G.xml");
+  A.QMAtoms().LoadFromFile(std::string(XTP_TEST_DATA_FOLDER) +
+                           "/overlap_filter/molecule.xyz");
+  A.setBasisSetSize(17);
+  A.setNumberOfAlphaElectrons(5);
+  A.setNumberOfOccupiedLevels(5);
+  A.MOs().eigenvalues() = Eigen::VectorXd::Zero(17);
+  A.MOs().eigenvalues() << -19.8117, -6.22408, -6.14094, -6.14094, -6.14094,
+      -3.72889, -3.72889, -3.72889, -3.64731, -3.09048, -3.09048, -3.09048,
+      -2.63214, -2.08206, -2.08206, -2.08206, -2.03268;
+  A.MOs().eigenvectors() = votca::tools::EigenIO_MatrixMarket::ReadMatrix(
+      std::string(XTP_TEST_DATA_FOLDER) + "/overlap_filter/MOs_A.mm");
+  A.setBSEindices(0, 16);
+  A.setGWindices(0, 16);
+  return A;
+}
+
+std::unique_ptr<StateFilter_base> OverlapFilter(double threshold) {
+  std::stringstream value;
+  value.precision(17);
+  value << threshold;
+  votca::tools::Property prop;
+  prop.add("overlap", value.str());
+  std::unique_ptr<StateFilter_base> filter =
+      std::unique_ptr<StateFilter_base>(Filter().Create("overlap"));
+  filter->Initialize(prop.get("overlap"));
+  return filter;
+}
+
+// the overlap of two excitons as the sum over their AO matrices, the way the
+// filter computed it before it worked in the space of the BSE levels
+double AOExcitonOverlap(const Orbitals& A, const Eigen::VectorXd& x,
+                        const Orbitals& B, const Eigen::VectorXd& y,
+                        const Eigen::MatrixXd& S) {
+  votca::Index vtotal = A.getBSEvmax() - A.getBSEvmin() + 1;
+  votca::Index ctotal = A.getBSEcmax() - A.getBSEcmin() + 1;
+  auto aomatrix = [&](const Orbitals& orb, const Eigen::VectorXd& coeffs) {
+    Eigen::Map<const Eigen::MatrixXd> mat(coeffs.data(), ctotal, vtotal);
+    return Eigen::MatrixXd(
+        orb.MOs().eigenvectors().middleCols(orb.getBSEvmin(), vtotal) *
+        mat.transpose() *
+        orb.MOs().eigenvectors().middleCols(orb.getBSEcmin(), ctotal)
+            .transpose());
+  };
+  return (aomatrix(A, x) * S * aomatrix(B, y).transpose())
+      .cwiseProduct(S)
+      .sum();
+}
+
+BOOST_AUTO_TEST_CASE(projected_overlap_test) {
+  libint2::initialize();
+  FilterFactory::RegisterAll();
+  Orbitals A = MethaneOrbitals();
+  AOOverlap S_ao;
+  S_ao.Fill(A.SetupDftBasis());
+  const Eigen::MatrixXd& S = S_ao.Matrix();
+
+  // the last state comes from rotated MOs and a mixture of the degenerate
+  // excitons, so that the levels of A and B differ and no overlaps coincide
+  Eigen::MatrixXd mixing(17, 17);
+  for (votca::Index i = 0; i < 17; i++) {
+    for (votca::Index j = 0; j < 17; j++) {
+      mixing(i, j) = (i == j) ? 1.0 : 0.1 * std::sin(double(i + 2 * j));
+    }
+  }
+  Eigen::MatrixXd U =
+      Eigen::HouseholderQR<Eigen::MatrixXd>(mixing).householderQ();
+  Eigen::Matrix3d exciton_mixing;
+  exciton_mixing << 0.9, 0.3, -0.2, 0.1, 0.8, 0.5, -0.4, 0.2, 0.7;
+  Eigen::Matrix3d R =
+      Eigen::HouseholderQR<Eigen::Matrix3d>(exciton_mixing).householderQ();
+
+  for (bool tda : {true, false}) {
+    std::string suffix = tda ? "" : "_btda";
+    A.setTDAApprox(tda);
+    A.BSESinglets().eigenvectors() =
+        votca::tools::EigenIO_MatrixMarket::ReadMatrix(
+            std::string(XTP_TEST_DATA_FOLDER) + "/overlap_filter/spsi_ref" +
+            suffix + ".mm");
+    if (!tda) {
+      A.BSESinglets().eigenvectors2() =
+          votca::tools::EigenIO_MatrixMarket::ReadMatrix(
+              std::string(XTP_TEST_DATA_FOLDER) +
+              "/overlap_filter/spsi_ref_btda_AR.mm");
+    }
+    Orbitals B = A;
+    B.MOs().eigenvectors() = A.MOs().eigenvectors() * U;
+    B.BSESinglets().eigenvectors() = A.BSESinglets().eigenvectors() * R;
+    if (!tda) {
+      B.BSESinglets().eigenvectors2() = A.BSESinglets().eigenvectors2() * R;
+    }
+
+    votca::Index nstates = A.BSESinglets().eigenvectors().cols();
+    Eigen::VectorXd reference(nstates);
+    for (votca::Index i = 0; i < nstates; i++) {
+      reference(i) =
+          AOExcitonOverlap(A, A.BSESinglets().eigenvectors().col(i), B,
+                           B.BSESinglets().eigenvectors().col(0), S);
+      if (!tda) {
+        reference(i) -=
+            AOExcitonOverlap(A, A.BSESinglets().eigenvectors2().col(i), B,
+                             B.BSESinglets().eigenvectors2().col(0), S);
+      }
+    }
+    reference = reference.cwiseAbs();
+    std::vector<votca::Index> ref_order(nstates);
+    std::iota(ref_order.begin(), ref_order.end(), 0);
+    std::sort(ref_order.begin(), ref_order.end(),
+              [&](votca::Index i, votca::Index j) {
+                return reference(i) > reference(j);
+              });
+
+    std::unique_ptr<StateFilter_base> all = OverlapFilter(0.0);
+    all->UpdateHist(B, QMState("s1"));
+    std::vector<votca::Index> order = all->CalcIndeces(A, QMStateType::Singlet);
+    BOOST_CHECK_EQUAL_COLLECTIONS(order.begin(), order.end(),
+                                  ref_order.begin(), ref_order.end());
+
+    // a threshold between two reference overlaps separates them
+    double threshold =
+        0.5 * (reference(ref_order[0]) + reference(ref_order[1]));
+    std::unique_ptr<StateFilter_base> best = OverlapFilter(threshold);
+    best->UpdateHist(B, QMState("s1"));
+    std::vector<votca::Index> found =
+        best->CalcIndeces(A, QMStateType::Singlet);
+    BOOST_CHECK_EQUAL(found.size(), size_t(1));
+    BOOST_CHECK_EQUAL(found[0], ref_order[0]);
+  }
+  libint2::finalize();
+}
+
+BOOST_AUTO_TEST_CASE(old_checkpoint_test) {
+  libint2::initialize();
+  FilterFactory::RegisterAll();
+  Orbitals A = MethaneOrbitals();
+  A.setTDAApprox(true);
+  A.BSESinglets().eigenvectors() =
+      votca::tools::EigenIO_MatrixMarket::ReadMatrix(
+          std::string(XTP_TEST_DATA_FOLDER) + "/overlap_filter/spsi_ref.mm");
+
+  // older versions stored excitons as basis^2 AO coefficients without a
+  // version, single particle states as AO coefficients
+  {
+    CheckpointFile f("overlap_filter_old.hdf5");
+    CheckpointWriter w = f.getWriter();
+    Eigen::VectorXd aocoeffs = A.MOs().eigenvectors().col(8);
+    w(aocoeffs, "laststatecoeff");
+    w(0.0045, "threshold");
+  }
+  std::unique_ptr<StateFilter_base> filter = OverlapFilter(0.0);
+  CheckpointFile f("overlap_filter_old.hdf5");
+  CheckpointReader r = f.getReader();
+  filter->ReadFromCpt(r);
+
+  std::vector<votca::Index> results =
+      filter->CalcIndeces(A, QMStateType::PQPstate);
+  BOOST_CHECK_EQUAL(results.size(), size_t(1));
+  BOOST_CHECK_EQUAL(results[0], 8);
+  BOOST_CHECK_THROW(filter->CalcIndeces(A, QMStateType::Singlet),
+                    std::runtime_error);
+  libint2::finalize();
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,363 @@
+/*
+ * Copyright 2009-2020 The VOTCA Development Team (http://www.votca.org)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+#define BOOST_TEST_MAIN
+
+#define BOOST_TEST_MODULE polarregion_test
+
+// Standard includes
+#include <iostream>
+
+// Third party includes
+#include <boost/lexical_cast.hpp>
+#include <boost/test/unit_test.hpp>
+
+// Local VOTCA includes
+#include "votca/xtp/checkpoint.h"
+#include "votca/xtp/dipolehistory.h"
+#include "votca/xtp/ewaldsum.h"
+#include "votca/xtp/polarregion.h"
+#include "votca/xtp/staticregion.h"
+
+using namespace votca::xtp;
+using namespace votca;
+
+BOOST_AUTO_TEST_SUITE(polarregion_test)
+
+BOOST_AUTO_TEST_CASE(dipole_history_extrapolation) {
+  Index size = 9;
+  Eigen::MatrixXd R = Eigen::MatrixXd::Random(size, size);
+  Eigen::MatrixXd A =
+      R.transpose() * R + Eigen::MatrixXd::Identity(size, size);
+  Eigen::VectorXd b0 = Eigen::VectorXd::Random(size);
+  Eigen::VectorXd db = Eigen::VectorXd::Random(size);
+  auto solve = [&](double t) -> Eigen::VectorXd {
+    return A.ldlt().solve(b0 + t * db);
+  };
+
+  DipoleHistory history;
+  history.setMaxSize(2);
+  for (Index step = 0; step < 5; step++) {
+    history.push_back(b0 + double(step) * db, solve(double(step)));
+  }
+  BOOST_CHECK_EQUAL(history.size(), 2);
+
+  // the fields of a linear sequence lie in the span of the last two, so the
+  // extrapolation is exact
+  for (double t : {5.0, 7.5, -1.0}) {
+    Eigen::VectorXd guess = history.Extrapolate(b0 + t * db);
+    bool check = guess.isApprox(solve(t), 1e-8);
+    if (!check) {
+      std::cout << "t=" << t << std::endl;
+      std::cout << "guess" << std::endl;
+      std::cout << guess.transpose() << std::endl;
+      std::cout << "ref" << std::endl;
+      std::cout << solve(t).transpose() << std::endl;
+    }
+    BOOST_CHECK_EQUAL(check, true);
+  }
+
+  history.clear();
+  BOOST_CHECK(history.empty());
+  history.setMaxSize(0);
+  history.push_back(b0, solve(0.0));
+  BOOST_CHECK(history.empty());
+}
+
+tools::Property PolarOptions(double tolerance_dipole,
+                             double tolerance_dipole_max) {
+  tools::Property prop;
+  prop.add("max_iter", "200");
+  prop.add("tolerance_energy", "1e-5");
+  prop.add("tolerance_dipole",
+           boost::lexical_cast<std::string>(tolerance_dipole));
+  prop.add("tolerance_dipole_max",
+           boost::lexical_cast<std::string>(tolerance_dipole_max));
+  prop.add("dipole_history", "3");
+  prop.add("exp_damp", "0.39");
+  prop.add("nearfield_cutoff", "0.0");
+  prop.add("nearfield_memory", "0.0");
+  prop.add("farfield_cellsize", "0.0");
+  prop.add("farfield_accuracy", "0.3");
+  prop.add("ewald_tolerance", "0.0");
+  return prop;
+}
+
+BOOST_AUTO_TEST_CASE(dipole_tolerance) {
+  Logger log;
+  double tolerance_dipole = 1e-6;
+  double tolerance_dipole_max = 1e-3;
+
+  std::unique_ptr<PolarRegion> polar = std::make_unique<PolarRegion>(0, log);
+  polar->Initialize(PolarOptions(tolerance_dipole, tolerance_dipole_max));
+  std::vector<Eigen::Vector3d> positions = {
+      Eigen::Vector3d(0, 0, 0), Eigen::Vector3d(3, 0, 0),
+      Eigen::Vector3d(0, 3.5, 0), Eigen::Vector3d(0, 0, 4)};
+  for (Index i = 0; i < Index(positions.size()); i++) {
+    PolarSegment seg("polar", i);
+    PolarSite site(0, "C", positions[i]);
+    site.setCharge(i % 2 == 0 ? 0.5 : -0.5);
+    site.setpolarization(8.0 * Eigen::Matrix3d::Identity());
+    seg.push_back(site);
+    polar->push_back(seg);
+  }
+
+  std::unique_ptr<StaticRegion> environment =
+      std::make_unique<StaticRegion>(1, log);
+  StaticSegment seg("static", 0);
+  seg.push_back(StaticSite(0, "C", Eigen::Vector3d(10, 1, 2)));
+  environment->push_back(seg);
+  StaticRegion* env = environment.get();
+  PolarRegion* pol = polar.get();
+
+  std::vector<std::unique_ptr<Region>> regions;
+  regions.push_back(std::move(polar));
+  regions.push_back(std::move(environment));
+
+  // without a previous energy the dipoles are solved to tolerance_dipole
+  pol->Reset();
+  pol->Evaluate(regions);
+  BOOST_CHECK_CLOSE(pol->DipoleTolerance(), tolerance_dipole, 1e-8);
+
+  // the energy still changes by much more than tolerance_energy, so the
+  // tolerance is loosened as far as tolerance_dipole_max
+  (*env)[0][0].setCharge(1.0);
+  pol->Reset();
+  pol->Evaluate(regions);
+  BOOST_CHECK_CLOSE(pol->DipoleTolerance(), tolerance_dipole_max, 1e-8);
+  BOOST_CHECK(!pol->Converged());
+
+  // with a fixed environment it tightens again and the region only converges
+  // after an evaluation at tolerance_dipole
+  double last_tolerance = pol->DipoleTolerance();
+  bool converged = false;
+  for (Index iteration = 0; iteration < 10 && !converged; iteration++) {
+    pol->Reset();
+    pol->Evaluate(regions);
+    BOOST_CHECK(pol->DipoleTolerance() <= last_tolerance);
+    last_tolerance = pol->DipoleTolerance();
+    converged = pol->Converged();
+  }
+  BOOST_CHECK(converged);
+  BOOST_CHECK_CLOSE(pol->DipoleTolerance(), tolerance_dipole, 1e-8);
+}
+
+// one polarisable point charge per segment
+std::unique_ptr<PolarRegion> ChargeRegion(
+    Logger& log, const tools::Property& options,
+    const std::vector<Eigen::Vector3d>& positions,
+    const std::vector<double>& charges, double polarisability) {
+  std::unique_ptr<PolarRegion> polar = std::make_unique<PolarRegion>(0, log);
+  polar->Initialize(options);
+  for (Index i = 0; i < Index(positions.size()); i++) {
+    PolarSegment seg("polar", i);
+    PolarSite site(0, "C", positions[i]);
+    site.setCharge(charges[i]);
+    site.setpolarization(polarisability * Eigen::Matrix3d::Identity());
+    seg.push_back(site);
+    polar->push_back(seg);
+  }
+  return polar;
+}
+
+// resets and evaluates a region on its own
+double EvaluateAlone(PolarRegion& polar) {
+  Logger log;
+  std::vector<std::unique_ptr<Region>> regions;
+  regions.push_back(std::make_unique<StaticRegion>(1, log));
+  polar.Reset();
+  polar.Evaluate(regions);
+  return polar.Etotal();
+}
+
+BOOST_AUTO_TEST_CASE(nearfield_tensors_follow_geometry) {
+  Logger log;
+  tools::Property options = PolarOptions(1e-9, 1e-9);
+  options.set("nearfield_cutoff", "3.0");
+  options.set("nearfield_memory", "100");
+  std::vector<Eigen::Vector3d> positions = {
+      Eigen::Vector3d(0, 0, 0), Eigen::Vector3d(3, 0, 0),
+      Eigen::Vector3d(0, 3.5, 0), Eigen::Vector3d(0, 0, 4)};
+  const std::vector<double> charges = {0.5, -0.5, 0.5, -0.5};
+
+  std::unique_ptr<PolarRegion> polar =
+      ChargeRegion(log, options, positions, charges, 8.0);
+  EvaluateAlone(*polar);
+  // same number of sites, but the stored tensors no longer fit
+  positions[1] = Eigen::Vector3d(2, 1, 0);
+  (*polar)[1][0].setPos(positions[1]);
+  double e_moved = EvaluateAlone(*polar);
+
+  std::unique_ptr<PolarRegion> fresh =
+      ChargeRegion(log, options, positions, charges, 8.0);
+  double e_fresh = EvaluateAlone(*fresh);
+  bool check = std::abs(e_moved - e_fresh) < 1e-8;
+  if (!check) {
+    std::cout << "moved " << e_moved << " fresh " << e_fresh << std::endl;
+  }
+  BOOST_CHECK_EQUAL(check, true);
+}
+
+BOOST_AUTO_TEST_CASE(periodic_field_checkpoint) {
+  Logger log;
+  tools::Property options = PolarOptions(1e-8, 1e-8);
+  options.set("ewald_tolerance", "1e-8");
+  const std::vector<Eigen::Vector3d> positions = {Eigen::Vector3d(9, 10, 10),
+                                                  Eigen::Vector3d(12, 10, 10),
+                                                  Eigen::Vector3d(10, 13, 11)};
+  const std::vector<double> charges = {0.4, -0.2, -0.2};
+
+  // a neutral dipolar cell, none of its sites belong to the region
+  Eigen::Matrix3d box = 20.0 * Eigen::Matrix3d::Identity();
+  std::vector<StaticSite> lattice = {
+      StaticSite(0, "C", Eigen::Vector3d(2, 3, 4)),
+      StaticSite(1, "C", Eigen::Vector3d(5, 3, 4))};
+  lattice[0].setCharge(1.0);
+  lattice[1].setCharge(-1.0);
+  std::vector<const StaticSite*> sites = {&lattice[0], &lattice[1]};
+  EwaldSum ewald(box, 1e-8, sites, {false, false}, 3);
+
+  std::unique_ptr<PolarRegion> polar =
+      ChargeRegion(log, options, positions, charges, 8.0);
+  polar->CalcPeriodicField(ewald);
+  {
+    CheckpointFile ff("polarregion_test.hdf5", CheckpointAccessLevel::CREATE);
+    CheckpointWriter ww = ff.getWriter();
+    polar->WriteToCpt(ww);
+  }
+  double e_periodic = EvaluateAlone(*polar);
+  std::unique_ptr<PolarRegion> open =
+      ChargeRegion(log, options, positions, charges, 8.0);
+  double e_open = EvaluateAlone(*open);
+
+  // like a restarted job, the region is only read from the checkpoint
+  std::unique_ptr<PolarRegion> restarted =
+      std::make_unique<PolarRegion>(0, log);
+  {
+    CheckpointFile ff("polarregion_test.hdf5", CheckpointAccessLevel::READ);
+    CheckpointReader rr = ff.getReader();
+    restarted->ReadFromCpt(rr);
+  }
+  BOOST_CHECK_CLOSE(restarted->EwaldTolerance(), 1e-8, 1e-8);
+  restarted->Initialize(options);
+  double e_restarted = EvaluateAlone(*restarted);
+
+  BOOST_CHECK(std::abs(e_periodic - e_open) > 1e-4);
+  bool check = std::abs(e_restarted - e_periodic) < 1e-8;
+  if (!check) {
+    std::cout << "periodic " << e_periodic << " restarted " << e_restarted
+              << " open " << e_open << std::endl;
+  }
+  BOOST_CHECK_EQUAL(check, true);
+}
+
+// induced dipoles of a region in a periodic box whose permanent and induced
+// images act on it
+Eigen::MatrixXd PeriodicDipoles(const Eigen::Matrix3d& box,
+                                const std::vector<Eigen::Vector3d>& positions,
+                                const std::vector<double>& charges,
+                                bool periodic) {
+  Logger log;
+  tools::Property options = PolarOptions(1e-10, 1e-10);
+  options.set("ewald_tolerance", "1e-10");
+  std::unique_ptr<PolarRegion> polar =
+      ChargeRegion(log, options, positions, charges, 2.0);
+  if (periodic) {
+    std::vector<const StaticSite*> sites;
+    for (const PolarSegment& seg : *polar) {
+      sites.push_back(&seg[0]);
+    }
+    EwaldSum ewald(box, 1e-10, sites, std::vector<bool>(sites.size(), true),
+                   Index(sites.size()));
+    polar->CalcPeriodicField(ewald);
+  }
+  EvaluateAlone(*polar);
+  Eigen::MatrixXd dipoles(positions.size(), 3);
+  for (Index i = 0; i < polar->size(); i++) {
+    dipoles.row(i) = (*polar)[i][0].Induced_Dipole().transpose();
+  }
+  return dipoles;
+}
+
+BOOST_AUTO_TEST_CASE(periodic_induced_dipoles) {
+  // the first two sites are close through the cell boundary, so the Thole
+  // damping acts between images
+  const double L = 14.0;
+  const std::vector<Eigen::Vector3d> positions = {
+      Eigen::Vector3d(0.6, 7, 7), Eigen::Vector3d(13.0, 7.8, 7),
+      Eigen::Vector3d(7, 2, 10), Eigen::Vector3d(7, 11, 3)};
+  const std::vector<double> charges = {0.5, -0.5, 0.3, -0.3};
+  const Eigen::Matrix3d box = L * Eigen::Matrix3d::Identity();
+  Eigen::MatrixXd cell = PeriodicDipoles(box, positions, charges, true);
+  Eigen::MatrixXd open = PeriodicDipoles(box, positions, charges, false);
+  BOOST_CHECK(!cell.isApprox(open, 1e-2));
+
+  // the same crystal from a 2x2x2 supercell gives the same dipoles in every
+  // copy of the cell
+  std::vector<Eigen::Vector3d> super_positions;
+  std::vector<double> super_charges;
+  for (Index copy = 0; copy < 8; copy++) {
+    const Eigen::Vector3d shift(double(copy % 2), double((copy / 2) % 2),
+                                double(copy / 4));
+    for (Index i = 0; i < Index(positions.size()); i++) {
+      super_positions.push_back(positions[i] + L * shift);
+      super_charges.push_back(charges[i]);
+    }
+  }
+  Eigen::MatrixXd super =
+      PeriodicDipoles(2 * box, super_positions, super_charges, true);
+  for (Index copy = 0; copy < 8; copy++) {
+    Eigen::MatrixXd copy_dipoles =
+        super.block(copy * Index(positions.size()), 0, positions.size(), 3);
+    bool check = copy_dipoles.isApprox(cell, 1e-6);
+    if (!check) {
+      std::cout << "copy " << copy << std::endl;
+      std::cout << copy_dipoles << std::endl;
+      std::cout << "cell" << std::endl;
+      std::cout << cell << std::endl;
+    }
+    BOOST_CHECK_EQUAL(check, true);
+  }
+}
+
+BOOST_AUTO_TEST_CASE(static_region_periodic_energy) {
+  Logger log;
+  StaticRegion region(0, log);
+  tools::Property options;
+  options.add("ewald_tolerance", "1e-10");
+  region.Initialize(options);
+  BOOST_CHECK_CLOSE(region.EwaldTolerance(), 1e-10, 1e-8);
+  StaticSegment seg("static", 0);
+  StaticSite charge(0, "C", Eigen::Vector3d(1, 2, 3));
+  charge.setCharge(0.7);
+  seg.push_back(charge);
+  StaticSite quadrupole(1, "C", Eigen::Vector3d(4, 2, 3));
+  Vector9d multipoles;
+  multipoles << -0.7, 0.1, 0.2, -0.1, 0.3, -0.2, 0.1, 0.05, -0.15;
+  quadrupole.setMultipole(multipoles, 2);
+  seg.push_back(quadrupole);
+  region.push_back(seg);
+
+  std::vector<const StaticSite*> sites = {&region[0][0], &region[0][1]};
+  Eigen::Matrix3d box = 12.0 * Eigen::Matrix3d::Identity();
+  EwaldSum ewald(box, 1e-10, sites, {true, true}, 2);
+  region.CalcPeriodicField(ewald);
+  double ref = 0.7 * ewald.Field<4>(charge.getPos())(0) +
+               ewald.Field<9>(quadrupole.getPos()).dot(multipoles);
+  BOOST_CHECK_CLOSE(region.Etotal(), ref, 1e-8);
+  BOOST_CHECK(std::abs(ref) > 1e-4);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,95 @@
+/*
+ * Copyright 2009-2020 The VOTCA Development Team (http://www.votca.org)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+#define BOOST_TEST_MAIN
+
+#define BOOST_TEST_MODULE segmentcelllist_test
+
+// Standard includes
+#include <iostream>
+
+// Third party includes
+#include <boost/test/unit_test.hpp>
+
+// Local VOTCA includes
+#include "votca/xtp/eeinteractor.h"
+#include "votca/xtp/segmentcelllist.h"
+
+using namespace votca::xtp;
+using namespace votca;
+
+BOOST_AUTO_TEST_SUITE(segmentcelllist_test)
+
+BOOST_AUTO_TEST_CASE(cells_and_expansion) {
+
+  std::vector<StaticSegment> segments;
+  for (Index i = 0; i < 3; i++) {
+    StaticSegment seg("seg", i);
+    for (Index j = 0; j < 2; j++) {
+      StaticSite site(2 * i + j, "C");
+      site.setPos(Eigen::Vector3d(0.5 * double(i), 0.7 * double(j), 0.2));
+      Vector9d multipoles = Vector9d::Zero();
+      multipoles(0) = 0.3 - 0.1 * double(i + j);
+      multipoles.segment<3>(1) = Eigen::Vector3d(0.1, -0.2, 0.05 * double(i));
+      multipoles.segment<5>(4) << 0.1, -0.05, 0.02, 0.03, -0.1;
+      site.setMultipole(multipoles, 2);
+      seg.push_back(site);
+    }
+    segments.push_back(seg);
+  }
+  // far away segment in its own cell
+  StaticSegment far("far", 3);
+  StaticSite farsite(6, "C");
+  farsite.setPos(Eigen::Vector3d(40.0, 0.0, 0.0));
+  farsite.setCharge(1.0);
+  far.push_back(farsite);
+  segments.push_back(far);
+
+  SegmentCellList cells(segments, 5.0);
+  BOOST_CHECK_EQUAL(cells.size(), 2);
+  BOOST_CHECK_EQUAL(cells.Segments(0).size(), 3);
+  BOOST_CHECK_EQUAL(cells.Segments(1).size(), 1);
+
+  PolarSegment target("target", 10);
+  PolarSite probe(0, "H", Eigen::Vector3d(0.5, 0.4, 60.0));
+  probe.setCharge(1.0);
+  target.push_back(probe);
+  BOOST_CHECK_EQUAL(cells.isFar(0, target.getPos(), 0.0, 0.3), true);
+  BOOST_CHECK_EQUAL(cells.isFar(1, segments[3].getPos(), 0.0, 0.3), false);
+
+  eeInteractor interactor;
+  PolarSegment exact = target;
+  double e_exact = 0.0;
+  for (Index i = 0; i < 3; i++) {
+    e_exact += interactor.ApplyStaticField<StaticSegment, Estatic::V>(
+        segments[i], exact);
+  }
+  PolarSegment expanded = target;
+  double e_expanded = interactor.ApplyStaticField<StaticSegment, Estatic::V>(
+      cells.Expansion(0), expanded);
+
+  // neglected octupoles decay with distance^-4
+  BOOST_CHECK_CLOSE(e_expanded, e_exact, 1e-3);
+  bool field_check = expanded[0].V().isApprox(exact[0].V(), 1e-4);
+  BOOST_CHECK_EQUAL(field_check, true);
+  if (!field_check) {
+    std::cout << "exact" << std::endl;
+    std::cout << exact[0].V().transpose() << std::endl;
+    std::cout << "expansion" << std::endl;
+    std::cout << expanded[0].V().transpose() << std::endl;
+  }
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,129 @@
+/*
+ * Copyright 2009-2020 The VOTCA Development Team (http://www.votca.org)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+#define BOOST_TEST_MAIN
+
+#define BOOST_TEST_MODULE segmentindex_test
+
+// Standard includes
+#include <iostream>
+
+// Third party includes
+#include <boost/test/unit_test.hpp>
+
+// Local VOTCA includes
+#include "votca/xtp/segment.h"
+#include "votca/xtp/segmentindex.h"
+
+using namespace votca::xtp;
+using namespace votca;
+
+BOOST_AUTO_TEST_SUITE(segmentindex_test)
+
+void FillTopology(Topology& top) {
+  for (Index i = 0; i < 200; i++) {
+    Segment& seg = top.AddSegment("seg");
+    // deterministic scatter over the box, some outside of it
+    const Eigen::Vector3d pos(double((37 * i) % 101) * 0.21 - 1.0,
+                              double((53 * i) % 97) * 0.19,
+                              double((71 * i) % 89) * 0.23 + 0.5);
+    seg.push_back(Atom(i, "C", pos));
+  }
+}
+
+std::vector<Index> BruteForce(const Topology& top, const Eigen::Vector3d& pos,
+                              double radius) {
+  std::vector<Index> result;
+  for (const Segment& seg : top.Segments()) {
+    if (top.PbShortestConnect(pos, seg.getPos()).norm() < radius) {
+      result.push_back(seg.getId());
+    }
+  }
+  return result;
+}
+
+BOOST_AUTO_TEST_CASE(periodic_box) {
+  Topology top;
+  Eigen::Matrix3d box = Eigen::Matrix3d::Zero();
+  box.diagonal() << 20.0, 18.0, 21.0;
+  top.setBox(box);
+  FillTopology(top);
+
+  SegmentIndex index(top);
+  BOOST_CHECK(index.NumberOfCells() > 1);
+  // small radii, radii across the boundary and larger than half the box
+  std::vector<double> radii = {0.5, 2.5, 6.0, 9.5, 15.0};
+  for (Index i = 0; i < 20; i++) {
+    const Eigen::Vector3d pos = top.getSegment(i * 7).getPos();
+    for (double radius : radii) {
+      std::vector<Index> found = index.FindSegments(pos, radius);
+      std::vector<Index> ref = BruteForce(top, pos, radius);
+      bool check = (found == ref);
+      if (!check) {
+        std::cout << "radius " << radius << " found " << found.size()
+                  << " ref " << ref.size() << std::endl;
+      }
+      BOOST_CHECK_EQUAL(check, true);
+    }
+  }
+}
+
+BOOST_AUTO_TEST_CASE(triclinic_box) {
+  Topology top;
+  // box vectors in the columns, skewed in all three directions
+  Eigen::Matrix3d box;
+  box.col(0) << 20.0, 0.0, 0.0;
+  box.col(1) << 6.0, 18.0, 0.0;
+  box.col(2) << -5.0, 4.0, 21.0;
+  top.setBox(box);
+  FillTopology(top);
+
+  SegmentIndex index(top);
+  BOOST_CHECK(index.NumberOfCells() > 1);
+  std::vector<double> radii = {0.5, 2.5, 6.0, 9.5, 15.0};
+  for (Index i = 0; i < 20; i++) {
+    // points inside and outside of the cell
+    const Eigen::Vector3d pos =
+        top.getSegment(i * 7).getPos() + double(i % 3 - 1) * box.col(2);
+    for (double radius : radii) {
+      std::vector<Index> found = index.FindSegments(pos, radius);
+      std::vector<Index> ref = BruteForce(top, pos, radius);
+      bool check = (found == ref);
+      if (!check) {
+        std::cout << "radius " << radius << " found " << found.size()
+                  << " ref " << ref.size() << std::endl;
+      }
+      BOOST_CHECK_EQUAL(check, true);
+    }
+  }
+}
+
+BOOST_AUTO_TEST_CASE(open_box) {
+  Topology top;
+  top.setBox(Eigen::Matrix3d::Zero());
+  FillTopology(top);
+
+  SegmentIndex index(top, 3.0);
+  const std::vector<Eigen::Vector3d> points = {Eigen::Vector3d(5, 5, 5),
+                                               Eigen::Vector3d(-4, 0, 30)};
+  for (const Eigen::Vector3d& pos : points) {
+    for (double radius : {1.0, 4.0, 12.0}) {
+      BOOST_CHECK(index.FindSegments(pos, radius) ==
+                  BruteForce(top, pos, radius));
+    }
+  }
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -37,6 +37,7 @@
 #include "votca/xtp/threecenter.h"
 #include <libint2/initialize.h>
 using namespace votca::xtp;
+using votca::Index;
 using namespace std;
 
 BOOST_AUTO_TEST_SUITE(sigma_test)
@@ -118,6 +119,37 @@ BOOST_AUTO_TEST_CASE(sigma_full) {
     cout << c_ref << endl;
   }
   BOOST_CHECK_EQUAL(check_c, true);
+
+  Eigen::VectorXd grid = Eigen::VectorXd::LinSpaced(21, -1.0, 1.0);
+  for (Index gw_level = 0; gw_level < 17; gw_level++) {
+    Eigen::VectorXd c_grid =
+        sigma->CalcCorrelationDiagElementOnGrid(gw_level, grid);
+    Eigen::VectorXd dc_grid =
+        sigma->CalcCorrelationDiagElementDerivativeOnGrid(gw_level, grid);
+    Eigen::VectorXd c_grid_ref = Eigen::VectorXd::Zero(grid.size());
+    Eigen::VectorXd dc_grid_ref = Eigen::VectorXd::Zero(grid.size());
+    for (Index i = 0; i < grid.size(); i++) {
+      c_grid_ref(i) = sigma->CalcCorrelationDiagElement(gw_level, grid(i));
+      dc_grid_ref(i) =
+          sigma->CalcCorrelationDiagElementDerivative(gw_level, grid(i));
+    }
+    bool check_c_grid = c_grid.isApprox(c_grid_ref, 1e-9);
+    if (!check_c_grid) {
+      cout << "Sigma C grid level " << gw_level << endl;
+      cout << c_grid.transpose() << endl;
+      cout << "Sigma C grid ref" << endl;
+      cout << c_grid_ref.transpose() << endl;
+    }
+    BOOST_CHECK_EQUAL(check_c_grid, true);
+    bool check_dc_grid = dc_grid.isApprox(dc_grid_ref, 1e-9);
+    if (!check_dc_grid) {
+      cout << "dSigma C grid level " << gw_level << endl;
+      cout << dc_grid.transpose() << endl;
+      cout << "dSigma C grid ref" << endl;
+      cout << dc_grid_ref.transpose() << endl;
+    }
+    BOOST_CHECK_EQUAL(check_dc_grid, true);
+  }
   libint2::finalize();
 }
 
@@ -30,6 +30,7 @@
 #include "votca/xtp/threecenter.h"
 #include <libint2/initialize.h>
 using namespace votca::xtp;
+using votca::Index;
 using namespace std;
 
 BOOST_AUTO_TEST_SUITE(threecenter_gwbse_test)
@@ -124,4 +125,89 @@ BOOST_AUTO_TEST_CASE(threecenter_gwbse) {
 
   libint2::finalize();
 }
+
+BOOST_AUTO_TEST_CASE(threecenter_gwbse_rebuild_from_ao) {
+  libint2::initialize();
+  QMMolecule mol(" ", 0);
+  mol.LoadFromFile(std::string(XTP_TEST_DATA_FOLDER) +
+                   "/threecenter_gwbse/molecule.xyz");
+  BasisSet basis;
+  basis.Load(std::string(XTP_TEST_DATA_FOLDER) +
+             "/threecenter_gwbse/3-21G.xml");
+  AOBasis aobasis;
+  aobasis.Fill(basis, mol);
+
+  Eigen::MatrixXd MOs = votca::tools::EigenIO_MatrixMarket::ReadMatrix(
+      std::string(XTP_TEST_DATA_FOLDER) + "/threecenter_gwbse/MOs.mm");
+
+  TCMatrix_gwbse tc_ref;
+  tc_ref.Initialize(aobasis.AOBasisSize(), 0, 5, 0, 7);
+  tc_ref.Fill(aobasis, aobasis, MOs);
+
+  TCMatrix_gwbse tc;
+  tc.setKeepAO3c(true);
+  tc.Initialize(aobasis.AOBasisSize(), 0, 5, 0, 7);
+  tc.Fill(aobasis, aobasis, MOs);
+
+  // scramble the MO integrals, a rebuild has to restore them
+  Eigen::MatrixXd auxmatrix = 2 * Eigen::MatrixXd::Identity(
+                                      aobasis.AOBasisSize(),
+                                      aobasis.AOBasisSize());
+  tc.MultiplyRightWithAuxMatrix(auxmatrix);
+  tc.Rebuild();
+
+  for (Index i = 0; i < tc.msize(); i++) {
+    bool check_rebuild = tc_ref[i].isApprox(tc[i], 1e-10);
+    if (!check_rebuild) {
+      cout << "tc" << i << endl;
+      cout << tc[i] << endl;
+      cout << "tc" << i << "_ref" << endl;
+      cout << tc_ref[i] << endl;
+    }
+    BOOST_CHECK_EQUAL(check_rebuild, true);
+  }
+
+  libint2::finalize();
+}
+
+BOOST_AUTO_TEST_CASE(threecenter_gwbse_scratchfile) {
+  libint2::initialize();
+  QMMolecule mol(" ", 0);
+  mol.LoadFromFile(std::string(XTP_TEST_DATA_FOLDER) +
+                   "/threecenter_gwbse/molecule.xyz");
+  BasisSet basis;
+  basis.Load(std::string(XTP_TEST_DATA_FOLDER) +
+             "/threecenter_gwbse/3-21G.xml");
+  AOBasis aobasis;
+  aobasis.Fill(basis, mol);
+
+  Eigen::MatrixXd MOs = votca::tools::EigenIO_MatrixMarket::ReadMatrix(
+      std::string(XTP_TEST_DATA_FOLDER) + "/threecenter_gwbse/MOs.mm");
+
+  TCMatrix_gwbse tc_ref;
+  tc_ref.Initialize(aobasis.AOBasisSize(), 0, 5, 0, 7);
+  tc_ref.Fill(aobasis, aobasis, MOs);
+  BOOST_CHECK_EQUAL(tc_ref.isOutOfCore(), false);
+
+  // any limit smaller than the integrals forces the scratch file
+  TCMatrix_gwbse tc;
+  tc.setMaxMemory(1, ".");
+  tc.Initialize(aobasis.AOBasisSize(), 0, 5, 0, 7);
+  BOOST_CHECK_EQUAL(tc.isOutOfCore(), true);
+  BOOST_CHECK_EQUAL(tc.MemorySize(), tc_ref.MemorySize());
+  tc.Fill(aobasis, aobasis, MOs);
+
+  for (Index i = 0; i < tc.msize(); i++) {
+    bool check_scratch = tc_ref[i].isApprox(tc[i], 1e-10);
+    if (!check_scratch) {
+      cout << "tc" << i << endl;
+      cout << tc[i] << endl;
+      cout << "tc" << i << "_ref" << endl;
+      cout << tc_ref[i] << endl;
+    }
+    BOOST_CHECK_EQUAL(check_scratch, true);
+  }
+
+  libint2::finalize();
+}
 BOOST_AUTO_TEST_SUITE_END()